@@ -0,0 +1,307 @@
+#include "PVAssetPack.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace PVEngine
+{
+	PVAssetPack::PVAssetPack()
+	{
+	}
+
+
+	PVAssetPack::~PVAssetPack()
+	{
+		Close();
+	}
+
+	void PVAssetPack::Open(const std::string& filename)
+	{
+		Close();
+		mapFile(filename);
+
+		if (mappedSize < sizeof(PVPackFormat::Header))
+		{
+			Close();
+			throw std::runtime_error("Asset pack " + filename + " is truncated");
+		}
+
+		PVPackFormat::Header header;
+		memcpy(&header, mappedData, sizeof(header));
+		if (header.magic != PVPackFormat::Magic)
+		{
+			Close();
+			throw std::runtime_error(filename + " is not an asset pack");
+		}
+		if (header.version != PVPackFormat::Version)
+		{
+			Close();
+			throw std::runtime_error("Asset pack " + filename + " has unsupported version " + std::to_string(header.version));
+		}
+		if (header.fileSize != mappedSize || header.tocOffset > mappedSize
+			|| (mappedSize - header.tocOffset) / sizeof(PVPackFormat::TocEntry) < header.entryCount)
+		{
+			Close();
+			throw std::runtime_error("Asset pack " + filename + " is truncated");
+		}
+
+		entries.resize(header.entryCount);
+		memcpy(entries.data(), mappedData + header.tocOffset, header.entryCount * sizeof(PVPackFormat::TocEntry));
+
+		for (auto& entry : entries)
+		{
+			entry.name[PVPackFormat::MaxNameLength - 1] = '\0';
+			if (entry.offset > mappedSize || entry.size > mappedSize - entry.offset || entry.stride == 0)
+			{
+				std::string name = entry.name;
+				Close();
+				throw std::runtime_error("Asset pack " + filename + " has an invalid entry " + name);
+			}
+		}
+	}
+
+	void PVAssetPack::Close()
+	{
+		unmapFile();
+		entries.clear();
+	}
+
+	void PVAssetPack::Prefetch() const
+	{
+		const uint64_t pageSize = 4096;
+		volatile uint8_t sink = 0;
+		for (uint64_t offset = 0; offset < mappedSize; offset += pageSize)
+		{
+			sink ^= mappedData[offset];
+		}
+	}
+
+	const PVPackFormat::TocEntry* PVAssetPack::Find(const std::string& name) const
+	{
+		for (const auto& entry : entries)
+		{
+			if (name == entry.name)
+			{
+				return &entry;
+			}
+		}
+		return nullptr;
+	}
+
+	const PVPackFormat::TocEntry& PVAssetPack::Require(const std::string& name, PVPackFormat::BlobType type, uint32_t stride) const
+	{
+		const PVPackFormat::TocEntry* entry = Find(name);
+		if (entry == nullptr)
+		{
+			throw std::runtime_error("Asset pack has no blob named " + name);
+		}
+		if (entry->type != type || entry->stride != stride)
+		{
+			throw std::runtime_error("Asset pack blob " + name + " does not have the expected layout");
+		}
+		return *entry;
+	}
+
+	void PVAssetPack::mapFile(const std::string& filename)
+	{
+#ifdef _WIN32
+		HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			throw std::runtime_error("Failed to open asset pack " + filename);
+		}
+
+		LARGE_INTEGER size;
+		GetFileSizeEx(file, &size);
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr)
+		{
+			CloseHandle(file);
+			throw std::runtime_error("Failed to map asset pack " + filename);
+		}
+
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (view == nullptr)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			throw std::runtime_error("Failed to map asset pack " + filename);
+		}
+
+		fileHandle = file;
+		mappingHandle = mapping;
+		mappedData = static_cast<const uint8_t*>(view);
+		mappedSize = static_cast<uint64_t>(size.QuadPart);
+#else
+		int file = open(filename.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			throw std::runtime_error("Failed to open asset pack " + filename);
+		}
+
+		struct stat fileStat;
+		if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+		{
+			close(file);
+			throw std::runtime_error("Failed to map asset pack " + filename);
+		}
+
+		void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		// the mapping keeps its own reference to the file
+		close(file);
+		if (view == MAP_FAILED)
+		{
+			throw std::runtime_error("Failed to map asset pack " + filename);
+		}
+
+		mappedData = static_cast<const uint8_t*>(view);
+		mappedSize = static_cast<uint64_t>(fileStat.st_size);
+#endif
+	}
+
+	void PVAssetPack::unmapFile()
+	{
+		if (mappedData == nullptr)
+		{
+			return;
+		}
+
+#ifdef _WIN32
+		UnmapViewOfFile(mappedData);
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+		mappingHandle = nullptr;
+		fileHandle = nullptr;
+#else
+		munmap(const_cast<uint8_t*>(mappedData), static_cast<size_t>(mappedSize));
+#endif
+		mappedData = nullptr;
+		mappedSize = 0;
+	}
+
+	PVAssetPackWriter::PVAssetPackWriter()
+	{
+	}
+
+
+	PVAssetPackWriter::~PVAssetPackWriter()
+	{
+	}
+
+	void PVAssetPackWriter::Open(const std::string& filename)
+	{
+		this->filename = filename;
+		file.open(filename, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			throw std::runtime_error("Failed to create asset pack " + filename);
+		}
+
+		// placeholder, the real header is written by Finish
+		PVPackFormat::Header header = {};
+		position = 0;
+		entries.clear();
+		writeBytes(&header, sizeof(header));
+	}
+
+	void PVAssetPackWriter::AddBlob(const std::string& name, PVPackFormat::BlobType type, uint32_t stride, const void* data, uint64_t size)
+	{
+		BeginBlob(name, type, stride);
+		WriteBlobData(data, size);
+		EndBlob();
+	}
+
+	void PVAssetPackWriter::BeginBlob(const std::string& name, PVPackFormat::BlobType type, uint32_t stride)
+	{
+		if (blobOpen)
+		{
+			throw std::runtime_error("Asset pack blob " + name + " started before the previous one ended");
+		}
+		if (name.size() >= PVPackFormat::MaxNameLength)
+		{
+			throw std::runtime_error("Asset pack blob name " + name + " is too long");
+		}
+		if (stride == 0)
+		{
+			throw std::runtime_error("Asset pack blob " + name + " needs a stride");
+		}
+
+		padTo(PVPackFormat::BlobAlignment);
+
+		PVPackFormat::TocEntry entry = {};
+		strncpy(entry.name, name.c_str(), PVPackFormat::MaxNameLength - 1);
+		entry.type = type;
+		entry.stride = stride;
+		entry.offset = position;
+		entry.size = 0;
+		entries.push_back(entry);
+		blobOpen = true;
+	}
+
+	void PVAssetPackWriter::WriteBlobData(const void* data, uint64_t size)
+	{
+		writeBytes(data, size);
+		entries.back().size += size;
+	}
+
+	void PVAssetPackWriter::EndBlob()
+	{
+		if (entries.back().size % entries.back().stride != 0)
+		{
+			throw std::runtime_error("Asset pack blob " + std::string(entries.back().name) + " is not a whole number of elements");
+		}
+		blobOpen = false;
+	}
+
+	void PVAssetPackWriter::Finish()
+	{
+		padTo(alignof(PVPackFormat::TocEntry));
+
+		PVPackFormat::Header header = {};
+		header.magic = PVPackFormat::Magic;
+		header.version = PVPackFormat::Version;
+		header.entryCount = static_cast<uint32_t>(entries.size());
+		header.tocOffset = position;
+
+		writeBytes(entries.data(), entries.size() * sizeof(PVPackFormat::TocEntry));
+		header.fileSize = position;
+
+		file.seekp(0);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.close();
+
+		if (file.fail())
+		{
+			throw std::runtime_error("Failed to write asset pack " + filename);
+		}
+	}
+
+	void PVAssetPackWriter::writeBytes(const void* data, uint64_t size)
+	{
+		file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+		if (file.fail())
+		{
+			throw std::runtime_error("Failed to write asset pack " + filename);
+		}
+		position += size;
+	}
+
+	void PVAssetPackWriter::padTo(uint64_t alignment)
+	{
+		static const char zeros[PVPackFormat::BlobAlignment] = {};
+		uint64_t padding = (alignment - position % alignment) % alignment;
+		writeBytes(zeros, padding);
+	}
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace PVEngine
+{
+	// On disk layout of a .pvpack file, version 1. Everything is little endian.
+	//	Header			at offset 0
+	//	blobs			each starting on a BlobAlignment boundary, already in the layout the GPU
+	//					buffers expect so they can be copied into staging memory as is
+	//	TocEntry[]		at header.tocOffset, written last so blobs can be streamed
+	namespace PVPackFormat
+	{
+		const uint32_t Magic = 0x4B505650; // "PVPK"
+		const uint32_t Version = 1;
+
+		// covers optimalBufferCopyOffsetAlignment and nonCoherentAtomSize on every device we know of
+		const uint64_t BlobAlignment = 256;
+
+		const size_t MaxNameLength = 56;
+
+		enum class BlobType : uint32_t
+		{
+			Raw = 0,
+			Vertices = 1,
+			Indices32 = 2
+		};
+
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t entryCount;
+			uint32_t reserved;
+			uint64_t tocOffset;
+			uint64_t fileSize;
+		};
+
+		struct TocEntry
+		{
+			// null terminated
+			char name[MaxNameLength];
+			BlobType type;
+			// size of one element (vertex stride, 4 for 32 bit indices, 1 for raw data)
+			uint32_t stride;
+			uint64_t offset;
+			uint64_t size;
+		};
+
+		static_assert(sizeof(Header) == 32, "pack header layout changed");
+		static_assert(sizeof(TocEntry) == 80, "pack toc layout changed");
+	}
+
+	// Read only view of a pack. The file is memory mapped and blobs point straight into the
+	// mapping, so nothing is parsed or copied until the data is written into staging memory
+	// and the OS only pages in the blobs that are actually used.
+	class PVAssetPack
+	{
+	public:
+		PVAssetPack();
+		~PVAssetPack();
+
+		// silent, it also runs on the tile cache's worker, callers report what they opened
+		void Open(const std::string& filename);
+		void Close();
+
+		// touches every page so the reads happen now, e.g. on a worker thread during startup,
+		// instead of as page faults while the blobs are copied into staging memory
+		void Prefetch() const;
+
+		// nullptr if the pack has no blob with that name
+		const PVPackFormat::TocEntry* Find(const std::string& name) const;
+
+		// like Find but throws if the blob is missing or is not of the expected type and stride
+		const PVPackFormat::TocEntry& Require(const std::string& name, PVPackFormat::BlobType type, uint32_t stride) const;
+
+		const void* GetData(const PVPackFormat::TocEntry& entry) const { return mappedData + entry.offset; }
+
+		uint64_t GetElementCount(const PVPackFormat::TocEntry& entry) const { return entry.size / entry.stride; }
+
+		//Getters
+		bool IsOpen() const { return mappedData != nullptr; }
+		uint64_t GetFileSize() const { return mappedSize; }
+		const std::vector<PVPackFormat::TocEntry>& GetEntries() const { return entries; }
+
+	private:
+		void mapFile(const std::string& filename);
+		void unmapFile();
+
+		const uint8_t* mappedData = nullptr;
+		uint64_t mappedSize = 0;
+
+#ifdef _WIN32
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#endif
+
+		// copy of the table of contents, it is small and is searched by name
+		std::vector<PVPackFormat::TocEntry> entries;
+	};
+
+	// Streams blobs into a new pack. Used by the PVPacker tool.
+	class PVAssetPackWriter
+	{
+	public:
+		PVAssetPackWriter();
+		~PVAssetPackWriter();
+
+		void Open(const std::string& filename);
+
+		void AddBlob(const std::string& name, PVPackFormat::BlobType type, uint32_t stride, const void* data, uint64_t size);
+
+		// for blobs too large to hold in memory, data is appended with WriteBlobData
+		void BeginBlob(const std::string& name, PVPackFormat::BlobType type, uint32_t stride);
+		void WriteBlobData(const void* data, uint64_t size);
+		void EndBlob();
+
+		// writes the table of contents and header and closes the file
+		void Finish();
+
+		//Getters
+		size_t GetBlobCount() const { return entries.size(); }
+		// the whole file once Finish has run
+		uint64_t GetFileSize() const { return position; }
+
+	private:
+		void writeBytes(const void* data, uint64_t size);
+		void padTo(uint64_t alignment);
+
+		std::ofstream file;
+		std::string filename;
+		uint64_t position = 0;
+		bool blobOpen = false;
+
+		std::vector<PVPackFormat::TocEntry> entries;
+	};
+}
@@ -0,0 +1,279 @@
+#include "PVBindlessTable.h"
+#include "PVHostAllocator.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace PVEngine
+{
+	static const VkDescriptorType bindingTypes[] =
+	{
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+		VK_DESCRIPTOR_TYPE_SAMPLER,
+	};
+
+	bool PVBindlessTable::QuerySupport(VkInstance instance, VkPhysicalDevice physicalDevice, Capacity& capacity)
+	{
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+		for (const char* required : GetRequiredDeviceExtensions())
+		{
+			bool found = false;
+			for (const auto& extension : availableExtensions)
+			{
+				if (strcmp(required, extension.extensionName) == 0)
+				{
+					found = true;
+					break;
+				}
+			}
+			if (!found)
+			{
+				return false;
+			}
+		}
+
+		auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR");
+		auto getProperties2 = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR");
+		if (getFeatures2 == nullptr || getProperties2 == nullptr)
+		{
+			return false;
+		}
+
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+		indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		VkPhysicalDeviceFeatures2KHR features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features.pNext = &indexingFeatures;
+		getFeatures2(physicalDevice, &features);
+
+		if (!indexingFeatures.runtimeDescriptorArray || !indexingFeatures.descriptorBindingPartiallyBound
+			|| !indexingFeatures.descriptorBindingUpdateUnusedWhilePending
+			|| !indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind
+			|| !indexingFeatures.descriptorBindingSampledImageUpdateAfterBind
+			|| !indexingFeatures.shaderStorageBufferArrayNonUniformIndexing
+			|| !indexingFeatures.shaderSampledImageArrayNonUniformIndexing)
+		{
+			return false;
+		}
+
+		VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+		indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+		VkPhysicalDeviceProperties2KHR properties = {};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+		properties.pNext = &indexingProperties;
+		getProperties2(physicalDevice, &properties);
+
+		// the set is visible to every stage, so the per stage limits apply as well as the per set ones
+		capacity.storageBuffers = std::min({ capacity.storageBuffers, indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+			indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers });
+		capacity.sampledImages = std::min({ capacity.sampledImages, indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+			indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages });
+		capacity.samplers = std::min({ capacity.samplers, indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+			indexingProperties.maxDescriptorSetUpdateAfterBindSamplers });
+
+		// leave a quarter of the per stage resource budget for the classic sets
+		uint64_t budget = indexingProperties.maxPerStageUpdateAfterBindResources / 4 * 3;
+		uint64_t total = uint64_t(capacity.storageBuffers) + capacity.sampledImages + capacity.samplers;
+		if (total > budget)
+		{
+			capacity.storageBuffers = static_cast<uint32_t>(capacity.storageBuffers * budget / total);
+			capacity.sampledImages = static_cast<uint32_t>(capacity.sampledImages * budget / total);
+			capacity.samplers = static_cast<uint32_t>(capacity.samplers * budget / total);
+		}
+
+		return capacity.storageBuffers > 0 && capacity.sampledImages > 0 && capacity.samplers > 0;
+	}
+
+	const std::vector<const char*>& PVBindlessTable::GetRequiredDeviceExtensions()
+	{
+		static const std::vector<const char*> extensions = { VK_KHR_MAINTENANCE3_EXTENSION_NAME, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME };
+		return extensions;
+	}
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT PVBindlessTable::GetRequiredFeatures()
+	{
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		features.runtimeDescriptorArray = VK_TRUE;
+		features.descriptorBindingPartiallyBound = VK_TRUE;
+		features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+		features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+		features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		features.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+		features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		return features;
+	}
+
+	PVBindlessTable::PVBindlessTable(const VkDevice* logicalDevice, const Capacity& capacity)
+		: device(logicalDevice), capacity(capacity)
+	{
+		slots[StorageBuffers].capacity = capacity.storageBuffers;
+		slots[SampledImages].capacity = capacity.sampledImages;
+		slots[Samplers].capacity = capacity.samplers;
+
+		VkDescriptorSetLayoutBinding bindings[3] = {};
+		VkDescriptorBindingFlagsEXT bindingFlags[3];
+		VkDescriptorPoolSize poolSizes[3];
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			bindings[i].binding = i;
+			bindings[i].descriptorType = bindingTypes[i];
+			bindings[i].descriptorCount = slots[i].capacity;
+			bindings[i].stageFlags = VK_SHADER_STAGE_ALL;
+
+			// unused entries may stay unwritten, and entries no pending frame reads may be rewritten
+			bindingFlags[i] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT
+				| VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+
+			poolSizes[i].type = bindingTypes[i];
+			poolSizes[i].descriptorCount = slots[i].capacity;
+		}
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+		bindingFlagsInfo.bindingCount = 3;
+		bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.pNext = &bindingFlagsInfo;
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+		layoutInfo.bindingCount = 3;
+		layoutInfo.pBindings = bindings;
+
+		if (vkCreateDescriptorSetLayout(*device, &layoutInfo, PVHostAllocator::Callbacks(PVAllocationType::Descriptor), &layout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create bindless descriptor set layout");
+		}
+
+		VkDescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+		poolInfo.maxSets = 1;
+		poolInfo.poolSizeCount = 3;
+		poolInfo.pPoolSizes = poolSizes;
+
+		if (vkCreateDescriptorPool(*device, &poolInfo, PVHostAllocator::Callbacks(PVAllocationType::Descriptor), &pool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create bindless descriptor pool");
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = pool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		if (vkAllocateDescriptorSets(*device, &allocInfo, &set) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create bindless descriptor set");
+		}
+		else
+		{
+			std::cout << "Bindless table created with " << capacity.storageBuffers << " storage buffers, " << capacity.sampledImages
+				<< " sampled images and " << capacity.samplers << " samplers" << std::endl;
+		}
+	}
+
+
+	PVBindlessTable::~PVBindlessTable()
+	{
+	}
+
+	void PVBindlessTable::Cleanup()
+	{
+		vkDestroyDescriptorPool(*device, pool, PVHostAllocator::Callbacks(PVAllocationType::Descriptor));
+		vkDestroyDescriptorSetLayout(*device, layout, PVHostAllocator::Callbacks(PVAllocationType::Descriptor));
+	}
+
+	uint32_t PVBindlessTable::RegisterStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+	{
+		uint32_t handle = allocateHandle(StorageBuffers);
+		VkDescriptorBufferInfo bufferInfo = { buffer, offset, range };
+		write(StorageBuffers, handle, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &bufferInfo, nullptr);
+		return handle;
+	}
+
+	uint32_t PVBindlessTable::RegisterSampledImage(VkImageView imageView, VkImageLayout layout)
+	{
+		uint32_t handle = allocateHandle(SampledImages);
+		VkDescriptorImageInfo imageInfo = { VK_NULL_HANDLE, imageView, layout };
+		write(SampledImages, handle, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, nullptr, &imageInfo);
+		return handle;
+	}
+
+	uint32_t PVBindlessTable::RegisterSampler(VkSampler sampler)
+	{
+		uint32_t handle = allocateHandle(Samplers);
+		VkDescriptorImageInfo imageInfo = { sampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED };
+		write(Samplers, handle, VK_DESCRIPTOR_TYPE_SAMPLER, nullptr, &imageInfo);
+		return handle;
+	}
+
+	void PVBindlessTable::Release(Binding binding, uint32_t handle, uint64_t retireValue)
+	{
+		std::lock_guard<std::mutex> lock(tableMutex);
+		slots[binding].pendingHandles.push_back(std::make_pair(handle, retireValue));
+	}
+
+	void PVBindlessTable::Flush(uint64_t completedValue)
+	{
+		std::lock_guard<std::mutex> lock(tableMutex);
+		for (auto& bindingSlots : slots)
+		{
+			size_t kept = 0;
+			for (size_t i = 0; i < bindingSlots.pendingHandles.size(); i++)
+			{
+				if (bindingSlots.pendingHandles[i].second <= completedValue)
+				{
+					bindingSlots.freeHandles.push_back(bindingSlots.pendingHandles[i].first);
+				}
+				else
+				{
+					bindingSlots.pendingHandles[kept++] = bindingSlots.pendingHandles[i];
+				}
+			}
+			bindingSlots.pendingHandles.resize(kept);
+		}
+	}
+
+	uint32_t PVBindlessTable::allocateHandle(Binding binding)
+	{
+		std::lock_guard<std::mutex> lock(tableMutex);
+		Slots& bindingSlots = slots[binding];
+		if (!bindingSlots.freeHandles.empty())
+		{
+			uint32_t handle = bindingSlots.freeHandles.back();
+			bindingSlots.freeHandles.pop_back();
+			return handle;
+		}
+		if (bindingSlots.next == bindingSlots.capacity)
+		{
+			throw std::runtime_error("Bindless table is full");
+		}
+		return bindingSlots.next++;
+	}
+
+	void PVBindlessTable::write(Binding binding, uint32_t handle, VkDescriptorType type, const VkDescriptorBufferInfo* bufferInfo,
+		const VkDescriptorImageInfo* imageInfo)
+	{
+		VkWriteDescriptorSet descriptorWrite = {};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = set;
+		descriptorWrite.dstBinding = binding;
+		descriptorWrite.dstArrayElement = handle;
+		descriptorWrite.descriptorType = type;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pBufferInfo = bufferInfo;
+		descriptorWrite.pImageInfo = imageInfo;
+
+		// writes to the set have to be externally synchronized
+		std::lock_guard<std::mutex> lock(tableMutex);
+		vkUpdateDescriptorSets(*device, 1, &descriptorWrite, 0, nullptr);
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include <mutex>
+
+namespace PVEngine
+{
+	// One descriptor set holding large update-after-bind arrays of storage buffers, sampled
+	// images and samplers (VK_EXT_descriptor_indexing). Resources are registered once and get a
+	// stable index that shaders use to look them up, so a frame binds this set a single time
+	// instead of a set per draw. Shaders declare the arrays through Shaders/bindless.glsl.
+	//
+	// A released index is only handed out again once the GPU has finished the frame that
+	// released it, see Release and Flush. Register/Release may be called from any thread.
+	class PVBindlessTable
+	{
+	public:
+		// array sizes, already clamped to the device limits by QuerySupport
+		struct Capacity
+		{
+			uint32_t storageBuffers = 16384;
+			uint32_t sampledImages = 16384;
+			uint32_t samplers = 256;
+		};
+
+		enum Binding : uint32_t
+		{
+			StorageBuffers = 0,
+			SampledImages = 1,
+			Samplers = 2,
+		};
+
+		static const uint32_t InvalidHandle = 0xFFFFFFFF;
+
+		// Checks for the extension and the features the table needs and clamps capacity to the
+		// device limits. Needs VK_KHR_get_physical_device_properties2 enabled on the instance.
+		static bool QuerySupport(VkInstance instance, VkPhysicalDevice physicalDevice, Capacity& capacity);
+
+		// extensions and feature struct to chain into VkDeviceCreateInfo when the table is used
+		static const std::vector<const char*>& GetRequiredDeviceExtensions();
+		static VkPhysicalDeviceDescriptorIndexingFeaturesEXT GetRequiredFeatures();
+
+		PVBindlessTable(const VkDevice* logicalDevice, const Capacity& capacity);
+		~PVBindlessTable();
+
+		void Cleanup();
+
+		uint32_t RegisterStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+		uint32_t RegisterSampledImage(VkImageView imageView, VkImageLayout layout);
+		uint32_t RegisterSampler(VkSampler sampler);
+
+		// the index becomes reusable once Flush sees retireValue completed
+		void Release(Binding binding, uint32_t handle, uint64_t retireValue);
+
+		void Flush(uint64_t completedValue);
+
+		//Getters
+		VkDescriptorSetLayout GetLayout() const { return layout; }
+		VkDescriptorSet GetSet() const { return set; }
+		const Capacity& GetCapacity() const { return capacity; }
+
+	private:
+		struct Slots
+		{
+			uint32_t capacity = 0;
+			uint32_t next = 0;
+			std::vector<uint32_t> freeHandles;
+			std::vector<std::pair<uint32_t, uint64_t>> pendingHandles;
+		};
+
+		uint32_t allocateHandle(Binding binding);
+		void write(Binding binding, uint32_t handle, VkDescriptorType type, const VkDescriptorBufferInfo* bufferInfo,
+			const VkDescriptorImageInfo* imageInfo);
+
+		const VkDevice* device;
+
+		Capacity capacity;
+
+		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+
+		VkDescriptorPool pool = VK_NULL_HANDLE;
+
+		VkDescriptorSet set = VK_NULL_HANDLE;
+
+		std::mutex tableMutex;
+
+		Slots slots[3];
+	};
+}
@@ -1,5 +1,5 @@
 #include "PVBuffer.h"
-#include "PVQueueFamily.h"
+#include "PVHostAllocator.h"
 
 namespace PVEngine
 {
@@ -12,32 +12,30 @@ namespace PVEngine
 	{
 	}
 
-	void PVBuffer::createBuffer(const VkDevice* logicalDevice, const VkPhysicalDevice* physicalDevice, 
-		const VkSurfaceKHR* surface, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, 
-		VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+	void PVBuffer::createBuffer(const PVDeviceContext* deviceContext, VkDeviceSize size, VkBufferUsageFlags usage, 
+		VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, VkSharingMode sharingMode)
 	{
+		const VkDevice* logicalDevice = deviceContext->GetLogicalDevice();
+
 		VkBufferCreateInfo bufferInfo = {};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 		bufferInfo.size = size;
 		bufferInfo.usage = usage;
 		
 
-		QueueFamilyIndices indices = FindQueueFamilies(physicalDevice, surface);
-		if (indices.graphicsFamily == indices.transferFamily)
-		{
-			bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			uint32_t indicesArray[] = { static_cast<uint32_t>(indices.graphicsFamily)};
-			bufferInfo.pQueueFamilyIndices = indicesArray;
-			bufferInfo.queueFamilyIndexCount = 1;
-		}
-		else
+		// buffers are exclusive unless asked otherwise, copyBuffer hands ownership from the
+		// transfer family to the graphics family with a release/acquire barrier pair when the two differ
+		const QueueFamilyIndices& indices = deviceContext->GetQueueFamilyIndices();
+		uint32_t queueFamilies[] = { static_cast<uint32_t>(indices.graphicsFamily), static_cast<uint32_t>(indices.transferFamily) };
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (sharingMode == VK_SHARING_MODE_CONCURRENT && queueFamilies[0] != queueFamilies[1])
 		{
 			bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
-			uint32_t indicesArray[] = { static_cast<uint32_t>(indices.graphicsFamily), static_cast<uint32_t>(indices.transferFamily) };
-			bufferInfo.pQueueFamilyIndices = indicesArray;
 			bufferInfo.queueFamilyIndexCount = 2;
+			bufferInfo.pQueueFamilyIndices = queueFamilies;
 		}
-		if (vkCreateBuffer(*logicalDevice, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+
+		if (vkCreateBuffer(*logicalDevice, &bufferInfo, PVHostAllocator::Callbacks(PVAllocationType::Buffer), &buffer) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create buffer");
 		}
@@ -52,9 +50,9 @@ namespace PVEngine
 		VkMemoryAllocateInfo allocateInfo = {};
 		allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 		allocateInfo.allocationSize = memRequirements.size;
-		allocateInfo.memoryTypeIndex = findMemoryType(*physicalDevice, memRequirements.memoryTypeBits, properties);
+		allocateInfo.memoryTypeIndex = deviceContext->FindMemoryType(memRequirements.memoryTypeBits, properties);
 
-		if (vkAllocateMemory(*logicalDevice, &allocateInfo, nullptr, &bufferMemory) != VK_SUCCESS)
+		if (vkAllocateMemory(*logicalDevice, &allocateInfo, PVHostAllocator::Callbacks(PVAllocationType::Memory), &bufferMemory) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to allocate buffer memory");
 		}
@@ -68,33 +66,39 @@ namespace PVEngine
 
 	void PVBuffer::cleanupBuffer(const VkDevice* logicalDevice, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
 	{
-		vkDestroyBuffer(*logicalDevice, buffer, nullptr);
-		vkFreeMemory(*logicalDevice, bufferMemory, nullptr);
+		vkDestroyBuffer(*logicalDevice, buffer, PVHostAllocator::Callbacks(PVAllocationType::Buffer));
+		vkFreeMemory(*logicalDevice, bufferMemory, PVHostAllocator::Callbacks(PVAllocationType::Memory));
 	}
 
-	uint32_t PVBuffer::findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties)
+	void PVBuffer::Retire(PVDeletionQueue* deletionQueue, uint64_t retireValue)
 	{
-		VkPhysicalDeviceMemoryProperties memProperties;
-		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+		deletionQueue->RetireBuffer(buffer, retireValue);
+		deletionQueue->RetireMemory(bufferMemory, retireValue);
+		buffer = VK_NULL_HANDLE;
+		bufferMemory = VK_NULL_HANDLE;
+	}
 
-		for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i)
+	bool PVBuffer::RecordOwnershipAcquire(VkCommandBuffer commandBuffer)
+	{
+		if (!acquirePending)
 		{
-			if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-			{
-				return i;
-			}
+			return false;
 		}
 
-		throw std::runtime_error("Failed to find suitable memory type");
+		vkCmdPipelineBarrier(commandBuffer, acquireStageMask, acquireStageMask, 0, 0, nullptr, 1, &acquireBarrier, 0, nullptr);
+		acquirePending = false;
+		return true;
 	}
 
-	void PVBuffer::copyBuffer(const VkDevice* logicalDevice, const VkCommandPool* commandPool, VkBuffer srcBuffer,
-		VkBuffer dstBuffer, VkDeviceSize size, const VkQueue* queue)
+	uint64_t PVBuffer::copyBuffer(const PVDeviceContext* deviceContext, const PVUploadContext* uploadContext, VkBuffer srcBuffer,
+		VkBuffer dstBuffer, VkDeviceSize size, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
 	{
+		const VkDevice* logicalDevice = deviceContext->GetLogicalDevice();
+
 		VkCommandBufferAllocateInfo bufferInfo = {};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 		bufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		bufferInfo.commandPool = *commandPool;
+		bufferInfo.commandPool = *uploadContext->commandPool;
 		bufferInfo.commandBufferCount = 1;
 		VkCommandBuffer commandBuffer;
 		vkAllocateCommandBuffers(*logicalDevice, &bufferInfo, &commandBuffer);
@@ -108,15 +112,37 @@ namespace PVEngine
 		copyRegion.size = size;
 		vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
+		const QueueFamilyIndices& indices = deviceContext->GetQueueFamilyIndices();
+		if (indices.graphicsFamily != indices.transferFamily && sharingMode == VK_SHARING_MODE_EXCLUSIVE)
+		{
+			// release half of the ownership transfer, the graphics queue records the matching
+			// acquire through RecordOwnershipAcquire before the buffer is first used
+			VkBufferMemoryBarrier releaseBarrier = {};
+			releaseBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			releaseBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			releaseBarrier.dstAccessMask = 0;
+			releaseBarrier.srcQueueFamilyIndex = static_cast<uint32_t>(indices.transferFamily);
+			releaseBarrier.dstQueueFamilyIndex = static_cast<uint32_t>(indices.graphicsFamily);
+			releaseBarrier.buffer = dstBuffer;
+			releaseBarrier.offset = 0;
+			releaseBarrier.size = size;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+				0, nullptr, 1, &releaseBarrier, 0, nullptr);
+
+			acquireBarrier = releaseBarrier;
+			acquireBarrier.srcAccessMask = 0;
+			acquireBarrier.dstAccessMask = dstAccessMask;
+			acquireStageMask = dstStageMask;
+			acquirePending = true;
+		}
+
 		vkEndCommandBuffer(commandBuffer);
 
-		VkSubmitInfo submitInfo = {};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
-		vkQueueSubmit(*queue, 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(*queue);
+		uint64_t copyValue = uploadContext->timeline->Submit(&commandBuffer, 1, {});
+
+		// the command buffer is freed once the transfer timeline passes the copy
+		uploadContext->deletionQueue->RetireCommandBuffers(*uploadContext->commandPool, { commandBuffer }, copyValue);
 
-		vkFreeCommandBuffers(*logicalDevice, *commandPool, 1, &commandBuffer);
+		return copyValue;
 	}
 }
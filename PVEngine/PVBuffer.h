@@ -1,9 +1,21 @@
 #pragma once
 #include "PVVertex.h"
+#include "PVDeviceContext.h"
+#include "PVDeletionQueue.h"
+#include "PVTimeline.h"
 #include <iostream>
 #include <vector>
 namespace PVEngine
 {
+	// everything needed to stage data through the transfer queue
+	struct PVUploadContext
+	{
+		const VkCommandPool* commandPool;
+		PVTimeline* timeline;
+		// staging resources are retired here against transfer timeline values
+		PVDeletionQueue* deletionQueue;
+	};
+
 	class PVBuffer
 	{
 	public:
@@ -12,21 +24,43 @@ namespace PVEngine
 
 		VkBuffer* GetBuffer() { return &buffer; }
 
+		// transfer timeline value that has to be reached before the buffer contents are valid
+		uint64_t GetUploadValue() { return uploadValue; }
+
+		// Records the graphics queue half of the ownership transfer started by the last upload.
+		// The submission has to wait for GetUploadValue() on the transfer timeline. Returns false
+		// when the transfer and graphics families are the same and nothing was recorded.
+		bool RecordOwnershipAcquire(VkCommandBuffer commandBuffer);
+
+		// hands the buffer and its memory to the deletion queue instead of destroying them now
+		void Retire(PVDeletionQueue* deletionQueue, uint64_t retireValue);
+
 	protected:
-		void createBuffer(const VkDevice* logicalDevice, const VkPhysicalDevice* physicalDevice,
-			const VkSurfaceKHR* surface, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, 
-			VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+		// concurrent buffers are shared by the graphics and transfer families, exclusive ones are
+		// created instead when the two are the same
+		void createBuffer(const PVDeviceContext* deviceContext, VkDeviceSize size, VkBufferUsageFlags usage, 
+			VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory,
+			VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE);
 
 		void cleanupBuffer(const VkDevice* logicalDevice, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
 
-		uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
-
-		void copyBuffer(const VkDevice* logicalDevice, const VkCommandPool* commandPool, VkBuffer srcBuffer, 
-			VkBuffer dstBuffer, VkDeviceSize size, const VkQueue* queue);
+		// Records and submits the copy without waiting for it, returns the transfer timeline value.
+		// dstStageMask/dstAccessMask describe the first use on the graphics queue.
+		uint64_t copyBuffer(const PVDeviceContext* deviceContext, const PVUploadContext* uploadContext, VkBuffer srcBuffer, 
+			VkBuffer dstBuffer, VkDeviceSize size, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask);
 
 	protected:
 		VkBuffer buffer;
 		VkDeviceMemory bufferMemory;
+		uint64_t uploadValue = 0;
+
+		// of the buffer copyBuffer fills, concurrent buffers need no ownership transfer
+		VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		// pending queue family ownership acquire for the graphics queue
+		bool acquirePending = false;
+		VkBufferMemoryBarrier acquireBarrier;
+		VkPipelineStageFlags acquireStageMask;
 	};
 }
 
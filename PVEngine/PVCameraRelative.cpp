@@ -0,0 +1,161 @@
+#include "PVCameraRelative.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+namespace PVEngine
+{
+	PVCameraRelative::PVCameraRelative()
+	{
+	}
+
+
+	PVCameraRelative::~PVCameraRelative()
+	{
+	}
+
+	uint32_t PVCameraRelative::Add(const glm::dvec3& position, const glm::mat3& basis)
+	{
+		positionX.push_back(position.x);
+		positionY.push_back(position.y);
+		positionZ.push_back(position.z);
+		bases.push_back(basis);
+		return static_cast<uint32_t>(bases.size() - 1);
+	}
+
+	void PVCameraRelative::SetPosition(uint32_t index, const glm::dvec3& position)
+	{
+		positionX[index] = position.x;
+		positionY[index] = position.y;
+		positionZ[index] = position.z;
+	}
+
+	void PVCameraRelative::SetBasis(uint32_t index, const glm::mat3& basis)
+	{
+		bases[index] = basis;
+	}
+
+	void PVCameraRelative::Clear()
+	{
+		positionX.clear();
+		positionY.clear();
+		positionZ.clear();
+		bases.clear();
+	}
+
+	void PVCameraRelative::Compute(const glm::dvec3& cameraPosition, void* output, size_t stride) const
+	{
+		uint8_t* destination = static_cast<uint8_t*>(output);
+		uint32_t count = GetCount();
+
+		const __m128d cameraX = _mm_set1_pd(cameraPosition.x);
+		const __m128d cameraY = _mm_set1_pd(cameraPosition.y);
+		const __m128d cameraZ = _mm_set1_pd(cameraPosition.z);
+
+		// four objects per iteration, two per double register, packed into one float register per axis
+		alignas(16) float relativeX[4];
+		alignas(16) float relativeY[4];
+		alignas(16) float relativeZ[4];
+		uint32_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 x = _mm_movelh_ps(_mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(&positionX[i]), cameraX)),
+				_mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(&positionX[i + 2]), cameraX)));
+			__m128 y = _mm_movelh_ps(_mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(&positionY[i]), cameraY)),
+				_mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(&positionY[i + 2]), cameraY)));
+			__m128 z = _mm_movelh_ps(_mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(&positionZ[i]), cameraZ)),
+				_mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(&positionZ[i + 2]), cameraZ)));
+			_mm_store_ps(relativeX, x);
+			_mm_store_ps(relativeY, y);
+			_mm_store_ps(relativeZ, z);
+
+			for (uint32_t lane = 0; lane < 4; lane++)
+			{
+				writeMatrix(destination + (i + lane) * stride, bases[i + lane], relativeX[lane], relativeY[lane], relativeZ[lane]);
+			}
+		}
+
+		for (; i < count; i++)
+		{
+			writeMatrix(destination + i * stride, bases[i], static_cast<float>(positionX[i] - cameraPosition.x),
+				static_cast<float>(positionY[i] - cameraPosition.y), static_cast<float>(positionZ[i] - cameraPosition.z));
+		}
+	}
+
+	glm::mat4 PVCameraRelative::View(const glm::dvec3& eye, const glm::dvec3& target, const glm::vec3& up)
+	{
+		// only the direction is needed, and it is taken before anything is rounded to float
+		glm::dvec3 direction = target - eye;
+		glm::vec3 forward = glm::vec3(direction / std::sqrt(glm::dot(direction, direction)));
+		return glm::lookAt(glm::vec3(0.0f), forward, up);
+	}
+
+	void PVCameraRelative::Benchmark(uint32_t objectCount)
+	{
+		// spread over a planet sized region, with the camera near its surface
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<double> offset(-50000.0, 50000.0);
+		std::uniform_real_distribution<float> angle(0.0f, glm::radians(360.0f));
+		const glm::dvec3 planetSurface(6371000.0, 0.0, 0.0);
+
+		PVCameraRelative objects;
+		for (uint32_t i = 0; i < objectCount; i++)
+		{
+			glm::mat3 basis(glm::rotate(glm::mat4(1.0f), angle(random), glm::vec3(0.0f, 0.0f, 1.0f)));
+			objects.Add(planetSurface + glm::dvec3(offset(random), offset(random), offset(random)), basis);
+		}
+		glm::dvec3 camera = planetSurface + glm::dvec3(12.25, -3.5, 2.0);
+
+		std::vector<glm::mat4> batched(objectCount);
+		std::vector<glm::mat4> reference(objectCount);
+		const uint32_t iterations = 20;
+
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t iteration = 0; iteration < iterations; iteration++)
+		{
+			objects.Compute(camera, batched.data(), sizeof(glm::mat4));
+		}
+		double batchedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+		// what it replaces: a double matrix per object, multiplied out and converted
+		start = std::chrono::steady_clock::now();
+		for (uint32_t iteration = 0; iteration < iterations; iteration++)
+		{
+			glm::dmat4 cameraTranslation = glm::translate(glm::dmat4(1.0), -camera);
+			for (uint32_t i = 0; i < objectCount; i++)
+			{
+				glm::dmat4 model(glm::dmat3(objects.bases[i]));
+				model[3] = glm::dvec4(objects.positionX[i], objects.positionY[i], objects.positionZ[i], 1.0);
+				reference[i] = glm::mat4(cameraTranslation * model);
+			}
+		}
+		double referenceMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+		// both should agree to float rounding of the relative position
+		float maxDifference = 0.0f;
+		for (uint32_t i = 0; i < objectCount; i++)
+		{
+			glm::vec4 difference = batched[i][3] - reference[i][3];
+			maxDifference = std::max(maxDifference, std::max(std::abs(difference.x), std::max(std::abs(difference.y), std::abs(difference.z))));
+		}
+
+		std::cout << "Camera relative benchmark, " << objectCount << " objects: batched " << batchedMs << " ms ("
+			<< batchedMs * 1000000.0 / objectCount << " ns per object), double matrices " << referenceMs << " ms, "
+			<< referenceMs / batchedMs << "x, max difference " << maxDifference << std::endl;
+	}
+
+	void PVCameraRelative::writeMatrix(uint8_t* destination, const glm::mat3& basis, float x, float y, float z)
+	{
+		glm::mat4 model(basis);
+		model[3] = glm::vec4(x, y, z, 1.0f);
+		memcpy(destination, &model, sizeof(model));
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+namespace PVEngine
+{
+	// Objects placed in double precision world space and drawn with float matrices relative to the
+	// camera. A float keeps 24 bits of mantissa, so a position a planet radius from the origin is
+	// only resolved to about half a metre and vertices snap and jitter as the camera moves. Here
+	// positions stay doubles, the camera position is subtracted in double once per object and
+	// frame, and only the small difference is converted to float. The view has no translation,
+	// the camera sits at the origin of camera relative space.
+	//
+	// Positions are kept as structure of arrays so the subtraction and conversion run on four
+	// objects at a time with SSE2, the rotation and scale part is float already and only copied.
+	class PVCameraRelative
+	{
+	public:
+		PVCameraRelative();
+		~PVCameraRelative();
+
+		// basis is rotation and scale, float is enough since it doesn't grow with distance.
+		// Returns the index of the object
+		uint32_t Add(const glm::dvec3& position, const glm::mat3& basis);
+		void SetPosition(uint32_t index, const glm::dvec3& position);
+		void SetBasis(uint32_t index, const glm::mat3& basis);
+		void Clear();
+
+		// writes every object's model matrix relative to cameraPosition, the first one to output
+		// and each following one stride bytes further, so it can fill draw constants or instance data
+		void Compute(const glm::dvec3& cameraPosition, void* output, size_t stride) const;
+
+		// the camera's rotation only, for a camera at eye looking at target
+		static glm::mat4 View(const glm::dvec3& eye, const glm::dvec3& target, const glm::vec3& up);
+
+		// times Compute for objectCount objects against building each matrix in double and converting
+		static void Benchmark(uint32_t objectCount);
+
+		//Getters
+		uint32_t GetCount() const { return static_cast<uint32_t>(positionX.size()); }
+
+	private:
+		static void writeMatrix(uint8_t* destination, const glm::mat3& basis, float x, float y, float z);
+
+		std::vector<double> positionX;
+		std::vector<double> positionY;
+		std::vector<double> positionZ;
+		std::vector<glm::mat3> bases;
+	};
+}
@@ -1,4 +1,5 @@
 #include "PVCommandPool.h"
+#include "PVHostAllocator.h"
 
 namespace PVEngine
 {
@@ -15,7 +16,7 @@ namespace PVEngine
 
 	void PVCommandPool::Cleanup(const VkDevice* logicalDevice)
 	{
-		vkDestroyCommandPool(*logicalDevice, commandPool, VK_NULL_HANDLE);
+		vkDestroyCommandPool(*logicalDevice, commandPool, PVHostAllocator::Callbacks(PVAllocationType::CommandPool));
 	}
 
 	void PVCommandPool::createCommandPool(const VkDevice* logicalDevice, uint32_t queueFamilyIndex, VkCommandPoolCreateFlags flags /* = 0 */)
@@ -25,7 +26,7 @@ namespace PVEngine
 		poolInfo.queueFamilyIndex = queueFamilyIndex;
 		poolInfo.flags = flags;
 
-		if (vkCreateCommandPool(*logicalDevice, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+		if (vkCreateCommandPool(*logicalDevice, &poolInfo, PVHostAllocator::Callbacks(PVAllocationType::CommandPool), &commandPool) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create command pool");
 		}
@@ -0,0 +1,55 @@
+#include "PVCpuTime.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace PVEngine
+{
+#ifdef _WIN32
+	// kernel plus user time, FILETIME counts 100 ns ticks
+	static double toSeconds(const FILETIME& kernelTime, const FILETIME& userTime)
+	{
+		ULARGE_INTEGER kernel;
+		kernel.LowPart = kernelTime.dwLowDateTime;
+		kernel.HighPart = kernelTime.dwHighDateTime;
+		ULARGE_INTEGER user;
+		user.LowPart = userTime.dwLowDateTime;
+		user.HighPart = userTime.dwHighDateTime;
+		return (kernel.QuadPart + user.QuadPart) * 1e-7;
+	}
+#else
+	static double readClock(clockid_t clock)
+	{
+		timespec time;
+		clock_gettime(clock, &time);
+		return time.tv_sec + time.tv_nsec * 1e-9;
+	}
+#endif
+
+	double PVCpuTime::GetThreadSeconds()
+	{
+#ifdef _WIN32
+		FILETIME creationTime, exitTime, kernelTime, userTime;
+		GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime);
+		return toSeconds(kernelTime, userTime);
+#else
+		return readClock(CLOCK_THREAD_CPUTIME_ID);
+#endif
+	}
+
+	double PVCpuTime::GetProcessSeconds()
+	{
+#ifdef _WIN32
+		FILETIME creationTime, exitTime, kernelTime, userTime;
+		GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime);
+		return toSeconds(kernelTime, userTime);
+#else
+		return readClock(CLOCK_PROCESS_CPUTIME_ID);
+#endif
+	}
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+namespace PVEngine
+{
+	// CPU time actually spent executing, as opposed to wall time, for utilization reports.
+	// Process time includes every thread, the driver's as well.
+	class PVCpuTime
+	{
+	public:
+		// seconds the calling thread has spent on a CPU
+		static double GetThreadSeconds();
+
+		static double GetProcessSeconds();
+	};
+}
@@ -0,0 +1,140 @@
+#include "PVDeletionQueue.h"
+#include "PVHostAllocator.h"
+
+namespace PVEngine
+{
+	PVDeletionQueue::PVDeletionQueue(const VkDevice* logicalDevice)
+		: device(logicalDevice)
+	{
+	}
+
+
+	PVDeletionQueue::~PVDeletionQueue()
+	{
+	}
+
+	void PVDeletionQueue::RetireBuffer(VkBuffer buffer, uint64_t retireValue)
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		buffers.push_back({ buffer, retireValue });
+	}
+
+	void PVDeletionQueue::RetireMemory(VkDeviceMemory deviceMemory, uint64_t retireValue)
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		memory.push_back({ deviceMemory, retireValue });
+	}
+
+	void PVDeletionQueue::RetireImage(VkImage image, uint64_t retireValue)
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		images.push_back({ image, retireValue });
+	}
+
+	void PVDeletionQueue::RetireImageView(VkImageView imageView, uint64_t retireValue)
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		imageViews.push_back({ imageView, retireValue });
+	}
+
+	void PVDeletionQueue::RetireFramebuffer(VkFramebuffer framebuffer, uint64_t retireValue)
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		framebuffers.push_back({ framebuffer, retireValue });
+	}
+
+	void PVDeletionQueue::RetirePipeline(VkPipeline pipeline, uint64_t retireValue)
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		pipelines.push_back({ pipeline, retireValue });
+	}
+
+	void PVDeletionQueue::RetirePipelineLayout(VkPipelineLayout pipelineLayout, uint64_t retireValue)
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		pipelineLayouts.push_back({ pipelineLayout, retireValue });
+	}
+
+	void PVDeletionQueue::RetireRenderPass(VkRenderPass renderPass, uint64_t retireValue)
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		renderPasses.push_back({ renderPass, retireValue });
+	}
+
+	void PVDeletionQueue::RetireSwapchain(VkSwapchainKHR swapchain, uint64_t retireValue)
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		swapchains.push_back({ swapchain, retireValue });
+	}
+
+	void PVDeletionQueue::RetireCommandBuffers(VkCommandPool commandPool, const std::vector<VkCommandBuffer>& buffersToFree, uint64_t retireValue)
+	{
+		if (buffersToFree.empty())
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(queueMutex);
+		commandBuffers.push_back({ commandPool, buffersToFree, retireValue });
+	}
+
+	void PVDeletionQueue::Flush(uint64_t completedValue)
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		VkDevice logicalDevice = *device;
+
+		// order matters, objects are destroyed before anything they were created from
+		flushList(commandBuffers, completedValue, [logicalDevice](const RetiredCommandBuffers& retired)
+		{
+			vkFreeCommandBuffers(logicalDevice, retired.commandPool, static_cast<uint32_t>(retired.commandBuffers.size()), retired.commandBuffers.data());
+		});
+		flushList(framebuffers, completedValue, [logicalDevice](const RetiredObject<VkFramebuffer>& retired)
+		{
+			vkDestroyFramebuffer(logicalDevice, retired.handle, PVHostAllocator::Callbacks(PVAllocationType::Framebuffer));
+		});
+		flushList(imageViews, completedValue, [logicalDevice](const RetiredObject<VkImageView>& retired)
+		{
+			vkDestroyImageView(logicalDevice, retired.handle, PVHostAllocator::Callbacks(PVAllocationType::ImageView));
+		});
+		flushList(images, completedValue, [logicalDevice](const RetiredObject<VkImage>& retired)
+		{
+			vkDestroyImage(logicalDevice, retired.handle, PVHostAllocator::Callbacks(PVAllocationType::Image));
+		});
+		flushList(swapchains, completedValue, [logicalDevice](const RetiredObject<VkSwapchainKHR>& retired)
+		{
+			vkDestroySwapchainKHR(logicalDevice, retired.handle, PVHostAllocator::Callbacks(PVAllocationType::Swapchain));
+		});
+		flushList(pipelines, completedValue, [logicalDevice](const RetiredObject<VkPipeline>& retired)
+		{
+			vkDestroyPipeline(logicalDevice, retired.handle, PVHostAllocator::Callbacks(PVAllocationType::Pipeline));
+		});
+		flushList(pipelineLayouts, completedValue, [logicalDevice](const RetiredObject<VkPipelineLayout>& retired)
+		{
+			vkDestroyPipelineLayout(logicalDevice, retired.handle, PVHostAllocator::Callbacks(PVAllocationType::PipelineLayout));
+		});
+		flushList(renderPasses, completedValue, [logicalDevice](const RetiredObject<VkRenderPass>& retired)
+		{
+			vkDestroyRenderPass(logicalDevice, retired.handle, PVHostAllocator::Callbacks(PVAllocationType::RenderPass));
+		});
+		flushList(buffers, completedValue, [logicalDevice](const RetiredObject<VkBuffer>& retired)
+		{
+			vkDestroyBuffer(logicalDevice, retired.handle, PVHostAllocator::Callbacks(PVAllocationType::Buffer));
+		});
+		flushList(memory, completedValue, [logicalDevice](const RetiredObject<VkDeviceMemory>& retired)
+		{
+			vkFreeMemory(logicalDevice, retired.handle, PVHostAllocator::Callbacks(PVAllocationType::Memory));
+		});
+	}
+
+	void PVDeletionQueue::FlushAll()
+	{
+		Flush(UINT64_MAX);
+	}
+
+	size_t PVDeletionQueue::GetPendingCount()
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		return buffers.size() + memory.size() + images.size() + imageViews.size() + framebuffers.size() + pipelines.size()
+			+ pipelineLayouts.size() + renderPasses.size() + swapchains.size() + commandBuffers.size();
+	}
+}
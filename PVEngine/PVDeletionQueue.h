@@ -0,0 +1,88 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+namespace PVEngine
+{
+	// Holds Vulkan objects that are no longer referenced by new work but may still be in use
+	// by the GPU. Every object is tagged with the frame (or timeline value) that last used it
+	// and is only destroyed once Flush is called with a completed value at or past that tag.
+	// Retire* may be called from any thread, Flush/FlushAll from the thread owning the device.
+	class PVDeletionQueue
+	{
+	public:
+		PVDeletionQueue(const VkDevice* logicalDevice);
+		~PVDeletionQueue();
+
+		void RetireBuffer(VkBuffer buffer, uint64_t retireValue);
+		void RetireMemory(VkDeviceMemory deviceMemory, uint64_t retireValue);
+		void RetireImage(VkImage image, uint64_t retireValue);
+		void RetireImageView(VkImageView imageView, uint64_t retireValue);
+		void RetireFramebuffer(VkFramebuffer framebuffer, uint64_t retireValue);
+		void RetirePipeline(VkPipeline pipeline, uint64_t retireValue);
+		void RetirePipelineLayout(VkPipelineLayout pipelineLayout, uint64_t retireValue);
+		void RetireRenderPass(VkRenderPass renderPass, uint64_t retireValue);
+		void RetireSwapchain(VkSwapchainKHR swapchain, uint64_t retireValue);
+		void RetireCommandBuffers(VkCommandPool commandPool, const std::vector<VkCommandBuffer>& buffersToFree, uint64_t retireValue);
+
+		// destroys every object whose retire value is <= completedValue
+		void Flush(uint64_t completedValue);
+
+		// destroys everything, only call once the device is idle
+		void FlushAll();
+
+		//Getters
+		size_t GetPendingCount();
+
+	private:
+		template <typename T>
+		struct RetiredObject
+		{
+			T handle;
+			uint64_t retireValue;
+		};
+
+		struct RetiredCommandBuffers
+		{
+			VkCommandPool commandPool;
+			std::vector<VkCommandBuffer> commandBuffers;
+			uint64_t retireValue;
+		};
+
+		// moves every entry with retireValue <= completedValue out of list and destroys it
+		template <typename T, typename DestroyFunc>
+		void flushList(std::vector<T>& list, uint64_t completedValue, DestroyFunc destroy)
+		{
+			size_t kept = 0;
+			for (size_t i = 0; i < list.size(); i++)
+			{
+				if (list[i].retireValue <= completedValue)
+				{
+					destroy(list[i]);
+				}
+				else
+				{
+					list[kept++] = list[i];
+				}
+			}
+			list.resize(kept);
+		}
+
+		const VkDevice* device;
+
+		std::mutex queueMutex;
+
+		std::vector<RetiredObject<VkBuffer>> buffers;
+		std::vector<RetiredObject<VkDeviceMemory>> memory;
+		std::vector<RetiredObject<VkImage>> images;
+		std::vector<RetiredObject<VkImageView>> imageViews;
+		std::vector<RetiredObject<VkFramebuffer>> framebuffers;
+		std::vector<RetiredObject<VkPipeline>> pipelines;
+		std::vector<RetiredObject<VkPipelineLayout>> pipelineLayouts;
+		std::vector<RetiredObject<VkRenderPass>> renderPasses;
+		std::vector<RetiredObject<VkSwapchainKHR>> swapchains;
+		std::vector<RetiredCommandBuffers> commandBuffers;
+	};
+}
@@ -0,0 +1,285 @@
+#include "PVDescriptorAllocator.h"
+#include "PVHostAllocator.h"
+
+#include <algorithm>
+
+namespace PVEngine
+{
+	// descriptors per set a pool is sized for, by type
+	static const struct
+	{
+		VkDescriptorType type;
+		float perSet;
+	} poolRatios[] =
+	{
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+		{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.0f },
+		{ VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f },
+		{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 0.5f },
+	};
+
+	// pools stop doubling at this size
+	static const uint32_t maxSetsPerPool = 4096;
+
+	PVDescriptorAllocator::PVDescriptorAllocator(const VkDevice* logicalDevice, uint32_t initialSetsPerPool /* = 32 */)
+		: device(logicalDevice), nextPoolSize(initialSetsPerPool), cachedSets(64)
+	{
+	}
+
+
+	PVDescriptorAllocator::~PVDescriptorAllocator()
+	{
+	}
+
+	void PVDescriptorAllocator::Cleanup()
+	{
+		for (auto& pool : usedPools)
+		{
+			vkDestroyDescriptorPool(*device, pool.pool, PVHostAllocator::Callbacks(PVAllocationType::Descriptor));
+		}
+		for (auto& pool : freePools)
+		{
+			vkDestroyDescriptorPool(*device, pool.pool, PVHostAllocator::Callbacks(PVAllocationType::Descriptor));
+		}
+		usedPools.clear();
+		freePools.clear();
+		generation++;
+		cachedSetCount = 0;
+	}
+
+	VkDescriptorSet PVDescriptorAllocator::Allocate(VkDescriptorSetLayout layout)
+	{
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		VkDescriptorSet set;
+		allocInfo.descriptorPool = currentPool().pool;
+		VkResult result = vkAllocateDescriptorSets(*device, &allocInfo, &set);
+
+		if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+		{
+			// the current pool is full, move on to a fresh one and try once more
+			Pool fresh = freePools.empty() ? createPool(nextPoolSize) : freePools.back();
+			if (!freePools.empty())
+			{
+				freePools.pop_back();
+			}
+			usedPools.push_back(fresh);
+
+			allocInfo.descriptorPool = fresh.pool;
+			result = vkAllocateDescriptorSets(*device, &allocInfo, &set);
+		}
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create descriptor set");
+		}
+
+		allocatedSets++;
+		return set;
+	}
+
+	VkDescriptorSet PVDescriptorAllocator::GetSet(VkDescriptorSetLayout layout, const PVDescriptorWrite* writes, uint32_t writeCount)
+	{
+		uint64_t hash = hashSet(layout, writes, writeCount);
+
+		// sets with equal hashes but different writes fall through to a fresh set
+		size_t mask = cachedSets.size() - 1;
+		for (size_t i = hash & mask; cachedSets[i].generation == generation; i = (i + 1) & mask)
+		{
+			if (cachedSets[i].hash == hash && sameSet(cachedSets[i], layout, writes, writeCount))
+			{
+				cacheHits++;
+				return cachedSets[i].set;
+			}
+		}
+
+		VkDescriptorSet set = Allocate(layout);
+		WriteSet(device, set, writes, writeCount);
+
+		if ((cachedSetCount + 1) * 4 > cachedSets.size() * 3)
+		{
+			growCache();
+			mask = cachedSets.size() - 1;
+		}
+		size_t slot = hash & mask;
+		while (cachedSets[slot].generation == generation)
+		{
+			slot = (slot + 1) & mask;
+		}
+		CachedSet& cached = cachedSets[slot];
+		cached.generation = generation;
+		cached.hash = hash;
+		cached.set = set;
+		cached.layout = layout;
+		cached.writeCount = writeCount;
+		std::copy(writes, writes + writeCount, cached.writes);
+		cachedSetCount++;
+		return set;
+	}
+
+	void PVDescriptorAllocator::WriteSet(const VkDevice* logicalDevice, VkDescriptorSet set, const PVDescriptorWrite* writes, uint32_t writeCount)
+	{
+		if (writeCount > MaxWritesPerSet)
+		{
+			throw std::runtime_error("Descriptor set has more writes than PVDescriptorAllocator::MaxWritesPerSet");
+		}
+
+		VkWriteDescriptorSet descriptorWrites[MaxWritesPerSet];
+		for (uint32_t i = 0; i < writeCount; i++)
+		{
+			VkWriteDescriptorSet& descriptorWrite = descriptorWrites[i];
+			descriptorWrite = {};
+			descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrite.dstSet = set;
+			descriptorWrite.dstBinding = writes[i].binding;
+			descriptorWrite.dstArrayElement = 0;
+			descriptorWrite.descriptorType = writes[i].type;
+			descriptorWrite.descriptorCount = 1;
+			if (writes[i].bufferInfo.buffer != VK_NULL_HANDLE)
+			{
+				descriptorWrite.pBufferInfo = &writes[i].bufferInfo;
+			}
+			else
+			{
+				descriptorWrite.pImageInfo = &writes[i].imageInfo;
+			}
+		}
+		vkUpdateDescriptorSets(*logicalDevice, writeCount, descriptorWrites, 0, nullptr);
+	}
+
+	void PVDescriptorAllocator::Reset()
+	{
+		for (auto& pool : usedPools)
+		{
+			vkResetDescriptorPool(*device, pool.pool, 0);
+			freePools.push_back(pool);
+		}
+		usedPools.clear();
+
+		// every cached entry belongs to an older generation from now on
+		generation++;
+		cachedSetCount = 0;
+	}
+
+	void PVDescriptorAllocator::growCache()
+	{
+		std::vector<CachedSet> previous(cachedSets.size() * 2);
+		previous.swap(cachedSets);
+
+		size_t mask = cachedSets.size() - 1;
+		for (const auto& cached : previous)
+		{
+			if (cached.generation != generation)
+			{
+				continue;
+			}
+			size_t slot = cached.hash & mask;
+			while (cachedSets[slot].generation == generation)
+			{
+				slot = (slot + 1) & mask;
+			}
+			cachedSets[slot] = cached;
+		}
+	}
+
+	PVDescriptorAllocator::Pool& PVDescriptorAllocator::currentPool()
+	{
+		if (usedPools.empty())
+		{
+			if (freePools.empty())
+			{
+				usedPools.push_back(createPool(nextPoolSize));
+			}
+			else
+			{
+				usedPools.push_back(freePools.back());
+				freePools.pop_back();
+			}
+		}
+		return usedPools.back();
+	}
+
+	PVDescriptorAllocator::Pool PVDescriptorAllocator::createPool(uint32_t maxSets)
+	{
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		for (const auto& ratio : poolRatios)
+		{
+			uint32_t count = static_cast<uint32_t>(ratio.perSet * maxSets);
+			poolSizes.push_back({ ratio.type, count > 0 ? count : 1 });
+		}
+
+		VkDescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		poolInfo.maxSets = maxSets;
+
+		Pool pool;
+		pool.maxSets = maxSets;
+		if (vkCreateDescriptorPool(*device, &poolInfo, PVHostAllocator::Callbacks(PVAllocationType::Descriptor), &pool.pool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create descriptor pool");
+		}
+		else
+		{
+			std::cout << "Descriptor Pool created successfully with room for " << maxSets << " sets" << std::endl;
+		}
+
+		nextPoolSize = maxSets * 2 < maxSetsPerPool ? maxSets * 2 : maxSetsPerPool;
+		return pool;
+	}
+
+	uint64_t PVDescriptorAllocator::hashSet(VkDescriptorSetLayout layout, const PVDescriptorWrite* writes, uint32_t writeCount)
+	{
+		// FNV-1a over the layout and the bound resources
+		uint64_t hash = 14695981039346656037ull;
+		auto mix = [&hash](uint64_t value)
+		{
+			hash ^= value;
+			hash *= 1099511628211ull;
+		};
+
+		mix(reinterpret_cast<uint64_t>(layout));
+		for (uint32_t i = 0; i < writeCount; i++)
+		{
+			const PVDescriptorWrite& write = writes[i];
+			mix(write.binding);
+			mix(static_cast<uint64_t>(write.type));
+			mix(reinterpret_cast<uint64_t>(write.bufferInfo.buffer));
+			mix(write.bufferInfo.offset);
+			mix(write.bufferInfo.range);
+			mix(reinterpret_cast<uint64_t>(write.imageInfo.imageView));
+			mix(reinterpret_cast<uint64_t>(write.imageInfo.sampler));
+			mix(static_cast<uint64_t>(write.imageInfo.imageLayout));
+		}
+		return hash;
+	}
+
+	bool PVDescriptorAllocator::sameSet(const CachedSet& cached, VkDescriptorSetLayout layout, const PVDescriptorWrite* writes, uint32_t writeCount)
+	{
+		if (cached.layout != layout || cached.writeCount != writeCount)
+		{
+			return false;
+		}
+		for (uint32_t i = 0; i < writeCount; i++)
+		{
+			const PVDescriptorWrite& a = cached.writes[i];
+			const PVDescriptorWrite& b = writes[i];
+			if (a.binding != b.binding || a.type != b.type
+				|| a.bufferInfo.buffer != b.bufferInfo.buffer || a.bufferInfo.offset != b.bufferInfo.offset
+				|| a.bufferInfo.range != b.bufferInfo.range || a.imageInfo.imageView != b.imageInfo.imageView
+				|| a.imageInfo.sampler != b.imageInfo.sampler || a.imageInfo.imageLayout != b.imageInfo.imageLayout)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <stdexcept>
+#include <initializer_list>
+#include <vector>
+
+namespace PVEngine
+{
+	// one resource bound to a descriptor set, either a buffer range or an image
+	struct PVDescriptorWrite
+	{
+		uint32_t binding;
+		VkDescriptorType type;
+		VkDescriptorBufferInfo bufferInfo;
+		VkDescriptorImageInfo imageInfo;
+
+		static PVDescriptorWrite Buffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+		{
+			PVDescriptorWrite write = {};
+			write.binding = binding;
+			write.type = type;
+			write.bufferInfo = { buffer, offset, range };
+			return write;
+		}
+
+		static PVDescriptorWrite Image(uint32_t binding, VkDescriptorType type, VkImageView imageView, VkSampler sampler, VkImageLayout layout)
+		{
+			PVDescriptorWrite write = {};
+			write.binding = binding;
+			write.type = type;
+			write.imageInfo = { sampler, imageView, layout };
+			return write;
+		}
+	};
+
+	// Hands out descriptor sets from a list of pools that grows when the current pool runs out,
+	// each new pool twice the size of the previous one. Sets requested through GetSet are cached
+	// by their layout and bound resources, so asking for the same set again is a hash lookup.
+	// Reset gives every set back at once by resetting the pools, which is how the per-frame
+	// allocators are recycled when their frame slot comes around again. Like a command pool an
+	// allocator must only be used by one thread at a time.
+	//
+	// The cache is an open addressed table that Reset empties by moving to a new generation, it
+	// only allocates when a frame asks for more distinct sets than any frame before it.
+	class PVDescriptorAllocator
+	{
+	public:
+		PVDescriptorAllocator(const VkDevice* logicalDevice, uint32_t initialSetsPerPool = 32);
+		~PVDescriptorAllocator();
+
+		void Cleanup();
+
+		// uncached allocation, the caller writes the descriptors
+		VkDescriptorSet Allocate(VkDescriptorSetLayout layout);
+
+		// allocated and written on the first request, cached until Reset
+		VkDescriptorSet GetSet(VkDescriptorSetLayout layout, std::initializer_list<PVDescriptorWrite> writes)
+		{
+			return GetSet(layout, writes.begin(), static_cast<uint32_t>(writes.size()));
+		}
+		VkDescriptorSet GetSet(VkDescriptorSetLayout layout, const PVDescriptorWrite* writes, uint32_t writeCount);
+
+		// writes into a set the caller owns, which the GPU must not be using
+		static void WriteSet(const VkDevice* logicalDevice, VkDescriptorSet set, std::initializer_list<PVDescriptorWrite> writes)
+		{
+			WriteSet(logicalDevice, set, writes.begin(), static_cast<uint32_t>(writes.size()));
+		}
+		static void WriteSet(const VkDevice* logicalDevice, VkDescriptorSet set, const PVDescriptorWrite* writes, uint32_t writeCount);
+
+		static const uint32_t MaxWritesPerSet = 8;
+
+		// frees every set, only once the GPU is done with all of them
+		void Reset();
+
+		//Getters
+		size_t GetPoolCount() const { return usedPools.size() + freePools.size(); }
+		uint64_t GetAllocatedSetCount() const { return allocatedSets; }
+		uint64_t GetCacheHitCount() const { return cacheHits; }
+
+	private:
+		struct CachedSet
+		{
+			// empty unless it matches the allocator's generation
+			uint64_t generation = 0;
+			uint64_t hash;
+			VkDescriptorSet set;
+			VkDescriptorSetLayout layout;
+			uint32_t writeCount;
+			PVDescriptorWrite writes[MaxWritesPerSet];
+		};
+
+		struct Pool
+		{
+			VkDescriptorPool pool;
+			uint32_t maxSets;
+		};
+
+		// the current pool, taken from the free list or newly created
+		Pool& currentPool();
+		Pool createPool(uint32_t maxSets);
+
+		// doubles the table, rehashing the sets of the current generation
+		void growCache();
+
+		static uint64_t hashSet(VkDescriptorSetLayout layout, const PVDescriptorWrite* writes, uint32_t writeCount);
+		static bool sameSet(const CachedSet& cached, VkDescriptorSetLayout layout, const PVDescriptorWrite* writes, uint32_t writeCount);
+
+		const VkDevice* device;
+
+		uint32_t nextPoolSize;
+
+		// pools handed out since the last Reset, the last one is allocated from
+		std::vector<Pool> usedPools;
+
+		// reset pools waiting to be reused
+		std::vector<Pool> freePools;
+
+		// a power of two of entries, at most three quarters used
+		std::vector<CachedSet> cachedSets;
+		uint32_t cachedSetCount = 0;
+		uint64_t generation = 1;
+
+		uint64_t allocatedSets = 0;
+
+		uint64_t cacheHits = 0;
+	};
+}
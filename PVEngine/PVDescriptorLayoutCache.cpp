@@ -0,0 +1,103 @@
+#include "PVDescriptorLayoutCache.h"
+#include "PVHostAllocator.h"
+
+#include <algorithm>
+
+namespace PVEngine
+{
+	PVDescriptorLayoutCache::PVDescriptorLayoutCache(const VkDevice* logicalDevice)
+		: device(logicalDevice)
+	{
+	}
+
+
+	PVDescriptorLayoutCache::~PVDescriptorLayoutCache()
+	{
+	}
+
+	void PVDescriptorLayoutCache::Cleanup()
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		for (auto& cached : layouts)
+		{
+			vkDestroyDescriptorSetLayout(*device, cached.second.layout, PVHostAllocator::Callbacks(PVAllocationType::Descriptor));
+		}
+		layouts.clear();
+	}
+
+	VkDescriptorSetLayout PVDescriptorLayoutCache::GetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings)
+	{
+		std::sort(bindings.begin(), bindings.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b)
+		{
+			return a.binding < b.binding;
+		});
+		uint64_t hash = hashBindings(bindings);
+
+		// layouts are only created at load time, holding the lock during creation is fine
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		auto cached = layouts.find(hash);
+		if (cached != layouts.end())
+		{
+			if (!sameBindings(cached->second.bindings, bindings))
+			{
+				throw std::runtime_error("Descriptor set layout hash collision");
+			}
+			return cached->second.layout;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		VkDescriptorSetLayout layout;
+		if (vkCreateDescriptorSetLayout(*device, &layoutInfo, PVHostAllocator::Callbacks(PVAllocationType::Descriptor), &layout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create descriptor set layout");
+		}
+		else
+		{
+			std::cout << "Descriptor Set Layout created successfully" << std::endl;
+		}
+
+		layouts[hash] = CachedLayout{ layout, bindings };
+		return layout;
+	}
+
+	uint64_t PVDescriptorLayoutCache::hashBindings(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+	{
+		// FNV-1a over the fields that make up the signature
+		uint64_t hash = 14695981039346656037ull;
+		auto mix = [&hash](uint64_t value)
+		{
+			hash ^= value;
+			hash *= 1099511628211ull;
+		};
+
+		for (const auto& binding : bindings)
+		{
+			mix(binding.binding);
+			mix(static_cast<uint64_t>(binding.descriptorType));
+			mix(binding.descriptorCount);
+			mix(binding.stageFlags);
+		}
+		return hash;
+	}
+
+	bool PVDescriptorLayoutCache::sameBindings(const std::vector<VkDescriptorSetLayoutBinding>& a, const std::vector<VkDescriptorSetLayoutBinding>& b)
+	{
+		if (a.size() != b.size())
+		{
+			return false;
+		}
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			if (a[i].binding != b[i].binding || a[i].descriptorType != b[i].descriptorType
+				|| a[i].descriptorCount != b[i].descriptorCount || a[i].stageFlags != b[i].stageFlags)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
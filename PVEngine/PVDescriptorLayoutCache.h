@@ -0,0 +1,45 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+namespace PVEngine
+{
+	// Descriptor set layouts deduplicated by their binding signature, so every pipeline or
+	// material asking for the same bindings shares one VkDescriptorSetLayout. Binding order in
+	// the request does not matter. Layouts live until Cleanup and can be requested from
+	// several threads at once.
+	class PVDescriptorLayoutCache
+	{
+	public:
+		PVDescriptorLayoutCache(const VkDevice* logicalDevice);
+		~PVDescriptorLayoutCache();
+
+		void Cleanup();
+
+		VkDescriptorSetLayout GetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings);
+
+		//Getters
+		size_t GetLayoutCount() { std::lock_guard<std::mutex> lock(cacheMutex); return layouts.size(); }
+
+	private:
+		struct CachedLayout
+		{
+			VkDescriptorSetLayout layout;
+			std::vector<VkDescriptorSetLayoutBinding> bindings;
+		};
+
+		// bindings must be sorted, immutable samplers are not part of the signature
+		static uint64_t hashBindings(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+		static bool sameBindings(const std::vector<VkDescriptorSetLayoutBinding>& a, const std::vector<VkDescriptorSetLayoutBinding>& b);
+
+		const VkDevice* device;
+
+		std::mutex cacheMutex;
+
+		std::unordered_map<uint64_t, CachedLayout> layouts;
+	};
+}
@@ -0,0 +1,63 @@
+#include "PVDeviceContext.h"
+
+namespace PVEngine
+{
+	PVDeviceContext::PVDeviceContext(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface)
+		: physicalDevice(physicalDevice), surface(surface)
+	{
+		queueFamilyIndices = FindQueueFamilies(&physicalDevice, &surface);
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+
+		std::cout << "Device context created for " << properties.deviceName << std::endl;
+	}
+
+
+	PVDeviceContext::~PVDeviceContext()
+	{
+	}
+
+	uint32_t PVDeviceContext::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags requiredProperties) const
+	{
+		uint32_t memoryTypeIndex;
+		if (!TryFindMemoryType(typeFilter, requiredProperties, memoryTypeIndex))
+		{
+			throw std::runtime_error("Failed to find suitable memory type");
+		}
+		return memoryTypeIndex;
+	}
+
+	bool PVDeviceContext::TryFindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags requiredProperties, uint32_t& memoryTypeIndex) const
+	{
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+		{
+			if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & requiredProperties) == requiredProperties)
+			{
+				memoryTypeIndex = i;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	VkFormat PVDeviceContext::FindDepthFormat() const
+	{
+		// reversed-Z only gains precision with a float format, the fixed point ones are a fallback
+		const VkFormat candidates[] = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D24_UNORM_S8_UINT };
+		for (VkFormat format : candidates)
+		{
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+			if (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+			{
+				if (format != VK_FORMAT_D32_SFLOAT && format != VK_FORMAT_D32_SFLOAT_S8_UINT)
+				{
+					std::cout << "No float depth format available, distant depth will lose precision" << std::endl;
+				}
+				return format;
+			}
+		}
+		throw std::runtime_error("Failed to find a supported depth format");
+	}
+}
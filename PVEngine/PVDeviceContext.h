@@ -0,0 +1,50 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <stdexcept>
+
+#include "PVQueueFamily.h"
+
+namespace PVEngine
+{
+	// Holds the physical/logical device handles together with everything we need to know
+	// about the physical device. Built once after the physical device is picked so buffers
+	// and the swapchain never have to query the driver again.
+	class PVDeviceContext
+	{
+	public:
+		PVDeviceContext(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface);
+		~PVDeviceContext();
+
+		void SetLogicalDevice(VkDevice logicalDevice) { this->logicalDevice = logicalDevice; }
+
+		uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags requiredProperties) const;
+
+		// same as FindMemoryType but reports failure instead of throwing, for optional memory types
+		bool TryFindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags requiredProperties, uint32_t& memoryTypeIndex) const;
+
+		// the depth format for reversed-Z, a float format when the device can render to one
+		VkFormat FindDepthFormat() const;
+
+		//Getters
+		const VkDevice* GetLogicalDevice() const { return &logicalDevice; }
+		const VkPhysicalDevice* GetPhysicalDevice() const { return &physicalDevice; }
+		const VkSurfaceKHR* GetSurface() const { return &surface; }
+		const QueueFamilyIndices& GetQueueFamilyIndices() const { return queueFamilyIndices; }
+		const VkPhysicalDeviceMemoryProperties& GetMemoryProperties() const { return memoryProperties; }
+		const VkPhysicalDeviceProperties& GetProperties() const { return properties; }
+		const VkPhysicalDeviceLimits& GetLimits() const { return properties.limits; }
+		const VkPhysicalDeviceFeatures& GetFeatures() const { return features; }
+
+	private:
+		VkPhysicalDevice physicalDevice;
+		VkDevice logicalDevice = VK_NULL_HANDLE;
+		VkSurfaceKHR surface;
+
+		// cached physical device information
+		QueueFamilyIndices queueFamilyIndices;
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		VkPhysicalDeviceProperties properties;
+		VkPhysicalDeviceFeatures features;
+	};
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+namespace PVEngine
+{
+	// Per-draw data pushed with vkCmdPushConstants, mirrors DrawConstants in shader.vert. At 80
+	// bytes it fits the 128 bytes of push constants every device guarantees.
+	struct PVDrawConstants
+	{
+		glm::mat4 model;
+
+		// x: morph factor towards the next terrain LOD, y: LOD level, zw: a terrain tile's corner
+		// in terrain space
+		glm::vec4 morph;
+
+		static VkPushConstantRange getPushConstantRange()
+		{
+			VkPushConstantRange range = {};
+			range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+			range.offset = 0;
+			range.size = sizeof(PVDrawConstants);
+
+			return range;
+		}
+	};
+}
@@ -0,0 +1,75 @@
+#include "PVFrameArena.h"
+
+#include <algorithm>
+#include <new>
+
+namespace PVEngine
+{
+	PVFrameArena::PVFrameArena(size_t capacity)
+		: capacity(capacity)
+	{
+		block = static_cast<uint8_t*>(::operator new(capacity));
+		// room to record overflow without the bookkeeping itself allocating mid frame
+		overflowBlocks.reserve(16);
+	}
+
+
+	PVFrameArena::~PVFrameArena()
+	{
+		Reset();
+		::operator delete(block);
+	}
+
+	void PVFrameArena::Reset()
+	{
+		for (const auto& overflowBlock : overflowBlocks)
+		{
+			::operator delete(overflowBlock.first, overflowBlock.second);
+		}
+		overflowBlocks.clear();
+
+		if (overflowBytes > 0)
+		{
+			// the frame did not fit, size the block for it with some headroom
+			capacity = std::max(capacity * 2, (used + overflowBytes) * 3 / 2);
+			::operator delete(block);
+			block = static_cast<uint8_t*>(::operator new(capacity));
+			overflowCount++;
+		}
+
+		used = 0;
+		overflowBytes = 0;
+	}
+
+	void* PVFrameArena::do_allocate(size_t bytes, size_t alignment)
+	{
+		uintptr_t base = reinterpret_cast<uintptr_t>(block);
+		uintptr_t aligned = (base + used + alignment - 1) & ~(uintptr_t(alignment) - 1);
+		size_t end = static_cast<size_t>(aligned - base) + bytes;
+
+		if (end <= capacity)
+		{
+			used = end;
+			peakBytes = std::max(peakBytes, GetUsedBytes());
+			return reinterpret_cast<void*>(aligned);
+		}
+
+		std::align_val_t overflowAlignment = std::align_val_t(std::max(alignment, alignof(std::max_align_t)));
+		void* memory = ::operator new(bytes, overflowAlignment);
+		overflowBlocks.push_back(std::make_pair(memory, overflowAlignment));
+		overflowBytes += bytes;
+		overflowCount++;
+		peakBytes = std::max(peakBytes, GetUsedBytes());
+		return memory;
+	}
+
+	void PVFrameArena::do_deallocate(void* memory, size_t bytes, size_t alignment)
+	{
+		// released all at once by Reset
+	}
+
+	bool PVFrameArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+	{
+		return this == &other;
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <memory_resource>
+
+namespace PVEngine
+{
+	// Linear allocator for memory that only lives for one frame. Allocations bump a pointer
+	// through one block and are never freed individually, Reset at the start of the frame
+	// hands everything back at once. The engine keeps one arena per frame in flight so data
+	// built for a frame can still be read while the next one is being prepared.
+	//
+	// It is a std::pmr::memory_resource, so standard containers draw from it through a
+	// polymorphic allocator:
+	//
+	//     std::pmr::vector<InstanceData> visible(&arena);
+	//
+	// When a frame needs more than the block holds the extra allocations come from the heap,
+	// and the next Reset replaces the block with one large enough for the whole frame, so
+	// after the first few frames a steady state frame makes no heap allocations at all.
+	// An arena belongs to one thread.
+	class PVFrameArena : public std::pmr::memory_resource
+	{
+	public:
+		explicit PVFrameArena(size_t capacity = 256 * 1024);
+		~PVFrameArena();
+
+		PVFrameArena(const PVFrameArena&) = delete;
+		PVFrameArena& operator=(const PVFrameArena&) = delete;
+
+		// everything allocated since the last reset becomes invalid
+		void Reset();
+
+		//Getters
+		size_t GetCapacity() const { return capacity; }
+		size_t GetUsedBytes() const { return used + overflowBytes; }
+		size_t GetPeakBytes() const { return peakBytes; }
+
+		// heap allocations made because the block ran out, growing it included
+		uint64_t GetOverflowCount() const { return overflowCount; }
+
+	protected:
+		void* do_allocate(size_t bytes, size_t alignment) override;
+		void do_deallocate(void* memory, size_t bytes, size_t alignment) override;
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+	private:
+		uint8_t* block = nullptr;
+		size_t capacity;
+		size_t used = 0;
+		size_t peakBytes = 0;
+
+		// allocations that did not fit, freed on the next reset
+		std::vector<std::pair<void*, std::align_val_t>> overflowBlocks;
+		size_t overflowBytes = 0;
+		uint64_t overflowCount = 0;
+	};
+}
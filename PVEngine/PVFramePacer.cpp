@@ -0,0 +1,180 @@
+#include "PVFramePacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace PVEngine
+{
+	PVFramePacer::PVFramePacer(PVTimeline* graphicsTimeline, Policy policy, double targetFps)
+		: timeline(graphicsTimeline), policy(policy), targetFps(targetFps)
+	{
+		if (this->targetFps <= 0.0)
+		{
+			this->targetFps = (policy == Policy::PowerSaving) ? 30.0 : 60.0;
+		}
+	}
+
+
+	PVFramePacer::~PVFramePacer()
+	{
+	}
+
+	std::vector<VkPresentModeKHR> PVFramePacer::GetPresentModePreference() const
+	{
+		switch (policy)
+		{
+		case Policy::LowLatency:
+			// mailbox does not tear, immediate only where it is missing
+			return { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR };
+		case Policy::PowerSaving:
+			return { VK_PRESENT_MODE_FIFO_KHR };
+		case Policy::FixedRate:
+		default:
+			return { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR };
+		}
+	}
+
+	void PVFramePacer::SetSwapchainInfo(VkPresentModeKHR presentMode, uint32_t imageCount)
+	{
+		this->presentMode = presentMode;
+		this->imageCount = imageCount;
+	}
+
+	void PVFramePacer::WaitForFrameStart()
+	{
+		Clock::time_point waitStart = Clock::now();
+
+		switch (policy)
+		{
+		case Policy::LowLatency:
+			if (lastSubmitValue > 0 && !timeline->IsComplete(lastSubmitValue))
+			{
+				// the GPU started the last frame when it was submitted, the queue holds nothing else.
+				// Recording overlaps the end of that frame, only the frame slot is waited for later
+				double leadMs = gpuMsAverage - cpuMsAverage;
+				if (leadMs > 0.0)
+				{
+					waitUntil(lastSubmit + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(leadMs)));
+				}
+			}
+			break;
+
+		case Policy::PowerSaving:
+		case Policy::FixedRate:
+		{
+			Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFps));
+			if (!started)
+			{
+				nextDeadline = waitStart;
+			}
+			waitUntil(nextDeadline);
+			// a frame that ran late moves the schedule instead of being followed by a burst
+			nextDeadline = std::max(nextDeadline + period, Clock::now());
+			break;
+		}
+		}
+
+		Clock::time_point now = Clock::now();
+		waitSumMs += std::chrono::duration<double, std::milli>(now - waitStart).count();
+		recordFrameStart(now);
+	}
+
+	void PVFramePacer::FrameSubmitted()
+	{
+		lastSubmit = Clock::now();
+		lastSubmitValue = timeline->GetLastSubmittedValue();
+
+		double cpuMs = std::chrono::duration<double, std::milli>(lastSubmit - frameStart).count();
+		cpuMsAverage = (cpuMsAverage == 0.0) ? cpuMs : cpuMsAverage * 0.9 + cpuMs * 0.1;
+	}
+
+	void PVFramePacer::GpuFrameMeasured(double gpuMs)
+	{
+		gpuMsAverage = (gpuMsAverage == 0.0) ? gpuMs : gpuMsAverage * 0.9 + gpuMs * 0.1;
+	}
+
+	const char* PVFramePacer::GetPolicyName(Policy policy)
+	{
+		switch (policy)
+		{
+		case Policy::LowLatency:
+			return "low latency";
+		case Policy::PowerSaving:
+			return "power saving";
+		case Policy::FixedRate:
+			return "fixed rate";
+		}
+		return "unknown";
+	}
+
+	void PVFramePacer::waitUntil(Clock::time_point deadline)
+	{
+		const Clock::duration spinTime = std::chrono::milliseconds(2);
+		Clock::time_point now = Clock::now();
+		if (deadline - now > spinTime)
+		{
+			std::this_thread::sleep_until(deadline - spinTime);
+		}
+		while (Clock::now() < deadline)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	void PVFramePacer::recordFrameStart(Clock::time_point now)
+	{
+		// frames submitted that the GPU has not finished yet
+		uint64_t queueDepth = timeline->GetLastSubmittedValue() - timeline->GetCompletedValue();
+		queueDepthSum += queueDepth;
+		queueDepthMax = std::max(queueDepthMax, queueDepth);
+		sampledFrames++;
+
+		if (started)
+		{
+			double intervalMs = std::chrono::duration<double, std::milli>(now - frameStart).count();
+			intervalSumMs += intervalMs;
+			intervalSquareSumMs += intervalMs * intervalMs;
+			intervalMaxMs = std::max(intervalMaxMs, intervalMs);
+			reportFrames++;
+		}
+		started = true;
+		frameStart = now;
+
+		if (reportFrames < 300)
+		{
+			return;
+		}
+
+		double meanMs = intervalSumMs / reportFrames;
+		double variance = std::max(intervalSquareSumMs / reportFrames - meanMs * meanMs, 0.0);
+
+		const char* presentModeName = "FIFO";
+		if (presentMode == VK_PRESENT_MODE_IMMEDIATE_KHR)
+		{
+			presentModeName = "IMMEDIATE";
+		}
+		else if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+		{
+			presentModeName = "MAILBOX";
+		}
+		else if (presentMode == VK_PRESENT_MODE_FIFO_RELAXED_KHR)
+		{
+			presentModeName = "FIFO_RELAXED";
+		}
+
+		std::cout << "Frame pacing (" << GetPolicyName(policy) << ", " << presentModeName << ", " << imageCount << " images): "
+			<< meanMs << " ms average frame, " << variance << " ms^2 variance (" << std::sqrt(variance) << " ms std dev), "
+			<< intervalMaxMs << " ms worst, queue depth " << static_cast<double>(queueDepthSum) / sampledFrames << " average, "
+			<< queueDepthMax << " max, " << waitSumMs / sampledFrames << " ms paced wait per frame" << std::endl;
+
+		reportFrames = 0;
+		sampledFrames = 0;
+		intervalSumMs = 0.0;
+		intervalSquareSumMs = 0.0;
+		intervalMaxMs = 0.0;
+		queueDepthSum = 0;
+		queueDepthMax = 0;
+		waitSumMs = 0.0;
+	}
+}
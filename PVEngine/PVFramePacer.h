@@ -0,0 +1,93 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "PVTimeline.h"
+
+namespace PVEngine
+{
+	// Decides when the render loop starts a frame and which present mode the swapchain uses.
+	//
+	// LowLatency presents with MAILBOX, or IMMEDIATE where that is missing. Before starting a
+	// frame it sleeps until the previous one is predicted to finish minus the time the CPU
+	// needs to record, so the snapshot and input it draws are as fresh as possible without
+	// leaving the GPU idle. It never blocks on the GPU itself, the render loop's wait for the
+	// frame slot does.
+	// PowerSaving presents with FIFO and limits the CPU to the target rate, 30 by default, so
+	// neither processor runs faster than needed.
+	// FixedRate starts frames on a fixed clock at the target rate, 60 by default, presenting
+	// with MAILBOX where available so the display refresh does not quantize the interval.
+	//
+	// Every policy reports the frame interval, its variance and the GPU queue depth.
+	class PVFramePacer
+	{
+	public:
+		enum class Policy
+		{
+			LowLatency,
+			PowerSaving,
+			FixedRate,
+		};
+
+		PVFramePacer(PVTimeline* graphicsTimeline, Policy policy, double targetFps);
+		~PVFramePacer();
+
+		// for PVSwapchain::SetPresentModePreference
+		std::vector<VkPresentModeKHR> GetPresentModePreference() const;
+
+		// what the swapchain ended up with, for the report
+		void SetSwapchainInfo(VkPresentModeKHR presentMode, uint32_t imageCount);
+
+		// blocks until the policy wants the next frame to start, call before reading the snapshot
+		void WaitForFrameStart();
+
+		// call once the frame's command buffers have been submitted
+		void FrameSubmitted();
+
+		// GPU time of a finished frame, from the timestamp queries
+		void GpuFrameMeasured(double gpuMs);
+
+		static const char* GetPolicyName(Policy policy);
+
+		//Getters
+		Policy GetPolicy() const { return policy; }
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		// sleeps most of the way and spins the rest, sleep alone overshoots by up to a scheduler tick
+		static void waitUntil(Clock::time_point deadline);
+
+		void recordFrameStart(Clock::time_point frameStart);
+
+		PVTimeline* timeline;
+		Policy policy;
+		double targetFps;
+
+		VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+		uint32_t imageCount = 0;
+
+		Clock::time_point frameStart;
+		Clock::time_point nextDeadline;
+		bool started = false;
+
+		// low latency prediction, exponential moving averages in milliseconds
+		Clock::time_point lastSubmit;
+		uint64_t lastSubmitValue = 0;
+		double cpuMsAverage = 0.0;
+		double gpuMsAverage = 0.0;
+
+		// statistics since the last report
+		uint32_t reportFrames = 0;
+		uint32_t sampledFrames = 0;
+		double intervalSumMs = 0.0;
+		double intervalSquareSumMs = 0.0;
+		double intervalMaxMs = 0.0;
+		uint64_t queueDepthSum = 0;
+		uint64_t queueDepthMax = 0;
+		double waitSumMs = 0.0;
+	};
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <glm/glm.hpp>
+
+namespace PVEngine
+{
+	// The six planes of a view-projection matrix, for culling bounding spheres on the CPU.
+	struct PVFrustum
+	{
+		// xyz: normal pointing inside, w: distance
+		glm::vec4 planes[6];
+
+		static PVFrustum fromViewProjection(const glm::mat4& viewProjection)
+		{
+			// rows of the matrix, glm stores columns
+			glm::vec4 rows[4];
+			for (int i = 0; i < 4; i++)
+			{
+				rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+			}
+
+			PVFrustum frustum;
+			frustum.planes[0] = rows[3] + rows[0];
+			frustum.planes[1] = rows[3] - rows[0];
+			frustum.planes[2] = rows[3] + rows[1];
+			frustum.planes[3] = rows[3] - rows[1];
+			// with the reversed-Z infinite projection w - z is the near plane and w + z only removes
+			// what is behind the camera, there is no far plane to cull against
+			frustum.planes[4] = rows[3] + rows[2];
+			frustum.planes[5] = rows[3] - rows[2];
+
+			for (auto& plane : frustum.planes)
+			{
+				plane /= glm::length(glm::vec3(plane));
+			}
+			return frustum;
+		}
+
+		bool intersectsSphere(const glm::vec3& center, float radius) const
+		{
+			for (const auto& plane : planes)
+			{
+				if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+}
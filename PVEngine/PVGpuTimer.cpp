@@ -0,0 +1,78 @@
+#include "PVGpuTimer.h"
+#include "PVHostAllocator.h"
+
+namespace PVEngine
+{
+	PVGpuTimer::PVGpuTimer(const PVDeviceContext* deviceContext, uint32_t frameCount)
+		: device(deviceContext->GetLogicalDevice()), recorded(frameCount, false)
+	{
+		supported = deviceContext->GetLimits().timestampComputeAndGraphics == VK_TRUE;
+		timestampPeriod = deviceContext->GetLimits().timestampPeriod;
+		if (!supported)
+		{
+			std::cout << "Timestamps are not supported, GPU times will not be reported" << std::endl;
+			return;
+		}
+
+		VkQueryPoolCreateInfo queryPoolInfo = {};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = frameCount * 2;
+
+		if (vkCreateQueryPool(*device, &queryPoolInfo, PVHostAllocator::Callbacks(PVAllocationType::QueryPool), &queryPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create timestamp query pool");
+		}
+	}
+
+
+	PVGpuTimer::~PVGpuTimer()
+	{
+	}
+
+	void PVGpuTimer::Cleanup()
+	{
+		if (queryPool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(*device, queryPool, PVHostAllocator::Callbacks(PVAllocationType::QueryPool));
+		}
+	}
+
+	void PVGpuTimer::Begin(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+	{
+		if (!supported)
+		{
+			return;
+		}
+		vkCmdResetQueryPool(commandBuffer, queryPool, frameIndex * 2, 2);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, frameIndex * 2);
+	}
+
+	void PVGpuTimer::End(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+	{
+		if (!supported)
+		{
+			return;
+		}
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, frameIndex * 2 + 1);
+		recorded[frameIndex] = true;
+	}
+
+	bool PVGpuTimer::GetResult(uint32_t frameIndex, double& milliseconds)
+	{
+		if (!supported || !recorded[frameIndex])
+		{
+			return false;
+		}
+
+		uint64_t timestamps[2];
+		if (vkGetQueryPoolResults(*device, queryPool, frameIndex * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+		{
+			return false;
+		}
+
+		milliseconds = (timestamps[1] - timestamps[0]) * timestampPeriod / 1000000.0;
+		return true;
+	}
+}
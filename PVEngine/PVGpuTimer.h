@@ -0,0 +1,45 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "PVDeviceContext.h"
+
+namespace PVEngine
+{
+	// Measures the GPU time of a span of commands with a pair of timestamps per frame slot. The
+	// result for a slot is read back the next time the slot comes around, after the CPU has
+	// waited for it, so reading never stalls.
+	class PVGpuTimer
+	{
+	public:
+		PVGpuTimer(const PVDeviceContext* deviceContext, uint32_t frameCount);
+		~PVGpuTimer();
+
+		void Cleanup();
+
+		// both outside a render pass
+		void Begin(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+		void End(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+		// GPU milliseconds of the last span recorded in this slot, false if there is none yet or
+		// the device cannot time graphics work
+		bool GetResult(uint32_t frameIndex, double& milliseconds);
+
+		//Getters
+		bool IsSupported() const { return supported; }
+
+	private:
+		const VkDevice* device;
+
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+
+		bool supported;
+
+		// nanoseconds per timestamp tick
+		double timestampPeriod;
+
+		std::vector<bool> recorded;
+	};
+}
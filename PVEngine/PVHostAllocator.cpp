@@ -0,0 +1,298 @@
+#include "PVHostAllocator.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+
+namespace PVEngine
+{
+	static const char* const scopeNames[] = { "command", "object", "cache", "device", "instance" };
+
+	static const char* const typeNames[] =
+	{
+		"instance", "device", "surface", "swapchain", "buffer", "memory", "image", "image view", "render pass",
+		"framebuffer", "pipeline", "pipeline layout", "shader module", "descriptor", "command pool", "sync",
+		"query pool", "other",
+	};
+
+	// heapAllocations split by thread, so a thread can count the mallocs its own calls caused
+	static thread_local uint64_t threadHeapAllocations = 0;
+
+	// payload sizes 16, 32, ... 4096 bytes
+	static size_t classSize(uint16_t sizeClass)
+	{
+		return size_t(16) << sizeClass;
+	}
+
+	PVHostAllocator& PVHostAllocator::Get()
+	{
+		static PVHostAllocator allocator;
+		return allocator;
+	}
+
+	PVHostAllocator::PVHostAllocator()
+	{
+		for (size_t i = 0; i < static_cast<size_t>(PVAllocationType::Count); i++)
+		{
+			// the type rides along in the user data, the allocator itself is the singleton
+			callbacks[i].pUserData = reinterpret_cast<void*>(i);
+			callbacks[i].pfnAllocation = &PVHostAllocator::allocation;
+			callbacks[i].pfnReallocation = &PVHostAllocator::reallocation;
+			callbacks[i].pfnFree = &PVHostAllocator::free;
+			callbacks[i].pfnInternalAllocation = &PVHostAllocator::internalAllocation;
+			callbacks[i].pfnInternalFree = &PVHostAllocator::internalFree;
+		}
+	}
+
+
+	PVHostAllocator::~PVHostAllocator()
+	{
+		for (void* chunk : chunks)
+		{
+			std::free(chunk);
+		}
+	}
+
+	VKAPI_ATTR void* VKAPI_CALL PVHostAllocator::allocation(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope)
+	{
+		PVAllocationType type = static_cast<PVAllocationType>(reinterpret_cast<uintptr_t>(userData));
+		return Get().allocate(size, alignment, scope, type);
+	}
+
+	VKAPI_ATTR void* VKAPI_CALL PVHostAllocator::reallocation(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+	{
+		if (original == nullptr)
+		{
+			return allocation(userData, size, alignment, scope);
+		}
+		if (size == 0)
+		{
+			Get().release(original);
+			return nullptr;
+		}
+
+		void* memory = allocation(userData, size, alignment, scope);
+		if (memory != nullptr)
+		{
+			const BlockHeader* header = static_cast<const BlockHeader*>(original) - 1;
+			memcpy(memory, original, static_cast<size_t>(header->size < size ? header->size : size));
+			Get().release(original);
+		}
+		return memory;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL PVHostAllocator::free(void* userData, void* memory)
+	{
+		if (memory != nullptr)
+		{
+			Get().release(memory);
+		}
+	}
+
+	VKAPI_ATTR void VKAPI_CALL PVHostAllocator::internalAllocation(void* userData, size_t size, VkInternalAllocationType allocationType, VkSystemAllocationScope scope)
+	{
+		PVHostAllocator& allocator = Get();
+		std::lock_guard<std::mutex> lock(allocator.poolMutex);
+		track(allocator.internalStats, static_cast<int64_t>(size));
+	}
+
+	VKAPI_ATTR void VKAPI_CALL PVHostAllocator::internalFree(void* userData, size_t size, VkInternalAllocationType allocationType, VkSystemAllocationScope scope)
+	{
+		PVHostAllocator& allocator = Get();
+		std::lock_guard<std::mutex> lock(allocator.poolMutex);
+		track(allocator.internalStats, -static_cast<int64_t>(size));
+	}
+
+	void* PVHostAllocator::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope, PVAllocationType type)
+	{
+		if (size == 0)
+		{
+			return nullptr;
+		}
+
+		uint16_t sizeClass = 0;
+		while (sizeClass < SizeClassCount && classSize(sizeClass) < size)
+		{
+			sizeClass++;
+		}
+
+		std::lock_guard<std::mutex> lock(poolMutex);
+
+		BlockHeader* header;
+		if (sizeClass < SizeClassCount && alignment <= alignof(BlockHeader))
+		{
+			if (freeLists[sizeClass] == nullptr)
+			{
+				refill(sizeClass);
+				if (freeLists[sizeClass] == nullptr)
+				{
+					return nullptr;
+				}
+			}
+			header = static_cast<BlockHeader*>(freeLists[sizeClass]);
+			freeLists[sizeClass] = *reinterpret_cast<void**>(header + 1);
+			header->heapBase = nullptr;
+			header->sizeClass = sizeClass;
+			pooledAllocations++;
+		}
+		else
+		{
+			if (alignment < alignof(BlockHeader))
+			{
+				alignment = alignof(BlockHeader);
+			}
+			void* base = std::malloc(size + alignment + sizeof(BlockHeader));
+			if (base == nullptr)
+			{
+				return nullptr;
+			}
+			uintptr_t payload = (reinterpret_cast<uintptr_t>(base) + sizeof(BlockHeader) + alignment - 1) & ~(uintptr_t(alignment) - 1);
+			header = reinterpret_cast<BlockHeader*>(payload) - 1;
+			header->heapBase = base;
+			header->sizeClass = HeapSizeClass;
+			heapAllocations++;
+			threadHeapAllocations++;
+		}
+
+		header->size = size;
+		header->scope = static_cast<uint8_t>(scope);
+		header->type = static_cast<uint8_t>(type);
+
+		track(scopeStats[scope], static_cast<int64_t>(size));
+		track(typeStats[static_cast<size_t>(type)], static_cast<int64_t>(size));
+		return header + 1;
+	}
+
+	void PVHostAllocator::release(void* memory)
+	{
+		BlockHeader* header = static_cast<BlockHeader*>(memory) - 1;
+
+		std::lock_guard<std::mutex> lock(poolMutex);
+		track(scopeStats[header->scope], -static_cast<int64_t>(header->size));
+		track(typeStats[header->type], -static_cast<int64_t>(header->size));
+
+		if (header->sizeClass == HeapSizeClass)
+		{
+			std::free(header->heapBase);
+			return;
+		}
+
+		*reinterpret_cast<void**>(header + 1) = freeLists[header->sizeClass];
+		freeLists[header->sizeClass] = header;
+	}
+
+	void PVHostAllocator::refill(uint16_t sizeClass)
+	{
+		uint8_t* chunk = static_cast<uint8_t*>(std::malloc(ChunkSize));
+		if (chunk == nullptr)
+		{
+			return;
+		}
+		chunks.push_back(chunk);
+		heapAllocations++;
+		threadHeapAllocations++;
+
+		// malloc alignment covers the header's 16 bytes, and every block keeps it
+		size_t blockSize = sizeof(BlockHeader) + classSize(sizeClass);
+		for (size_t offset = 0; offset + blockSize <= ChunkSize; offset += blockSize)
+		{
+			void* block = chunk + offset;
+			*reinterpret_cast<void**>(static_cast<BlockHeader*>(block) + 1) = freeLists[sizeClass];
+			freeLists[sizeClass] = block;
+		}
+	}
+
+	void PVHostAllocator::track(PVAllocationStats& stats, int64_t bytes)
+	{
+		stats.currentBytes += bytes;
+		if (bytes > 0)
+		{
+			stats.allocationCount++;
+			stats.liveCount++;
+			if (stats.currentBytes > stats.peakBytes)
+			{
+				stats.peakBytes = stats.currentBytes;
+			}
+		}
+		else
+		{
+			stats.liveCount--;
+		}
+	}
+
+	PVAllocationStats PVHostAllocator::GetScopeStats(VkSystemAllocationScope scope)
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		return scopeStats[scope];
+	}
+
+	PVAllocationStats PVHostAllocator::GetTypeStats(PVAllocationType type)
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		return typeStats[static_cast<size_t>(type)];
+	}
+
+	uint64_t PVHostAllocator::GetHeapAllocationCount()
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		return heapAllocations;
+	}
+
+	uint64_t PVHostAllocator::GetThreadHeapAllocationCount()
+	{
+		return threadHeapAllocations;
+	}
+
+	uint64_t PVHostAllocator::GetPooledAllocationCount()
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		return pooledAllocations;
+	}
+
+	void PVHostAllocator::PrintReport(std::ostream& stream)
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+
+		auto printLine = [&stream](const char* name, const PVAllocationStats& stats)
+		{
+			if (stats.allocationCount == 0)
+			{
+				return;
+			}
+			stream << "  " << std::left << std::setw(16) << name << std::right << std::setw(10) << stats.currentBytes << " bytes now, "
+				<< std::setw(10) << stats.peakBytes << " peak, " << std::setw(8) << stats.allocationCount << " allocations, "
+				<< stats.liveCount << " live" << std::endl;
+		};
+
+		stream << "Driver host memory by scope:" << std::endl;
+		for (uint32_t i = 0; i < ScopeCount; i++)
+		{
+			printLine(scopeNames[i], scopeStats[i]);
+		}
+		stream << "Driver host memory by object type:" << std::endl;
+		for (size_t i = 0; i < static_cast<size_t>(PVAllocationType::Count); i++)
+		{
+			printLine(typeNames[i], typeStats[i]);
+		}
+		printLine("internal", internalStats);
+		stream << "  " << pooledAllocations << " allocations served from the pool, " << heapAllocations << " from the heap ("
+			<< chunks.size() << " chunks)" << std::endl;
+	}
+
+	bool PVHostAllocator::CheckForLeaks(std::ostream& stream)
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+
+		bool clean = true;
+		for (size_t i = 0; i < static_cast<size_t>(PVAllocationType::Count); i++)
+		{
+			if (typeStats[i].liveCount > 0)
+			{
+				stream << "Driver host memory leak: " << typeStats[i].liveCount << " " << typeNames[i] << " allocation(s), "
+					<< typeStats[i].currentBytes << " bytes" << std::endl;
+				clean = false;
+			}
+		}
+		return clean;
+	}
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+namespace PVEngine
+{
+	// what a driver host allocation was made for, every create call passes the callbacks of its type
+	enum class PVAllocationType : uint8_t
+	{
+		Instance,
+		Device,
+		Surface,
+		Swapchain,
+		Buffer,
+		Memory,
+		Image,
+		ImageView,
+		RenderPass,
+		Framebuffer,
+		Pipeline,
+		PipelineLayout,
+		ShaderModule,
+		Descriptor,
+		CommandPool,
+		Sync,
+		QueryPool,
+		Other,
+		Count
+	};
+
+	struct PVAllocationStats
+	{
+		uint64_t currentBytes = 0;
+		uint64_t peakBytes = 0;
+		// allocations made so far, and how many of them are still alive
+		uint64_t allocationCount = 0;
+		uint64_t liveCount = 0;
+	};
+
+	// VkAllocationCallbacks routing the driver's host allocations through a size class pool.
+	// Small blocks come from 64 KB chunks and go back on a free list when the driver frees them,
+	// so objects that are created and destroyed over and over, like everything rebuilt on
+	// swapchain recreation, stop hitting malloc once the pool is warm. Large or over-aligned
+	// blocks go to the heap directly. Every block carries a header with its size, scope and
+	// object type, which feeds the counters and high water marks.
+	//
+	// There is one allocator for the process, the callbacks may be called from any thread.
+	class PVHostAllocator
+	{
+	public:
+		static PVHostAllocator& Get();
+
+		// pass as pAllocator to vkCreate*/vkAllocate* and the matching vkDestroy*/vkFree*
+		static const VkAllocationCallbacks* Callbacks(PVAllocationType type) { return &Get().callbacks[static_cast<size_t>(type)]; }
+
+		PVAllocationStats GetScopeStats(VkSystemAllocationScope scope);
+		PVAllocationStats GetTypeStats(PVAllocationType type);
+
+		// number of mallocs made on behalf of the driver, chunks included
+		uint64_t GetHeapAllocationCount();
+
+		// the same, only the mallocs made on the calling thread
+		static uint64_t GetThreadHeapAllocationCount();
+
+		// allocations served from the pool without touching the heap
+		uint64_t GetPooledAllocationCount();
+
+		void PrintReport(std::ostream& stream);
+
+		// reports every object type that still has live allocations, returns false if any do
+		bool CheckForLeaks(std::ostream& stream);
+
+	private:
+		PVHostAllocator();
+		~PVHostAllocator();
+
+		PVHostAllocator(const PVHostAllocator&) = delete;
+		PVHostAllocator& operator=(const PVHostAllocator&) = delete;
+
+		struct alignas(16) BlockHeader
+		{
+			// start of the heap block, null for pooled blocks
+			void* heapBase;
+			uint64_t size;
+			uint16_t sizeClass;
+			uint8_t scope;
+			uint8_t type;
+		};
+
+		static VKAPI_ATTR void* VKAPI_CALL allocation(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope);
+		static VKAPI_ATTR void* VKAPI_CALL reallocation(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+		static VKAPI_ATTR void VKAPI_CALL free(void* userData, void* memory);
+		static VKAPI_ATTR void VKAPI_CALL internalAllocation(void* userData, size_t size, VkInternalAllocationType allocationType, VkSystemAllocationScope scope);
+		static VKAPI_ATTR void VKAPI_CALL internalFree(void* userData, size_t size, VkInternalAllocationType allocationType, VkSystemAllocationScope scope);
+
+		void* allocate(size_t size, size_t alignment, VkSystemAllocationScope scope, PVAllocationType type);
+		void release(void* memory);
+
+		// carves a fresh chunk into blocks of the size class, called with poolMutex held
+		void refill(uint16_t sizeClass);
+
+		static void track(PVAllocationStats& stats, int64_t bytes);
+
+		static const uint32_t ScopeCount = 5;
+		static const uint16_t SizeClassCount = 9;
+		static const uint16_t HeapSizeClass = 0xFFFF;
+		static const size_t ChunkSize = 64 * 1024;
+
+		VkAllocationCallbacks callbacks[static_cast<size_t>(PVAllocationType::Count)];
+
+		std::mutex poolMutex;
+
+		// singly linked free lists, the link lives in the block's payload
+		void* freeLists[SizeClassCount] = {};
+
+		std::vector<void*> chunks;
+
+		PVAllocationStats scopeStats[ScopeCount];
+		PVAllocationStats typeStats[static_cast<size_t>(PVAllocationType::Count)];
+		PVAllocationStats internalStats;
+
+		uint64_t heapAllocations = 0;
+		uint64_t pooledAllocations = 0;
+	};
+}
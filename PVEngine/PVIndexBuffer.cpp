@@ -3,10 +3,9 @@
 
 namespace PVEngine
 {
-	PVIndexBuffer::PVIndexBuffer(const VkDevice* logicalDevice, const VkPhysicalDevice* physicalDevice, const VkSurfaceKHR* surface,
-		const VkCommandPool* transferCommandPool, const VkQueue* transferQueue)
+	PVIndexBuffer::PVIndexBuffer(const PVDeviceContext* deviceContext, const PVUploadContext* uploadContext, const uint32_t* indices, uint32_t indexCount)
 	{
-		CreateIndexBuffer(logicalDevice, physicalDevice, surface, transferCommandPool, transferQueue);
+		CreateIndexBuffer(deviceContext, uploadContext, indices, indexCount);
 	}
 
 
@@ -15,29 +14,31 @@ namespace PVEngine
 	}
 
 
-	void PVIndexBuffer::CreateIndexBuffer(const VkDevice* logicalDevice, const VkPhysicalDevice* physicalDevice, const VkSurfaceKHR* surface,
-		const VkCommandPool* transferCommandPool, const VkQueue* transferQueue)
+	void PVIndexBuffer::CreateIndexBuffer(const PVDeviceContext* deviceContext, const PVUploadContext* uploadContext, const uint32_t* indices, uint32_t indexCount)
 	{
-		VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+		const VkDevice* logicalDevice = deviceContext->GetLogicalDevice();
+		this->indexCount = indexCount;
+		VkDeviceSize bufferSize = sizeof(uint32_t) * indexCount;
 
 		VkBuffer stagingBuffer;
 		VkDeviceMemory stagingBufferMemory;
 
-		createBuffer(logicalDevice, physicalDevice, surface, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		createBuffer(deviceContext, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
 
 		void* data;
 		vkMapMemory(*logicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, indices.data(), (size_t)bufferSize);
+		memcpy(data, indices, (size_t)bufferSize);
 		vkUnmapMemory(*logicalDevice, stagingBufferMemory);
 
-		createBuffer(logicalDevice, physicalDevice, surface, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		createBuffer(deviceContext, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory);
 
-		copyBuffer(logicalDevice, transferCommandPool, stagingBuffer, buffer, bufferSize, transferQueue);
+		uploadValue = copyBuffer(deviceContext, uploadContext, stagingBuffer, buffer, bufferSize,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
 
-		vkDestroyBuffer(*logicalDevice, stagingBuffer, nullptr);
-		vkFreeMemory(*logicalDevice, stagingBufferMemory, nullptr);
+		uploadContext->deletionQueue->RetireBuffer(stagingBuffer, uploadValue);
+		uploadContext->deletionQueue->RetireMemory(stagingBufferMemory, uploadValue);
 	}
 	void PVIndexBuffer::CleanupIndexBuffer(const VkDevice* logicalDevice)
 	{
@@ -7,23 +7,19 @@ namespace PVEngine
 	class PVIndexBuffer : public PVBuffer
 	{
 	public:
-		PVIndexBuffer(const VkDevice* logicalDevice, const VkPhysicalDevice* physicalDevice, const VkSurfaceKHR* surface,
-			const VkCommandPool* transferCommandPool, const VkQueue* transferQueue);
+		// 32 bit indices, e.g. straight out of a mapped asset pack
+		PVIndexBuffer(const PVDeviceContext* deviceContext, const PVUploadContext* uploadContext, const uint32_t* indices, uint32_t indexCount);
 		~PVIndexBuffer();
 
-		void CreateIndexBuffer(const VkDevice* logicalDevice, const VkPhysicalDevice* physicalDevice, const VkSurfaceKHR* surface,
-			const VkCommandPool* transferCommandPool, const VkQueue* transferQueue);
+		void CreateIndexBuffer(const PVDeviceContext* deviceContext, const PVUploadContext* uploadContext, const uint32_t* indices, uint32_t indexCount);
 		void CleanupIndexBuffer(const VkDevice* logicalDevice);
 
 		//Getters
-		uint32_t GetIndicesSize() { return indices.size(); }
+		uint32_t GetIndicesSize() { return indexCount; }
 
 	private:
 
-		const std::vector<uint32_t> indices =
-		{
-			0,1,2,2,3,0
-		};
+		uint32_t indexCount = 0;
 	};
 }
 
@@ -0,0 +1,51 @@
+#include "PVInstanceBuffer.h"
+
+#include <cstring>
+
+namespace PVEngine
+{
+	PVInstanceBuffer::PVInstanceBuffer(const PVDeviceContext* deviceContext, uint32_t initialCapacity /* = 1024 */)
+		: deviceContext(deviceContext)
+	{
+		create(initialCapacity);
+	}
+
+
+	PVInstanceBuffer::~PVInstanceBuffer()
+	{
+	}
+
+	void PVInstanceBuffer::Cleanup(const VkDevice* logicalDevice)
+	{
+		vkUnmapMemory(*logicalDevice, bufferMemory);
+		cleanupBuffer(logicalDevice, buffer, bufferMemory);
+	}
+
+	void PVInstanceBuffer::Upload(const InstanceData* instances, uint32_t count, PVDeletionQueue* deletionQueue, uint64_t retireValue)
+	{
+		if (count > capacity)
+		{
+			// the memory is retired still mapped, freeing it unmaps it implicitly
+			Retire(deletionQueue, retireValue);
+
+			uint32_t newCapacity = capacity * 2;
+			while (newCapacity < count)
+			{
+				newCapacity *= 2;
+			}
+			create(newCapacity);
+		}
+
+		memcpy(mappedData, instances, count * sizeof(InstanceData));
+		instanceCount = count;
+	}
+
+	void PVInstanceBuffer::create(uint32_t newCapacity)
+	{
+		capacity = newCapacity > 0 ? newCapacity : 1;
+		createBuffer(deviceContext, capacity * sizeof(InstanceData), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, bufferMemory);
+
+		vkMapMemory(*deviceContext->GetLogicalDevice(), bufferMemory, 0, capacity * sizeof(InstanceData), 0, &mappedData);
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "PVBuffer.h"
+
+namespace PVEngine
+{
+	// Host visible, persistently mapped vertex buffer of InstanceData bound at binding 1. One
+	// exists per frame in flight and is refilled every frame from the culling results. When a
+	// frame needs more room the buffer is retired and replaced by one twice the size.
+	class PVInstanceBuffer : public PVBuffer
+	{
+	public:
+		PVInstanceBuffer(const PVDeviceContext* deviceContext, uint32_t initialCapacity = 1024);
+		~PVInstanceBuffer();
+
+		void Cleanup(const VkDevice* logicalDevice);
+
+		// copies the instances in, growing the buffer first if needed; the old buffer is retired
+		// against retireValue
+		void Upload(const InstanceData* instances, uint32_t count, PVDeletionQueue* deletionQueue, uint64_t retireValue);
+
+		//Getters
+		uint32_t GetInstanceCount() const { return instanceCount; }
+		uint32_t GetCapacity() const { return capacity; }
+
+	private:
+		void create(uint32_t newCapacity);
+
+		const PVDeviceContext* deviceContext;
+
+		uint32_t capacity = 0;
+
+		uint32_t instanceCount = 0;
+
+		void* mappedData = nullptr;
+	};
+}
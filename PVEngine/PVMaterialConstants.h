@@ -0,0 +1,30 @@
+#pragma once
+#include "PVDrawConstants.h"
+
+#include <cstdint>
+
+namespace PVEngine
+{
+	// Bindless handles for the fragment stage, mirroring MaterialConstants in material.frag. Only
+	// in the pipeline layout when there is a bindless table, right after the vertex stage's
+	// PVDrawConstants.
+	struct PVMaterialConstants
+	{
+		// storage buffer with a vec4 tint per material
+		uint32_t materialBuffer;
+		uint32_t materialCount;
+		// PVBindlessTable::InvalidHandle until the texture's coarsest level has streamed in
+		uint32_t albedoTexture;
+		uint32_t albedoSampler;
+
+		static VkPushConstantRange getPushConstantRange()
+		{
+			VkPushConstantRange range = {};
+			range.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+			range.offset = sizeof(PVDrawConstants);
+			range.size = sizeof(PVMaterialConstants);
+
+			return range;
+		}
+	};
+}
@@ -0,0 +1,533 @@
+#include "PVOcclusionCuller.h"
+#include "PVHostAllocator.h"
+#include "PVFrustum.h"
+
+#include <algorithm>
+
+namespace PVEngine
+{
+	PVOcclusionCuller::PVOcclusionCuller(const PVDeviceContext* deviceContext, PVDeletionQueue* deletionQueue, PVShaderCache* shaderCache,
+		PVDescriptorLayoutCache* layoutCache, uint32_t frameCount)
+		: deviceContext(deviceContext), device(deviceContext->GetLogicalDevice()), deletionQueue(deletionQueue),
+		frameRenderAreas(frameCount), recorded(frameCount, false), frameSets(frameCount)
+	{
+		auto binding = [](uint32_t index, VkDescriptorType type)
+		{
+			VkDescriptorSetLayoutBinding layoutBinding = {};
+			layoutBinding.binding = index;
+			layoutBinding.descriptorType = type;
+			layoutBinding.descriptorCount = 1;
+			layoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			return layoutBinding;
+		};
+
+		cullSetLayout = layoutCache->GetLayout({
+			binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER),
+			binding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER),
+			binding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER),
+			binding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER),
+			binding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER),
+			binding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER),
+			binding(6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER) });
+		pyramidSetLayout = layoutCache->GetLayout({
+			binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER),
+			binding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE) });
+
+		VkPushConstantRange cullConstants = { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t) };
+		VkPipelineLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layoutInfo.setLayoutCount = 1;
+		layoutInfo.pSetLayouts = &cullSetLayout;
+		layoutInfo.pushConstantRangeCount = 1;
+		layoutInfo.pPushConstantRanges = &cullConstants;
+		if (vkCreatePipelineLayout(*device, &layoutInfo, PVHostAllocator::Callbacks(PVAllocationType::PipelineLayout), &cullPipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create occlusion culling pipeline layout");
+		}
+
+		VkPushConstantRange pyramidConstants = { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PyramidConstants) };
+		layoutInfo.pSetLayouts = &pyramidSetLayout;
+		layoutInfo.pPushConstantRanges = &pyramidConstants;
+		if (vkCreatePipelineLayout(*device, &layoutInfo, PVHostAllocator::Callbacks(PVAllocationType::PipelineLayout), &pyramidPipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create Hi-Z pyramid pipeline layout");
+		}
+
+		cullPipeline = createPipeline(shaderCache->GetModule(PVShaders::HiZCull), cullPipelineLayout);
+		pyramidPipeline = createPipeline(shaderCache->GetModule(PVShaders::HiZPyramid), pyramidPipelineLayout);
+
+		// exact texel values, the shaders pick the level themselves
+		VkSamplerCreateInfo samplerInfo = {};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.minLod = 0.0f;
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+		if (vkCreateSampler(*device, &samplerInfo, PVHostAllocator::Callbacks(PVAllocationType::Other), &pyramidSampler) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create Hi-Z sampler");
+		}
+
+		for (uint32_t i = 0; i < frameCount; i++)
+		{
+			uniformBuffers.push_back(new PVStorageBuffer(deviceContext, sizeof(CullUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, true));
+			readbackBuffers.push_back(new PVStorageBuffer(deviceContext, sizeof(DrawArguments), VK_BUFFER_USAGE_TRANSFER_DST_BIT, true));
+		}
+
+		// the overdraw report needs fragment shader invocation counts
+		if (deviceContext->GetFeatures().pipelineStatisticsQuery)
+		{
+			VkQueryPoolCreateInfo queryPoolInfo = {};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+			queryPoolInfo.queryCount = frameCount;
+			queryPoolInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+			if (vkCreateQueryPool(*device, &queryPoolInfo, PVHostAllocator::Callbacks(PVAllocationType::QueryPool), &statisticsPool) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create pipeline statistics query pool");
+			}
+		}
+		else
+		{
+			std::cout << "Pipeline statistics are not supported, overdraw will not be reported" << std::endl;
+		}
+	}
+
+
+	PVOcclusionCuller::~PVOcclusionCuller()
+	{
+		for (auto buffer : uniformBuffers)
+		{
+			delete buffer;
+		}
+		for (auto buffer : readbackBuffers)
+		{
+			delete buffer;
+		}
+		delete instanceBuffer;
+		delete boundsBuffer;
+		delete drawInstanceBuffer;
+		delete drawArgumentBuffer;
+		delete candidateBuffer;
+	}
+
+	void PVOcclusionCuller::Cleanup()
+	{
+		// the caller flushes the deletion queue once the device is idle
+		retirePyramid(0);
+
+		for (auto buffer : uniformBuffers)
+		{
+			buffer->Cleanup(device);
+		}
+		for (auto buffer : readbackBuffers)
+		{
+			buffer->Cleanup(device);
+		}
+		for (auto buffer : { instanceBuffer, boundsBuffer, drawInstanceBuffer, drawArgumentBuffer, candidateBuffer })
+		{
+			if (buffer != nullptr)
+			{
+				buffer->Cleanup(device);
+			}
+		}
+
+		if (statisticsPool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(*device, statisticsPool, PVHostAllocator::Callbacks(PVAllocationType::QueryPool));
+		}
+		vkDestroySampler(*device, pyramidSampler, PVHostAllocator::Callbacks(PVAllocationType::Other));
+		vkDestroyPipeline(*device, cullPipeline, PVHostAllocator::Callbacks(PVAllocationType::Pipeline));
+		vkDestroyPipeline(*device, pyramidPipeline, PVHostAllocator::Callbacks(PVAllocationType::Pipeline));
+		vkDestroyPipelineLayout(*device, cullPipelineLayout, PVHostAllocator::Callbacks(PVAllocationType::PipelineLayout));
+		vkDestroyPipelineLayout(*device, pyramidPipelineLayout, PVHostAllocator::Callbacks(PVAllocationType::PipelineLayout));
+	}
+
+	void PVOcclusionCuller::SetInstances(const std::vector<InstanceData>& instances, const std::vector<glm::vec4>& bounds, uint32_t indexCount)
+	{
+		this->indexCount = indexCount;
+		instanceCount = static_cast<uint32_t>(instances.size());
+		VkDeviceSize instanceBytes = std::max<VkDeviceSize>(instanceCount, 1) * sizeof(InstanceData);
+
+		// written once, small enough that reading it over the bus every frame doesn't matter
+		instanceBuffer = new PVStorageBuffer(deviceContext, instanceBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true);
+		instanceBuffer->Write(instances.data(), 0, instanceCount * sizeof(InstanceData));
+		boundsBuffer = new PVStorageBuffer(deviceContext, std::max<VkDeviceSize>(instanceCount, 1) * sizeof(glm::vec4), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true);
+		boundsBuffer->Write(bounds.data(), 0, instanceCount * sizeof(glm::vec4));
+
+		// room for every instance in both phases
+		drawInstanceBuffer = new PVStorageBuffer(deviceContext, instanceBytes * 2,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, false);
+		drawArgumentBuffer = new PVStorageBuffer(deviceContext, sizeof(DrawArguments),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, false);
+		candidateBuffer = new PVStorageBuffer(deviceContext, std::max<VkDeviceSize>(instanceCount, 1) * sizeof(uint32_t),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false);
+	}
+
+	void PVOcclusionCuller::Resize(VkExtent2D extent, uint64_t retireValue)
+	{
+		retirePyramid(retireValue);
+		createPyramid(extent);
+	}
+
+	void PVOcclusionCuller::Update(uint32_t frameIndex, const glm::mat4& viewProjection)
+	{
+		CullUniforms uniforms = {};
+		uniforms.viewProjection = viewProjection;
+		uniforms.pyramidViewProjection = pyramidViewProjection;
+		PVFrustum frustum = PVFrustum::fromViewProjection(viewProjection);
+		for (int i = 0; i < 6; i++)
+		{
+			uniforms.frustumPlanes[i] = frustum.planes[i];
+		}
+		uniforms.pyramidSize = glm::vec2(static_cast<float>(pyramidExtent.width), static_cast<float>(pyramidExtent.height));
+		uniforms.instanceCount = instanceCount;
+		uniforms.pyramidValid = pyramidValid ? 1 : 0;
+		uniformBuffers[frameIndex]->Write(&uniforms, 0, sizeof(uniforms));
+
+		// this frame builds the pyramid the next one tests against
+		pyramidViewProjection = viewProjection;
+		pyramidValid = true;
+	}
+
+	void PVOcclusionCuller::BeginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkExtent2D renderArea)
+	{
+		frameRenderAreas[frameIndex] = renderArea;
+
+		if (!pyramidInitialized)
+		{
+			VkImageMemoryBarrier pyramidBarrier = {};
+			pyramidBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			pyramidBarrier.srcAccessMask = 0;
+			pyramidBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			pyramidBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			pyramidBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+			pyramidBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			pyramidBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			pyramidBarrier.image = pyramid;
+			pyramidBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1 };
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+				0, nullptr, 0, nullptr, 1, &pyramidBarrier);
+			pyramidInitialized = true;
+		}
+
+		// last frame's draws and readback are done with the arguments, and its pyramid is visible
+		// to this frame's early phase
+		VkMemoryBarrier previousFrame = {};
+		previousFrame.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		previousFrame.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		previousFrame.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+			| VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &previousFrame, 0, nullptr, 0, nullptr);
+
+		DrawArguments arguments = {};
+		arguments.draws[0] = { indexCount, 0, 0, 0, 0 };
+		arguments.draws[1] = { indexCount, 0, 0, 0, 0 };
+		vkCmdUpdateBuffer(commandBuffer, *drawArgumentBuffer->GetBuffer(), 0, sizeof(arguments), &arguments);
+
+		VkMemoryBarrier argumentsReset = {};
+		argumentsReset.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		argumentsReset.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		argumentsReset.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			1, &argumentsReset, 0, nullptr, 0, nullptr);
+
+		if (statisticsPool != VK_NULL_HANDLE)
+		{
+			vkCmdResetQueryPool(commandBuffer, statisticsPool, frameIndex, 1);
+			vkCmdBeginQuery(commandBuffer, statisticsPool, frameIndex, 0);
+		}
+	}
+
+	void PVOcclusionCuller::EndFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+	{
+		if (statisticsPool != VK_NULL_HANDLE)
+		{
+			vkCmdEndQuery(commandBuffer, statisticsPool, frameIndex);
+		}
+
+		VkMemoryBarrier countersWritten = {};
+		countersWritten.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		countersWritten.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		countersWritten.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			1, &countersWritten, 0, nullptr, 0, nullptr);
+
+		VkBufferCopy copyRegion = { 0, 0, sizeof(DrawArguments) };
+		vkCmdCopyBuffer(commandBuffer, *drawArgumentBuffer->GetBuffer(), *readbackBuffers[frameIndex]->GetBuffer(), 1, &copyRegion);
+
+		VkMemoryBarrier readback = {};
+		readback.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		readback.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		readback.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+			1, &readback, 0, nullptr, 0, nullptr);
+
+		recorded[frameIndex] = true;
+	}
+
+	void PVOcclusionCuller::RecordCull(VkCommandBuffer commandBuffer, Phase phase, uint32_t frameIndex, PVDescriptorAllocator* descriptorAllocator)
+	{
+		FrameSets& sets = frameSets[frameIndex];
+		if (sets.cullSet == VK_NULL_HANDLE)
+		{
+			sets.cullSet = descriptorAllocator->Allocate(cullSetLayout);
+		}
+		if (sets.cullVersion != pyramidVersion)
+		{
+			PVDescriptorAllocator::WriteSet(device, sets.cullSet, {
+				PVDescriptorWrite::Buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, *uniformBuffers[frameIndex]->GetBuffer(), 0, sizeof(CullUniforms)),
+				PVDescriptorWrite::Buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, *instanceBuffer->GetBuffer(), 0, VK_WHOLE_SIZE),
+				PVDescriptorWrite::Buffer(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, *boundsBuffer->GetBuffer(), 0, VK_WHOLE_SIZE),
+				PVDescriptorWrite::Buffer(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, *drawInstanceBuffer->GetBuffer(), 0, VK_WHOLE_SIZE),
+				PVDescriptorWrite::Buffer(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, *drawArgumentBuffer->GetBuffer(), 0, VK_WHOLE_SIZE),
+				PVDescriptorWrite::Buffer(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, *candidateBuffer->GetBuffer(), 0, VK_WHOLE_SIZE),
+				PVDescriptorWrite::Image(6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, pyramidView, pyramidSampler, VK_IMAGE_LAYOUT_GENERAL) });
+			sets.cullVersion = pyramidVersion;
+		}
+		VkDescriptorSet set = sets.cullSet;
+
+		uint32_t phaseIndex = (phase == Phase::Early) ? 0 : 1;
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &set, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(phaseIndex), &phaseIndex);
+		vkCmdDispatch(commandBuffer, (instanceCount + 63) / 64, 1, 1);
+
+		// the draws read the results, the late phase and the pyramid build come after the early phase
+		VkMemoryBarrier culled = {};
+		culled.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		culled.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		culled.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT
+			| VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			1, &culled, 0, nullptr, 0, nullptr);
+	}
+
+	void PVOcclusionCuller::RecordPyramid(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImageView depthView, VkExtent2D renderArea,
+		PVDescriptorAllocator* descriptorAllocator)
+	{
+		FrameSets& sets = frameSets[frameIndex];
+		while (sets.pyramidSets.size() < pyramidLevelViews.size())
+		{
+			sets.pyramidSets.push_back(descriptorAllocator->Allocate(pyramidSetLayout));
+		}
+		if (sets.pyramidVersion != pyramidVersion || sets.depthView != depthView)
+		{
+			for (uint32_t level = 0; level < pyramidLevelViews.size(); level++)
+			{
+				PVDescriptorAllocator::WriteSet(device, sets.pyramidSets[level], {
+					level == 0
+						? PVDescriptorWrite::Image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, depthView, pyramidSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+						: PVDescriptorWrite::Image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, pyramidLevelViews[level - 1], pyramidSampler, VK_IMAGE_LAYOUT_GENERAL),
+					PVDescriptorWrite::Image(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, pyramidLevelViews[level], VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL) });
+			}
+			sets.pyramidVersion = pyramidVersion;
+			sets.depthView = depthView;
+		}
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramidPipeline);
+
+		VkExtent2D sourceSize = renderArea;
+		for (uint32_t level = 0; level < pyramidLevelViews.size(); level++)
+		{
+			VkExtent2D levelSize = { std::max(pyramidExtent.width >> level, 1u), std::max(pyramidExtent.height >> level, 1u) };
+
+			VkDescriptorSet set = sets.pyramidSets[level];
+			PyramidConstants constants = { { static_cast<int32_t>(sourceSize.width), static_cast<int32_t>(sourceSize.height) },
+				{ static_cast<int32_t>(levelSize.width), static_cast<int32_t>(levelSize.height) } };
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramidPipelineLayout, 0, 1, &set, 0, nullptr);
+			vkCmdPushConstants(commandBuffer, pyramidPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+			vkCmdDispatch(commandBuffer, (levelSize.width + 7) / 8, (levelSize.height + 7) / 8, 1);
+
+			// the next level and the late phase read this one
+			VkMemoryBarrier levelWritten = {};
+			levelWritten.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			levelWritten.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			levelWritten.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+				1, &levelWritten, 0, nullptr, 0, nullptr);
+
+			sourceSize = levelSize;
+		}
+	}
+
+	void PVOcclusionCuller::RecordDraw(VkCommandBuffer commandBuffer, Phase phase)
+	{
+		// the late instances start halfway through the buffer, offsetting the binding avoids
+		// needing drawIndirectFirstInstance
+		VkBuffer instances = *drawInstanceBuffer->GetBuffer();
+		VkDeviceSize instanceOffset = (phase == Phase::Early) ? 0 : instanceCount * sizeof(InstanceData);
+		vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instances, &instanceOffset);
+
+		VkDeviceSize argumentOffset = (phase == Phase::Early) ? 0 : sizeof(VkDrawIndexedIndirectCommand);
+		vkCmdDrawIndexedIndirect(commandBuffer, *drawArgumentBuffer->GetBuffer(), argumentOffset, 1, sizeof(VkDrawIndexedIndirectCommand));
+	}
+
+	void PVOcclusionCuller::FrameCompleted(uint32_t frameIndex)
+	{
+		if (!recorded[frameIndex])
+		{
+			return;
+		}
+		recorded[frameIndex] = false;
+
+		DrawArguments arguments;
+		readbackBuffers[frameIndex]->Read(&arguments, 0, sizeof(arguments));
+		frustumVisibleTotal += arguments.frustumVisibleCount;
+		earlyDrawnTotal += arguments.draws[0].instanceCount;
+		lateDrawnTotal += arguments.draws[1].instanceCount;
+		occludedTotal += arguments.candidateCount - arguments.draws[1].instanceCount;
+
+		uint64_t fragmentInvocations;
+		if (statisticsPool != VK_NULL_HANDLE && vkGetQueryPoolResults(*device, statisticsPool, frameIndex, 1, sizeof(fragmentInvocations),
+			&fragmentInvocations, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+		{
+			fragmentTotal += fragmentInvocations;
+			pixelTotal += static_cast<uint64_t>(frameRenderAreas[frameIndex].width) * frameRenderAreas[frameIndex].height;
+		}
+
+		if (++reportFrames < 300)
+		{
+			return;
+		}
+
+		std::cout << "Occlusion culling: " << instanceCount << " instances, " << frustumVisibleTotal / reportFrames << " in the frustum, "
+			<< earlyDrawnTotal / reportFrames << " drawn early, " << lateDrawnTotal / reportFrames << " drawn late, "
+			<< occludedTotal / reportFrames << " occluded saving " << occludedTotal / reportFrames * (indexCount / 3) << " triangles per frame";
+		if (pixelTotal > 0)
+		{
+			std::cout << ", overdraw " << static_cast<double>(fragmentTotal) / pixelTotal;
+		}
+		std::cout << std::endl;
+
+		reportFrames = 0;
+		frustumVisibleTotal = 0;
+		earlyDrawnTotal = 0;
+		lateDrawnTotal = 0;
+		occludedTotal = 0;
+		fragmentTotal = 0;
+		pixelTotal = 0;
+	}
+
+	VkPipeline PVOcclusionCuller::createPipeline(VkShaderModule shaderModule, VkPipelineLayout layout)
+	{
+		VkComputePipelineCreateInfo pipelineInfo = {};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = shaderModule;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.layout = layout;
+
+		VkPipeline pipeline;
+		if (vkCreateComputePipelines(*device, VK_NULL_HANDLE, 1, &pipelineInfo, PVHostAllocator::Callbacks(PVAllocationType::Pipeline), &pipeline) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create occlusion culling compute pipeline");
+		}
+		return pipeline;
+	}
+
+	void PVOcclusionCuller::createPyramid(VkExtent2D extent)
+	{
+		// the power of two below the extent keeps every level an exact half of the one before
+		auto previousPowerOfTwo = [](uint32_t value)
+		{
+			uint32_t result = 1;
+			while (result * 2 <= value)
+			{
+				result *= 2;
+			}
+			return result;
+		};
+		pyramidExtent = { previousPowerOfTwo(std::max(extent.width, 1u)), previousPowerOfTwo(std::max(extent.height, 1u)) };
+
+		uint32_t levelCount = 1;
+		while ((std::max(pyramidExtent.width, pyramidExtent.height) >> levelCount) > 0)
+		{
+			levelCount++;
+		}
+
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = VK_FORMAT_R32_SFLOAT;
+		imageInfo.extent = { pyramidExtent.width, pyramidExtent.height, 1 };
+		imageInfo.mipLevels = levelCount;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		if (vkCreateImage(*device, &imageInfo, PVHostAllocator::Callbacks(PVAllocationType::Image), &pyramid) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create Hi-Z pyramid");
+		}
+
+		VkMemoryRequirements requirements;
+		vkGetImageMemoryRequirements(*device, pyramid, &requirements);
+		VkMemoryAllocateInfo allocateInfo = {};
+		allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocateInfo.allocationSize = requirements.size;
+		allocateInfo.memoryTypeIndex = deviceContext->FindMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		if (vkAllocateMemory(*device, &allocateInfo, PVHostAllocator::Callbacks(PVAllocationType::Memory), &pyramidMemory) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate Hi-Z pyramid memory");
+		}
+		vkBindImageMemory(*device, pyramid, pyramidMemory, 0);
+
+		VkImageViewCreateInfo viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = pyramid;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = VK_FORMAT_R32_SFLOAT;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+		if (vkCreateImageView(*device, &viewInfo, PVHostAllocator::Callbacks(PVAllocationType::ImageView), &pyramidView) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create Hi-Z pyramid view");
+		}
+
+		// one view per level for writing it and reading it while building the next
+		pyramidLevelViews.resize(levelCount);
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+			if (vkCreateImageView(*device, &viewInfo, PVHostAllocator::Callbacks(PVAllocationType::ImageView), &pyramidLevelViews[level]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create Hi-Z pyramid level view");
+			}
+		}
+
+		pyramidInitialized = false;
+		pyramidValid = false;
+		// every frame slot rewrites its sets before using the new pyramid
+		pyramidVersion++;
+		std::cout << "Hi-Z pyramid " << pyramidExtent.width << "x" << pyramidExtent.height << " with " << levelCount << " levels" << std::endl;
+	}
+
+	void PVOcclusionCuller::retirePyramid(uint64_t retireValue)
+	{
+		if (pyramid == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		for (auto levelView : pyramidLevelViews)
+		{
+			deletionQueue->RetireImageView(levelView, retireValue);
+		}
+		pyramidLevelViews.clear();
+		deletionQueue->RetireImageView(pyramidView, retireValue);
+		deletionQueue->RetireImage(pyramid, retireValue);
+		deletionQueue->RetireMemory(pyramidMemory, retireValue);
+		pyramid = VK_NULL_HANDLE;
+		pyramidView = VK_NULL_HANDLE;
+		pyramidMemory = VK_NULL_HANDLE;
+	}
+}
@@ -0,0 +1,167 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "PVDeviceContext.h"
+#include "PVDeletionQueue.h"
+#include "PVShaderCache.h"
+#include "PVDescriptorLayoutCache.h"
+#include "PVDescriptorAllocator.h"
+#include "PVStorageBuffer.h"
+#include "PVVertex.h"
+
+namespace PVEngine
+{
+	// Hi-Z occlusion culling of instances on the GPU. A compute shader reduces the depth buffer
+	// into a pyramid of farthest depths, and every instance's bounds are tested against the level
+	// where they cover about one texel. Culling runs in two phases:
+	//	- early, before the main pass: frustum test, then last frame's pyramid from last frame's
+	//	  camera. Survivors are drawn, the rest become candidates
+	//	- late, after the pyramid is rebuilt from the early depth: candidates that are visible
+	//	  after all are drawn, so objects coming out from behind others never pop in a frame late
+	// Results go straight into an instance buffer and indirect draws, nothing is read back
+	// except the counters for the report.
+	class PVOcclusionCuller
+	{
+	public:
+		enum class Phase
+		{
+			Early,
+			Late
+		};
+
+		PVOcclusionCuller(const PVDeviceContext* deviceContext, PVDeletionQueue* deletionQueue, PVShaderCache* shaderCache,
+			PVDescriptorLayoutCache* layoutCache, uint32_t frameCount);
+		~PVOcclusionCuller();
+
+		void Cleanup();
+
+		// bounds are xyz center and w radius, indexCount is what every instance draws
+		void SetInstances(const std::vector<InstanceData>& instances, const std::vector<glm::vec4>& bounds, uint32_t indexCount);
+
+		// the pyramid follows the depth buffer size, the old one is retired against retireValue
+		void Resize(VkExtent2D extent, uint64_t retireValue);
+
+		// the camera this frame is culled with, the early phase uses the previous one
+		void Update(uint32_t frameIndex, const glm::mat4& viewProjection);
+
+		// both outside a render pass, before and after everything else the culler records
+		void BeginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkExtent2D renderArea);
+		void EndFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+		// Each frame slot keeps its descriptor sets, allocated from descriptorAllocator on first use
+		// and only rewritten after a resize, so the allocator must never be reset
+		void RecordCull(VkCommandBuffer commandBuffer, Phase phase, uint32_t frameIndex, PVDescriptorAllocator* descriptorAllocator);
+
+		// reduces the render area of the depth buffer, which has to be in SHADER_READ_ONLY_OPTIMAL
+		void RecordPyramid(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkImageView depthView, VkExtent2D renderArea,
+			PVDescriptorAllocator* descriptorAllocator);
+
+		// inside the render pass, with an instanced pipeline and the mesh at binding 0 bound
+		void RecordDraw(VkCommandBuffer commandBuffer, Phase phase);
+
+		// reads the counters of the frame that last used this slot, once the CPU has waited for it
+		void FrameCompleted(uint32_t frameIndex);
+
+		//Getters
+		uint32_t GetInstanceCount() const { return instanceCount; }
+
+	private:
+		// std140, matches hiz_cull.comp
+		struct CullUniforms
+		{
+			glm::mat4 viewProjection;
+			glm::mat4 pyramidViewProjection;
+			glm::vec4 frustumPlanes[6];
+			glm::vec2 pyramidSize;
+			uint32_t instanceCount;
+			uint32_t pyramidValid;
+		};
+
+		struct DrawArguments
+		{
+			VkDrawIndexedIndirectCommand draws[2];
+			uint32_t frustumVisibleCount;
+			uint32_t candidateCount;
+		};
+
+		struct PyramidConstants
+		{
+			int32_t sourceSize[2];
+			int32_t destinationSize[2];
+		};
+
+		// written while the slot's previous frame is known to have finished
+		struct FrameSets
+		{
+			VkDescriptorSet cullSet = VK_NULL_HANDLE;
+			// one per pyramid level, reading the level above or the depth buffer
+			std::vector<VkDescriptorSet> pyramidSets;
+			// the pyramid version and depth view the sets were last written with
+			uint32_t cullVersion = 0;
+			uint32_t pyramidVersion = 0;
+			VkImageView depthView = VK_NULL_HANDLE;
+		};
+
+		VkPipeline createPipeline(VkShaderModule shaderModule, VkPipelineLayout layout);
+		void createPyramid(VkExtent2D extent);
+		void retirePyramid(uint64_t retireValue);
+
+		const PVDeviceContext* deviceContext;
+		const VkDevice* device;
+		PVDeletionQueue* deletionQueue;
+
+		VkDescriptorSetLayout cullSetLayout;
+		VkDescriptorSetLayout pyramidSetLayout;
+		VkPipelineLayout cullPipelineLayout;
+		VkPipelineLayout pyramidPipelineLayout;
+		VkPipeline cullPipeline;
+		VkPipeline pyramidPipeline;
+		VkSampler pyramidSampler;
+
+		// farthest depth per texel, kept in GENERAL, the first level is the power of two below the extent
+		VkImage pyramid = VK_NULL_HANDLE;
+		VkDeviceMemory pyramidMemory = VK_NULL_HANDLE;
+		VkImageView pyramidView = VK_NULL_HANDLE;
+		std::vector<VkImageView> pyramidLevelViews;
+		VkExtent2D pyramidExtent = { 0, 0 };
+		bool pyramidInitialized = false;
+		// the camera of the last pyramid recorded, and whether one was recorded at this size
+		glm::mat4 pyramidViewProjection;
+		bool pyramidValid = false;
+
+		uint32_t instanceCount = 0;
+		uint32_t indexCount = 0;
+		PVStorageBuffer* instanceBuffer = nullptr;
+		PVStorageBuffer* boundsBuffer = nullptr;
+		PVStorageBuffer* drawInstanceBuffer = nullptr;
+		PVStorageBuffer* drawArgumentBuffer = nullptr;
+		PVStorageBuffer* candidateBuffer = nullptr;
+
+		// per frame slot
+		std::vector<PVStorageBuffer*> uniformBuffers;
+		std::vector<PVStorageBuffer*> readbackBuffers;
+		std::vector<VkExtent2D> frameRenderAreas;
+		std::vector<bool> recorded;
+		std::vector<FrameSets> frameSets;
+		// counts up every time the pyramid is created
+		uint32_t pyramidVersion = 0;
+
+		// fragment shader invocations, for overdraw
+		VkQueryPool statisticsPool = VK_NULL_HANDLE;
+
+		// report totals
+		uint32_t reportFrames = 0;
+		uint64_t frustumVisibleTotal = 0;
+		uint64_t earlyDrawnTotal = 0;
+		uint64_t lateDrawnTotal = 0;
+		uint64_t occludedTotal = 0;
+		uint64_t fragmentTotal = 0;
+		uint64_t pixelTotal = 0;
+	};
+}
@@ -0,0 +1,1052 @@
+#include "PVRenderGraph.h"
+#include "PVHostAllocator.h"
+
+#include <algorithm>
+
+namespace PVEngine
+{
+	PVRenderGraph::PVRenderGraph(const PVDeviceContext* deviceContext, PVDeletionQueue* deletionQueue)
+		: deviceContext(deviceContext), deletionQueue(deletionQueue)
+	{
+	}
+
+
+	PVRenderGraph::~PVRenderGraph()
+	{
+	}
+
+	PVRenderGraph::ResourceHandle PVRenderGraph::CreateImage(const std::string& name, const ImageDesc& desc)
+	{
+		Resource resource;
+		resource.name = name;
+		resource.desc = desc;
+		resources.push_back(resource);
+		dirty = true;
+		return static_cast<ResourceHandle>(resources.size() - 1);
+	}
+
+	PVRenderGraph::ResourceHandle PVRenderGraph::ImportImage(const std::string& name, const ImageDesc& desc, VkImageLayout initialLayout,
+		VkPipelineStageFlags initialStage, VkImageLayout finalLayout)
+	{
+		Resource resource;
+		resource.name = name;
+		resource.desc = desc;
+		resource.imported = true;
+		resource.initialLayout = initialLayout;
+		resource.initialStage = initialStage;
+		resource.finalLayout = finalLayout;
+		resources.push_back(resource);
+		dirty = true;
+		return static_cast<ResourceHandle>(resources.size() - 1);
+	}
+
+	void PVRenderGraph::SetImportedImage(ResourceHandle resource, VkImage image, VkImageView imageView)
+	{
+		resources[resource].image = image;
+		resources[resource].imageView = imageView;
+	}
+
+	PVRenderGraph::PassHandle PVRenderGraph::AddPass(const std::string& name, PassType type, std::function<void(VkCommandBuffer)> record)
+	{
+		Pass pass;
+		pass.name = name;
+		pass.type = type;
+		pass.record = record;
+		passes.push_back(pass);
+		dirty = true;
+		return static_cast<PassHandle>(passes.size() - 1);
+	}
+
+	void PVRenderGraph::Use(PassHandle pass, ResourceHandle resource, Usage usage)
+	{
+		passes[pass].accesses.push_back({ resource, usage });
+		dirty = true;
+	}
+
+	bool PVRenderGraph::NeedsCompile(VkExtent2D extent) const
+	{
+		return dirty || extent.width != compiledExtent.width || extent.height != compiledExtent.height;
+	}
+
+	void PVRenderGraph::Compile(VkExtent2D extent, uint64_t retireValue)
+	{
+		retireCompiledObjects(retireValue);
+
+		statistics = Statistics();
+		statistics.passCount = static_cast<uint32_t>(passes.size());
+
+		for (auto& resource : resources)
+		{
+			resource.extent = (resource.desc.extent.width != 0) ? resource.desc.extent : extent;
+			resource.usageFlags = 0;
+			resource.firstGroup = UINT32_MAX;
+			resource.lastGroup = 0;
+			resource.lazy = false;
+			resource.aliasPredecessor = UINT32_MAX;
+		}
+
+		buildGroups();
+		computeLifetimes();
+		assignMemory();
+		buildBarriersAndRenderPasses();
+
+		dirty = false;
+		compiledExtent = extent;
+
+		std::cout << "Render graph compiled: " << statistics.passCount << " passes in " << statistics.renderPassCount
+			<< " render passes, " << statistics.barrierCount << " image barriers in " << statistics.pipelineBarrierCalls
+			<< " pipeline barriers, " << statistics.subpassDependencyCount << " subpass dependencies, transient memory "
+			<< statistics.allocatedBytes / 1024 << " KB (" << statistics.transientBytes / 1024 << " KB without aliasing, "
+			<< statistics.lazyImageCount << " lazily allocated images)" << std::endl;
+	}
+
+	void PVRenderGraph::Execute(VkCommandBuffer commandBuffer, std::pmr::memory_resource* scratch)
+	{
+		for (auto& group : groups)
+		{
+			recordBarriers(commandBuffer, group.preBarriers, scratch);
+
+			if (group.type != PassType::Graphics)
+			{
+				passes[group.passes[0]].record(commandBuffer);
+				continue;
+			}
+
+			VkRenderPassBeginInfo renderPassInfo = {};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassInfo.renderPass = group.renderPass;
+			renderPassInfo.framebuffer = getFramebuffer(group);
+			renderPassInfo.renderArea.offset = { 0, 0 };
+			renderPassInfo.renderArea.extent = { std::min(group.renderArea.width, group.extent.width), std::min(group.renderArea.height, group.extent.height) };
+			renderPassInfo.clearValueCount = static_cast<uint32_t>(group.clearValues.size());
+			renderPassInfo.pClearValues = group.clearValues.data();
+
+			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+			for (size_t i = 0; i < group.passes.size(); i++)
+			{
+				if (i > 0)
+				{
+					vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+				}
+				passes[group.passes[i]].record(commandBuffer);
+			}
+			vkCmdEndRenderPass(commandBuffer);
+		}
+
+		recordBarriers(commandBuffer, finalBarriers, scratch);
+	}
+
+	void PVRenderGraph::Cleanup()
+	{
+		// the caller flushes the deletion queue once the device is idle
+		retireCompiledObjects(0);
+	}
+
+	VkRenderPass PVRenderGraph::GetRenderPass(PassHandle pass) const
+	{
+		return groups[passes[pass].group].renderPass;
+	}
+
+	uint32_t PVRenderGraph::GetSubpass(PassHandle pass) const
+	{
+		return passes[pass].subpass;
+	}
+
+	VkExtent2D PVRenderGraph::GetPassExtent(PassHandle pass) const
+	{
+		return groups[passes[pass].group].extent;
+	}
+
+	void PVRenderGraph::SetRenderArea(PassHandle pass, VkExtent2D extent)
+	{
+		groups[passes[pass].group].renderArea = extent;
+	}
+
+	VkImage PVRenderGraph::GetImage(ResourceHandle resource) const
+	{
+		return resources[resource].image;
+	}
+
+	VkImageView PVRenderGraph::GetImageView(ResourceHandle resource) const
+	{
+		return resources[resource].imageView;
+	}
+
+	PVRenderGraph::UsageInfo PVRenderGraph::getUsageInfo(Usage usage, PassType passType)
+	{
+		VkPipelineStageFlags shaderStages = (passType == PassType::Compute) ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+			: (VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		VkPipelineStageFlags depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+		switch (usage)
+		{
+		case Usage::ColorAttachment:
+			return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true, true };
+		case Usage::DepthAttachment:
+			return { depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true, true };
+		case Usage::DepthRead:
+			return { depthStages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false, true };
+		case Usage::InputAttachment:
+			return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_INPUT_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, true };
+		case Usage::Sampled:
+			return { shaderStages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, false };
+		case Usage::StorageRead:
+			return { shaderStages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false, false };
+		case Usage::StorageWrite:
+			return { shaderStages, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true, false };
+		case Usage::TransferSrc:
+			return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false, false };
+		case Usage::TransferDst:
+			return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true, false };
+		}
+
+		throw std::runtime_error("Unknown render graph usage");
+	}
+
+	bool PVRenderGraph::isDepthFormat(VkFormat format)
+	{
+		return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_X8_D24_UNORM_PACK32 || format == VK_FORMAT_D32_SFLOAT
+			|| format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+	}
+
+	VkImageUsageFlags PVRenderGraph::getImageUsageFlag(Usage usage)
+	{
+		switch (usage)
+		{
+		case Usage::ColorAttachment:
+			return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		case Usage::DepthAttachment:
+		case Usage::DepthRead:
+			return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		case Usage::InputAttachment:
+			return VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+		case Usage::Sampled:
+			return VK_IMAGE_USAGE_SAMPLED_BIT;
+		case Usage::StorageRead:
+		case Usage::StorageWrite:
+			return VK_IMAGE_USAGE_STORAGE_BIT;
+		case Usage::TransferSrc:
+			return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		case Usage::TransferDst:
+			return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		}
+		return 0;
+	}
+
+	void PVRenderGraph::buildGroups()
+	{
+		groups.clear();
+
+		for (uint32_t passIndex = 0; passIndex < passes.size(); passIndex++)
+		{
+			Pass& pass = passes[passIndex];
+
+			// every graphics pass needs an attachment to get its extent from
+			VkExtent2D passExtent = { 0, 0 };
+			if (pass.type == PassType::Graphics)
+			{
+				for (const auto& access : pass.accesses)
+				{
+					if (getUsageInfo(access.usage, pass.type).attachment)
+					{
+						passExtent = resources[access.resource].extent;
+						break;
+					}
+				}
+				if (passExtent.width == 0)
+				{
+					throw std::runtime_error("Render graph pass " + pass.name + " has no attachments");
+				}
+			}
+
+			bool merge = false;
+			if (pass.type == PassType::Graphics && !groups.empty() && groups.back().type == PassType::Graphics)
+			{
+				Group& group = groups.back();
+				merge = (passExtent.width == group.extent.width && passExtent.height == group.extent.height);
+
+				// anything the group touches can only be used as an attachment, other usages would
+				// need a layout change or barrier in the middle of the render pass
+				for (const auto& access : pass.accesses)
+				{
+					if (!merge)
+					{
+						break;
+					}
+
+					UsageInfo info = getUsageInfo(access.usage, pass.type);
+					if (info.attachment && resources[access.resource].extent.width != group.extent.width)
+					{
+						merge = false;
+					}
+					bool touchedByGroup = false;
+					for (PassHandle groupPass : group.passes)
+					{
+						for (const auto& groupAccess : passes[groupPass].accesses)
+						{
+							if (groupAccess.resource == access.resource)
+							{
+								touchedByGroup = true;
+								if (!getUsageInfo(groupAccess.usage, PassType::Graphics).attachment)
+								{
+									merge = false;
+								}
+							}
+						}
+					}
+					if (touchedByGroup && !info.attachment)
+					{
+						merge = false;
+					}
+				}
+			}
+
+			if (!merge)
+			{
+				Group group;
+				group.type = pass.type;
+				group.extent = passExtent;
+				group.renderArea = passExtent;
+				groups.push_back(group);
+			}
+
+			pass.group = static_cast<uint32_t>(groups.size() - 1);
+			pass.subpass = static_cast<uint32_t>(groups.back().passes.size());
+			groups.back().passes.push_back(passIndex);
+		}
+
+		for (const auto& group : groups)
+		{
+			if (group.type == PassType::Graphics)
+			{
+				statistics.renderPassCount++;
+			}
+		}
+	}
+
+	void PVRenderGraph::computeLifetimes()
+	{
+		std::vector<bool> attachmentOnly(resources.size(), true);
+
+		for (const auto& pass : passes)
+		{
+			for (const auto& access : pass.accesses)
+			{
+				Resource& resource = resources[access.resource];
+				resource.usageFlags |= getImageUsageFlag(access.usage);
+				resource.firstGroup = std::min(resource.firstGroup, pass.group);
+				resource.lastGroup = std::max(resource.lastGroup, pass.group);
+				if (!getUsageInfo(access.usage, pass.type).attachment)
+				{
+					attachmentOnly[access.resource] = false;
+				}
+			}
+		}
+
+		for (size_t i = 0; i < resources.size(); i++)
+		{
+			Resource& resource = resources[i];
+			// images that never leave a single render pass never need to be backed by real memory
+			if (!resource.imported && resource.firstGroup != UINT32_MAX && resource.firstGroup == resource.lastGroup
+				&& attachmentOnly[i])
+			{
+				resource.lazy = true;
+				resource.usageFlags |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+			}
+		}
+	}
+
+	void PVRenderGraph::assignMemory()
+	{
+		const VkDevice logicalDevice = *deviceContext->GetLogicalDevice();
+
+		struct MemorySlot
+		{
+			VkDeviceSize size;
+			uint32_t memoryTypeBits;
+			std::vector<ResourceHandle> occupants;
+		};
+
+		std::vector<ResourceHandle> aliasCandidates;
+		std::vector<VkMemoryRequirements> requirements(resources.size());
+
+		for (ResourceHandle handle = 0; handle < resources.size(); handle++)
+		{
+			Resource& resource = resources[handle];
+			if (resource.imported || resource.firstGroup == UINT32_MAX)
+			{
+				continue;
+			}
+
+			VkImageCreateInfo imageInfo = {};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.format = resource.desc.format;
+			imageInfo.extent = { resource.extent.width, resource.extent.height, 1 };
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.usage = resource.usageFlags;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			if (vkCreateImage(logicalDevice, &imageInfo, PVHostAllocator::Callbacks(PVAllocationType::Image), &resource.image) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create render graph image " + resource.name);
+			}
+			vkGetImageMemoryRequirements(logicalDevice, resource.image, &requirements[handle]);
+
+			uint32_t lazyMemoryType;
+			if (resource.lazy && deviceContext->TryFindMemoryType(requirements[handle].memoryTypeBits,
+				VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, lazyMemoryType))
+			{
+				VkMemoryAllocateInfo allocateInfo = {};
+				allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+				allocateInfo.allocationSize = requirements[handle].size;
+				allocateInfo.memoryTypeIndex = lazyMemoryType;
+
+				VkDeviceMemory lazyMemory;
+				if (vkAllocateMemory(logicalDevice, &allocateInfo, PVHostAllocator::Callbacks(PVAllocationType::Memory), &lazyMemory) != VK_SUCCESS)
+				{
+					throw std::runtime_error("Failed to allocate lazy render graph memory");
+				}
+				vkBindImageMemory(logicalDevice, resource.image, lazyMemory, 0);
+				memoryBlocks.push_back(lazyMemory);
+				statistics.lazyImageCount++;
+			}
+			else
+			{
+				resource.lazy = false;
+				aliasCandidates.push_back(handle);
+				statistics.transientBytes += requirements[handle].size;
+			}
+		}
+
+		// largest first, then first fit into a slot no current occupant overlaps in time with
+		std::sort(aliasCandidates.begin(), aliasCandidates.end(), [&requirements](ResourceHandle a, ResourceHandle b)
+		{
+			return requirements[a].size > requirements[b].size;
+		});
+
+		std::vector<MemorySlot> slots;
+		for (ResourceHandle handle : aliasCandidates)
+		{
+			const Resource& resource = resources[handle];
+			MemorySlot* chosenSlot = nullptr;
+
+			for (auto& slot : slots)
+			{
+				uint32_t sharedTypes = slot.memoryTypeBits & requirements[handle].memoryTypeBits;
+				uint32_t memoryType;
+				if (!deviceContext->TryFindMemoryType(sharedTypes, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, memoryType))
+				{
+					continue;
+				}
+
+				bool overlaps = false;
+				for (ResourceHandle occupant : slot.occupants)
+				{
+					if (!(resources[occupant].lastGroup < resource.firstGroup || resource.lastGroup < resources[occupant].firstGroup))
+					{
+						overlaps = true;
+						break;
+					}
+				}
+				if (!overlaps)
+				{
+					chosenSlot = &slot;
+					break;
+				}
+			}
+
+			if (chosenSlot == nullptr)
+			{
+				slots.push_back({ 0, requirements[handle].memoryTypeBits, {} });
+				chosenSlot = &slots.back();
+			}
+			chosenSlot->size = std::max(chosenSlot->size, requirements[handle].size);
+			chosenSlot->memoryTypeBits &= requirements[handle].memoryTypeBits;
+			chosenSlot->occupants.push_back(handle);
+		}
+
+		for (auto& slot : slots)
+		{
+			VkMemoryAllocateInfo allocateInfo = {};
+			allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocateInfo.allocationSize = slot.size;
+			allocateInfo.memoryTypeIndex = deviceContext->FindMemoryType(slot.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+			VkDeviceMemory slotMemory;
+			if (vkAllocateMemory(logicalDevice, &allocateInfo, PVHostAllocator::Callbacks(PVAllocationType::Memory), &slotMemory) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to allocate render graph memory");
+			}
+			memoryBlocks.push_back(slotMemory);
+			statistics.allocatedBytes += slot.size;
+
+			// occupants in execution order, each one takes over the memory from the one before
+			std::sort(slot.occupants.begin(), slot.occupants.end(), [this](ResourceHandle a, ResourceHandle b)
+			{
+				return resources[a].firstGroup < resources[b].firstGroup;
+			});
+			for (size_t i = 0; i < slot.occupants.size(); i++)
+			{
+				vkBindImageMemory(logicalDevice, resources[slot.occupants[i]].image, slotMemory, 0);
+				if (i > 0)
+				{
+					resources[slot.occupants[i]].aliasPredecessor = slot.occupants[i - 1];
+				}
+			}
+		}
+
+		for (auto& resource : resources)
+		{
+			if (resource.imported || resource.image == VK_NULL_HANDLE)
+			{
+				continue;
+			}
+
+			VkImageViewCreateInfo viewInfo = {};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = resource.image;
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = resource.desc.format;
+			viewInfo.subresourceRange.aspectMask = isDepthFormat(resource.desc.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+			viewInfo.subresourceRange.baseMipLevel = 0;
+			viewInfo.subresourceRange.levelCount = 1;
+			viewInfo.subresourceRange.baseArrayLayer = 0;
+			viewInfo.subresourceRange.layerCount = 1;
+
+			if (vkCreateImageView(logicalDevice, &viewInfo, PVHostAllocator::Callbacks(PVAllocationType::ImageView), &resource.imageView) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create render graph image view " + resource.name);
+			}
+		}
+	}
+
+	void PVRenderGraph::buildBarriersAndRenderPasses()
+	{
+		// Every execution runs the same passes, so with more than one frame in flight the previous
+		// execution's uses of a graph owned image, and of every image sharing its memory, may still
+		// be running when this one starts. The first use in the frame waits on all of them.
+		std::vector<ResourceHandle> memoryRoots(resources.size());
+		std::vector<VkPipelineStageFlags> previousStages(resources.size(), 0);
+		std::vector<VkAccessFlags> previousAccess(resources.size(), 0);
+		for (ResourceHandle handle = 0; handle < resources.size(); handle++)
+		{
+			ResourceHandle root = handle;
+			while (resources[root].aliasPredecessor != UINT32_MAX)
+			{
+				root = resources[root].aliasPredecessor;
+			}
+			memoryRoots[handle] = root;
+		}
+		for (const auto& pass : passes)
+		{
+			for (const auto& access : pass.accesses)
+			{
+				if (resources[access.resource].imported)
+				{
+					continue;
+				}
+				UsageInfo info = getUsageInfo(access.usage, pass.type);
+				ResourceHandle root = memoryRoots[access.resource];
+				previousStages[root] |= info.stageMask;
+				if (info.write)
+				{
+					previousAccess[root] |= info.accessMask;
+				}
+			}
+		}
+
+		std::vector<ResourceState> states(resources.size());
+		for (size_t i = 0; i < resources.size(); i++)
+		{
+			const Resource& resource = resources[i];
+			states[i] = { resource.initialLayout, resource.initialStage, 0, 0, resource.imported && resource.initialLayout != VK_IMAGE_LAYOUT_UNDEFINED };
+			if (!resource.imported)
+			{
+				// the contents are discarded, only the previous frame's uses are waited on
+				states[i].writeStages = previousStages[memoryRoots[i]];
+				states[i].writeAccess = previousAccess[memoryRoots[i]];
+			}
+		}
+
+		// Checks usage against the tracked state. Returns true when something has to wait and
+		// fills in what it waits on, then moves the state past the usage.
+		auto resolveHazard = [](ResourceState& state, const UsageInfo& info, VkPipelineStageFlags& srcStages, VkAccessFlags& srcAccess) -> bool
+		{
+			bool layoutChange = state.layout != info.layout;
+			bool hazard = layoutChange
+				|| (info.write && (state.writeStages | state.readStages) != 0)
+				|| (!info.write && state.writeStages != 0 && (info.stageMask & ~state.readStages) != 0);
+
+			srcStages = 0;
+			srcAccess = 0;
+			if (hazard)
+			{
+				srcStages = state.writeStages | ((info.write || layoutChange) ? state.readStages : 0);
+				srcAccess = state.writeAccess;
+				if (srcStages == 0)
+				{
+					srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+				}
+			}
+
+			if (info.write)
+			{
+				state = { info.layout, info.stageMask, info.accessMask, 0, true };
+			}
+			else if (layoutChange)
+			{
+				// the transition itself is a write later readers have to wait on
+				state = { info.layout, info.stageMask, 0, info.stageMask, state.hasContents };
+			}
+			else
+			{
+				state.readStages |= info.stageMask;
+			}
+			return hazard;
+		};
+
+		// all usages of one resource within a pass collapse into a single state
+		auto combinedUsage = [this](const Pass& pass, ResourceHandle resource) -> UsageInfo
+		{
+			UsageInfo combined = {};
+			bool first = true;
+			for (const auto& access : pass.accesses)
+			{
+				if (access.resource != resource)
+				{
+					continue;
+				}
+				UsageInfo info = getUsageInfo(access.usage, pass.type);
+				if (first)
+				{
+					combined = info;
+					first = false;
+				}
+				else
+				{
+					if (combined.layout != info.layout)
+					{
+						throw std::runtime_error("Render graph pass " + pass.name + " uses " + resources[resource].name + " in two layouts");
+					}
+					combined.stageMask |= info.stageMask;
+					combined.accessMask |= info.accessMask;
+					combined.write = combined.write || info.write;
+				}
+			}
+			return combined;
+		};
+
+		auto addBarrier = [](BarrierBatch& batch, ResourceHandle resource, const ResourceState& before, const UsageInfo& info,
+			VkPipelineStageFlags srcStages, VkAccessFlags srcAccess)
+		{
+			batch.srcStageMask |= srcStages;
+			batch.dstStageMask |= info.stageMask;
+			// contents that are not needed can be discarded with an undefined old layout
+			VkImageLayout oldLayout = before.hasContents ? before.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+			batch.barriers.push_back({ resource, oldLayout, info.layout, srcAccess, info.accessMask });
+		};
+
+		std::vector<std::vector<VkAttachmentDescription>> attachmentDescriptions(groups.size());
+		std::vector<std::vector<VkSubpassDependency>> dependencies(groups.size());
+		// group and attachment index of the last render pass use of each resource
+		std::vector<std::pair<uint32_t, uint32_t>> lastAttachmentUse(resources.size(), std::make_pair(UINT32_MAX, 0u));
+
+		finalBarriers = BarrierBatch();
+
+		for (uint32_t groupIndex = 0; groupIndex < groups.size(); groupIndex++)
+		{
+			Group& group = groups[groupIndex];
+
+			// aliased images take over the memory from their predecessor, so they have to wait for
+			// everything that used it
+			for (size_t i = 0; i < resources.size(); i++)
+			{
+				if (resources[i].firstGroup == groupIndex && resources[i].aliasPredecessor != UINT32_MAX)
+				{
+					const ResourceState& previous = states[resources[i].aliasPredecessor];
+					states[i] = { VK_IMAGE_LAYOUT_UNDEFINED, previous.writeStages | previous.readStages | previousStages[memoryRoots[i]],
+						previous.writeAccess | previousAccess[memoryRoots[i]], 0, false };
+				}
+			}
+
+			if (group.type != PassType::Graphics)
+			{
+				const Pass& pass = passes[group.passes[0]];
+				std::vector<ResourceHandle> handled;
+				for (const auto& access : pass.accesses)
+				{
+					if (std::find(handled.begin(), handled.end(), access.resource) != handled.end())
+					{
+						continue;
+					}
+					handled.push_back(access.resource);
+
+					UsageInfo info = combinedUsage(pass, access.resource);
+					ResourceState before = states[access.resource];
+					VkPipelineStageFlags srcStages;
+					VkAccessFlags srcAccess;
+					if (resolveHazard(states[access.resource], info, srcStages, srcAccess))
+					{
+						addBarrier(group.preBarriers, access.resource, before, info, srcStages, srcAccess);
+					}
+				}
+				continue;
+			}
+
+			// graphics group, collect attachments in first use order
+			for (PassHandle passHandle : group.passes)
+			{
+				for (const auto& access : passes[passHandle].accesses)
+				{
+					if (getUsageInfo(access.usage, PassType::Graphics).attachment
+						&& std::find(group.attachments.begin(), group.attachments.end(), access.resource) == group.attachments.end())
+					{
+						group.attachments.push_back(access.resource);
+					}
+				}
+			}
+
+			for (uint32_t attachmentIndex = 0; attachmentIndex < group.attachments.size(); attachmentIndex++)
+			{
+				ResourceHandle handle = group.attachments[attachmentIndex];
+				const Resource& resource = resources[handle];
+				ResourceState& state = states[handle];
+
+				VkAttachmentDescription description = {};
+				description.format = resource.desc.format;
+				description.samples = VK_SAMPLE_COUNT_1_BIT;
+				description.loadOp = state.hasContents ? VK_ATTACHMENT_LOAD_OP_LOAD
+					: (resource.desc.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+				description.storeOp = (resource.imported || resource.lastGroup > groupIndex) ? VK_ATTACHMENT_STORE_OP_STORE
+					: VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				description.initialLayout = state.hasContents ? state.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+
+				group.clearValues.push_back(resource.desc.clearValue);
+
+				// walk the subpasses, the first wait becomes an external dependency and later ones
+				// become dependencies between subpasses
+				uint32_t lastSubpass = VK_SUBPASS_EXTERNAL;
+				for (uint32_t subpass = 0; subpass < group.passes.size(); subpass++)
+				{
+					const Pass& pass = passes[group.passes[subpass]];
+					bool usesResource = false;
+					for (const auto& access : pass.accesses)
+					{
+						usesResource = usesResource || access.resource == handle;
+					}
+					if (!usesResource)
+					{
+						continue;
+					}
+
+					UsageInfo info = combinedUsage(pass, handle);
+					if (lastSubpass == VK_SUBPASS_EXTERNAL && description.initialLayout == VK_IMAGE_LAYOUT_UNDEFINED)
+					{
+						// discarded contents need no transition, only earlier users of the memory are waited on
+						state.layout = info.layout;
+					}
+
+					VkPipelineStageFlags srcStages;
+					VkAccessFlags srcAccess;
+					if (resolveHazard(state, info, srcStages, srcAccess))
+					{
+						VkSubpassDependency dependency = {};
+						dependency.srcSubpass = lastSubpass;
+						dependency.dstSubpass = subpass;
+						dependency.srcStageMask = srcStages;
+						dependency.srcAccessMask = srcAccess;
+						dependency.dstStageMask = info.stageMask;
+						dependency.dstAccessMask = info.accessMask;
+						dependency.dependencyFlags = (lastSubpass == VK_SUBPASS_EXTERNAL) ? 0 : VK_DEPENDENCY_BY_REGION_BIT;
+						dependencies[groupIndex].push_back(dependency);
+					}
+					lastSubpass = subpass;
+				}
+
+				description.finalLayout = state.layout;
+				attachmentDescriptions[groupIndex].push_back(description);
+				lastAttachmentUse[handle] = std::make_pair(groupIndex, attachmentIndex);
+			}
+
+			// sampled or storage images used inside the render pass are synchronized up front
+			for (PassHandle passHandle : group.passes)
+			{
+				const Pass& pass = passes[passHandle];
+				for (const auto& access : pass.accesses)
+				{
+					UsageInfo info = getUsageInfo(access.usage, PassType::Graphics);
+					if (info.attachment)
+					{
+						continue;
+					}
+					ResourceState before = states[access.resource];
+					VkPipelineStageFlags srcStages;
+					VkAccessFlags srcAccess;
+					if (resolveHazard(states[access.resource], info, srcStages, srcAccess))
+					{
+						addBarrier(group.preBarriers, access.resource, before, info, srcStages, srcAccess);
+					}
+				}
+			}
+		}
+
+		// leave imported images in the layout their owner expects
+		for (ResourceHandle handle = 0; handle < resources.size(); handle++)
+		{
+			const Resource& resource = resources[handle];
+			if (!resource.imported || resource.firstGroup == UINT32_MAX || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED
+				|| resource.finalLayout == states[handle].layout)
+			{
+				continue;
+			}
+
+			uint32_t lastGroup = lastAttachmentUse[handle].first;
+			if (lastGroup != UINT32_MAX && lastGroup == resource.lastGroup)
+			{
+				// last used as an attachment, the render pass transitions it on the way out
+				attachmentDescriptions[lastGroup][lastAttachmentUse[handle].second].finalLayout = resource.finalLayout;
+			}
+			else
+			{
+				UsageInfo info = { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, resource.finalLayout, false, false };
+				ResourceState before = states[handle];
+				VkPipelineStageFlags srcStages;
+				VkAccessFlags srcAccess;
+				resolveHazard(states[handle], info, srcStages, srcAccess);
+				addBarrier(finalBarriers, handle, before, info, srcStages, srcAccess);
+			}
+		}
+
+		for (uint32_t groupIndex = 0; groupIndex < groups.size(); groupIndex++)
+		{
+			Group& group = groups[groupIndex];
+			if (group.type == PassType::Graphics)
+			{
+				createRenderPass(group, attachmentDescriptions[groupIndex], dependencies[groupIndex]);
+				statistics.subpassDependencyCount += static_cast<uint32_t>(dependencies[groupIndex].size());
+			}
+			if (!group.preBarriers.barriers.empty())
+			{
+				statistics.barrierCount += static_cast<uint32_t>(group.preBarriers.barriers.size());
+				statistics.pipelineBarrierCalls++;
+			}
+		}
+		if (!finalBarriers.barriers.empty())
+		{
+			statistics.barrierCount += static_cast<uint32_t>(finalBarriers.barriers.size());
+			statistics.pipelineBarrierCalls++;
+		}
+	}
+
+	void PVRenderGraph::createRenderPass(Group& group, const std::vector<VkAttachmentDescription>& attachmentDescriptions,
+		const std::vector<VkSubpassDependency>& dependencies)
+	{
+		size_t subpassCount = group.passes.size();
+		std::vector<std::vector<VkAttachmentReference>> colorReferences(subpassCount);
+		std::vector<std::vector<VkAttachmentReference>> inputReferences(subpassCount);
+		std::vector<VkAttachmentReference> depthReferences(subpassCount);
+		std::vector<std::vector<uint32_t>> preserveAttachments(subpassCount);
+		std::vector<VkSubpassDescription> subpasses(subpassCount);
+
+		for (size_t subpass = 0; subpass < subpassCount; subpass++)
+		{
+			const Pass& pass = passes[group.passes[subpass]];
+			bool hasDepth = false;
+
+			for (const auto& access : pass.accesses)
+			{
+				UsageInfo info = getUsageInfo(access.usage, PassType::Graphics);
+				if (!info.attachment)
+				{
+					continue;
+				}
+
+				uint32_t attachmentIndex = static_cast<uint32_t>(std::find(group.attachments.begin(), group.attachments.end(), access.resource)
+					- group.attachments.begin());
+				VkAttachmentReference reference = { attachmentIndex, info.layout };
+
+				if (access.usage == Usage::ColorAttachment)
+				{
+					colorReferences[subpass].push_back(reference);
+				}
+				else if (access.usage == Usage::InputAttachment)
+				{
+					inputReferences[subpass].push_back(reference);
+				}
+				else
+				{
+					depthReferences[subpass] = reference;
+					hasDepth = true;
+				}
+			}
+
+			// attachments written before this subpass and read after it must be preserved
+			for (uint32_t attachmentIndex = 0; attachmentIndex < group.attachments.size(); attachmentIndex++)
+			{
+				bool usedBefore = false;
+				bool usedHere = false;
+				bool usedAfter = false;
+				for (size_t other = 0; other < subpassCount; other++)
+				{
+					for (const auto& access : passes[group.passes[other]].accesses)
+					{
+						if (access.resource != group.attachments[attachmentIndex])
+						{
+							continue;
+						}
+						usedBefore = usedBefore || other < subpass;
+						usedHere = usedHere || other == subpass;
+						usedAfter = usedAfter || other > subpass;
+					}
+				}
+				if (usedBefore && usedAfter && !usedHere)
+				{
+					preserveAttachments[subpass].push_back(attachmentIndex);
+				}
+			}
+
+			VkSubpassDescription& description = subpasses[subpass];
+			description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			description.colorAttachmentCount = static_cast<uint32_t>(colorReferences[subpass].size());
+			description.pColorAttachments = colorReferences[subpass].data();
+			description.inputAttachmentCount = static_cast<uint32_t>(inputReferences[subpass].size());
+			description.pInputAttachments = inputReferences[subpass].data();
+			description.pDepthStencilAttachment = hasDepth ? &depthReferences[subpass] : nullptr;
+			description.preserveAttachmentCount = static_cast<uint32_t>(preserveAttachments[subpass].size());
+			description.pPreserveAttachments = preserveAttachments[subpass].data();
+		}
+
+		VkRenderPassCreateInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescriptions.size());
+		renderPassInfo.pAttachments = attachmentDescriptions.data();
+		renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+		renderPassInfo.pSubpasses = subpasses.data();
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
+
+		if (vkCreateRenderPass(*deviceContext->GetLogicalDevice(), &renderPassInfo, PVHostAllocator::Callbacks(PVAllocationType::RenderPass), &group.renderPass) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create render pass");
+		}
+		else
+		{
+			std::cout << "Render Pass created successfully" << std::endl;
+		}
+	}
+
+	void PVRenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch, std::pmr::memory_resource* scratch)
+	{
+		if (batch.barriers.empty())
+		{
+			return;
+		}
+
+		std::pmr::vector<VkImageMemoryBarrier> imageBarriers(batch.barriers.size(), VkImageMemoryBarrier{}, scratch);
+		for (size_t i = 0; i < batch.barriers.size(); i++)
+		{
+			const Barrier& barrier = batch.barriers[i];
+			VkImageMemoryBarrier& imageBarrier = imageBarriers[i];
+			imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageBarrier.srcAccessMask = barrier.srcAccessMask;
+			imageBarrier.dstAccessMask = barrier.dstAccessMask;
+			imageBarrier.oldLayout = barrier.oldLayout;
+			imageBarrier.newLayout = barrier.newLayout;
+			imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.image = resources[barrier.resource].image;
+			imageBarrier.subresourceRange.aspectMask = isDepthFormat(resources[barrier.resource].desc.format)
+				? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+			imageBarrier.subresourceRange.baseMipLevel = 0;
+			imageBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+			imageBarrier.subresourceRange.baseArrayLayer = 0;
+			imageBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+		}
+
+		vkCmdPipelineBarrier(commandBuffer, batch.srcStageMask, batch.dstStageMask, 0, 0, nullptr, 0, nullptr,
+			static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+	}
+
+	VkFramebuffer PVRenderGraph::getFramebuffer(Group& group)
+	{
+		std::vector<VkImageView>& views = framebufferViews;
+		views.clear();
+		for (ResourceHandle handle : group.attachments)
+		{
+			views.push_back(resources[handle].imageView);
+		}
+
+		auto cached = group.framebuffers.find(views);
+		if (cached != group.framebuffers.end())
+		{
+			return cached->second;
+		}
+
+		VkFramebufferCreateInfo framebufferInfo = {};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = group.renderPass;
+		framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+		framebufferInfo.pAttachments = views.data();
+		framebufferInfo.width = group.extent.width;
+		framebufferInfo.height = group.extent.height;
+		framebufferInfo.layers = 1;
+
+		VkFramebuffer framebuffer;
+		if (vkCreateFramebuffer(*deviceContext->GetLogicalDevice(), &framebufferInfo, PVHostAllocator::Callbacks(PVAllocationType::Framebuffer), &framebuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create framebuffer");
+		}
+
+		group.framebuffers[views] = framebuffer;
+		return framebuffer;
+	}
+
+	void PVRenderGraph::retireCompiledObjects(uint64_t retireValue)
+	{
+		for (auto& group : groups)
+		{
+			for (auto& framebuffer : group.framebuffers)
+			{
+				deletionQueue->RetireFramebuffer(framebuffer.second, retireValue);
+			}
+			if (group.renderPass != VK_NULL_HANDLE)
+			{
+				deletionQueue->RetireRenderPass(group.renderPass, retireValue);
+			}
+		}
+		groups.clear();
+
+		for (auto& resource : resources)
+		{
+			if (resource.imported)
+			{
+				continue;
+			}
+			if (resource.imageView != VK_NULL_HANDLE)
+			{
+				deletionQueue->RetireImageView(resource.imageView, retireValue);
+			}
+			if (resource.image != VK_NULL_HANDLE)
+			{
+				deletionQueue->RetireImage(resource.image, retireValue);
+			}
+			resource.imageView = VK_NULL_HANDLE;
+			resource.image = VK_NULL_HANDLE;
+		}
+
+		for (VkDeviceMemory memoryBlock : memoryBlocks)
+		{
+			deletionQueue->RetireMemory(memoryBlock, retireValue);
+		}
+		memoryBlocks.clear();
+	}
+}
@@ -0,0 +1,243 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <stdexcept>
+#include <functional>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory_resource>
+
+#include "PVDeviceContext.h"
+#include "PVDeletionQueue.h"
+
+namespace PVEngine
+{
+	// Frame graph for the engine's passes. Passes declare the images they read and write and
+	// the graph works out the render passes, barriers and transient memory from that:
+	//	- consecutive graphics passes that only touch attachments are merged into subpasses
+	//	- barriers are only emitted on layout changes and real hazards, attachment barriers are
+	//	  folded into render pass layouts and external subpass dependencies where possible
+	//	- transient images whose lifetimes don't overlap share memory, images that only live
+	//	  inside one render pass use lazily allocated memory when the device has it
+	//	- the first use of a graph owned image in a frame waits on the previous frame's uses of
+	//	  it and of the images sharing its memory, so frames in flight don't race on them
+	// Compile rebuilds the Vulkan objects and only needs to run when the graph or extent changes.
+	class PVRenderGraph
+	{
+	public:
+		typedef uint32_t ResourceHandle;
+		typedef uint32_t PassHandle;
+
+		enum class PassType
+		{
+			Graphics,
+			Compute,
+			Transfer
+		};
+
+		enum class Usage
+		{
+			ColorAttachment,
+			DepthAttachment,
+			DepthRead,
+			InputAttachment,
+			Sampled,
+			StorageRead,
+			StorageWrite,
+			TransferSrc,
+			TransferDst
+		};
+
+		struct ImageDesc
+		{
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			// absolute size, leave at 0 to follow the extent passed to Compile
+			VkExtent2D extent = { 0, 0 };
+			// clear on first use in the graph instead of discarding
+			bool clear = false;
+			VkClearValue clearValue = {};
+		};
+
+		struct Statistics
+		{
+			uint32_t passCount = 0;
+			uint32_t renderPassCount = 0;
+			// explicit image barriers recorded per execution
+			uint32_t barrierCount = 0;
+			uint32_t pipelineBarrierCalls = 0;
+			uint32_t subpassDependencyCount = 0;
+			// transient memory with and without aliasing
+			VkDeviceSize transientBytes = 0;
+			VkDeviceSize allocatedBytes = 0;
+			uint32_t lazyImageCount = 0;
+		};
+
+		PVRenderGraph(const PVDeviceContext* deviceContext, PVDeletionQueue* deletionQueue);
+		~PVRenderGraph();
+
+		// images owned by the graph, only valid between Compile calls
+		ResourceHandle CreateImage(const std::string& name, const ImageDesc& desc);
+
+		// Images owned elsewhere, e.g. the swapchain. initialLayout/initialStage describe the
+		// state at the start of the graph and finalLayout the state it has to be left in.
+		ResourceHandle ImportImage(const std::string& name, const ImageDesc& desc, VkImageLayout initialLayout,
+			VkPipelineStageFlags initialStage, VkImageLayout finalLayout);
+
+		// the imported image can change between executions without recompiling
+		void SetImportedImage(ResourceHandle resource, VkImage image, VkImageView imageView);
+
+		PassHandle AddPass(const std::string& name, PassType type, std::function<void(VkCommandBuffer)> record);
+
+		// Limits the render area of the pass's render pass to the top left corner of its
+		// attachments, for rendering at a lower resolution without recreating them. Clamped to
+		// the attachment size, can change between executions without recompiling.
+		void SetRenderArea(PassHandle pass, VkExtent2D extent);
+
+		void Use(PassHandle pass, ResourceHandle resource, Usage usage);
+
+		// Builds render passes, images and barrier lists for the given extent. Objects from the
+		// previous compile are retired to the deletion queue against retireValue.
+		void Compile(VkExtent2D extent, uint64_t retireValue);
+
+		// scratch holds the barrier lists while recording, the engine passes its frame arena
+		void Execute(VkCommandBuffer commandBuffer, std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
+
+		void Cleanup();
+
+		bool NeedsCompile(VkExtent2D extent) const;
+
+		//Getters
+		VkRenderPass GetRenderPass(PassHandle pass) const;
+		uint32_t GetSubpass(PassHandle pass) const;
+		VkExtent2D GetPassExtent(PassHandle pass) const;
+		VkImage GetImage(ResourceHandle resource) const;
+		VkImageView GetImageView(ResourceHandle resource) const;
+		const Statistics& GetStatistics() const { return statistics; }
+
+	private:
+		struct UsageInfo
+		{
+			VkPipelineStageFlags stageMask;
+			VkAccessFlags accessMask;
+			VkImageLayout layout;
+			bool write;
+			bool attachment;
+		};
+
+		struct ResourceAccess
+		{
+			ResourceHandle resource;
+			Usage usage;
+		};
+
+		struct Pass
+		{
+			std::string name;
+			PassType type;
+			std::function<void(VkCommandBuffer)> record;
+			std::vector<ResourceAccess> accesses;
+
+			// filled by Compile
+			uint32_t group = 0;
+			uint32_t subpass = 0;
+		};
+
+		struct Resource
+		{
+			std::string name;
+			ImageDesc desc;
+			bool imported = false;
+			VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkPipelineStageFlags initialStage = 0;
+			VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			// filled by Compile
+			VkExtent2D extent = { 0, 0 };
+			VkImageUsageFlags usageFlags = 0;
+			uint32_t firstGroup = UINT32_MAX;
+			uint32_t lastGroup = 0;
+			bool lazy = false;
+			// transient resource that used the same memory before this one, or UINT32_MAX
+			ResourceHandle aliasPredecessor = UINT32_MAX;
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView imageView = VK_NULL_HANDLE;
+		};
+
+		// synchronization state of one image while walking the graph
+		struct ResourceState
+		{
+			VkImageLayout layout;
+			// stages/access of the last write (or layout transition) still to be made visible
+			VkPipelineStageFlags writeStages;
+			VkAccessFlags writeAccess;
+			// stages that already waited on the last write
+			VkPipelineStageFlags readStages;
+			bool hasContents;
+		};
+
+		struct Barrier
+		{
+			ResourceHandle resource;
+			VkImageLayout oldLayout;
+			VkImageLayout newLayout;
+			VkAccessFlags srcAccessMask;
+			VkAccessFlags dstAccessMask;
+		};
+
+		struct BarrierBatch
+		{
+			VkPipelineStageFlags srcStageMask = 0;
+			VkPipelineStageFlags dstStageMask = 0;
+			std::vector<Barrier> barriers;
+		};
+
+		// one render pass for graphics groups, or a single compute/transfer pass
+		struct Group
+		{
+			PassType type;
+			std::vector<PassHandle> passes;
+			BarrierBatch preBarriers;
+			VkExtent2D extent = { 0, 0 };
+
+			// graphics groups only
+			VkExtent2D renderArea = { 0, 0 };
+			std::vector<ResourceHandle> attachments;
+			std::vector<VkClearValue> clearValues;
+			VkRenderPass renderPass = VK_NULL_HANDLE;
+			std::map<std::vector<VkImageView>, VkFramebuffer> framebuffers;
+		};
+
+		static UsageInfo getUsageInfo(Usage usage, PassType passType);
+		static bool isDepthFormat(VkFormat format);
+		static VkImageUsageFlags getImageUsageFlag(Usage usage);
+
+		void buildGroups();
+		void computeLifetimes();
+		void assignMemory();
+		void buildBarriersAndRenderPasses();
+		void createRenderPass(Group& group, const std::vector<VkAttachmentDescription>& attachmentDescriptions,
+			const std::vector<VkSubpassDependency>& dependencies);
+		void recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch, std::pmr::memory_resource* scratch);
+		VkFramebuffer getFramebuffer(Group& group);
+		void retireCompiledObjects(uint64_t retireValue);
+
+		const PVDeviceContext* deviceContext;
+		PVDeletionQueue* deletionQueue;
+
+		std::vector<Resource> resources;
+		std::vector<Pass> passes;
+		std::vector<Group> groups;
+		BarrierBatch finalBarriers;
+
+		// lookup key for the framebuffer cache, kept to avoid building a new one every frame
+		std::vector<VkImageView> framebufferViews;
+
+		std::vector<VkDeviceMemory> memoryBlocks;
+
+		bool dirty = true;
+		VkExtent2D compiledExtent = { 0, 0 };
+
+		Statistics statistics;
+	};
+}
@@ -0,0 +1,55 @@
+#include "PVResolutionScaler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace PVEngine
+{
+	PVResolutionScaler::PVResolutionScaler(double targetGpuMs, float minScale, float maxScale)
+		: targetGpuMs(targetGpuMs), minScale(minScale), maxScale(maxScale), scale(maxScale), lowestScale(maxScale), highestScale(minScale)
+	{
+	}
+
+
+	PVResolutionScaler::~PVResolutionScaler()
+	{
+	}
+
+	void PVResolutionScaler::Update(double gpuMs)
+	{
+		// the measurement is a couple of frames old, smoothing keeps the controller from chasing it
+		gpuMsAverage = (gpuMsAverage == 0.0) ? gpuMs : gpuMsAverage * 0.8 + gpuMs * 0.2;
+
+		// only grow with clear headroom so the scale does not oscillate around the budget
+		const float maxStep = 0.05f;
+		if (gpuMsAverage > targetGpuMs || gpuMsAverage < targetGpuMs * 0.85)
+		{
+			float desired = scale * static_cast<float>(std::sqrt(targetGpuMs / std::max(gpuMsAverage, 0.01)));
+			desired = std::min(std::max(desired, scale * (1.0f - maxStep)), scale * (1.0f + maxStep));
+			scale = std::min(std::max(desired, minScale), maxScale);
+		}
+
+		gpuMsSum += gpuMs;
+		scaleSum += scale;
+		lowestScale = std::min(lowestScale, scale);
+		highestScale = std::max(highestScale, scale);
+		if (++reportFrames == 300)
+		{
+			std::cout << "Dynamic resolution: " << 100.0 * scaleSum / reportFrames << "% average scale (" << 100.0f * lowestScale << "% to "
+				<< 100.0f * highestScale << "%), " << gpuMsSum / reportFrames << " ms GPU against a " << targetGpuMs << " ms budget" << std::endl;
+			reportFrames = 0;
+			gpuMsSum = 0.0;
+			scaleSum = 0.0;
+			lowestScale = maxScale;
+			highestScale = minScale;
+		}
+	}
+
+	VkExtent2D PVResolutionScaler::GetRenderExtent(VkExtent2D fullExtent) const
+	{
+		VkExtent2D extent;
+		extent.width = std::max(static_cast<uint32_t>(std::lround(fullExtent.width * scale)), 1u);
+		extent.height = std::max(static_cast<uint32_t>(std::lround(fullExtent.height * scale)), 1u);
+		return extent;
+	}
+}
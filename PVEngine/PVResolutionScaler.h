@@ -0,0 +1,42 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <iostream>
+
+namespace PVEngine
+{
+	// Picks the resolution the scene is rendered at from the measured GPU frame time. Over
+	// budget the scale drops, with enough headroom it climbs back, each by at most a few
+	// percent per frame so the picture does not pump. GPU cost is taken to follow the pixel
+	// count, the square of the scale. The scale applies to both axes of the full extent and
+	// stays between the configured bounds.
+	class PVResolutionScaler
+	{
+	public:
+		PVResolutionScaler(double targetGpuMs, float minScale, float maxScale);
+		~PVResolutionScaler();
+
+		// GPU time of one finished frame
+		void Update(double gpuMs);
+
+		// the part of the full size target to render into this frame
+		VkExtent2D GetRenderExtent(VkExtent2D fullExtent) const;
+
+		//Getters
+		float GetScale() const { return scale; }
+
+	private:
+		double targetGpuMs;
+		float minScale;
+		float maxScale;
+
+		float scale;
+		double gpuMsAverage = 0.0;
+
+		// statistics since the last report
+		uint32_t reportFrames = 0;
+		double gpuMsSum = 0.0;
+		double scaleSum = 0.0;
+		float lowestScale;
+		float highestScale;
+	};
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <chrono>
+#include <glm/glm.hpp>
+
+namespace PVEngine
+{
+	// Everything the renderer needs from one simulation step. The simulation publishes a new
+	// one through a PVSnapshotMailbox after every step, the renderer only ever reads them.
+	struct PVSceneSnapshot
+	{
+		// simulation steps taken so far
+		uint64_t tick = 0;
+
+		double simulationTime = 0.0;
+
+		// rotation of the quads around z, radians
+		float rotation = 0.0f;
+
+		// world space camera position, and its rotation only: everything is drawn relative to
+		// the camera so float precision is spent where the camera is
+		glm::dvec3 cameraPosition = glm::dvec3(0.0);
+		glm::mat4 view = glm::mat4(1.0f);
+
+		// key events handled so far, and when the oldest one no frame has shown yet arrived, for
+		// measuring input latency
+		uint64_t inputCount = 0;
+		std::chrono::steady_clock::time_point inputTime;
+	};
+}
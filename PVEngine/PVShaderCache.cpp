@@ -0,0 +1,119 @@
+#include "PVShaderCache.h"
+#include "PVHostAllocator.h"
+
+#include <fstream>
+
+namespace PVEngine
+{
+	PVShaderCache::PVShaderCache(const VkDevice* logicalDevice)
+		: device(logicalDevice)
+	{
+	}
+
+
+	PVShaderCache::~PVShaderCache()
+	{
+	}
+
+	void PVShaderCache::Cleanup()
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		for (auto& cached : modules)
+		{
+			vkDestroyShaderModule(*device, cached.second.module, PVHostAllocator::Callbacks(PVAllocationType::ShaderModule));
+		}
+		modules.clear();
+	}
+
+	VkShaderModule PVShaderCache::GetModule(const PVShaderCode& shader)
+	{
+		if (!hotReloadDirectory.empty())
+		{
+			std::vector<uint32_t> code;
+			size_t codeSize;
+			if (readSpirvFile(hotReloadDirectory + "/" + shader.name + ".spv", code, codeSize))
+			{
+				return GetModule(code.data(), codeSize);
+			}
+		}
+
+		return GetModule(shader.code, shader.codeSize);
+	}
+
+	VkShaderModule PVShaderCache::GetModule(const uint32_t* code, size_t codeSize)
+	{
+		uint64_t hash = hashCode(code, codeSize);
+
+		{
+			std::lock_guard<std::mutex> lock(cacheMutex);
+			auto cached = modules.find(hash);
+			if (cached != modules.end())
+			{
+				if (cached->second.codeSize != codeSize)
+				{
+					throw std::runtime_error("Shader module hash collision");
+				}
+				return cached->second.module;
+			}
+		}
+
+		VkShaderModuleCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = codeSize;
+		createInfo.pCode = code;
+
+		VkShaderModule shaderModule;
+		if (vkCreateShaderModule(*device, &createInfo, PVHostAllocator::Callbacks(PVAllocationType::ShaderModule), &shaderModule) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create shader module");
+		}
+		else
+		{
+			std::cout << "Shader module created successfully!" << std::endl;
+		}
+
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		auto inserted = modules.insert(std::make_pair(hash, CachedModule{ shaderModule, codeSize }));
+		if (!inserted.second)
+		{
+			// another thread created the same module first
+			vkDestroyShaderModule(*device, shaderModule, PVHostAllocator::Callbacks(PVAllocationType::ShaderModule));
+		}
+		return inserted.first->second.module;
+	}
+
+	uint64_t PVShaderCache::hashCode(const uint32_t* code, size_t codeSize)
+	{
+		// FNV-1a over the words
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < codeSize / sizeof(uint32_t); i++)
+		{
+			hash ^= code[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	bool PVShaderCache::readSpirvFile(const std::string& filename, std::vector<uint32_t>& code, size_t& codeSize)
+	{
+		std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		codeSize = static_cast<size_t>(file.tellg());
+		if (codeSize % sizeof(uint32_t) != 0)
+		{
+			throw std::runtime_error("Invalid SPIR-V file " + filename);
+		}
+		code.resize(codeSize / sizeof(uint32_t));
+
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(code.data()), codeSize);
+		file.close();
+
+		return true;
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+#include "PVShaders.h"
+
+namespace PVEngine
+{
+	// Shader modules keyed by a hash of their SPIR-V, created once and kept for the lifetime of
+	// the device so pipeline recreation never rebuilds them. With a hot reload directory set
+	// the loose <name>.spv files there take priority over the embedded code; an edited file
+	// hashes differently and gets a new module, unchanged files hit the cache. Modules can be
+	// requested from several threads at once.
+	class PVShaderCache
+	{
+	public:
+		PVShaderCache(const VkDevice* logicalDevice);
+		~PVShaderCache();
+
+		void Cleanup();
+
+		VkShaderModule GetModule(const PVShaderCode& shader);
+
+		VkShaderModule GetModule(const uint32_t* code, size_t codeSize);
+
+		// empty to only use the embedded shaders
+		void SetHotReloadDirectory(const std::string& directory) { hotReloadDirectory = directory; }
+
+		//Getters
+		size_t GetModuleCount() { std::lock_guard<std::mutex> lock(cacheMutex); return modules.size(); }
+
+	private:
+		struct CachedModule
+		{
+			VkShaderModule module;
+			size_t codeSize;
+		};
+
+		static uint64_t hashCode(const uint32_t* code, size_t codeSize);
+
+		// reads straight into 32 bit words, returns false if the file does not exist
+		static bool readSpirvFile(const std::string& filename, std::vector<uint32_t>& code, size_t& codeSize);
+
+		const VkDevice* device;
+
+		std::string hotReloadDirectory;
+
+		// guards modules, creation itself runs outside the lock
+		std::mutex cacheMutex;
+
+		std::unordered_map<uint64_t, CachedModule> modules;
+	};
+}
@@ -0,0 +1,59 @@
+#include "PVShaders.h"
+
+namespace PVEngine
+{
+	namespace
+	{
+		constexpr uint32_t vertexCode[] =
+		{
+#include "Shaders/Generated/shader.vert.inc"
+		};
+
+		constexpr uint32_t instancedVertexCode[] =
+		{
+#include "Shaders/Generated/instanced.vert.inc"
+		};
+
+		constexpr uint32_t fragmentCode[] =
+		{
+#include "Shaders/Generated/shader.frag.inc"
+		};
+
+		constexpr uint32_t materialFragmentCode[] =
+		{
+#include "Shaders/Generated/material.frag.inc"
+		};
+
+		constexpr uint32_t hiZPyramidCode[] =
+		{
+#include "Shaders/Generated/hiz_pyramid.comp.inc"
+		};
+
+		constexpr uint32_t hiZCullCode[] =
+		{
+#include "Shaders/Generated/hiz_cull.comp.inc"
+		};
+
+		constexpr uint32_t terrainVertexCode[] =
+		{
+#include "Shaders/Generated/terrain.vert.inc"
+		};
+
+		constexpr uint32_t terrainFragmentCode[] =
+		{
+#include "Shaders/Generated/terrain.frag.inc"
+		};
+	}
+
+	namespace PVShaders
+	{
+		const PVShaderCode Vertex = { "vert", vertexCode, sizeof(vertexCode) };
+		const PVShaderCode InstancedVertex = { "instanced_vert", instancedVertexCode, sizeof(instancedVertexCode) };
+		const PVShaderCode Fragment = { "frag", fragmentCode, sizeof(fragmentCode) };
+		const PVShaderCode MaterialFragment = { "material_frag", materialFragmentCode, sizeof(materialFragmentCode) };
+		const PVShaderCode HiZPyramid = { "hiz_pyramid_comp", hiZPyramidCode, sizeof(hiZPyramidCode) };
+		const PVShaderCode HiZCull = { "hiz_cull_comp", hiZCullCode, sizeof(hiZCullCode) };
+		const PVShaderCode TerrainVertex = { "terrain_vert", terrainVertexCode, sizeof(terrainVertexCode) };
+		const PVShaderCode TerrainFragment = { "terrain_frag", terrainFragmentCode, sizeof(terrainFragmentCode) };
+	}
+}
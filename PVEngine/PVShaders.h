@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+namespace PVEngine
+{
+	// SPIR-V compiled into the engine. The words are generated from Shaders/*.vert|frag|comp by the
+	// glslangValidator custom build step into Shaders/Generated, so nothing is read from disk
+	// and the code is already 4 byte aligned for vkCreateShaderModule.
+	struct PVShaderCode
+	{
+		// file name without .spv, used to find the loose file when hot reloading
+		const char* name;
+		const uint32_t* code;
+		// in bytes
+		size_t codeSize;
+	};
+
+	namespace PVShaders
+	{
+		extern const PVShaderCode Vertex;
+		extern const PVShaderCode InstancedVertex;
+		extern const PVShaderCode Fragment;
+		extern const PVShaderCode MaterialFragment;
+		extern const PVShaderCode HiZPyramid;
+		extern const PVShaderCode HiZCull;
+		extern const PVShaderCode TerrainVertex;
+		extern const PVShaderCode TerrainFragment;
+	}
+}
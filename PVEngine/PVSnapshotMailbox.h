@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace PVEngine
+{
+	// Hands the latest value from one producer thread to one consumer thread without locks or
+	// waiting. Three slots: the producer fills its own, publishing swaps it with the shared
+	// slot, and the consumer swaps its slot with the shared one when something new was
+	// published. Neither side ever touches the slot the other one holds, so a published value
+	// is immutable until the consumer lets go of it, and the producer can run ahead and
+	// overwrite values the consumer never picked up.
+	template<typename T>
+	class PVSnapshotMailbox
+	{
+	public:
+		// producer: the slot to fill, it may hold an old value that has to be overwritten completely
+		T& BeginWrite() { return slots[writeIndex].value; }
+
+		// producer: makes the slot from BeginWrite the latest value
+		void Publish()
+		{
+			uint8_t previous = shared.exchange(static_cast<uint8_t>(writeIndex | FreshBit), std::memory_order_acq_rel);
+			writeIndex = previous & IndexMask;
+		}
+
+		// consumer: takes the latest published value if there is one newer than the current, returns
+		// whether it did
+		bool Acquire()
+		{
+			if ((shared.load(std::memory_order_relaxed) & FreshBit) == 0)
+			{
+				return false;
+			}
+			uint8_t previous = shared.exchange(readIndex, std::memory_order_acq_rel);
+			readIndex = previous & IndexMask;
+			return true;
+		}
+
+		// consumer: the value taken by the last Acquire
+		const T& Read() const { return slots[readIndex].value; }
+
+	private:
+		static const uint8_t IndexMask = 3;
+		static const uint8_t FreshBit = 4;
+
+		// kept on separate cache lines, the two threads write them concurrently
+		struct alignas(64) Slot
+		{
+			T value;
+		};
+
+		Slot slots[3];
+
+		alignas(64) uint8_t writeIndex = 0;
+		alignas(64) uint8_t readIndex = 1;
+		alignas(64) std::atomic<uint8_t> shared{ 2 };
+	};
+}
@@ -0,0 +1,44 @@
+#include "PVStorageBuffer.h"
+
+#include <cstring>
+
+namespace PVEngine
+{
+	PVStorageBuffer::PVStorageBuffer(const PVDeviceContext* deviceContext, VkDeviceSize size, VkBufferUsageFlags usage, bool hostVisible)
+		: bufferSize(size)
+	{
+		VkMemoryPropertyFlags properties = hostVisible ? (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+			: VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		createBuffer(deviceContext, bufferSize, usage, properties, buffer, bufferMemory);
+
+		if (hostVisible)
+		{
+			vkMapMemory(*deviceContext->GetLogicalDevice(), bufferMemory, 0, bufferSize, 0, &mappedData);
+		}
+	}
+
+
+	PVStorageBuffer::~PVStorageBuffer()
+	{
+	}
+
+	void PVStorageBuffer::Cleanup(const VkDevice* logicalDevice)
+	{
+		if (mappedData != nullptr)
+		{
+			vkUnmapMemory(*logicalDevice, bufferMemory);
+			mappedData = nullptr;
+		}
+		cleanupBuffer(logicalDevice, buffer, bufferMemory);
+	}
+
+	void PVStorageBuffer::Write(const void* data, VkDeviceSize offset, VkDeviceSize size)
+	{
+		memcpy(static_cast<uint8_t*>(mappedData) + offset, data, static_cast<size_t>(size));
+	}
+
+	void PVStorageBuffer::Read(void* data, VkDeviceSize offset, VkDeviceSize size) const
+	{
+		memcpy(data, static_cast<const uint8_t*>(mappedData) + offset, static_cast<size_t>(size));
+	}
+}
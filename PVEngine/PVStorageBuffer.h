@@ -0,0 +1,29 @@
+#pragma once
+#include "PVBuffer.h"
+
+namespace PVEngine
+{
+	// Plain buffer for GPU written data and small host written tables. Host visible buffers stay
+	// mapped for their whole lifetime, device local ones can only be filled by commands.
+	class PVStorageBuffer : public PVBuffer
+	{
+	public:
+		PVStorageBuffer(const PVDeviceContext* deviceContext, VkDeviceSize size, VkBufferUsageFlags usage, bool hostVisible);
+		~PVStorageBuffer();
+
+		void Cleanup(const VkDevice* logicalDevice);
+
+		// host visible buffers only
+		void Write(const void* data, VkDeviceSize offset, VkDeviceSize size);
+		void Read(void* data, VkDeviceSize offset, VkDeviceSize size) const;
+
+		//Getters
+		VkDeviceSize GetSize() const { return bufferSize; }
+		void* GetMappedData() const { return mappedData; }
+
+	private:
+		VkDeviceSize bufferSize;
+
+		void* mappedData = nullptr;
+	};
+}
@@ -1,4 +1,5 @@
 #include "PVSwapchain.h"
+#include "PVHostAllocator.h"
 
 #include <algorithm>
 
@@ -14,9 +15,9 @@ namespace PVEngine
 	{
 	}
 
-	void PVSwapchain::Create(const VkDevice* logicalDevice, VkPhysicalDevice* physicalDevice, const VkSurfaceKHR* surface, Window* windowObj,SwapChainSupportDetails swapChainSupport)
+	void PVSwapchain::Create(const PVDeviceContext* deviceContext, Window* windowObj, const SwapChainSupportDetails& swapChainSupport)
 	{
-		device = logicalDevice;
+		device = deviceContext->GetLogicalDevice();
 		// use helper functions to get optimal settings
 		VkSurfaceFormatKHR surfaceFormat = ChooseSwapSurfaceFormat(swapChainSupport.formats);
 		VkPresentModeKHR presentMode = ChooseSwapPresentMode(swapChainSupport.presentModes);
@@ -25,10 +26,11 @@ namespace PVEngine
 		// fill in data fro create info
 		VkSwapchainCreateInfoKHR createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-		createInfo.surface = *surface;
+		createInfo.surface = *deviceContext->GetSurface();
 
 		// get proper image count 
-		uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+		uint32_t imageCount = requestedImageCount > 0 ? requestedImageCount : swapChainSupport.capabilities.minImageCount + 1;
+		imageCount = std::max(imageCount, swapChainSupport.capabilities.minImageCount);
 		if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount)
 		{
 			imageCount = swapChainSupport.capabilities.maxImageCount;
@@ -39,18 +41,19 @@ namespace PVEngine
 		createInfo.imageColorSpace = surfaceFormat.colorSpace;
 		createInfo.imageExtent = extent;
 		createInfo.imageArrayLayers = 1;
-		createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		// transfer destination where possible, for upscaling into the image with a blit
+		createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
 		createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		createInfo.preTransform = swapChainSupport.capabilities.currentTransform;
 		createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 		createInfo.presentMode = presentMode;
 		createInfo.clipped = VK_TRUE;
-		createInfo.oldSwapchain = VK_NULL_HANDLE;
+		createInfo.oldSwapchain = oldSwapChain;
 
 
 
 		//attempt to create swap chain
-		if (vkCreateSwapchainKHR(*logicalDevice, &createInfo, nullptr, &swapChain) != VK_SUCCESS)
+		if (vkCreateSwapchainKHR(*device, &createInfo, PVHostAllocator::Callbacks(PVAllocationType::Swapchain), &swapChain) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create swap chain");
 		}
@@ -59,14 +62,18 @@ namespace PVEngine
 			std::cout << "Swap chain created successfully" << std::endl;
 		}
 
+		oldSwapChain = VK_NULL_HANDLE;
+
 		// populate swap chain image vector
-		vkGetSwapchainImagesKHR(*logicalDevice, swapChain, &imageCount, nullptr);
+		vkGetSwapchainImagesKHR(*device, swapChain, &imageCount, nullptr);
 		swapChainImages.resize(imageCount);
-		vkGetSwapchainImagesKHR(*logicalDevice, swapChain, &imageCount, swapChainImages.data());
+		vkGetSwapchainImagesKHR(*device, swapChain, &imageCount, swapChainImages.data());
 
 		// stores data for chosen surface format and extent
 		swapChainImageFormat = surfaceFormat.format;
 		swapChainExtent = extent;
+		swapChainPresentMode = presentMode;
+		swapChainImageUsage = createInfo.imageUsage;
 
 		CreateImageViews();
 	}
@@ -75,17 +82,22 @@ namespace PVEngine
 	{
 		for (size_t i = 0; i < swapChainImageViews.size(); i++)
 		{
-			vkDestroyImageView(*device, swapChainImageViews[i], VK_NULL_HANDLE);
+			vkDestroyImageView(*device, swapChainImageViews[i], PVHostAllocator::Callbacks(PVAllocationType::ImageView));
 		}
-		vkDestroySwapchainKHR(*device, swapChain, VK_NULL_HANDLE);
+		vkDestroySwapchainKHR(*device, swapChain, PVHostAllocator::Callbacks(PVAllocationType::Swapchain));
 	}
 
-	void PVSwapchain::CleanupFramebuffers()
+	void PVSwapchain::Retire(PVDeletionQueue* deletionQueue, uint64_t retireValue)
 	{
-		for (size_t i = 0; i < swapChainFramebuffers.size(); i++)
+		for (size_t i = 0; i < swapChainImageViews.size(); i++)
 		{
-			vkDestroyFramebuffer(*device, swapChainFramebuffers[i], VK_NULL_HANDLE);
+			deletionQueue->RetireImageView(swapChainImageViews[i], retireValue);
 		}
+		deletionQueue->RetireSwapchain(swapChain, retireValue);
+
+		swapChainImageViews.clear();
+		oldSwapChain = swapChain;
+		swapChain = VK_NULL_HANDLE;
 	}
 
 	void PVSwapchain::CreateImageViews()
@@ -109,7 +121,7 @@ namespace PVEngine
 			createInfo.subresourceRange.baseArrayLayer = 0;
 			createInfo.subresourceRange.layerCount = 1;
 
-			if (vkCreateImageView(*device, &createInfo, nullptr, &swapChainImageViews[i]) != VK_SUCCESS)
+			if (vkCreateImageView(*device, &createInfo, PVHostAllocator::Callbacks(PVAllocationType::ImageView), &swapChainImageViews[i]) != VK_SUCCESS)
 			{
 				throw std::runtime_error("Failed to create image views");
 			}
@@ -118,36 +130,7 @@ namespace PVEngine
 		std::cout << "Image views created successfully" << std::endl;
 	}
 
-	void PVSwapchain::CreateFramebuffers(VkRenderPass* renderPass)
-	{
-		swapChainFramebuffers.resize(swapChainImageViews.size());
-
-		for (size_t i = 0; i < swapChainImageViews.size(); i++)
-		{
-			VkImageView attachments[] = { swapChainImageViews[i] };
-
-
-			VkFramebufferCreateInfo framebufferInfo = {};
-			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			framebufferInfo.renderPass = *renderPass;
-			framebufferInfo.attachmentCount = 1;
-			framebufferInfo.pAttachments = attachments;
-			framebufferInfo.width = swapChainExtent.width;
-			framebufferInfo.height = swapChainExtent.height;
-			framebufferInfo.layers = 1;
-
-			if (vkCreateFramebuffer(*device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS)
-			{
-				throw std::runtime_error("Failed to create framebuffer");
-			}
-		}
-
-		std::cout << "Framebuffers created successfully!" << std::endl;
-	}
-
-	
-
-	VkSurfaceFormatKHR PVSwapchain::ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats)
+	VkSurfaceFormatKHR PVSwapchain::ChooseSwapSurfaceFormat(const std::pmr::vector<VkSurfaceFormatKHR>& availableFormats)
 	{
 		// if surface has no preferred format
 		if (availableFormats.size() == 1 && availableFormats[0].format == VK_FORMAT_UNDEFINED)
@@ -167,7 +150,7 @@ namespace PVEngine
 		return availableFormats[0];
 	}
 
-	VkPresentModeKHR PVSwapchain::ChooseSwapPresentMode(const std::vector<VkPresentModeKHR> availablePresentModes)
+	VkPresentModeKHR PVSwapchain::ChooseSwapPresentMode(const std::pmr::vector<VkPresentModeKHR>& availablePresentModes)
 	{
 		/*
 		VK_PRESENT_MODE_IMMEDIATE_KHR
@@ -180,11 +163,11 @@ namespace PVEngine
 		Functions just like standard FIFO, except if the queue is empty when there is a vertical refresh, the next image that is put into the queue will be presented immediately. As a result, also can cause screen tearing.
 		*/
 
-		for (const auto& currentMode : availablePresentModes)
+		for (VkPresentModeKHR preferredMode : presentModePreference)
 		{
-			if (currentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+			if (std::find(availablePresentModes.begin(), availablePresentModes.end(), preferredMode) != availablePresentModes.end())
 			{
-				return currentMode;
+				return preferredMode;
 			}
 		}
 
@@ -2,19 +2,28 @@
 
 #include <vulkan/vulkan.h>
 #include <vector>
+#include <memory_resource>
 #include <iostream>
 #include <stdexcept>
 
 #include "Window.h"
+#include "PVDeviceContext.h"
+#include "PVDeletionQueue.h"
 
 namespace PVEngine
 {
 
+	// only needed while the swapchain is created, the lists come from the caller's memory resource
 	struct SwapChainSupportDetails
 	{
+		explicit SwapChainSupportDetails(std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+			: formats(memory), presentModes(memory)
+		{
+		}
+
 		VkSurfaceCapabilitiesKHR capabilities;
-		std::vector<VkSurfaceFormatKHR> formats;
-		std::vector<VkPresentModeKHR> presentModes;
+		std::pmr::vector<VkSurfaceFormatKHR> formats;
+		std::pmr::vector<VkPresentModeKHR> presentModes;
 	};
 
 	class PVSwapchain
@@ -23,18 +32,25 @@ namespace PVEngine
 		PVSwapchain();
 		~PVSwapchain();
 
-		void Create(const VkDevice* logicalDevice, VkPhysicalDevice* physicalDevice, const VkSurfaceKHR* surface, Window* windowObj, SwapChainSupportDetails swapChainSupport);
+		void Create(const PVDeviceContext* deviceContext, Window* windowObj, const SwapChainSupportDetails& swapChainSupport);
 		void Cleanup();
-		void CleanupFramebuffers();
 
+		// hands the image views and swapchain to the deletion queue so the swapchain can be
+		// recreated without waiting for the device to go idle
+		void Retire(PVDeletionQueue* deletionQueue, uint64_t retireValue);
 
-		VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
 
-		VkPresentModeKHR ChooseSwapPresentMode(const std::vector<VkPresentModeKHR> availablePresentModes);
+		// present modes in order of preference, FIFO is the fallback every device supports
+		void SetPresentModePreference(const std::vector<VkPresentModeKHR>& presentModes) { presentModePreference = presentModes; }
 
-		VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, Window windowObj);
+		// images to ask for, clamped to what the surface allows, 0 for one more than the minimum
+		void SetImageCount(uint32_t count) { requestedImageCount = count; }
+
+		VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::pmr::vector<VkSurfaceFormatKHR>& availableFormats);
+
+		VkPresentModeKHR ChooseSwapPresentMode(const std::pmr::vector<VkPresentModeKHR>& availablePresentModes);
 
-		void CreateFramebuffers(VkRenderPass* renderPass);
+		VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, Window windowObj);
 
 		void CreateImageViews();
 
@@ -42,22 +58,31 @@ namespace PVEngine
 		VkSwapchainKHR* GetSwapchain() { return &swapChain; }
 		VkFormat* GetImageFormat() { return &swapChainImageFormat; }
 		VkExtent2D* GetExtent() { return &swapChainExtent; }
-		size_t GetFramebufferSize() { return swapChainFramebuffers.size(); }
-		VkFramebuffer* GetFramebuffer(unsigned int index) { return &swapChainFramebuffers[index]; }
+		VkPresentModeKHR GetPresentMode() { return swapChainPresentMode; }
+		VkImageUsageFlags GetImageUsage() { return swapChainImageUsage; }
+		size_t GetImageCount() { return swapChainImages.size(); }
+		VkImage GetImage(size_t index) { return swapChainImages[index]; }
+		VkImageView GetImageView(size_t index) { return swapChainImageViews[index]; }
 
 
 	private:
 		VkSwapchainKHR swapChain;
 
+		// retired swapchain handed to the next Create as oldSwapchain
+		VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE;
+
 		std::vector<VkImage> swapChainImages;
 
 		std::vector<VkImageView> swapChainImageViews;
 
-		std::vector<VkFramebuffer> swapChainFramebuffers;
-
 		// store swap chain details
 		VkFormat swapChainImageFormat;
 		VkExtent2D swapChainExtent;
+		VkPresentModeKHR swapChainPresentMode;
+		VkImageUsageFlags swapChainImageUsage;
+
+		std::vector<VkPresentModeKHR> presentModePreference = { VK_PRESENT_MODE_MAILBOX_KHR };
+		uint32_t requestedImageCount = 0;
 
 		const VkDevice* device;
 	};
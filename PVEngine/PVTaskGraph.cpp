@@ -0,0 +1,205 @@
+#include "PVTaskGraph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <thread>
+
+namespace PVEngine
+{
+	PVTaskGraph::PVTaskGraph()
+	{
+	}
+
+
+	PVTaskGraph::~PVTaskGraph()
+	{
+	}
+
+	PVTaskGraph::TaskHandle PVTaskGraph::AddTask(const std::string& name, std::function<void()> work,
+		const std::vector<TaskHandle>& dependencies /* = {} */, bool mainThreadOnly /* = false */)
+	{
+		TaskHandle handle = static_cast<TaskHandle>(tasks.size());
+		for (TaskHandle dependency : dependencies)
+		{
+			// tasks can only depend on earlier tasks, which also rules out cycles
+			if (dependency >= handle)
+			{
+				throw std::runtime_error("Task " + name + " depends on a task that does not exist yet");
+			}
+			tasks[dependency].dependents.push_back(handle);
+		}
+
+		Task task;
+		task.name = name;
+		task.work = work;
+		task.dependencies = dependencies;
+		task.mainThreadOnly = mainThreadOnly;
+		tasks.push_back(task);
+		return handle;
+	}
+
+	double PVTaskGraph::millisecondsSinceStart() const
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - executeStart).count();
+	}
+
+	void PVTaskGraph::Execute(uint32_t workerCount)
+	{
+		readyTasks.clear();
+		readyMainThreadTasks.clear();
+		runningCount = 0;
+		completedCount = 0;
+		firstError = nullptr;
+		threadCount = workerCount + 1;
+
+		for (TaskHandle handle = 0; handle < tasks.size(); handle++)
+		{
+			Task& task = tasks[handle];
+			task.remainingDependencies = static_cast<uint32_t>(task.dependencies.size());
+			if (task.remainingDependencies == 0)
+			{
+				(task.mainThreadOnly ? readyMainThreadTasks : readyTasks).push_back(handle);
+			}
+		}
+
+		executeStart = std::chrono::steady_clock::now();
+
+		std::vector<std::thread> workers;
+		for (uint32_t i = 0; i < workerCount; i++)
+		{
+			workers.emplace_back(&PVTaskGraph::workerLoop, this, i + 1, false);
+		}
+		workerLoop(0, true);
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+
+		wallTimeMs = millisecondsSinceStart();
+
+		if (firstError)
+		{
+			std::rethrow_exception(firstError);
+		}
+	}
+
+	void PVTaskGraph::workerLoop(uint32_t threadIndex, bool mainThread)
+	{
+		std::unique_lock<std::mutex> lock(graphMutex);
+		while (true)
+		{
+			// after an error nothing new is started and the remaining tasks are abandoned
+			auto finished = [this] { return completedCount == tasks.size() || (firstError && runningCount == 0); };
+			taskReady.wait(lock, [this, mainThread, &finished]
+			{
+				bool hasWork = !firstError && (!readyTasks.empty() || (mainThread && !readyMainThreadTasks.empty()));
+				return finished() || hasWork;
+			});
+
+			if (finished())
+			{
+				return;
+			}
+
+			std::deque<TaskHandle>& queue = (mainThread && !readyMainThreadTasks.empty()) ? readyMainThreadTasks : readyTasks;
+			TaskHandle handle = queue.front();
+			queue.pop_front();
+			runningCount++;
+
+			Task& task = tasks[handle];
+			task.thread = threadIndex;
+			task.startMs = millisecondsSinceStart();
+			lock.unlock();
+
+			std::exception_ptr error;
+			try
+			{
+				task.work();
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+
+			lock.lock();
+			task.endMs = millisecondsSinceStart();
+			runningCount--;
+
+			if (error)
+			{
+				if (!firstError)
+				{
+					firstError = error;
+				}
+			}
+			else
+			{
+				completedCount++;
+				for (TaskHandle dependent : task.dependents)
+				{
+					Task& dependentTask = tasks[dependent];
+					if (--dependentTask.remainingDependencies == 0)
+					{
+						(dependentTask.mainThreadOnly ? readyMainThreadTasks : readyTasks).push_back(dependent);
+					}
+				}
+			}
+			taskReady.notify_all();
+		}
+	}
+
+	double PVTaskGraph::GetSerialTime() const
+	{
+		double total = 0.0;
+		for (const auto& task : tasks)
+		{
+			total += task.endMs - task.startMs;
+		}
+		return total;
+	}
+
+	double PVTaskGraph::GetCriticalPathTime() const
+	{
+		// tasks are stored in a valid execution order, so one pass is enough
+		std::vector<double> finish(tasks.size(), 0.0);
+		double longest = 0.0;
+		for (size_t i = 0; i < tasks.size(); i++)
+		{
+			double start = 0.0;
+			for (TaskHandle dependency : tasks[i].dependencies)
+			{
+				start = std::max(start, finish[dependency]);
+			}
+			finish[i] = start + (tasks[i].endMs - tasks[i].startMs);
+			longest = std::max(longest, finish[i]);
+		}
+		return longest;
+	}
+
+	void PVTaskGraph::PrintReport(std::ostream& stream) const
+	{
+		std::vector<TaskHandle> order(tasks.size());
+		for (TaskHandle i = 0; i < order.size(); i++)
+		{
+			order[i] = i;
+		}
+		std::sort(order.begin(), order.end(), [this](TaskHandle a, TaskHandle b)
+		{
+			return tasks[a].startMs < tasks[b].startMs;
+		});
+
+		stream << std::fixed << std::setprecision(2);
+		stream << "Startup on " << threadCount << " thread(s):" << std::endl;
+		for (TaskHandle handle : order)
+		{
+			const Task& task = tasks[handle];
+			stream << "  " << std::left << std::setw(24) << task.name << std::right << " thread " << task.thread
+				<< "  " << std::setw(9) << task.startMs << " -> " << std::setw(9) << task.endMs
+				<< " ms  (" << task.endMs - task.startMs << " ms)" << std::endl;
+		}
+		stream << "  wall " << wallTimeMs << " ms, serial sum " << GetSerialTime() << " ms, critical path "
+			<< GetCriticalPathTime() << " ms" << std::endl;
+		stream << std::defaultfloat;
+	}
+}
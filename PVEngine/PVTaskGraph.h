@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <chrono>
+
+namespace PVEngine
+{
+	// Runs a set of tasks with dependencies between them on worker threads and records when each
+	// one ran. Used to overlap the independent parts of engine startup. Tasks flagged as main
+	// thread only (window creation for GLFW) are picked up by the thread that calls Execute.
+	class PVTaskGraph
+	{
+	public:
+		typedef uint32_t TaskHandle;
+
+		PVTaskGraph();
+		~PVTaskGraph();
+
+		TaskHandle AddTask(const std::string& name, std::function<void()> work, const std::vector<TaskHandle>& dependencies = {},
+			bool mainThreadOnly = false);
+
+		// Runs every task and returns once all of them finished. With workerCount 0 everything runs
+		// serially on the calling thread. The first exception thrown by a task is rethrown here
+		// after the running tasks have finished.
+		void Execute(uint32_t workerCount);
+
+		// per task timings, the critical path and the time a serial run would have taken
+		void PrintReport(std::ostream& stream) const;
+
+		//Getters
+		double GetWallTime() const { return wallTimeMs; }
+		double GetSerialTime() const;
+		double GetCriticalPathTime() const;
+
+	private:
+		struct Task
+		{
+			std::string name;
+			std::function<void()> work;
+			std::vector<TaskHandle> dependencies;
+			std::vector<TaskHandle> dependents;
+			bool mainThreadOnly;
+
+			// filled by Execute
+			uint32_t remainingDependencies = 0;
+			uint32_t thread = 0;
+			double startMs = 0.0;
+			double endMs = 0.0;
+		};
+
+		void workerLoop(uint32_t threadIndex, bool mainThread);
+		double millisecondsSinceStart() const;
+
+		std::vector<Task> tasks;
+
+		std::mutex graphMutex;
+		std::condition_variable taskReady;
+		std::deque<TaskHandle> readyTasks;
+		std::deque<TaskHandle> readyMainThreadTasks;
+		size_t runningCount = 0;
+		size_t completedCount = 0;
+		std::exception_ptr firstError;
+
+		std::chrono::steady_clock::time_point executeStart;
+		double wallTimeMs = 0.0;
+		uint32_t threadCount = 1;
+	};
+}
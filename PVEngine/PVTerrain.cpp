@@ -0,0 +1,425 @@
+#include "PVTerrain.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace PVEngine
+{
+	PVTerrain::PVTerrain(const PVDeviceContext* deviceContext, const glm::dvec3& origin, uint32_t tilesPerSide, uint32_t tileResolution,
+		float tileSize, uint64_t seed, const std::string& cacheDirectory, uint32_t frameCount)
+		: deviceContext(deviceContext), tilesPerSide(tilesPerSide), tileResolution(tileResolution), tileSize(tileSize)
+	{
+		if (tilesPerSide == 0 || tileResolution < 2)
+		{
+			throw std::runtime_error("Terrain needs at least one tile of two vertices per side");
+		}
+
+		sampleSpacing = tileSize / (tileResolution - 1);
+		samplesPerSide = tilesPerSide * (tileResolution - 1) + 1;
+
+		heights.resize(static_cast<size_t>(samplesPerSide) * samplesPerSide, 0.0f);
+		tileCache = new PVTileCache(cacheDirectory);
+
+		// a tile is uploaded as a whole once its heights arrive
+		VkDeviceSize tileBytes = static_cast<VkDeviceSize>(tileResolution) * tileResolution * sizeof(TerrainVertex);
+		tiles.resize(static_cast<size_t>(tilesPerSide) * tilesPerSide);
+		for (uint32_t tileY = 0; tileY < tilesPerSide; tileY++)
+		{
+			for (uint32_t tileX = 0; tileX < tilesPerSide; tileX++)
+			{
+				Tile& tile = tiles[tileY * tilesPerSide + tileX];
+				tile.vertexBuffer = new PVStorageBuffer(deviceContext, tileBytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, false);
+				tileOrigins.Add(origin + glm::dvec3(tileX * static_cast<double>(tileSize), tileY * static_cast<double>(tileSize), 0.0), glm::mat3(1.0f));
+			}
+		}
+		// zw carry each tile's corner in terrain space, for texturing
+		tileConstants.resize(tiles.size());
+		for (uint32_t i = 0; i < tileConstants.size(); i++)
+		{
+			tileConstants[i].morph = glm::vec4(0.0f, 0.0f, (i % tilesPerSide) * tileSize, (i / tilesPerSide) * tileSize);
+		}
+
+		// the same grid for every tile, two triangles per cell wound like the quad
+		std::vector<uint32_t> indices;
+		for (uint32_t y = 0; y + 1 < tileResolution; y++)
+		{
+			for (uint32_t x = 0; x + 1 < tileResolution; x++)
+			{
+				uint32_t corner = y * tileResolution + x;
+				indices.insert(indices.end(), { corner, corner + 1, corner + tileResolution + 1, corner + tileResolution + 1, corner + tileResolution, corner });
+			}
+		}
+		indexCount = static_cast<uint32_t>(indices.size());
+		indexBuffer = new PVStorageBuffer(deviceContext, indices.size() * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, true);
+		indexBuffer->Write(indices.data(), 0, indices.size() * sizeof(uint32_t));
+
+		// one flat face at the finest LOD until the terrain covers a planet. The generator runs on
+		// the cache's thread, so it only captures copies
+		uint32_t resolution = tileResolution;
+		uint32_t cells = tileResolution - 1;
+		float spacing = sampleSpacing;
+		for (uint32_t tileY = 0; tileY < tilesPerSide; tileY++)
+		{
+			for (uint32_t tileX = 0; tileX < tilesPerSide; tileX++)
+			{
+				PVTileCache::Key key = { seed, 0, 0, tileX, tileY };
+				tileCache->Request(key, tileResolution, tileResolution, [=](std::vector<float>& tileHeights)
+				{
+					for (uint32_t y = 0; y < resolution; y++)
+					{
+						for (uint32_t x = 0; x < resolution; x++)
+						{
+							tileHeights[y * resolution + x] = GenerateHeight((tileX * cells + x) * spacing, (tileY * cells + y) * spacing, seed);
+						}
+					}
+				});
+			}
+		}
+		loadingTileCount = static_cast<uint32_t>(tiles.size());
+
+		for (uint32_t i = 0; i < frameCount; i++)
+		{
+			stagingBuffers.push_back(new PVStorageBuffer(deviceContext, tileBytes * tiles.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, true));
+		}
+
+		std::cout << "Terrain of " << tiles.size() << " tiles with " << tileResolution << "x" << tileResolution << " vertices" << std::endl;
+	}
+
+
+	PVTerrain::~PVTerrain()
+	{
+		delete tileCache;
+		for (auto& tile : tiles)
+		{
+			delete tile.vertexBuffer;
+		}
+		delete indexBuffer;
+		for (auto buffer : stagingBuffers)
+		{
+			delete buffer;
+		}
+	}
+
+	void PVTerrain::Cleanup()
+	{
+		tileCache->Stop();
+
+		const VkDevice* device = deviceContext->GetLogicalDevice();
+		for (auto& tile : tiles)
+		{
+			tile.vertexBuffer->Cleanup(device);
+		}
+		indexBuffer->Cleanup(device);
+		for (auto buffer : stagingBuffers)
+		{
+			buffer->Cleanup(device);
+		}
+	}
+
+	void PVTerrain::ApplyBrush(const Brush& brush)
+	{
+		std::lock_guard<std::mutex> lock(brushMutex);
+		pendingBrushes.push_back(brush);
+	}
+
+	void PVTerrain::Update(uint32_t frameIndex, const glm::dvec3& cameraPosition)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		receiveTiles();
+
+		// an edit on a tile that is still loading would be overwritten
+		if (loadingTileCount == 0)
+		{
+			std::lock_guard<std::mutex> lock(brushMutex);
+			appliedBrushes.swap(pendingBrushes);
+		}
+		for (const auto& brush : appliedBrushes)
+		{
+			applyBrush(brush);
+		}
+		brushTotal += appliedBrushes.size();
+		appliedBrushes.clear();
+
+		VkDeviceSize stagingOffset = 0;
+		VkDeviceSize tileBytes = static_cast<VkDeviceSize>(tileResolution) * tileResolution * sizeof(TerrainVertex);
+		for (uint32_t tileY = 0; tileY < tilesPerSide; tileY++)
+		{
+			for (uint32_t tileX = 0; tileX < tilesPerSide; tileX++)
+			{
+				Tile& tile = tiles[tileY * tilesPerSide + tileX];
+				tile.copies.clear();
+				for (const auto& rect : tile.dirtyRects)
+				{
+					stageRect(tile, tileX, tileY, rect, stagingBuffers[frameIndex], stagingOffset);
+				}
+				if (!tile.dirtyRects.empty())
+				{
+					tileUploadBytesTotal += tileBytes;
+				}
+				tile.dirtyRects.clear();
+				regionTotal += tile.copies.size();
+			}
+		}
+		uploadBytesTotal += stagingOffset;
+
+		tileOrigins.Compute(cameraPosition, &tileConstants[0].model, sizeof(PVDrawConstants));
+
+		updateMsTotal += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (++reportFrames == 300)
+		{
+			std::cout << "Terrain edits: " << brushTotal << " brushes, " << vertexTotal << " vertices rebuilt in " << regionTotal
+				<< " copy regions, " << uploadBytesTotal / 1024 << " KB uploaded where whole tiles would be " << tileUploadBytesTotal / 1024
+				<< " KB, " << updateMsTotal / reportFrames << " ms CPU per frame" << std::endl;
+			reportFrames = 0;
+			brushTotal = 0;
+			vertexTotal = 0;
+			regionTotal = 0;
+			uploadBytesTotal = 0;
+			tileUploadBytesTotal = 0;
+			updateMsTotal = 0.0;
+		}
+	}
+
+	void PVTerrain::RecordUpload(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+	{
+		bool anyCopies = false;
+		for (const auto& tile : tiles)
+		{
+			anyCopies = anyCopies || !tile.copies.empty();
+		}
+		if (!anyCopies)
+		{
+			return;
+		}
+
+		// earlier frames may still be reading the vertex buffers, the copies wait for their vertex input
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+		for (auto& tile : tiles)
+		{
+			if (!tile.copies.empty())
+			{
+				vkCmdCopyBuffer(commandBuffer, *stagingBuffers[frameIndex]->GetBuffer(), *tile.vertexBuffer->GetBuffer(),
+					static_cast<uint32_t>(tile.copies.size()), tile.copies.data());
+			}
+		}
+
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	void PVTerrain::RecordDraw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
+	{
+		vkCmdBindIndexBuffer(commandBuffer, *indexBuffer->GetBuffer(), 0, VK_INDEX_TYPE_UINT32);
+		VkDeviceSize offset = 0;
+		for (size_t i = 0; i < tiles.size(); i++)
+		{
+			if (!tiles[i].loaded)
+			{
+				continue;
+			}
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, tiles[i].vertexBuffer->GetBuffer(), &offset);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PVDrawConstants), &tileConstants[i]);
+			vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+		}
+	}
+
+	void PVTerrain::receiveTiles()
+	{
+		uint32_t cells = tileResolution - 1;
+		PVTileCache::Result result;
+		while (loadingTileCount > 0 && tileCache->PopResult(result))
+		{
+			uint32_t firstX = result.key.x * cells;
+			uint32_t firstY = result.key.y * cells;
+			for (uint32_t y = 0; y < tileResolution; y++)
+			{
+				memcpy(&heights[(firstY + y) * samplesPerSide + firstX], &result.heights[y * tileResolution], tileResolution * sizeof(float));
+			}
+			tiles[result.key.y * tilesPerSide + result.key.x].loaded = true;
+
+			// the neighbours' edge normals read this tile's heights too
+			uint32_t lastSample = samplesPerSide - 1;
+			markDirty(firstX > 0 ? firstX - 1 : 0, firstY > 0 ? firstY - 1 : 0, std::min(firstX + cells + 1, lastSample), std::min(firstY + cells + 1, lastSample));
+
+			if (--loadingTileCount == 0)
+			{
+				tileCache->PrintReport(std::cout);
+			}
+		}
+	}
+
+	void PVTerrain::applyBrush(const Brush& brush)
+	{
+		if (brush.radius <= 0.0f)
+		{
+			return;
+		}
+
+		int64_t lastSample = static_cast<int64_t>(samplesPerSide) - 1;
+		int64_t x0 = std::max<int64_t>(static_cast<int64_t>(std::floor((brush.center.x - brush.radius) / sampleSpacing)), 0);
+		int64_t y0 = std::max<int64_t>(static_cast<int64_t>(std::floor((brush.center.y - brush.radius) / sampleSpacing)), 0);
+		int64_t x1 = std::min<int64_t>(static_cast<int64_t>(std::ceil((brush.center.x + brush.radius) / sampleSpacing)), lastSample);
+		int64_t y1 = std::min<int64_t>(static_cast<int64_t>(std::ceil((brush.center.y + brush.radius) / sampleSpacing)), lastSample);
+		if (x0 > x1 || y0 > y1)
+		{
+			return;
+		}
+
+		for (int64_t y = y0; y <= y1; y++)
+		{
+			for (int64_t x = x0; x <= x1; x++)
+			{
+				glm::vec2 offset = glm::vec2(x * sampleSpacing, y * sampleSpacing) - brush.center;
+				float distance2 = glm::dot(offset, offset) / (brush.radius * brush.radius);
+				if (distance2 < 1.0f)
+				{
+					float falloff = 1.0f - distance2;
+					heights[y * samplesPerSide + x] += brush.height * falloff * falloff;
+				}
+			}
+		}
+
+		// the normals around the footprint read the changed heights as well
+		markDirty(static_cast<uint32_t>(std::max<int64_t>(x0 - 1, 0)), static_cast<uint32_t>(std::max<int64_t>(y0 - 1, 0)),
+			static_cast<uint32_t>(std::min(x1 + 1, lastSample)), static_cast<uint32_t>(std::min(y1 + 1, lastSample)));
+	}
+
+	void PVTerrain::markDirty(uint32_t sampleX0, uint32_t sampleY0, uint32_t sampleX1, uint32_t sampleY1)
+	{
+		uint32_t cells = tileResolution - 1;
+		for (uint32_t tileY = 0; tileY < tilesPerSide; tileY++)
+		{
+			uint32_t firstY = tileY * cells;
+			if (firstY + cells < sampleY0 || firstY > sampleY1)
+			{
+				continue;
+			}
+			for (uint32_t tileX = 0; tileX < tilesPerSide; tileX++)
+			{
+				uint32_t firstX = tileX * cells;
+				if (firstX + cells < sampleX0 || firstX > sampleX1)
+				{
+					continue;
+				}
+
+				Rect rect = { std::max(sampleX0, firstX) - firstX, std::max(sampleY0, firstY) - firstY,
+					std::min(sampleX1, firstX + cells) - firstX, std::min(sampleY1, firstY + cells) - firstY };
+
+				// overlapping rectangles are merged so no vertex is rebuilt or copied twice
+				std::vector<Rect>& rects = tiles[tileY * tilesPerSide + tileX].dirtyRects;
+				for (size_t i = 0; i < rects.size();)
+				{
+					const Rect& other = rects[i];
+					if (other.x1 < rect.x0 || rect.x1 < other.x0 || other.y1 < rect.y0 || rect.y1 < other.y0)
+					{
+						i++;
+						continue;
+					}
+					rect = { std::min(rect.x0, other.x0), std::min(rect.y0, other.y0), std::max(rect.x1, other.x1), std::max(rect.y1, other.y1) };
+					rects.erase(rects.begin() + i);
+					i = 0;
+				}
+				rects.push_back(rect);
+			}
+		}
+	}
+
+	void PVTerrain::stageRect(Tile& tile, uint32_t tileX, uint32_t tileY, const Rect& rect, PVStorageBuffer* staging, VkDeviceSize& stagingOffset)
+	{
+		uint8_t* stagingData = static_cast<uint8_t*>(staging->GetMappedData());
+		uint32_t width = rect.x1 - rect.x0 + 1;
+		VkDeviceSize rowBytes = width * sizeof(TerrainVertex);
+		uint32_t cells = tileResolution - 1;
+
+		for (uint32_t y = rect.y0; y <= rect.y1; y++)
+		{
+			TerrainVertex* destination = reinterpret_cast<TerrainVertex*>(stagingData + stagingOffset);
+			for (uint32_t x = rect.x0; x <= rect.x1; x++)
+			{
+				destination[x - rect.x0] = buildVertex(tileX * cells + x, tileY * cells + y, tileX, tileY);
+			}
+
+			// full width rows follow each other in both buffers and go out as one region
+			VkDeviceSize destinationOffset = static_cast<VkDeviceSize>(y * tileResolution + rect.x0) * sizeof(TerrainVertex);
+			if (!tile.copies.empty() && tile.copies.back().srcOffset + tile.copies.back().size == stagingOffset &&
+				tile.copies.back().dstOffset + tile.copies.back().size == destinationOffset)
+			{
+				tile.copies.back().size += rowBytes;
+			}
+			else
+			{
+				tile.copies.push_back({ stagingOffset, destinationOffset, rowBytes });
+			}
+			stagingOffset += rowBytes;
+		}
+		vertexTotal += static_cast<uint64_t>(width) * (rect.y1 - rect.y0 + 1);
+	}
+
+	TerrainVertex PVTerrain::buildVertex(uint32_t sampleX, uint32_t sampleY, uint32_t tileX, uint32_t tileY) const
+	{
+		uint32_t cells = tileResolution - 1;
+
+		TerrainVertex vertex;
+		vertex.position = glm::vec3((sampleX - tileX * cells) * sampleSpacing, (sampleY - tileY * cells) * sampleSpacing, height(sampleX, sampleY));
+
+		// central differences, from the whole terrain's heights so shared edges agree
+		float slopeX = height(static_cast<int64_t>(sampleX) + 1, sampleY) - height(static_cast<int64_t>(sampleX) - 1, sampleY);
+		float slopeY = height(sampleX, static_cast<int64_t>(sampleY) + 1) - height(sampleX, static_cast<int64_t>(sampleY) - 1);
+		vertex.normal = glm::normalize(glm::vec3(-slopeX, -slopeY, 2.0f * sampleSpacing));
+		return vertex;
+	}
+
+	float PVTerrain::GenerateHeight(float x, float y, uint64_t seed)
+	{
+		// value noise summed over many octaves, the kind of work a cache pays for
+		float result = 0.0f;
+		float amplitude = 0.12f;
+		float frequency = 0.6f;
+		for (uint32_t octave = 0; octave < 12; octave++)
+		{
+			float scaledX = x * frequency;
+			float scaledY = y * frequency;
+			float cellX = std::floor(scaledX);
+			float cellY = std::floor(scaledY);
+			float fractionX = scaledX - cellX;
+			float fractionY = scaledY - cellY;
+			fractionX = fractionX * fractionX * (3.0f - 2.0f * fractionX);
+			fractionY = fractionY * fractionY * (3.0f - 2.0f * fractionY);
+
+			int64_t latticeX = static_cast<int64_t>(cellX);
+			int64_t latticeY = static_cast<int64_t>(cellY);
+			uint64_t octaveSeed = seed + octave;
+			float bottom = glm::mix(latticeValue(latticeX, latticeY, octaveSeed), latticeValue(latticeX + 1, latticeY, octaveSeed), fractionX);
+			float top = glm::mix(latticeValue(latticeX, latticeY + 1, octaveSeed), latticeValue(latticeX + 1, latticeY + 1, octaveSeed), fractionX);
+			result += amplitude * (glm::mix(bottom, top, fractionY) * 2.0f - 1.0f);
+
+			amplitude *= 0.5f;
+			frequency *= 2.0f;
+		}
+		return result;
+	}
+
+	float PVTerrain::latticeValue(int64_t x, int64_t y, uint64_t seed)
+	{
+		uint64_t hash = seed * 0x9E3779B97F4A7C15ull ^ static_cast<uint64_t>(x) * 0xC2B2AE3D27D4EB4Full ^ static_cast<uint64_t>(y) * 0x165667B19E3779F9ull;
+		hash ^= hash >> 29;
+		hash *= 0xBF58476D1CE4E5B9ull;
+		hash ^= hash >> 32;
+		return static_cast<float>(hash >> 40) / 16777216.0f;
+	}
+
+	float PVTerrain::height(int64_t sampleX, int64_t sampleY) const
+	{
+		int64_t lastSample = static_cast<int64_t>(samplesPerSide) - 1;
+		sampleX = std::min(std::max<int64_t>(sampleX, 0), lastSample);
+		sampleY = std::min(std::max<int64_t>(sampleY, 0), lastSample);
+		return heights[sampleY * samplesPerSide + sampleX];
+	}
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "PVDeviceContext.h"
+#include "PVStorageBuffer.h"
+#include "PVCameraRelative.h"
+#include "PVDrawConstants.h"
+#include "PVVertex.h"
+#include "PVTileCache.h"
+
+namespace PVEngine
+{
+	// A square of height field tiles that can be deformed while it is drawn. Brushes change the
+	// heights under them and leave dirty rectangles on the tiles they touch. Once per frame only
+	// the vertices inside those rectangles are rebuilt and copied into the tiles' vertex buffers,
+	// one copy region per row, so an edit costs what it covers and not what the tile holds.
+	//
+	// Neighbouring tiles share their edge vertices, heights are kept in one grid for the whole
+	// terrain so both copies of an edge always agree.
+	//
+	// Tile heights are generated from the seed in the background, or loaded from a PVTileCache
+	// in cacheDirectory when an earlier run stored them. A tile is drawn once it arrives, brushes
+	// wait until every tile has.
+	class PVTerrain
+	{
+	public:
+		struct Brush
+		{
+			// terrain space, x and y from 0 to the terrain's size
+			glm::vec2 center;
+			float radius;
+			// added at the center and fading to nothing at the radius, negative digs
+			float height;
+		};
+
+		// tileResolution is vertices per tile side, tiles sit next to each other from origin on.
+		// An empty cacheDirectory generates every tile on every run
+		PVTerrain(const PVDeviceContext* deviceContext, const glm::dvec3& origin, uint32_t tilesPerSide, uint32_t tileResolution,
+			float tileSize, uint64_t seed, const std::string& cacheDirectory, uint32_t frameCount);
+		~PVTerrain();
+
+		void Cleanup();
+
+		// from any thread, the edit shows in the next frame that calls Update
+		void ApplyBrush(const Brush& brush);
+
+		// takes in the tiles that arrived, applies the brushes so far, rebuilds the dirty vertices
+		// into this frame slot's staging buffer and places the tiles relative to the camera, once
+		// the slot is free again
+		void Update(uint32_t frameIndex, const glm::dvec3& cameraPosition);
+
+		// copies the staged vertices, outside a render pass and before anything draws the terrain
+		void RecordUpload(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+		// inside the render pass with the terrain pipeline bound, layout takes PVDrawConstants
+		void RecordDraw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
+
+		// fractal noise at a point in terrain space, the same everywhere for a seed, from any thread
+		static float GenerateHeight(float x, float y, uint64_t seed);
+
+		//Getters
+		float GetSize() const { return tilesPerSide * tileSize; }
+
+	private:
+		// inclusive vertex coordinates inside one tile
+		struct Rect
+		{
+			uint32_t x0, y0, x1, y1;
+		};
+
+		struct Tile
+		{
+			PVStorageBuffer* vertexBuffer = nullptr;
+			bool loaded = false;
+			std::vector<Rect> dirtyRects;
+			// regions of this frame's upload, sources in the frame's staging buffer
+			std::vector<VkBufferCopy> copies;
+		};
+
+		void applyBrush(const Brush& brush);
+		void markDirty(uint32_t sampleX0, uint32_t sampleY0, uint32_t sampleX1, uint32_t sampleY1);
+		void stageRect(Tile& tile, uint32_t tileX, uint32_t tileY, const Rect& rect, PVStorageBuffer* staging, VkDeviceSize& stagingOffset);
+		TerrainVertex buildVertex(uint32_t sampleX, uint32_t sampleY, uint32_t tileX, uint32_t tileY) const;
+		float height(int64_t sampleX, int64_t sampleY) const;
+		void receiveTiles();
+
+		static float latticeValue(int64_t x, int64_t y, uint64_t seed);
+
+		const PVDeviceContext* deviceContext;
+
+		uint32_t tilesPerSide;
+		uint32_t tileResolution;
+		float tileSize;
+		float sampleSpacing;
+
+		// heights of the whole terrain, samplesPerSide squared
+		uint32_t samplesPerSide;
+		std::vector<float> heights;
+
+		std::vector<Tile> tiles;
+		uint32_t loadingTileCount = 0;
+
+		PVTileCache* tileCache = nullptr;
+		PVStorageBuffer* indexBuffer = nullptr;
+		uint32_t indexCount = 0;
+
+		// one per frame slot, big enough for every vertex of the terrain
+		std::vector<PVStorageBuffer*> stagingBuffers;
+
+		std::mutex brushMutex;
+		std::vector<Brush> pendingBrushes;
+		std::vector<Brush> appliedBrushes;
+
+		PVCameraRelative tileOrigins;
+		std::vector<PVDrawConstants> tileConstants;
+
+		// report totals
+		uint32_t reportFrames = 0;
+		uint64_t brushTotal = 0;
+		uint64_t vertexTotal = 0;
+		uint64_t regionTotal = 0;
+		uint64_t uploadBytesTotal = 0;
+		uint64_t tileUploadBytesTotal = 0;
+		double updateMsTotal = 0.0;
+	};
+}
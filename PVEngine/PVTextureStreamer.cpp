@@ -0,0 +1,670 @@
+#include "PVTextureStreamer.h"
+#include "PVHostAllocator.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace PVEngine
+{
+	PVTextureStreamer::PVTextureStreamer(const PVDeviceContext* deviceContext, const PVUploadContext* uploadContext, PVDeletionQueue* deletionQueue,
+		VkDeviceSize uploadBudget)
+		: deviceContext(deviceContext), device(deviceContext->GetLogicalDevice()), uploadContext(uploadContext), deletionQueue(deletionQueue),
+		uploadBudget(uploadBudget)
+	{
+		if (uploadBudget == 0)
+		{
+			throw std::runtime_error("Texture upload budget must not be zero");
+		}
+
+		for (uint32_t i = 0; i < StagingBufferCount; i++)
+		{
+			StagingBuffer staging;
+			staging.buffer = new PVStorageBuffer(deviceContext, uploadBudget, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, true);
+			stagingBuffers.push_back(staging);
+		}
+	}
+
+
+	PVTextureStreamer::~PVTextureStreamer()
+	{
+		for (auto& staging : stagingBuffers)
+		{
+			delete staging.buffer;
+		}
+	}
+
+	void PVTextureStreamer::Cleanup()
+	{
+		for (auto& texture : textures)
+		{
+			if (texture.view != VK_NULL_HANDLE)
+			{
+				vkDestroyImageView(*device, texture.view, PVHostAllocator::Callbacks(PVAllocationType::ImageView));
+			}
+			vkDestroyImage(*device, texture.image, PVHostAllocator::Callbacks(PVAllocationType::Image));
+			vkFreeMemory(*device, texture.memory, PVHostAllocator::Callbacks(PVAllocationType::Memory));
+		}
+		for (auto& staging : stagingBuffers)
+		{
+			staging.buffer->Cleanup(device);
+		}
+	}
+
+	PVTextureStreamer::TextureHandle PVTextureStreamer::Load(const std::string& filename)
+	{
+		std::ifstream file(filename, std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+		{
+			throw std::runtime_error("Failed to open texture " + filename);
+		}
+		std::vector<uint8_t> fileData(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(fileData.data()), fileData.size());
+		if (!file)
+		{
+			throw std::runtime_error("Failed to read texture " + filename);
+		}
+
+		return Load(filename, std::move(fileData));
+	}
+
+	PVTextureStreamer::TextureHandle PVTextureStreamer::Load(const std::string& name, std::vector<uint8_t> fileData)
+	{
+		PVKtx2Format::Header header;
+		if (fileData.size() < sizeof(header))
+		{
+			throw std::runtime_error("Texture " + name + " is not a KTX2 file");
+		}
+		std::memcpy(&header, fileData.data(), sizeof(header));
+		if (std::memcmp(header.identifier, PVKtx2Format::Identifier, sizeof(PVKtx2Format::Identifier)) != 0)
+		{
+			throw std::runtime_error("Texture " + name + " is not a KTX2 file");
+		}
+		if (header.supercompressionScheme != 0)
+		{
+			throw std::runtime_error("Texture " + name + " is supercompressed, only plain KTX2 data is supported");
+		}
+		if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1)
+		{
+			throw std::runtime_error("Texture " + name + " is not a 2D texture");
+		}
+
+		Texture texture;
+		texture.name = name;
+		texture.format = static_cast<VkFormat>(header.vkFormat);
+		if (!getFormatInfo(texture.format, texture.blockBytes, texture.blockSize))
+		{
+			throw std::runtime_error("Texture " + name + " has unsupported format " + std::to_string(header.vkFormat));
+		}
+		if (texture.blockSize > 1 && !deviceContext->GetFeatures().textureCompressionBC)
+		{
+			throw std::runtime_error("Texture " + name + " is block compressed, which the device doesn't support");
+		}
+
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(*deviceContext->GetPhysicalDevice(), texture.format, &formatProperties);
+		if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+		{
+			throw std::runtime_error("Texture " + name + " has a format the device can't sample");
+		}
+
+		uint32_t fullLevelCount = 1;
+		while ((std::max(header.pixelWidth, header.pixelHeight) >> fullLevelCount) > 0)
+		{
+			fullLevelCount++;
+		}
+		texture.storedLevelCount = std::max(header.levelCount, 1u);
+		if (texture.storedLevelCount > fullLevelCount)
+		{
+			throw std::runtime_error("Texture " + name + " has more levels than its size allows");
+		}
+		if (fileData.size() < sizeof(header) + texture.storedLevelCount * sizeof(PVKtx2Format::LevelIndex))
+		{
+			throw std::runtime_error("Texture " + name + " is truncated");
+		}
+
+		for (uint32_t i = 0; i < texture.storedLevelCount; i++)
+		{
+			PVKtx2Format::LevelIndex index;
+			std::memcpy(&index, fileData.data() + sizeof(header) + i * sizeof(index), sizeof(index));
+
+			Level level;
+			level.extent = { std::max(header.pixelWidth >> i, 1u), std::max(header.pixelHeight >> i, 1u) };
+			level.rowBytes = static_cast<VkDeviceSize>((level.extent.width + texture.blockSize - 1) / texture.blockSize) * texture.blockBytes;
+			level.rowCount = (level.extent.height + texture.blockSize - 1) / texture.blockSize;
+			level.fileOffset = index.byteOffset;
+			if (index.byteLength != level.rowBytes * level.rowCount || index.byteOffset + index.byteLength > fileData.size())
+			{
+				throw std::runtime_error("Texture " + name + " level " + std::to_string(i) + " doesn't match its size");
+			}
+			// a band is at least one row of blocks
+			if (level.rowBytes > uploadBudget)
+			{
+				throw std::runtime_error("Texture " + name + " has rows larger than the upload budget");
+			}
+			texture.levels.push_back(level);
+		}
+
+		// blits can't write block compressed formats, those keep only what the file stores
+		VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+			VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		bool generate = texture.storedLevelCount < fullLevelCount && (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures;
+		texture.levelCount = generate ? fullLevelCount : texture.storedLevelCount;
+		if (texture.storedLevelCount < fullLevelCount && !generate)
+		{
+			std::cout << "Texture " << name << " stores " << texture.storedLevelCount << " of " << fullLevelCount
+				<< " levels and its format can't be blitted, the rest are left out" << std::endl;
+		}
+
+		VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		if (generate)
+		{
+			usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		}
+		createImage(texture, usage);
+
+		texture.residentLevel = texture.levelCount;
+		texture.copyLevel = texture.storedLevelCount - 1;
+		texture.fileData = std::move(fileData);
+		texture.loadTime = std::chrono::steady_clock::now();
+
+		// the report covers everything streamed since the streamer was last idle
+		if (pendingLevels == 0)
+		{
+			streamStart = texture.loadTime;
+			streamMs = 0.0;
+			uploadBytesTotal = 0;
+			submitTotal = 0;
+			streamFrames = 0;
+			stalledFrames = 0;
+			generatedLevelTotal = 0;
+		}
+		pendingLevels += texture.levelCount;
+
+		textures.push_back(std::move(texture));
+		return static_cast<TextureHandle>(textures.size() - 1);
+	}
+
+	void PVTextureStreamer::Update()
+	{
+		bool copying = false;
+		for (const auto& texture : textures)
+		{
+			copying = copying || !texture.fileData.empty();
+		}
+		if (!copying)
+		{
+			return;
+		}
+
+		streamFrames++;
+		StagingBuffer& staging = stagingBuffers[nextStagingBuffer];
+		if (!uploadContext->timeline->IsComplete(staging.value))
+		{
+			stalledFrames++;
+			return;
+		}
+
+		uint8_t* stagingData = static_cast<uint8_t*>(staging.buffer->GetMappedData());
+		VkDeviceSize stagingOffset = 0;
+		std::vector<VkImageMemoryBarrier> startBarriers;
+		std::vector<VkImageMemoryBarrier> endBarriers;
+		std::vector<std::pair<VkImage, VkBufferImageCopy>> copies;
+		std::vector<CopiedLevel> finished;
+
+		const QueueFamilyIndices& indices = deviceContext->GetQueueFamilyIndices();
+		bool transferOwnership = indices.graphicsFamily != indices.transferFamily;
+
+		while (true)
+		{
+			// the smallest level still missing goes first, every texture gets its coarse levels
+			// before any of them gets its fine ones
+			TextureHandle next = 0;
+			VkDeviceSize nextBytes = 0;
+			for (TextureHandle i = 0; i < textures.size(); i++)
+			{
+				const Texture& texture = textures[i];
+				if (texture.fileData.empty())
+				{
+					continue;
+				}
+				const Level& level = texture.levels[texture.copyLevel];
+				VkDeviceSize levelBytes = level.rowBytes * level.rowCount;
+				if (nextBytes == 0 || levelBytes < nextBytes)
+				{
+					next = i;
+					nextBytes = levelBytes;
+				}
+			}
+			if (nextBytes == 0)
+			{
+				break;
+			}
+
+			Texture& texture = textures[next];
+			Level& level = texture.levels[texture.copyLevel];
+
+			// copies from a buffer start on a multiple of 4 and of the block size
+			VkDeviceSize alignment = std::max<VkDeviceSize>(texture.blockBytes, 4);
+			VkDeviceSize offset = (stagingOffset + alignment - 1) / alignment * alignment;
+			uint32_t rows = static_cast<uint32_t>(std::min<VkDeviceSize>(level.rowCount - level.rowsCopied,
+				offset < uploadBudget ? (uploadBudget - offset) / level.rowBytes : 0));
+			if (rows == 0)
+			{
+				break;
+			}
+
+			VkImageMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = texture.image;
+			barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, texture.copyLevel, 1, 0, 1 };
+			if (level.rowsCopied == 0)
+			{
+				barrier.srcAccessMask = 0;
+				barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				startBarriers.push_back(barrier);
+			}
+
+			VkDeviceSize bytes = rows * level.rowBytes;
+			std::memcpy(stagingData + offset, texture.fileData.data() + level.fileOffset + level.rowsCopied * level.rowBytes, bytes);
+
+			uint32_t y = level.rowsCopied * texture.blockSize;
+			VkBufferImageCopy region = {};
+			region.bufferOffset = offset;
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, texture.copyLevel, 0, 1 };
+			region.imageOffset = { 0, static_cast<int32_t>(y), 0 };
+			region.imageExtent = { level.extent.width, std::min(rows * texture.blockSize, level.extent.height - y), 1 };
+			copies.push_back({ texture.image, region });
+
+			stagingOffset = offset + bytes;
+			level.rowsCopied += rows;
+			if (level.rowsCopied < level.rowCount)
+			{
+				continue;
+			}
+
+			// release half of the ownership transfer, RecordAcquire records the acquire
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = 0;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			if (transferOwnership)
+			{
+				barrier.srcQueueFamilyIndex = static_cast<uint32_t>(indices.transferFamily);
+				barrier.dstQueueFamilyIndex = static_cast<uint32_t>(indices.graphicsFamily);
+			}
+			endBarriers.push_back(barrier);
+			finished.push_back({ next, texture.copyLevel, 0 });
+
+			if (texture.copyLevel == 0)
+			{
+				std::vector<uint8_t>().swap(texture.fileData);
+			}
+			else
+			{
+				texture.copyLevel--;
+			}
+		}
+		if (copies.empty())
+		{
+			return;
+		}
+
+		VkCommandBufferAllocateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		bufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		bufferInfo.commandPool = *uploadContext->commandPool;
+		bufferInfo.commandBufferCount = 1;
+		VkCommandBuffer commandBuffer;
+		vkAllocateCommandBuffers(*device, &bufferInfo, &commandBuffer);
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+		if (!startBarriers.empty())
+		{
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+				0, nullptr, 0, nullptr, static_cast<uint32_t>(startBarriers.size()), startBarriers.data());
+		}
+		for (const auto& copy : copies)
+		{
+			vkCmdCopyBufferToImage(commandBuffer, *staging.buffer->GetBuffer(), copy.first, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.second);
+		}
+		if (!endBarriers.empty())
+		{
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+				0, nullptr, 0, nullptr, static_cast<uint32_t>(endBarriers.size()), endBarriers.data());
+		}
+
+		vkEndCommandBuffer(commandBuffer);
+
+		uint64_t copyValue = uploadContext->timeline->Submit(&commandBuffer, 1, {});
+		uploadContext->deletionQueue->RetireCommandBuffers(*uploadContext->commandPool, { commandBuffer }, copyValue);
+
+		staging.value = copyValue;
+		nextStagingBuffer = (nextStagingBuffer + 1) % StagingBufferCount;
+		for (auto& level : finished)
+		{
+			level.value = copyValue;
+			copiedLevels.push_back(level);
+		}
+
+		uploadBytesTotal += stagingOffset;
+		submitTotal++;
+	}
+
+	void PVTextureStreamer::RecordAcquire(VkCommandBuffer commandBuffer, uint64_t retireValue)
+	{
+		// only copies the CPU has seen finish, waiting for them costs the graphics queue nothing
+		uint64_t completedValue = uploadContext->timeline->GetCompletedValue();
+		size_t acquiredCount = 0;
+		while (acquiredCount < copiedLevels.size() && copiedLevels[acquiredCount].value <= completedValue)
+		{
+			acquiredCount++;
+		}
+		if (acquiredCount == 0)
+		{
+			return;
+		}
+
+		const QueueFamilyIndices& indices = deviceContext->GetQueueFamilyIndices();
+		if (indices.graphicsFamily != indices.transferFamily)
+		{
+			std::vector<VkImageMemoryBarrier> acquireBarriers;
+			for (size_t i = 0; i < acquiredCount; i++)
+			{
+				const CopiedLevel& copied = copiedLevels[i];
+				VkImageMemoryBarrier barrier = {};
+				barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				barrier.srcAccessMask = 0;
+				barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+				barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				barrier.srcQueueFamilyIndex = static_cast<uint32_t>(indices.transferFamily);
+				barrier.dstQueueFamilyIndex = static_cast<uint32_t>(indices.graphicsFamily);
+				barrier.image = textures[copied.texture].image;
+				barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, copied.level, 1, 0, 1 };
+				acquireBarriers.push_back(barrier);
+			}
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+				0, nullptr, 0, nullptr, static_cast<uint32_t>(acquireBarriers.size()), acquireBarriers.data());
+		}
+
+		for (size_t i = 0; i < acquiredCount; i++)
+		{
+			const CopiedLevel& copied = copiedLevels[i];
+			Texture& texture = textures[copied.texture];
+			if (copied.level == texture.storedLevelCount - 1 && texture.levelCount > texture.storedLevelCount)
+			{
+				generateMips(commandBuffer, texture);
+				uint32_t generatedCount = texture.levelCount - texture.storedLevelCount;
+				generatedLevelTotal += generatedCount;
+				pendingLevels -= generatedCount;
+			}
+			pendingLevels--;
+			setResidentLevel(texture, copied.level, retireValue);
+			acquireValue = std::max(acquireValue, copied.value);
+		}
+		copiedLevels.erase(copiedLevels.begin(), copiedLevels.begin() + acquiredCount);
+
+		if (pendingLevels == 0)
+		{
+			streamMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - streamStart).count();
+		}
+	}
+
+	std::vector<uint8_t> PVTextureStreamer::CreateTestKtx2(uint32_t size, uint32_t levelCount)
+	{
+		uint32_t storedLevelCount = std::max(levelCount, 1u);
+
+		// no data format descriptor, the loader doesn't read one
+		PVKtx2Format::Header header = {};
+		std::memcpy(header.identifier, PVKtx2Format::Identifier, sizeof(header.identifier));
+		header.vkFormat = VK_FORMAT_R8G8B8A8_UNORM;
+		header.typeSize = 1;
+		header.pixelWidth = size;
+		header.pixelHeight = size;
+		header.faceCount = 1;
+		header.levelCount = levelCount;
+
+		std::vector<PVKtx2Format::LevelIndex> levels(storedLevelCount);
+		uint64_t dataSize = 0;
+		for (uint32_t i = 0; i < storedLevelCount; i++)
+		{
+			uint64_t levelSize = std::max(size >> i, 1u);
+			levels[i].byteLength = levelSize * levelSize * 4;
+			levels[i].uncompressedByteLength = levels[i].byteLength;
+			dataSize += levels[i].byteLength;
+		}
+
+		size_t dataStart = sizeof(header) + levels.size() * sizeof(PVKtx2Format::LevelIndex);
+		std::vector<uint8_t> fileData(dataStart + dataSize);
+
+		// coarsest level first, the way KTX2 files lay them out
+		uint64_t offset = dataStart;
+		for (uint32_t i = storedLevelCount; i-- > 0;)
+		{
+			levels[i].byteOffset = offset;
+			uint32_t levelSize = std::max(size >> i, 1u);
+			uint8_t* texel = fileData.data() + offset;
+			for (uint32_t y = 0; y < levelSize; y++)
+			{
+				for (uint32_t x = 0; x < levelSize; x++)
+				{
+					// eight checks a side over a gradient, the same picture on every level
+					bool check = (((x * 8 / levelSize) + (y * 8 / levelSize)) & 1) != 0;
+					texel[0] = static_cast<uint8_t>(x * 255 / levelSize);
+					texel[1] = static_cast<uint8_t>(y * 255 / levelSize);
+					texel[2] = check ? 255 : 64;
+					texel[3] = 255;
+					texel += 4;
+				}
+			}
+			offset += levels[i].byteLength;
+		}
+
+		std::memcpy(fileData.data(), &header, sizeof(header));
+		std::memcpy(fileData.data() + sizeof(header), levels.data(), levels.size() * sizeof(PVKtx2Format::LevelIndex));
+		return fileData;
+	}
+
+	void PVTextureStreamer::PrintReport(std::ostream& stream) const
+	{
+		if (textures.empty() || pendingLevels > 0)
+		{
+			return;
+		}
+
+		double firstLevelMs = 0.0;
+		double completeMs = 0.0;
+		for (const auto& texture : textures)
+		{
+			firstLevelMs += texture.firstLevelMs;
+			completeMs += texture.completeMs;
+		}
+
+		stream << "Texture streaming: " << textures.size() << " textures, " << uploadBytesTotal / 1024 << " KB in " << streamMs << " ms ("
+			<< (streamMs > 0.0 ? uploadBytesTotal / 1048576.0 / (streamMs / 1000.0) : 0.0) << " MB/s) over " << streamFrames << " frames and "
+			<< submitTotal << " submits at up to " << uploadBudget / 1024 << " KB a frame, " << stalledFrames << " frames waiting for staging, "
+			<< generatedLevelTotal << " levels generated on the GPU, first level after " << firstLevelMs / textures.size()
+			<< " ms, complete after " << completeMs / textures.size() << " ms on average" << std::endl;
+	}
+
+	bool PVTextureStreamer::getFormatInfo(VkFormat format, uint32_t& blockBytes, uint32_t& blockSize)
+	{
+		blockSize = 1;
+		switch (format)
+		{
+		case VK_FORMAT_R8_UNORM:
+			blockBytes = 1;
+			return true;
+		case VK_FORMAT_R8G8_UNORM:
+			blockBytes = 2;
+			return true;
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+		case VK_FORMAT_R32_SFLOAT:
+			blockBytes = 4;
+			return true;
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+			blockBytes = 8;
+			return true;
+		case VK_FORMAT_R32G32B32A32_SFLOAT:
+			blockBytes = 16;
+			return true;
+		default:
+			break;
+		}
+
+		blockSize = 4;
+		switch (format)
+		{
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+		case VK_FORMAT_BC4_SNORM_BLOCK:
+			blockBytes = 8;
+			return true;
+		case VK_FORMAT_BC2_UNORM_BLOCK:
+		case VK_FORMAT_BC2_SRGB_BLOCK:
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC5_SNORM_BLOCK:
+		case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+		case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			blockBytes = 16;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	void PVTextureStreamer::createImage(Texture& texture, VkImageUsageFlags usage)
+	{
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = texture.format;
+		imageInfo.extent = { texture.levels[0].extent.width, texture.levels[0].extent.height, 1 };
+		imageInfo.mipLevels = texture.levelCount;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = usage;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		if (vkCreateImage(*device, &imageInfo, PVHostAllocator::Callbacks(PVAllocationType::Image), &texture.image) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create texture " + texture.name);
+		}
+
+		VkMemoryRequirements requirements;
+		vkGetImageMemoryRequirements(*device, texture.image, &requirements);
+		VkMemoryAllocateInfo allocateInfo = {};
+		allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocateInfo.allocationSize = requirements.size;
+		allocateInfo.memoryTypeIndex = deviceContext->FindMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		if (vkAllocateMemory(*device, &allocateInfo, PVHostAllocator::Callbacks(PVAllocationType::Memory), &texture.memory) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate memory for texture " + texture.name);
+		}
+		vkBindImageMemory(*device, texture.image, texture.memory, 0);
+	}
+
+	void PVTextureStreamer::generateMips(VkCommandBuffer commandBuffer, const Texture& texture)
+	{
+		uint32_t sourceLevel = texture.storedLevelCount - 1;
+		VkExtent2D extent = texture.levels[0].extent;
+
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = texture.image;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, sourceLevel, 1, 0, 1 };
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		// each level from the one above it, which has just been written
+		for (uint32_t level = sourceLevel + 1; level < texture.levelCount; level++)
+		{
+			barrier.subresourceRange.baseMipLevel = level;
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+			VkImageBlit blit = {};
+			blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+			blit.srcOffsets[1] = { static_cast<int32_t>(std::max(extent.width >> (level - 1), 1u)),
+				static_cast<int32_t>(std::max(extent.height >> (level - 1), 1u)), 1 };
+			blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+			blit.dstOffsets[1] = { static_cast<int32_t>(std::max(extent.width >> level, 1u)), static_cast<int32_t>(std::max(extent.height >> level, 1u)), 1 };
+			vkCmdBlitImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				1, &blit, VK_FILTER_LINEAR);
+
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		}
+
+		barrier.subresourceRange.baseMipLevel = sourceLevel;
+		barrier.subresourceRange.levelCount = texture.levelCount - sourceLevel;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	void PVTextureStreamer::setResidentLevel(Texture& texture, uint32_t level, uint64_t retireValue)
+	{
+		// frames already submitted still sample through the old view
+		if (texture.view != VK_NULL_HANDLE)
+		{
+			deletionQueue->RetireImageView(texture.view, retireValue);
+		}
+
+		VkImageViewCreateInfo viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = texture.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = texture.format;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, texture.levelCount - level, 0, 1 };
+		if (vkCreateImageView(*device, &viewInfo, PVHostAllocator::Callbacks(PVAllocationType::ImageView), &texture.view) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create view of texture " + texture.name);
+		}
+
+		double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - texture.loadTime).count();
+		if (texture.residentLevel == texture.levelCount)
+		{
+			texture.firstLevelMs = elapsedMs;
+		}
+		if (level == 0)
+		{
+			texture.completeMs = elapsedMs;
+		}
+		texture.residentLevel = level;
+	}
+}
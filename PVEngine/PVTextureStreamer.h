@@ -0,0 +1,196 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "PVDeviceContext.h"
+#include "PVDeletionQueue.h"
+#include "PVBuffer.h"
+#include "PVStorageBuffer.h"
+
+namespace PVEngine
+{
+	// The subset of KTX2 the streamer reads: 2D textures without supercompression, in a block
+	// compressed or plain format. Everything is little endian.
+	//	Header			at offset 0
+	//	LevelIndex[]	levelCount of them right after, finest level first
+	//	level data		anywhere after that, usually coarsest first
+	namespace PVKtx2Format
+	{
+		const uint8_t Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+		struct Header
+		{
+			uint8_t identifier[12];
+			uint32_t vkFormat;
+			uint32_t typeSize;
+			uint32_t pixelWidth;
+			uint32_t pixelHeight;
+			uint32_t pixelDepth;
+			uint32_t layerCount;
+			uint32_t faceCount;
+			// 0 asks the loader to generate the mips below the one stored level
+			uint32_t levelCount;
+			uint32_t supercompressionScheme;
+			uint32_t dfdByteOffset;
+			uint32_t dfdByteLength;
+			uint32_t kvdByteOffset;
+			uint32_t kvdByteLength;
+			uint64_t sgdByteOffset;
+			uint64_t sgdByteLength;
+		};
+		static_assert(sizeof(Header) == 80, "KTX2 header must be 80 bytes");
+
+		struct LevelIndex
+		{
+			uint64_t byteOffset;
+			uint64_t byteLength;
+			uint64_t uncompressedByteLength;
+		};
+		static_assert(sizeof(LevelIndex) == 24, "KTX2 level index entries must be 24 bytes");
+	}
+
+	// Loads KTX2 textures and streams their mip levels to the GPU coarsest first, so a texture
+	// can be sampled a frame or two after it is asked for, blurry, and sharpens as the finer
+	// levels arrive. Levels are copied on the transfer queue in bands of block rows, the bytes
+	// copied per frame never exceed the budget however large a level is.
+	//
+	// Once a level's copy has finished the graphics queue takes it over and widens the texture's
+	// view to include it. Mips the file doesn't store are blitted down from the coarsest stored
+	// level on the graphics queue as soon as that arrives, for formats that can be blitted;
+	// block compressed textures stop at their last stored level.
+	//
+	// Used from the thread that draws, GetImageView changes while a texture streams in.
+	class PVTextureStreamer
+	{
+	public:
+		typedef uint32_t TextureHandle;
+
+		PVTextureStreamer(const PVDeviceContext* deviceContext, const PVUploadContext* uploadContext, PVDeletionQueue* deletionQueue,
+			VkDeviceSize uploadBudget);
+		~PVTextureStreamer();
+
+		void Cleanup();
+
+		TextureHandle Load(const std::string& filename);
+
+		// the same from a KTX2 file already in memory, name is only used in messages
+		TextureHandle Load(const std::string& name, std::vector<uint8_t> fileData);
+
+		// copies the next bands of the levels still missing, up to the upload budget, and submits
+		// them on the transfer queue
+		void Update();
+
+		// outside a render pass and before anything samples the textures, takes over the levels
+		// whose copies have finished. Views replaced here are retired against retireValue, the
+		// last graphics timeline value that may still use them.
+		void RecordAcquire(VkCommandBuffer commandBuffer, uint64_t retireValue);
+
+		// a RGBA8 KTX2 file of size squared texels with levelCount levels stored, 0 to leave the
+		// mips to the GPU, for tests and benchmarks
+		static std::vector<uint8_t> CreateTestKtx2(uint32_t size, uint32_t levelCount);
+
+		// once every texture loaded so far is complete
+		void PrintReport(std::ostream& stream) const;
+
+		//Getters
+		// null until the coarsest level has arrived. Only spans the resident levels, so sampling
+		// through it never reaches a level still streaming in
+		VkImageView GetImageView(TextureHandle texture) const { return textures[texture].view; }
+		// the finest level that can be sampled, GetLevelCount while none can
+		uint32_t GetResidentLevel(TextureHandle texture) const { return textures[texture].residentLevel; }
+		uint32_t GetLevelCount(TextureHandle texture) const { return textures[texture].levelCount; }
+		bool IsComplete(TextureHandle texture) const { return textures[texture].residentLevel == 0; }
+		bool IsIdle() const { return pendingLevels == 0; }
+		// transfer timeline value the graphics submission has to wait for before the acquires it
+		// recorded, already reached when RecordAcquire saw it
+		uint64_t GetAcquireValue() const { return acquireValue; }
+
+	private:
+		struct Level
+		{
+			VkExtent2D extent;
+			VkDeviceSize fileOffset;
+			// bytes of one row of blocks, and how many rows there are
+			VkDeviceSize rowBytes;
+			uint32_t rowCount;
+			uint32_t rowsCopied = 0;
+		};
+
+		struct Texture
+		{
+			std::string name;
+			VkFormat format;
+			// texels per block side, 1 for formats that aren't block compressed
+			uint32_t blockSize;
+			uint32_t blockBytes;
+			// stored levels come first, the generated ones follow
+			uint32_t levelCount;
+			uint32_t storedLevelCount;
+			VkImage image = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			uint32_t residentLevel;
+			// the stored level being copied, counting down to 0
+			uint32_t copyLevel;
+			std::vector<Level> levels;
+			// the file, freed once every stored level is copied
+			std::vector<uint8_t> fileData;
+			std::chrono::steady_clock::time_point loadTime;
+			double firstLevelMs = 0.0;
+			double completeMs = 0.0;
+		};
+
+		// a level whose last band went out in the submission signaling value
+		struct CopiedLevel
+		{
+			TextureHandle texture;
+			uint32_t level;
+			uint64_t value;
+		};
+
+		struct StagingBuffer
+		{
+			PVStorageBuffer* buffer;
+			// transfer timeline value of the submission last reading it
+			uint64_t value = 0;
+		};
+
+		// keeps one buffer free while two submissions are in flight
+		static const uint32_t StagingBufferCount = 3;
+
+		static bool getFormatInfo(VkFormat format, uint32_t& blockBytes, uint32_t& blockSize);
+		void createImage(Texture& texture, VkImageUsageFlags usage);
+		// from the coarsest stored level, which must be in SHADER_READ_ONLY_OPTIMAL
+		void generateMips(VkCommandBuffer commandBuffer, const Texture& texture);
+		void setResidentLevel(Texture& texture, uint32_t level, uint64_t retireValue);
+
+		const PVDeviceContext* deviceContext;
+		const VkDevice* device;
+		const PVUploadContext* uploadContext;
+		PVDeletionQueue* deletionQueue;
+
+		VkDeviceSize uploadBudget;
+		std::vector<StagingBuffer> stagingBuffers;
+		uint32_t nextStagingBuffer = 0;
+
+		std::vector<Texture> textures;
+		// levels not yet resident, stored or generated
+		uint32_t pendingLevels = 0;
+		std::vector<CopiedLevel> copiedLevels;
+		uint64_t acquireValue = 0;
+
+		// report totals, since the first texture that is still streaming was loaded
+		std::chrono::steady_clock::time_point streamStart;
+		double streamMs = 0.0;
+		uint64_t uploadBytesTotal = 0;
+		uint32_t submitTotal = 0;
+		uint32_t streamFrames = 0;
+		uint32_t stalledFrames = 0;
+		uint32_t generatedLevelTotal = 0;
+	};
+}
@@ -0,0 +1,390 @@
+#include "PVTileCache.h"
+#include "PVAssetPack.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+namespace PVEngine
+{
+	PVTileCache::PVTileCache(const std::string& directory)
+		: directory(directory)
+	{
+		worker = std::thread(&PVTileCache::workerLoop, this);
+	}
+
+
+	PVTileCache::~PVTileCache()
+	{
+		Stop();
+	}
+
+	void PVTileCache::Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			requests.clear();
+		}
+		wakeUp.notify_all();
+		if (worker.joinable())
+		{
+			worker.join();
+		}
+	}
+
+	void PVTileCache::Request(const Key& key, uint32_t width, uint32_t height, Generator generator)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			requests.push_back({ key, width, height, generator });
+		}
+		wakeUp.notify_one();
+	}
+
+	bool PVTileCache::PopResult(Result& result)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (results.empty())
+		{
+			return false;
+		}
+		result = std::move(results.front());
+		results.pop_front();
+		return true;
+	}
+
+	void PVTileCache::PrintReport(std::ostream& stream) const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		uint32_t total = hitCount + missCount;
+		if (total == 0)
+		{
+			return;
+		}
+
+		stream << "Tile cache: " << hitCount << " of " << total << " tiles loaded (" << 100.0 * hitCount / total << "% hits)";
+		if (storedBytes > 0)
+		{
+			stream << ", " << storedBytes / 1024 << " KB on disk for " << rawBytes / 1024 << " KB of heights ("
+				<< static_cast<double>(rawBytes) / storedBytes << ":1)";
+		}
+		if (hitCount > 0)
+		{
+			stream << ", load " << loadMsTotal / hitCount << " ms";
+		}
+		stream << ", generate " << generateMsTotal / total << " ms per tile" << std::endl;
+	}
+
+	void PVTileCache::Encode(const std::vector<int32_t>& values, uint32_t width, uint32_t height, std::vector<uint8_t>& encoded)
+	{
+		const uint32_t blockSize = 64;
+		encoded.clear();
+
+		uint32_t residuals[blockSize];
+		size_t count = static_cast<size_t>(width) * height;
+		for (size_t first = 0; first < count; first += blockSize)
+		{
+			uint32_t blockCount = static_cast<uint32_t>(std::min<size_t>(blockSize, count - first));
+			uint32_t combined = 0;
+			for (uint32_t i = 0; i < blockCount; i++)
+			{
+				size_t index = first + i;
+				uint32_t x = static_cast<uint32_t>(index % width);
+				uint32_t y = static_cast<uint32_t>(index / width);
+
+				// smooth terrain is close to a plane locally, which left + up - upper left predicts exactly
+				int64_t prediction = 0;
+				if (x > 0 && y > 0)
+				{
+					prediction = static_cast<int64_t>(values[index - 1]) + values[index - width] - values[index - width - 1];
+				}
+				else if (x > 0)
+				{
+					prediction = values[index - 1];
+				}
+				else if (y > 0)
+				{
+					prediction = values[index - width];
+				}
+				int32_t residual = static_cast<int32_t>(values[index] - prediction);
+
+				// zigzag, small negative residuals become small numbers as well
+				residuals[i] = (static_cast<uint32_t>(residual) << 1) ^ static_cast<uint32_t>(residual >> 31);
+				combined |= residuals[i];
+			}
+
+			uint8_t bits = 0;
+			while (bits < 32 && (combined >> bits) != 0)
+			{
+				bits++;
+			}
+			encoded.push_back(bits);
+
+			uint64_t pending = 0;
+			uint32_t pendingBits = 0;
+			for (uint32_t i = 0; i < blockCount; i++)
+			{
+				pending |= static_cast<uint64_t>(residuals[i]) << pendingBits;
+				pendingBits += bits;
+				while (pendingBits >= 8)
+				{
+					encoded.push_back(static_cast<uint8_t>(pending));
+					pending >>= 8;
+					pendingBits -= 8;
+				}
+			}
+			if (pendingBits > 0)
+			{
+				encoded.push_back(static_cast<uint8_t>(pending));
+			}
+		}
+	}
+
+	bool PVTileCache::Decode(const uint8_t* encoded, size_t encodedSize, uint32_t width, uint32_t height, std::vector<int32_t>& values)
+	{
+		const uint32_t blockSize = 64;
+		size_t count = static_cast<size_t>(width) * height;
+		values.resize(count);
+
+		size_t position = 0;
+		for (size_t first = 0; first < count; first += blockSize)
+		{
+			uint32_t blockCount = static_cast<uint32_t>(std::min<size_t>(blockSize, count - first));
+			if (position >= encodedSize)
+			{
+				return false;
+			}
+			uint32_t bits = encoded[position++];
+			size_t blockBytes = (static_cast<size_t>(bits) * blockCount + 7) / 8;
+			if (bits > 32 || encodedSize - position < blockBytes)
+			{
+				return false;
+			}
+
+			uint64_t pending = 0;
+			uint32_t pendingBits = 0;
+			uint64_t mask = (bits == 32) ? 0xFFFFFFFFull : ((1ull << bits) - 1);
+			for (uint32_t i = 0; i < blockCount; i++)
+			{
+				while (pendingBits < bits)
+				{
+					pending |= static_cast<uint64_t>(encoded[position++]) << pendingBits;
+					pendingBits += 8;
+				}
+				uint32_t zigzag = static_cast<uint32_t>(pending & mask);
+				pending >>= bits;
+				pendingBits -= bits;
+				int32_t residual = static_cast<int32_t>(zigzag >> 1) ^ -static_cast<int32_t>(zigzag & 1);
+
+				size_t index = first + i;
+				uint32_t x = static_cast<uint32_t>(index % width);
+				uint32_t y = static_cast<uint32_t>(index / width);
+				int64_t prediction = 0;
+				if (x > 0 && y > 0)
+				{
+					prediction = static_cast<int64_t>(values[index - 1]) + values[index - width] - values[index - width - 1];
+				}
+				else if (x > 0)
+				{
+					prediction = values[index - 1];
+				}
+				else if (y > 0)
+				{
+					prediction = values[index - width];
+				}
+				values[index] = static_cast<int32_t>(prediction + residual);
+			}
+		}
+		return position == encodedSize;
+	}
+
+	void PVTileCache::workerLoop()
+	{
+		while (true)
+		{
+			PendingRequest request;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wakeUp.wait(lock, [this] { return stopping || !requests.empty(); });
+				if (stopping)
+				{
+					return;
+				}
+				request = std::move(requests.front());
+				requests.pop_front();
+			}
+
+			std::vector<int32_t> quantized;
+			float generateMs = 0.0f;
+			auto start = std::chrono::steady_clock::now();
+			bool hit = load(request, quantized, generateMs);
+			double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			if (!hit)
+			{
+				std::vector<float> heights(static_cast<size_t>(request.width) * request.height);
+				start = std::chrono::steady_clock::now();
+				request.generator(heights);
+				generateMs = static_cast<float>(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+				quantized.resize(heights.size());
+				for (size_t i = 0; i < heights.size(); i++)
+				{
+					quantized[i] = static_cast<int32_t>(std::lround(heights[i] / PVTileFormat::QuantizationStep));
+				}
+				store(request, quantized, generateMs);
+			}
+
+			Result result;
+			result.key = request.key;
+			result.hit = hit;
+			result.heights.resize(quantized.size());
+			for (size_t i = 0; i < quantized.size(); i++)
+			{
+				result.heights[i] = quantized[i] * PVTileFormat::QuantizationStep;
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (hit)
+			{
+				hitCount++;
+				loadMsTotal += elapsedMs;
+			}
+			else
+			{
+				missCount++;
+			}
+			generateMsTotal += generateMs;
+			results.push_back(std::move(result));
+		}
+	}
+
+	std::string PVTileCache::pathFor(const Key& key) const
+	{
+		// FNV-1a of the key, the first byte picks a subdirectory so none grows too large
+		uint64_t hash = 0xcbf29ce484222325ull;
+		auto mix = [&hash](uint64_t value, uint32_t bytes)
+		{
+			for (uint32_t i = 0; i < bytes; i++)
+			{
+				hash ^= (value >> (i * 8)) & 0xFF;
+				hash *= 0x100000001b3ull;
+			}
+		};
+		mix(key.seed, 8);
+		mix(key.face, 4);
+		mix(key.lod, 4);
+		mix(key.x, 4);
+		mix(key.y, 4);
+
+		char name[17];
+		snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+		return (std::filesystem::path(directory) / std::string(name, 2) / (std::string(name) + ".pvtile")).string();
+	}
+
+	bool PVTileCache::load(const PendingRequest& request, std::vector<int32_t>& quantized, float& generateMs)
+	{
+		if (directory.empty())
+		{
+			return false;
+		}
+
+		std::string path = pathFor(request.key);
+		std::error_code error;
+		if (!std::filesystem::exists(path, error))
+		{
+			return false;
+		}
+
+		// a damaged or foreign file is a miss, the tile is generated and the file replaced
+		try
+		{
+			PVAssetPack pack;
+			pack.Open(path);
+
+			const PVPackFormat::TocEntry& headerEntry = pack.Require("header", PVPackFormat::BlobType::Raw, 1);
+			const PVPackFormat::TocEntry& heightsEntry = pack.Require("heights", PVPackFormat::BlobType::Raw, 1);
+			if (headerEntry.size != sizeof(PVTileFormat::TileHeader))
+			{
+				return false;
+			}
+
+			PVTileFormat::TileHeader header;
+			memcpy(&header, pack.GetData(headerEntry), sizeof(header));
+			if (header.magic != PVTileFormat::Magic || header.version != PVTileFormat::Version || header.seed != request.key.seed
+				|| header.face != request.key.face || header.lod != request.key.lod || header.x != request.key.x || header.y != request.key.y
+				|| header.width != request.width || header.height != request.height)
+			{
+				return false;
+			}
+
+			if (!Decode(static_cast<const uint8_t*>(pack.GetData(heightsEntry)), static_cast<size_t>(heightsEntry.size), header.width, header.height, quantized))
+			{
+				return false;
+			}
+			generateMs = header.generateMs;
+
+			std::lock_guard<std::mutex> lock(mutex);
+			rawBytes += quantized.size() * sizeof(float);
+			storedBytes += heightsEntry.size;
+			return true;
+		}
+		catch (const std::runtime_error&)
+		{
+			return false;
+		}
+	}
+
+	void PVTileCache::store(const PendingRequest& request, const std::vector<int32_t>& quantized, float generateMs)
+	{
+		if (directory.empty())
+		{
+			return;
+		}
+
+		PVTileFormat::TileHeader header = {};
+		header.magic = PVTileFormat::Magic;
+		header.version = PVTileFormat::Version;
+		header.seed = request.key.seed;
+		header.face = request.key.face;
+		header.lod = request.key.lod;
+		header.x = request.key.x;
+		header.y = request.key.y;
+		header.width = request.width;
+		header.height = request.height;
+		header.generateMs = generateMs;
+
+		std::vector<uint8_t> encoded;
+		Encode(quantized, request.width, request.height, encoded);
+
+		// written next to the final name and renamed, a reader never sees half a file
+		std::string path = pathFor(request.key);
+		std::string temporaryPath = path + ".tmp";
+		try
+		{
+			std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+
+			PVAssetPackWriter writer;
+			writer.Open(temporaryPath);
+			writer.AddBlob("header", PVPackFormat::BlobType::Raw, 1, &header, sizeof(header));
+			writer.AddBlob("heights", PVPackFormat::BlobType::Raw, 1, encoded.data(), encoded.size());
+			writer.Finish();
+
+			std::filesystem::rename(temporaryPath, path);
+		}
+		catch (const std::exception& e)
+		{
+			// the tile is still served, only the next run has to generate it again
+			std::cout << "Tile cache couldn't store " << path << ": " << e.what() << std::endl;
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		rawBytes += quantized.size() * sizeof(float);
+		storedBytes += encoded.size();
+	}
+}
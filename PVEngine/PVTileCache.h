@@ -0,0 +1,125 @@
+#pragma once
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace PVEngine
+{
+	// On disk layout of a cached tile, a .pvpack with two raw blobs. Everything is little endian.
+	//	"header"	TileHeader
+	//	"heights"	the quantized heights, predicted from their neighbours and bit packed
+	namespace PVTileFormat
+	{
+		const uint32_t Magic = 0x4C545650; // "PVTL"
+		const uint32_t Version = 1;
+
+		// heights are stored in steps of 1/65536, far below anything a vertex shows
+		const float QuantizationStep = 1.0f / 65536.0f;
+
+		struct TileHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint64_t seed;
+			uint32_t face;
+			uint32_t lod;
+			uint32_t x;
+			uint32_t y;
+			uint32_t width;
+			uint32_t height;
+			// what generating the tile took when it was stored, for the report
+			float generateMs;
+			uint32_t reserved;
+		};
+
+		static_assert(sizeof(TileHeader) == 48, "tile header layout changed");
+	}
+
+	// Persistent cache of generated terrain tiles. Tiles are found by a hash of everything that
+	// determines their contents, seed, cube face, LOD and tile coordinates, so a file never needs
+	// invalidating: a different planet or LOD is simply a different file.
+	//
+	// Requests are served by a worker thread of its own. A hit maps the file and decodes it, a
+	// miss runs the generator, hands the result back and writes it out for the next run. Either
+	// way the heights come back quantized, so a tile looks the same whether it was loaded or
+	// generated. With no directory every request is a miss and nothing is written.
+	class PVTileCache
+	{
+	public:
+		struct Key
+		{
+			uint64_t seed;
+			uint32_t face;
+			uint32_t lod;
+			uint32_t x;
+			uint32_t y;
+		};
+
+		struct Result
+		{
+			Key key;
+			std::vector<float> heights;
+			bool hit;
+		};
+
+		// fills width * height heights, row by row, on the cache's worker thread
+		typedef std::function<void(std::vector<float>& heights)> Generator;
+
+		PVTileCache(const std::string& directory);
+		~PVTileCache();
+
+		// waits for the request being served and drops the rest
+		void Stop();
+
+		void Request(const Key& key, uint32_t width, uint32_t height, Generator generator);
+
+		// false while nothing has finished since the last call
+		bool PopResult(Result& result);
+
+		void PrintReport(std::ostream& stream) const;
+
+		// the codec on its own: each value is predicted from its left, upper and upper left
+		// neighbours, the zigzagged residuals are bit packed in blocks of 64 with one width each
+		static void Encode(const std::vector<int32_t>& values, uint32_t width, uint32_t height, std::vector<uint8_t>& encoded);
+		static bool Decode(const uint8_t* encoded, size_t encodedSize, uint32_t width, uint32_t height, std::vector<int32_t>& values);
+
+	private:
+		struct PendingRequest
+		{
+			Key key;
+			uint32_t width;
+			uint32_t height;
+			Generator generator;
+		};
+
+		void workerLoop();
+		std::string pathFor(const Key& key) const;
+		bool load(const PendingRequest& request, std::vector<int32_t>& quantized, float& generateMs);
+		void store(const PendingRequest& request, const std::vector<int32_t>& quantized, float generateMs);
+
+		std::string directory;
+
+		std::thread worker;
+		mutable std::mutex mutex;
+		std::condition_variable wakeUp;
+		std::deque<PendingRequest> requests;
+		std::deque<Result> results;
+		bool stopping = false;
+
+		// report totals, written by the worker under the mutex
+		uint32_t hitCount = 0;
+		uint32_t missCount = 0;
+		uint64_t rawBytes = 0;
+		uint64_t storedBytes = 0;
+		double loadMsTotal = 0.0;
+		// generating misses, and what the hits took to generate when they were stored
+		double generateMsTotal = 0.0;
+	};
+}
@@ -0,0 +1,136 @@
+#include "PVTimeline.h"
+#include "PVHostAllocator.h"
+
+namespace PVEngine
+{
+	PVTimeline::PVTimeline(const VkDevice* logicalDevice, VkQueue queue)
+		: device(logicalDevice), queue(queue)
+	{
+		getSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(*device, "vkGetSemaphoreCounterValueKHR");
+		waitSemaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(*device, "vkWaitSemaphoresKHR");
+		if (getSemaphoreCounterValue == nullptr || waitSemaphores == nullptr)
+		{
+			throw std::runtime_error("Timeline semaphore functions not available");
+		}
+
+		VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo = {};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &typeInfo;
+
+		if (vkCreateSemaphore(*device, &semaphoreInfo, PVHostAllocator::Callbacks(PVAllocationType::Sync), &semaphore) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create timeline semaphore");
+		}
+		else
+		{
+			std::cout << "Timeline semaphore created successfully" << std::endl;
+		}
+	}
+
+
+	PVTimeline::~PVTimeline()
+	{
+	}
+
+	void PVTimeline::Cleanup()
+	{
+		vkDestroySemaphore(*device, semaphore, PVHostAllocator::Callbacks(PVAllocationType::Sync));
+	}
+
+	uint64_t PVTimeline::Submit(const VkCommandBuffer* commandBuffers, uint32_t commandBufferCount, const std::pmr::vector<WaitPoint>& waitPoints,
+		VkSemaphore binaryWaitSemaphore /* = VK_NULL_HANDLE */, VkPipelineStageFlags binaryWaitStage /* = 0 */,
+		VkSemaphore binarySignalSemaphore /* = VK_NULL_HANDLE */)
+	{
+		// submissions come from more than one thread, so the lists live on the stack rather than
+		// in a frame arena, the heap is only touched for unusually long wait lists
+		uint8_t scratch[512];
+		std::pmr::monotonic_buffer_resource scratchMemory(scratch, sizeof(scratch));
+		std::pmr::vector<VkSemaphore> waitSemaphoreList(&scratchMemory);
+		std::pmr::vector<uint64_t> waitValues(&scratchMemory);
+		std::pmr::vector<VkPipelineStageFlags> waitStages(&scratchMemory);
+		waitSemaphoreList.reserve(waitPoints.size() + 1);
+		waitValues.reserve(waitPoints.size() + 1);
+		waitStages.reserve(waitPoints.size() + 1);
+		for (const auto& waitPoint : waitPoints)
+		{
+			waitSemaphoreList.push_back(waitPoint.timeline->GetSemaphore());
+			waitValues.push_back(waitPoint.value);
+			waitStages.push_back(waitPoint.stageMask);
+		}
+		if (binaryWaitSemaphore != VK_NULL_HANDLE)
+		{
+			// the value is ignored for binary semaphores
+			waitSemaphoreList.push_back(binaryWaitSemaphore);
+			waitValues.push_back(0);
+			waitStages.push_back(binaryWaitStage);
+		}
+
+		std::lock_guard<std::mutex> lock(submitMutex);
+		uint64_t signalValue = lastSubmittedValue + 1;
+
+		VkSemaphore signalSemaphoreList[] = { semaphore, binarySignalSemaphore };
+		uint64_t signalValues[] = { signalValue, 0 };
+		uint32_t signalCount = (binarySignalSemaphore != VK_NULL_HANDLE) ? 2 : 1;
+
+		VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+		timelineInfo.pWaitSemaphoreValues = waitValues.data();
+		timelineInfo.signalSemaphoreValueCount = signalCount;
+		timelineInfo.pSignalSemaphoreValues = signalValues;
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphoreList.size());
+		submitInfo.pWaitSemaphores = waitSemaphoreList.data();
+		submitInfo.pWaitDstStageMask = waitStages.data();
+		submitInfo.commandBufferCount = commandBufferCount;
+		submitInfo.pCommandBuffers = commandBuffers;
+		submitInfo.signalSemaphoreCount = signalCount;
+		submitInfo.pSignalSemaphores = signalSemaphoreList;
+
+		if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to submit to timeline queue");
+		}
+
+		lastSubmittedValue = signalValue;
+		return signalValue;
+	}
+
+	uint64_t PVTimeline::GetCompletedValue() const
+	{
+		uint64_t value = 0;
+		if (getSemaphoreCounterValue(*device, semaphore, &value) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to read timeline semaphore value");
+		}
+		return value;
+	}
+
+	void PVTimeline::Wait(uint64_t value) const
+	{
+		VkSemaphoreWaitInfoKHR waitInfo = {};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &semaphore;
+		waitInfo.pValues = &value;
+
+		if (waitSemaphores(*device, &waitInfo, UINT64_MAX) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to wait on timeline semaphore");
+		}
+	}
+
+	uint64_t PVTimeline::GetLastSubmittedValue() const
+	{
+		std::lock_guard<std::mutex> lock(submitMutex);
+		return lastSubmittedValue;
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <stdexcept>
+#include <mutex>
+#include <vector>
+#include <memory_resource>
+
+namespace PVEngine
+{
+	// Wraps a queue together with a VK_KHR_timeline_semaphore whose value increases by one on
+	// every submission. Other queues can wait on any value it has handed out and the CPU can
+	// poll or block on it, which replaces per-submission fences and queue idle waits.
+	class PVTimeline
+	{
+	public:
+		// a timeline value some other submission has to reach before this one starts
+		struct WaitPoint
+		{
+			const PVTimeline* timeline;
+			uint64_t value;
+			VkPipelineStageFlags stageMask;
+		};
+
+		PVTimeline(const VkDevice* logicalDevice, VkQueue queue);
+		~PVTimeline();
+
+		void Cleanup();
+
+		// Submits the command buffers and returns the timeline value they signal on completion.
+		// Binary semaphores are only meant for swapchain acquire and present.
+		uint64_t Submit(const VkCommandBuffer* commandBuffers, uint32_t commandBufferCount, const std::pmr::vector<WaitPoint>& waitPoints,
+			VkSemaphore binaryWaitSemaphore = VK_NULL_HANDLE, VkPipelineStageFlags binaryWaitStage = 0,
+			VkSemaphore binarySignalSemaphore = VK_NULL_HANDLE);
+
+		// highest value the GPU has finished
+		uint64_t GetCompletedValue() const;
+
+		bool IsComplete(uint64_t value) const { return value <= GetCompletedValue(); }
+
+		// blocks the calling thread until the GPU has reached value
+		void Wait(uint64_t value) const;
+
+		// blocks until everything submitted so far has finished
+		void WaitIdle() const { Wait(GetLastSubmittedValue()); }
+
+		//Getters
+		VkSemaphore GetSemaphore() const { return semaphore; }
+		VkQueue GetQueue() const { return queue; }
+		uint64_t GetLastSubmittedValue() const;
+
+	private:
+		const VkDevice* device;
+
+		VkQueue queue;
+
+		VkSemaphore semaphore;
+
+		// value signaled by the most recent submission, guarded by submitMutex
+		uint64_t lastSubmittedValue = 0;
+
+		// vkQueueSubmit needs the queue externally synchronized
+		mutable std::mutex submitMutex;
+
+		PFN_vkGetSemaphoreCounterValueKHR getSemaphoreCounterValue;
+		PFN_vkWaitSemaphoresKHR waitSemaphores;
+	};
+}
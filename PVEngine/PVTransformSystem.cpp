@@ -0,0 +1,348 @@
+#include "PVTransformSystem.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace PVEngine
+{
+	PVTransformSystem::PVTransformSystem()
+	{
+	}
+
+
+	PVTransformSystem::~PVTransformSystem()
+	{
+	}
+
+	uint32_t PVTransformSystem::Add(uint32_t parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+	{
+		if (parent != NO_PARENT && parent >= nodeCount)
+		{
+			throw std::runtime_error("Transform parents have to be added before their children");
+		}
+
+		if (nodeCount == positionX.size())
+		{
+			grow();
+		}
+
+		uint32_t index = nodeCount++;
+		positionX[index] = position.x;
+		positionY[index] = position.y;
+		positionZ[index] = position.z;
+		rotationX[index] = rotation.x;
+		rotationY[index] = rotation.y;
+		rotationZ[index] = rotation.z;
+		rotationW[index] = rotation.w;
+		scaleX[index] = scale.x;
+		scaleY[index] = scale.y;
+		scaleZ[index] = scale.z;
+		parents[index] = parent;
+		dirty[index] = 1;
+		world.push_back(glm::mat4(1.0f));
+		return index;
+	}
+
+	void PVTransformSystem::Clear()
+	{
+		nodeCount = 0;
+		for (auto* values : { &positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ, &rotationW, &scaleX, &scaleY, &scaleZ })
+		{
+			values->clear();
+		}
+		for (auto& values : local)
+		{
+			values.clear();
+		}
+		parents.clear();
+		dirty.clear();
+		worldChanged.clear();
+		world.clear();
+	}
+
+	void PVTransformSystem::SetPosition(uint32_t index, const glm::vec3& position)
+	{
+		positionX[index] = position.x;
+		positionY[index] = position.y;
+		positionZ[index] = position.z;
+		dirty[index] = 1;
+	}
+
+	void PVTransformSystem::SetRotation(uint32_t index, const glm::quat& rotation)
+	{
+		rotationX[index] = rotation.x;
+		rotationY[index] = rotation.y;
+		rotationZ[index] = rotation.z;
+		rotationW[index] = rotation.w;
+		dirty[index] = 1;
+	}
+
+	void PVTransformSystem::SetScale(uint32_t index, const glm::vec3& scale)
+	{
+		scaleX[index] = scale.x;
+		scaleY[index] = scale.y;
+		scaleZ[index] = scale.z;
+		dirty[index] = 1;
+	}
+
+	uint32_t PVTransformSystem::Update()
+	{
+		// a block of four is rebuilt whole if any of its nodes changed, that is no slower than one
+		for (uint32_t first = 0; first < nodeCount; first += 4)
+		{
+			uint32_t blockDirty;
+			memcpy(&blockDirty, &dirty[first], sizeof(blockDirty));
+			if (blockDirty != 0)
+			{
+				computeLocal(first);
+			}
+		}
+
+		uint32_t updated = 0;
+		for (uint32_t i = 0; i < nodeCount; i++)
+		{
+			uint32_t parent = parents[i];
+			if (!dirty[i] && (parent == NO_PARENT || !worldChanged[parent]))
+			{
+				worldChanged[i] = 0;
+				continue;
+			}
+
+			__m128 column0 = _mm_setr_ps(local[0][i], local[1][i], local[2][i], 0.0f);
+			__m128 column1 = _mm_setr_ps(local[3][i], local[4][i], local[5][i], 0.0f);
+			__m128 column2 = _mm_setr_ps(local[6][i], local[7][i], local[8][i], 0.0f);
+			__m128 column3 = _mm_setr_ps(local[9][i], local[10][i], local[11][i], 1.0f);
+
+			float* result = &world[i][0][0];
+			if (parent == NO_PARENT)
+			{
+				_mm_storeu_ps(result, column0);
+				_mm_storeu_ps(result + 4, column1);
+				_mm_storeu_ps(result + 8, column2);
+				_mm_storeu_ps(result + 12, column3);
+			}
+			else
+			{
+				// parent * local, the local matrix is affine so its last row is known
+				const float* parentWorld = &world[parent][0][0];
+				__m128 parent0 = _mm_loadu_ps(parentWorld);
+				__m128 parent1 = _mm_loadu_ps(parentWorld + 4);
+				__m128 parent2 = _mm_loadu_ps(parentWorld + 8);
+				__m128 parent3 = _mm_loadu_ps(parentWorld + 12);
+				const __m128 columns[4] = { column0, column1, column2, column3 };
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					__m128 sum = _mm_add_ps(
+						_mm_add_ps(_mm_mul_ps(parent0, _mm_shuffle_ps(columns[c], columns[c], _MM_SHUFFLE(0, 0, 0, 0))),
+							_mm_mul_ps(parent1, _mm_shuffle_ps(columns[c], columns[c], _MM_SHUFFLE(1, 1, 1, 1)))),
+						_mm_mul_ps(parent2, _mm_shuffle_ps(columns[c], columns[c], _MM_SHUFFLE(2, 2, 2, 2))));
+					if (c == 3)
+					{
+						sum = _mm_add_ps(sum, parent3);
+					}
+					_mm_storeu_ps(result + c * 4, sum);
+				}
+			}
+
+			worldChanged[i] = 1;
+			dirty[i] = 0;
+			updated++;
+		}
+		return updated;
+	}
+
+	void PVTransformSystem::WriteMatrices(const glm::mat4& transform, void* destination, size_t stride) const
+	{
+		const float* transformColumns = &transform[0][0];
+		__m128 transform0 = _mm_loadu_ps(transformColumns);
+		__m128 transform1 = _mm_loadu_ps(transformColumns + 4);
+		__m128 transform2 = _mm_loadu_ps(transformColumns + 8);
+		__m128 transform3 = _mm_loadu_ps(transformColumns + 12);
+
+		// written in order one whole matrix at a time, which suits write combined mapped memory
+		uint8_t* output = static_cast<uint8_t*>(destination);
+		for (uint32_t i = 0; i < nodeCount; i++)
+		{
+			const float* worldColumns = &world[i][0][0];
+			float* result = reinterpret_cast<float*>(output + i * stride);
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				__m128 column = _mm_loadu_ps(worldColumns + c * 4);
+				__m128 sum = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(transform0, _mm_shuffle_ps(column, column, _MM_SHUFFLE(0, 0, 0, 0))),
+						_mm_mul_ps(transform1, _mm_shuffle_ps(column, column, _MM_SHUFFLE(1, 1, 1, 1)))),
+					_mm_add_ps(_mm_mul_ps(transform2, _mm_shuffle_ps(column, column, _MM_SHUFFLE(2, 2, 2, 2))),
+						_mm_mul_ps(transform3, _mm_shuffle_ps(column, column, _MM_SHUFFLE(3, 3, 3, 3)))));
+				_mm_storeu_ps(result + c * 4, sum);
+			}
+		}
+	}
+
+	void PVTransformSystem::Benchmark(uint32_t planetCount)
+	{
+		// every planet has four moons with eight props each
+		const uint32_t moonsPerPlanet = 4;
+		const uint32_t propsPerMoon = 8;
+
+		PVTransformSystem transforms;
+		std::vector<uint32_t> planets;
+		for (uint32_t p = 0; p < planetCount; p++)
+		{
+			float orbit = 100.0f + p * 10.0f;
+			glm::quat tilt = glm::angleAxis(glm::radians(static_cast<float>(p % 90)), glm::vec3(1.0f, 0.0f, 0.0f));
+			uint32_t planet = transforms.Add(NO_PARENT, glm::vec3(orbit, 0.0f, 0.0f), tilt, glm::vec3(2.0f));
+			planets.push_back(planet);
+			for (uint32_t m = 0; m < moonsPerPlanet; m++)
+			{
+				glm::quat moonRotation = glm::angleAxis(glm::radians(90.0f * m), glm::vec3(0.0f, 0.0f, 1.0f));
+				uint32_t moon = transforms.Add(planet, glm::vec3(3.0f, 0.0f, 0.0f), moonRotation, glm::vec3(0.25f));
+				for (uint32_t prop = 0; prop < propsPerMoon; prop++)
+				{
+					glm::quat propRotation = glm::angleAxis(glm::radians(45.0f * prop), glm::vec3(0.0f, 1.0f, 0.0f));
+					transforms.Add(moon, glm::vec3(0.0f, 1.2f, 0.0f), propRotation, glm::vec3(0.1f));
+				}
+			}
+		}
+		uint32_t nodeCount = transforms.GetCount();
+		transforms.Update();
+
+		glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f) *
+			glm::lookAt(glm::vec3(0.0f, -50.0f, 20.0f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		std::vector<glm::mat4> matrices(nodeCount);
+		const uint32_t iterations = 20;
+
+		// every node changed
+		double fullMs = 0.0;
+		for (uint32_t iteration = 0; iteration < iterations; iteration++)
+		{
+			float angle = glm::radians(static_cast<float>(iteration));
+			for (uint32_t i = 0; i < nodeCount; i++)
+			{
+				transforms.SetRotation(i, glm::angleAxis(angle, glm::vec3(0.0f, 0.0f, 1.0f)));
+			}
+			auto start = std::chrono::steady_clock::now();
+			transforms.Update();
+			fullMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+		fullMs /= iterations;
+
+		// one planet in a hundred moved, its moons and props follow
+		double partialMs = 0.0;
+		uint32_t partialNodes = 0;
+		for (uint32_t iteration = 0; iteration < iterations; iteration++)
+		{
+			for (uint32_t p = 0; p < planetCount; p += 100)
+			{
+				transforms.SetPosition(planets[p], glm::vec3(100.0f + p * 10.0f, static_cast<float>(iteration), 0.0f));
+			}
+			auto start = std::chrono::steady_clock::now();
+			partialNodes = transforms.Update();
+			partialMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+		partialMs /= iterations;
+
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t iteration = 0; iteration < iterations; iteration++)
+		{
+			transforms.WriteMatrices(viewProjection, matrices.data(), sizeof(glm::mat4));
+		}
+		double writeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+		// the same with glm, one node at a time
+		std::vector<glm::mat4> referenceWorld(nodeCount);
+		std::vector<glm::mat4> referenceMatrices(nodeCount);
+		start = std::chrono::steady_clock::now();
+		for (uint32_t iteration = 0; iteration < iterations; iteration++)
+		{
+			for (uint32_t i = 0; i < nodeCount; i++)
+			{
+				glm::quat rotation(transforms.rotationW[i], transforms.rotationX[i], transforms.rotationY[i], transforms.rotationZ[i]);
+				glm::mat4 localMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(transforms.positionX[i], transforms.positionY[i], transforms.positionZ[i])) *
+					glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), glm::vec3(transforms.scaleX[i], transforms.scaleY[i], transforms.scaleZ[i]));
+				uint32_t parent = transforms.parents[i];
+				referenceWorld[i] = parent == NO_PARENT ? localMatrix : referenceWorld[parent] * localMatrix;
+				referenceMatrices[i] = viewProjection * referenceWorld[i];
+			}
+		}
+		double referenceMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+		float maxDifference = 0.0f;
+		for (uint32_t i = 0; i < nodeCount; i++)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				glm::vec4 difference = glm::abs(matrices[i][c] - referenceMatrices[i][c]);
+				maxDifference = std::max(maxDifference, std::max(std::max(difference.x, difference.y), std::max(difference.z, difference.w)));
+			}
+		}
+
+		std::cout << "Transform benchmark, " << nodeCount << " nodes: full update " << nodeCount / (fullMs * 1000.0)
+			<< " matrices/us, " << partialNodes << " dirty " << partialMs << " ms, view projection write " << nodeCount / (writeMs * 1000.0)
+			<< " matrices/us, glm update and write " << nodeCount / (referenceMs * 1000.0) << " matrices/us, max difference "
+			<< maxDifference << std::endl;
+	}
+
+	void PVTransformSystem::grow()
+	{
+		for (auto* values : { &positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ, &scaleX, &scaleY, &scaleZ })
+		{
+			values->resize(values->size() + 4, 0.0f);
+		}
+		rotationW.resize(rotationW.size() + 4, 1.0f);
+		std::fill(scaleX.end() - 4, scaleX.end(), 1.0f);
+		std::fill(scaleY.end() - 4, scaleY.end(), 1.0f);
+		std::fill(scaleZ.end() - 4, scaleZ.end(), 1.0f);
+		for (auto& values : local)
+		{
+			values.resize(values.size() + 4, 0.0f);
+		}
+		parents.resize(parents.size() + 4, NO_PARENT);
+		dirty.resize(dirty.size() + 4, 0);
+		worldChanged.resize(worldChanged.size() + 4, 0);
+	}
+
+	void PVTransformSystem::computeLocal(uint32_t first)
+	{
+		__m128 x = _mm_loadu_ps(&rotationX[first]);
+		__m128 y = _mm_loadu_ps(&rotationY[first]);
+		__m128 z = _mm_loadu_ps(&rotationZ[first]);
+		__m128 w = _mm_loadu_ps(&rotationW[first]);
+		__m128 sx = _mm_loadu_ps(&scaleX[first]);
+		__m128 sy = _mm_loadu_ps(&scaleY[first]);
+		__m128 sz = _mm_loadu_ps(&scaleZ[first]);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+
+		__m128 xx = _mm_mul_ps(x, x);
+		__m128 yy = _mm_mul_ps(y, y);
+		__m128 zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y);
+		__m128 xz = _mm_mul_ps(x, z);
+		__m128 yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x);
+		__m128 wy = _mm_mul_ps(w, y);
+		__m128 wz = _mm_mul_ps(w, z);
+
+		// the rotation matrix of a unit quaternion, each column scaled, as glm::mat4_cast lays it out
+		_mm_storeu_ps(&local[0][first], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx));
+		_mm_storeu_ps(&local[1][first], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx));
+		_mm_storeu_ps(&local[2][first], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx));
+		_mm_storeu_ps(&local[3][first], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy));
+		_mm_storeu_ps(&local[4][first], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy));
+		_mm_storeu_ps(&local[5][first], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy));
+		_mm_storeu_ps(&local[6][first], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz));
+		_mm_storeu_ps(&local[7][first], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz));
+		_mm_storeu_ps(&local[8][first], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz));
+		_mm_storeu_ps(&local[9][first], _mm_loadu_ps(&positionX[first]));
+		_mm_storeu_ps(&local[10][first], _mm_loadu_ps(&positionY[first]));
+		_mm_storeu_ps(&local[11][first], _mm_loadu_ps(&positionZ[first]));
+	}
+}
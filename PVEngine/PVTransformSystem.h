@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace PVEngine
+{
+	// Local position, rotation and scale of many scene nodes, kept as structure of arrays so the
+	// matrices are built four nodes at a time with SSE. A node only hangs below nodes added before
+	// it, so one pass in index order sees every parent before its children, and only nodes that
+	// changed or whose parent moved are recomputed.
+	//
+	// Everything here is float, relative to an anchor the caller places camera relative with
+	// PVCameraRelative, so a hierarchy never spans more than float precision can hold.
+	class PVTransformSystem
+	{
+	public:
+		static const uint32_t NO_PARENT = UINT32_MAX;
+
+		PVTransformSystem();
+		~PVTransformSystem();
+
+		// parent has to be added already, returns the index of the node
+		uint32_t Add(uint32_t parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+		void Clear();
+
+		void SetPosition(uint32_t index, const glm::vec3& position);
+		void SetRotation(uint32_t index, const glm::quat& rotation);
+		void SetScale(uint32_t index, const glm::vec3& scale);
+
+		// rebuilds the world matrices of changed nodes and everything below them, returns how many
+		uint32_t Update();
+
+		// writes transform * world for every node, the first to destination and each following one
+		// stride bytes further. With a view projection these are the matrices a shader needs, and
+		// destination can be mapped buffer memory
+		void WriteMatrices(const glm::mat4& transform, void* destination, size_t stride) const;
+
+		// times full and partial updates of a planets, moons and props hierarchy against glm
+		static void Benchmark(uint32_t planetCount);
+
+		//Getters
+		uint32_t GetCount() const { return nodeCount; }
+		const glm::mat4& GetWorld(uint32_t index) const { return world[index]; }
+
+	private:
+		void grow();
+		void computeLocal(uint32_t first);
+
+		uint32_t nodeCount = 0;
+
+		// padded to a multiple of four with identity nodes, so blocks never read past the end
+		std::vector<float> positionX, positionY, positionZ;
+		std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+		std::vector<float> scaleX, scaleY, scaleZ;
+
+		// the upper 3x4 of every local matrix, column by column
+		std::vector<float> local[12];
+
+		std::vector<uint32_t> parents;
+		std::vector<uint8_t> dirty;
+		std::vector<uint8_t> worldChanged;
+		std::vector<glm::mat4> world;
+	};
+}
@@ -1,12 +1,14 @@
 #include "PVUniformBuffer.h"
 
+#include <cmath>
+
 namespace PVEngine
 {
 
-	PVUniformBuffer::PVUniformBuffer(const VkDevice* logicalDevice, const VkPhysicalDevice* physicalDevice, const VkSurfaceKHR* surface,
-		const VkCommandPool* transferCommandPool, const VkQueue* transferQueue)
+	PVUniformBuffer::PVUniformBuffer(const PVDeviceContext* deviceContext, VkDeviceSize size /* = sizeof(UniformBufferObject) */)
+		: bufferSize(size)
 	{
-		CreateUniformBuffer(logicalDevice, physicalDevice, surface, transferCommandPool, transferQueue);
+		CreateUniformBuffer(deviceContext);
 	}
 
 
@@ -14,37 +16,40 @@ namespace PVEngine
 	{
 	}
 
-	void PVUniformBuffer::CreateUniformBuffer(const VkDevice* logicalDevice, const VkPhysicalDevice* physicalDevice, const VkSurfaceKHR* surface,
-		const VkCommandPool* transferCommandPool, const VkQueue* transferQueue)
+	void PVUniformBuffer::CreateUniformBuffer(const PVDeviceContext* deviceContext)
 	{
-		VkDeviceSize bufferSize = GetUniformBufferSize();
-
-		createBuffer(logicalDevice, physicalDevice, surface, bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		createBuffer(deviceContext, bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,buffer, bufferMemory);
+
+		vkMapMemory(*deviceContext->GetLogicalDevice(), bufferMemory, 0, bufferSize, 0, &mappedData);
 	}
 	void PVUniformBuffer::CleanupUniformBuffer(const VkDevice* logicalDevice)
 	{
+		vkUnmapMemory(*logicalDevice, bufferMemory);
 		cleanupBuffer(logicalDevice, buffer, bufferMemory);
 	}
 
-	void PVUniformBuffer::Update(const VkDevice* logicalDevice, const VkExtent2D &swapChainExtent)
+	PVUniformBuffer::UniformBufferObject PVUniformBuffer::Update(const glm::mat4& view, const VkExtent2D &swapChainExtent)
 	{
-		static auto startTime = std::chrono::high_resolution_clock::now();
-
-		auto currentTime = std::chrono::high_resolution_clock::now();
-		float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
-
 		UniformBufferObject ubo = {};
-		ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-
-		ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-
-		ubo.proj = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float) swapChainExtent.height, 0.1f, 10.0f);
-		ubo.proj[1][1] *= -1; //Flipping the y cooridinate since glm projection view is left handed
+		ubo.view = view;
+
+		// reversed-Z with an infinite far plane, depth is nearPlane / distance so it is 1 at the
+		// near plane and tends to 0 far away, where a float depth buffer has the most precision
+		const float nearPlane = 0.1f;
+		float focalLength = 1.0f / std::tan(glm::radians(45.0f) * 0.5f);
+		ubo.proj = glm::mat4(0.0f);
+		ubo.proj[0][0] = focalLength / (swapChainExtent.width / (float) swapChainExtent.height);
+		ubo.proj[1][1] = -focalLength; //Flipping the y cooridinate since Vulkan's clip space points down
+		ubo.proj[2][3] = -1.0f;
+		ubo.proj[3][2] = nearPlane;
+
+		Write(&ubo, 0, sizeof(ubo));
+		return ubo;
+	}
 
-		void* data;
-		vkMapMemory(*logicalDevice, bufferMemory, 0, sizeof(ubo), 0, &data);
-		memcpy(data, &ubo, sizeof(ubo));
-		vkUnmapMemory(*logicalDevice, bufferMemory);
+	void PVUniformBuffer::Write(const void* data, VkDeviceSize offset, VkDeviceSize size)
+	{
+		memcpy(static_cast<uint8_t*>(mappedData) + offset, data, static_cast<size_t>(size));
 	}
 }
@@ -9,34 +9,39 @@
 
 namespace PVEngine
 {
+	// Host visible uniform buffer that stays mapped for its whole lifetime. One exists per frame
+	// in flight so the CPU never writes memory a previous frame is still reading.
 	class PVUniformBuffer : public PVBuffer
 	{
 	public:
 
+		// per-frame camera data, per-draw data goes through PVDrawConstants
 		struct UniformBufferObject
 		{
-			glm::mat4 model;
 			glm::mat4 view;
 			glm::mat4 proj;
 		};
 
 
-		PVUniformBuffer(const VkDevice* logicalDevice, const VkPhysicalDevice* physicalDevice, const VkSurfaceKHR* surface,
-			const VkCommandPool* transferCommandPool, const VkQueue* transferQueue);
+		PVUniformBuffer(const PVDeviceContext* deviceContext, VkDeviceSize size = sizeof(UniformBufferObject));
 		~PVUniformBuffer();
 
-		void CreateUniformBuffer(const VkDevice* logicalDevice, const VkPhysicalDevice* physicalDevice, const VkSurfaceKHR* surface,
-			const VkCommandPool* transferCommandPool, const VkQueue* transferQueue);
+		void CreateUniformBuffer(const PVDeviceContext* deviceContext);
 		void CleanupUniformBuffer(const VkDevice* logicalDevice);
 
-		void Update(const VkDevice* logicalDevice, const VkExtent2D &swapChainExtent);
+		// writes the camera to the start of the buffer and returns it for culling, the view comes
+		// from the simulation and the projection from the swapchain
+		UniformBufferObject Update(const glm::mat4& view, const VkExtent2D &swapChainExtent);
+
+		void Write(const void* data, VkDeviceSize offset, VkDeviceSize size);
 
 		//Getters
-		VkDeviceSize GetUniformBufferSize() { return sizeof(UniformBufferObject); }
+		VkDeviceSize GetUniformBufferSize() { return bufferSize; }
+		void* GetMappedData() const { return mappedData; }
 
 	private:
+		VkDeviceSize bufferSize;
 
-	
+		void* mappedData = nullptr;
 	};
 }
-
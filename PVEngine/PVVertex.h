@@ -36,4 +36,84 @@ namespace PVEngine
 			return attributeDescriptions;
 		}
 	};
+
+	// Terrain tile vertex, the position is relative to the tile's origin so it stays small
+	struct TerrainVertex
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+
+		static VkVertexInputBindingDescription getBindingDescription()
+		{
+			VkVertexInputBindingDescription bindingDescription = {};
+			bindingDescription.binding = 0;
+			bindingDescription.stride = sizeof(TerrainVertex);
+			bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+			return bindingDescription;
+		}
+
+		static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions()
+		{
+			std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions = {};
+			//Position attributes
+			attributeDescriptions[0].binding = 0;
+			attributeDescriptions[0].location = 0;
+			attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+			attributeDescriptions[0].offset = offsetof(TerrainVertex, position);
+			//Normal attributes
+			attributeDescriptions[1].binding = 0;
+			attributeDescriptions[1].location = 1;
+			attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+			attributeDescriptions[1].offset = offsetof(TerrainVertex, normal);
+
+			return attributeDescriptions;
+		}
+	};
+
+	// Per-instance attributes on binding 1, advanced once per instance. One of these per
+	// visible object lets a whole batch of the same mesh go out in a single draw.
+	struct InstanceData
+	{
+		glm::mat4 transform;
+		// x: morph factor towards the next LOD, y: LOD level, zw: unused
+		glm::vec4 morph;
+		uint32_t materialIndex;
+		uint32_t padding[3];
+
+		static VkVertexInputBindingDescription getBindingDescription()
+		{
+			VkVertexInputBindingDescription bindingDescription = {};
+			bindingDescription.binding = 1;
+			bindingDescription.stride = sizeof(InstanceData);
+			bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+			return bindingDescription;
+		}
+
+		static std::array<VkVertexInputAttributeDescription, 6> getAttributeDescriptions()
+		{
+			std::array<VkVertexInputAttributeDescription, 6> attributeDescriptions = {};
+			//Transform, one location per column
+			for (uint32_t column = 0; column < 4; column++)
+			{
+				attributeDescriptions[column].binding = 1;
+				attributeDescriptions[column].location = 2 + column;
+				attributeDescriptions[column].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+				attributeDescriptions[column].offset = offsetof(InstanceData, transform) + column * sizeof(glm::vec4);
+			}
+			//Morph attributes
+			attributeDescriptions[4].binding = 1;
+			attributeDescriptions[4].location = 6;
+			attributeDescriptions[4].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+			attributeDescriptions[4].offset = offsetof(InstanceData, morph);
+			//Material index
+			attributeDescriptions[5].binding = 1;
+			attributeDescriptions[5].location = 7;
+			attributeDescriptions[5].format = VK_FORMAT_R32_UINT;
+			attributeDescriptions[5].offset = offsetof(InstanceData, materialIndex);
+
+			return attributeDescriptions;
+		}
+	};
 }
\ No newline at end of file
@@ -3,10 +3,10 @@
 namespace PVEngine
 {
 
-	PVVertexBuffer::PVVertexBuffer(const VkDevice* logicalDevice, const VkPhysicalDevice* physicalDevice, const VkSurfaceKHR* surface,
-		const VkCommandPool* transferCommandPool, const VkQueue* transferQueue)
+	PVVertexBuffer::PVVertexBuffer(const PVDeviceContext* deviceContext, const PVUploadContext* uploadContext, const Vertex* vertices, uint32_t vertexCount,
+		VkSharingMode sharingMode /* = VK_SHARING_MODE_EXCLUSIVE */)
 	{
-		Create(logicalDevice, physicalDevice, surface, transferCommandPool, transferQueue);
+		Create(deviceContext, uploadContext, vertices, vertexCount, sharingMode);
 	}
 
 
@@ -14,29 +14,33 @@ namespace PVEngine
 	{
 	}
 
-	void PVVertexBuffer::Create(const VkDevice* logicalDevice, const VkPhysicalDevice* physicalDevice, const VkSurfaceKHR* surface,
-		const VkCommandPool* transferCommandPool, const VkQueue* transferQueue)
+	void PVVertexBuffer::Create(const PVDeviceContext* deviceContext, const PVUploadContext* uploadContext, const Vertex* vertices, uint32_t vertexCount,
+		VkSharingMode sharingMode /* = VK_SHARING_MODE_EXCLUSIVE */)
 	{
-		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+		const VkDevice* logicalDevice = deviceContext->GetLogicalDevice();
+		this->vertexCount = vertexCount;
+		this->sharingMode = sharingMode;
+		VkDeviceSize bufferSize = sizeof(Vertex) * vertexCount;
 
 		VkBuffer stagingBuffer;
 		VkDeviceMemory stagingBufferMemory;
 
-		createBuffer(logicalDevice, physicalDevice, surface, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
+		createBuffer(deviceContext, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
 
 		void* data;
 		vkMapMemory(*logicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, vertices.data(), (size_t)bufferSize);
+		memcpy(data, vertices, (size_t)bufferSize);
 		vkUnmapMemory(*logicalDevice, stagingBufferMemory);
 
-		createBuffer(logicalDevice, physicalDevice, surface, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory);
+		createBuffer(deviceContext, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory, sharingMode);
 
-		copyBuffer(logicalDevice, transferCommandPool, stagingBuffer, buffer, bufferSize, transferQueue);
+		uploadValue = copyBuffer(deviceContext, uploadContext, stagingBuffer, buffer, bufferSize,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
 
-		vkDestroyBuffer(*logicalDevice, stagingBuffer, nullptr);
-		vkFreeMemory(*logicalDevice, stagingBufferMemory, nullptr);
+		uploadContext->deletionQueue->RetireBuffer(stagingBuffer, uploadValue);
+		uploadContext->deletionQueue->RetireMemory(stagingBufferMemory, uploadValue);
 	}
 
 	void PVVertexBuffer::Cleanup(const VkDevice* logicalDevice)
@@ -6,25 +6,21 @@ namespace PVEngine
 	class PVVertexBuffer : public PVBuffer
 	{
 	public:
-		PVVertexBuffer(const VkDevice* logicalDevice, const VkPhysicalDevice* physicalDevice, const VkSurfaceKHR* surface,
-			const VkCommandPool* transferCommandPool, const VkQueue* transferQueue);
+		// vertices already in the Vertex layout, e.g. straight out of a mapped asset pack. Concurrent
+		// buffers are only made to compare against exclusive ones, see PlanetVulkan::SetSharingBenchmark
+		PVVertexBuffer(const PVDeviceContext* deviceContext, const PVUploadContext* uploadContext, const Vertex* vertices, uint32_t vertexCount,
+			VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE);
 		~PVVertexBuffer();
 
-		void Create(const VkDevice* logicalDevice, const VkPhysicalDevice* physicalDevice, const VkSurfaceKHR* surface,
-			const VkCommandPool* transferCommandPool, const VkQueue* transferQueue);
+		void Create(const PVDeviceContext* deviceContext, const PVUploadContext* uploadContext, const Vertex* vertices, uint32_t vertexCount,
+			VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE);
 		void Cleanup(const VkDevice* logicalDevice);
 
 		//Getters
-		uint32_t GetVerticesSize() { return vertices.size(); }
+		uint32_t GetVerticesSize() { return vertexCount; }
 	private:
 
-		const std::vector<Vertex> vertices = 
-		{
-			{ { -0.5f, -0.5f },{ 1.0f, 1.0f, 1.0f } },
-			{ {0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}},
-			{ { 0.5f, 0.5f },{ 0.0f, 1.0f, 0.0f } },
-			{ {-0.5f, 0.5f},{ 0.0f, 0.0f, 1.0f } }
-		};
+		uint32_t vertexCount = 0;
 	};
 }
 
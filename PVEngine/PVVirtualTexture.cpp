@@ -0,0 +1,661 @@
+#include "PVVirtualTexture.h"
+#include "PVHostAllocator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+
+namespace PVEngine
+{
+	PVVirtualTexture::PVVirtualTexture(const PVDeviceContext* deviceContext, PVDescriptorLayoutCache* layoutCache, float size, uint32_t pagesPerSide,
+		uint32_t cachePagesPerSide, VkDeviceSize uploadBudget, uint64_t seed, const std::string& cacheDirectory, HeightFunction heightFunction,
+		uint32_t frameCount)
+		: deviceContext(deviceContext), device(deviceContext->GetLogicalDevice()), size(size), pagesPerSide(pagesPerSide),
+		cachePagesPerSide(cachePagesPerSide), seed(seed), heightFunction(heightFunction), sets(frameCount, VK_NULL_HANDLE),
+		uploads(frameCount), recorded(frameCount, false)
+	{
+		if (pagesPerSide == 0 || (pagesPerSide & (pagesPerSide - 1)) != 0)
+		{
+			throw std::runtime_error("Virtual texture pages per side must be a power of two");
+		}
+		// slot coordinates are stored in 8 bits each
+		if (cachePagesPerSide == 0 || cachePagesPerSide > 256)
+		{
+			throw std::runtime_error("Virtual texture cache must be between 1 and 256 pages per side");
+		}
+
+		mipCount = 1;
+		while ((pagesPerSide >> mipCount) > 0)
+		{
+			mipCount++;
+		}
+
+		for (uint32_t mip = 0; mip < mipCount; mip++)
+		{
+			levelOffsets.push_back(static_cast<uint32_t>(pages.size()));
+			uint32_t levelPages = pagesPerSide >> mip;
+			for (uint32_t y = 0; y < levelPages; y++)
+			{
+				for (uint32_t x = 0; x < levelPages; x++)
+				{
+					Page page;
+					page.slot = NoSlot;
+					page.mip = mip;
+					page.x = x;
+					page.y = y;
+					pages.push_back(page);
+				}
+			}
+
+			// the GPU's table starts out undefined, the first upload writes all of it
+			Rect rect;
+			rect.x0 = 0;
+			rect.y0 = 0;
+			rect.x1 = levelPages - 1;
+			rect.y1 = levelPages - 1;
+			rect.empty = false;
+			dirtyRects.push_back(rect);
+		}
+		pageTable.assign(pages.size(), InvalidEntry);
+		slotPages.assign(static_cast<size_t>(cachePagesPerSide) * cachePagesPerSide, NoSlot);
+
+		VkDeviceSize pageBytes = static_cast<VkDeviceSize>(PageSize) * PageSize * (sizeof(float) + sizeof(uint32_t));
+		maxPagesPerFrame = static_cast<uint32_t>(std::max<VkDeviceSize>(uploadBudget / pageBytes, 1));
+
+		setLayout = GetSetLayout(layoutCache);
+		createImage(VK_FORMAT_R32_SFLOAT, heightImage, heightMemory, heightView);
+		createImage(VK_FORMAT_R8G8B8A8_UNORM, albedoImage, albedoMemory, albedoView);
+
+		// the shader clamps inside the page's border, so plain bilinear is enough
+		VkSamplerCreateInfo samplerInfo = {};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_LINEAR;
+		samplerInfo.minFilter = VK_FILTER_LINEAR;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.minLod = 0.0f;
+		samplerInfo.maxLod = 0.0f;
+		if (vkCreateSampler(*device, &samplerInfo, PVHostAllocator::Callbacks(PVAllocationType::Other), &sampler) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create virtual texture sampler");
+		}
+
+		VkDeviceSize tableBytes = pages.size() * sizeof(uint32_t);
+		pageTableBuffer = new PVStorageBuffer(deviceContext, tableBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, false);
+		feedbackBuffer = new PVStorageBuffer(deviceContext, tableBytes,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, false);
+		for (uint32_t i = 0; i < frameCount; i++)
+		{
+			uniformBuffers.push_back(new PVStorageBuffer(deviceContext, sizeof(Uniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, true));
+			stagingBuffers.push_back(new PVStorageBuffer(deviceContext, tableBytes + maxPagesPerFrame * pageBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, true));
+			readbackBuffers.push_back(new PVStorageBuffer(deviceContext, tableBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT, true));
+		}
+
+		// kept apart from the terrain's tiles, the keys would collide
+		pageCache = new PVTileCache(cacheDirectory.empty() ? std::string() : (std::filesystem::path(cacheDirectory) / "pages").string());
+
+		// the coarsest page covers everything, the rest are loaded as the feedback asks for them
+		requestPage(levelOffsets[mipCount - 1]);
+
+		std::cout << "Virtual texture: " << pages.size() << " pages of " << PageSize << "x" << PageSize << " in " << mipCount << " mips, cache of "
+			<< slotPages.size() << " pages (" << slotPages.size() * pageBytes / (1024 * 1024) << " MB), " << maxPagesPerFrame << " uploads per frame" << std::endl;
+	}
+
+
+	PVVirtualTexture::~PVVirtualTexture()
+	{
+		delete pageCache;
+		delete pageTableBuffer;
+		delete feedbackBuffer;
+		for (auto buffer : uniformBuffers)
+		{
+			delete buffer;
+		}
+		for (auto buffer : stagingBuffers)
+		{
+			delete buffer;
+		}
+		for (auto buffer : readbackBuffers)
+		{
+			delete buffer;
+		}
+	}
+
+	void PVVirtualTexture::Cleanup()
+	{
+		pageCache->Stop();
+
+		vkDestroySampler(*device, sampler, PVHostAllocator::Callbacks(PVAllocationType::Other));
+		vkDestroyImageView(*device, heightView, PVHostAllocator::Callbacks(PVAllocationType::ImageView));
+		vkDestroyImageView(*device, albedoView, PVHostAllocator::Callbacks(PVAllocationType::ImageView));
+		vkDestroyImage(*device, heightImage, PVHostAllocator::Callbacks(PVAllocationType::Image));
+		vkDestroyImage(*device, albedoImage, PVHostAllocator::Callbacks(PVAllocationType::Image));
+		vkFreeMemory(*device, heightMemory, PVHostAllocator::Callbacks(PVAllocationType::Memory));
+		vkFreeMemory(*device, albedoMemory, PVHostAllocator::Callbacks(PVAllocationType::Memory));
+
+		pageTableBuffer->Cleanup(device);
+		feedbackBuffer->Cleanup(device);
+		for (auto buffer : uniformBuffers)
+		{
+			buffer->Cleanup(device);
+		}
+		for (auto buffer : stagingBuffers)
+		{
+			buffer->Cleanup(device);
+		}
+		for (auto buffer : readbackBuffers)
+		{
+			buffer->Cleanup(device);
+		}
+	}
+
+	VkDescriptorSetLayout PVVirtualTexture::GetSetLayout(PVDescriptorLayoutCache* layoutCache)
+	{
+		auto binding = [](uint32_t index, VkDescriptorType type)
+		{
+			VkDescriptorSetLayoutBinding layoutBinding = {};
+			layoutBinding.binding = index;
+			layoutBinding.descriptorType = type;
+			layoutBinding.descriptorCount = 1;
+			layoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+			return layoutBinding;
+		};
+
+		return layoutCache->GetLayout({
+			binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER),
+			binding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER),
+			binding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER),
+			binding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER),
+			binding(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER) });
+	}
+
+	void PVVirtualTexture::FrameCompleted(uint32_t frameIndex)
+	{
+		if (!recorded[frameIndex])
+		{
+			return;
+		}
+		recorded[frameIndex] = false;
+
+		const uint32_t* requested = static_cast<const uint32_t*>(readbackBuffers[frameIndex]->GetMappedData());
+		candidates.clear();
+		for (uint32_t i = 0; i < pages.size(); i++)
+		{
+			if (requested[i] == 0)
+			{
+				continue;
+			}
+			wantedTotal++;
+
+			// whatever is drawn in its place stays in the cache, down to the coarsest page
+			const Page& wanted = pages[i];
+			for (uint32_t mip = wanted.mip; mip < mipCount; mip++)
+			{
+				Page& above = pages[pageIndex(mip, wanted.x >> (mip - wanted.mip), wanted.y >> (mip - wanted.mip))];
+				if (above.slot != NoSlot)
+				{
+					above.lastUsedFrame = frameNumber;
+				}
+			}
+
+			// pages are loaded coarse to fine, so the one missing is right below the resident one
+			uint32_t entry = pageTable[i];
+			uint32_t haveMip = (entry == InvalidEntry) ? mipCount : residentMip(entry);
+			if (haveMip <= wanted.mip)
+			{
+				continue;
+			}
+			uint32_t nextMip = haveMip - 1;
+			uint32_t next = pageIndex(nextMip, wanted.x >> (nextMip - wanted.mip), wanted.y >> (nextMip - wanted.mip));
+			if (pages[next].wantedFrame == frameNumber)
+			{
+				continue;
+			}
+			pages[next].wantedFrame = frameNumber;
+			candidates.push_back({ haveMip - wanted.mip, next });
+		}
+
+		// the pages missing the most detail first, coarser ones before finer on a tie
+		std::sort(candidates.begin(), candidates.end(), [this](const std::pair<uint32_t, uint32_t>& a, const std::pair<uint32_t, uint32_t>& b)
+		{
+			if (a.first != b.first)
+			{
+				return a.first > b.first;
+			}
+			return pages[a.second].mip > pages[b.second].mip;
+		});
+		for (const auto& candidate : candidates)
+		{
+			if (pagesInFlight >= MaxPagesInFlight)
+			{
+				break;
+			}
+			requestPage(candidate.second);
+		}
+	}
+
+	void PVVirtualTexture::Update(uint32_t frameIndex)
+	{
+		frameNumber++;
+
+		FrameUpload& upload = uploads[frameIndex];
+		upload.tableCopies.clear();
+		upload.heightCopies.clear();
+		upload.albedoCopies.clear();
+
+		PVTileCache::Result result;
+		while (pageCache->PopResult(result))
+		{
+			pagesInFlight--;
+			arrivedPages.push_back(std::move(result));
+		}
+
+		// the page table goes first in the staging buffer, at the same offsets it has on the GPU
+		VkDeviceSize stagingOffset = pages.size() * sizeof(uint32_t);
+		uint32_t placed = 0;
+		while (!arrivedPages.empty() && placed < maxPagesPerFrame)
+		{
+			if (placePage(arrivedPages.front(), frameIndex, stagingOffset))
+			{
+				placed++;
+			}
+			else
+			{
+				// asked for again once the feedback still wants it and there is room
+				droppedTotal++;
+			}
+			arrivedPages.pop_front();
+		}
+		waitingTotal += arrivedPages.size();
+
+		stageTable(frameIndex);
+
+		Uniforms uniforms = {};
+		uniforms.size = size;
+		uniforms.pagesPerSide = pagesPerSide;
+		uniforms.mipCount = mipCount;
+		uniforms.pageSize = PageSize;
+		uniforms.pageBorder = PageBorder;
+		uniforms.cachePagesPerSide = cachePagesPerSide;
+		uniforms.feedbackPhase = static_cast<uint32_t>(frameNumber % 16);
+		uniformBuffers[frameIndex]->Write(&uniforms, 0, sizeof(uniforms));
+
+		if (++reportFrames == 300)
+		{
+			size_t residentCount = std::count_if(slotPages.begin(), slotPages.end(), [](uint32_t page) { return page != NoSlot; });
+			std::cout << "Virtual texture: " << residentCount << " of " << slotPages.size() << " cache pages in use, " << wantedTotal / reportFrames
+				<< " pages wanted per frame, " << uploadedTotal << " uploaded (" << uploadBytesTotal / reportFrames / 1024 << " KB per frame), "
+				<< tableEntriesTotal << " page table entries updated, " << evictedTotal << " evicted, " << droppedTotal << " dropped with the cache full, "
+				<< waitingTotal / reportFrames << " waiting for upload budget" << std::endl;
+			pageCache->PrintReport(std::cout);
+
+			reportFrames = 0;
+			wantedTotal = 0;
+			uploadedTotal = 0;
+			uploadBytesTotal = 0;
+			tableEntriesTotal = 0;
+			evictedTotal = 0;
+			droppedTotal = 0;
+			waitingTotal = 0;
+		}
+	}
+
+	void PVVirtualTexture::RecordUpload(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+	{
+		const FrameUpload& upload = uploads[frameIndex];
+
+		if (!initialized)
+		{
+			VkImageMemoryBarrier imageBarriers[2] = {};
+			VkImage images[] = { heightImage, albedoImage };
+			for (uint32_t i = 0; i < 2; i++)
+			{
+				imageBarriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				imageBarriers[i].srcAccessMask = 0;
+				imageBarriers[i].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				imageBarriers[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				imageBarriers[i].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+				imageBarriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				imageBarriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				imageBarriers[i].image = images[i];
+				imageBarriers[i].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			}
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+				0, nullptr, 0, nullptr, 2, imageBarriers);
+			vkCmdFillBuffer(commandBuffer, *feedbackBuffer->GetBuffer(), 0, VK_WHOLE_SIZE, 0);
+		}
+		else if (upload.tableCopies.empty() && upload.heightCopies.empty())
+		{
+			return;
+		}
+		else
+		{
+			// earlier frames may still be sampling the pages and entries about to be replaced
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+		}
+
+		VkBuffer staging = *stagingBuffers[frameIndex]->GetBuffer();
+		if (!upload.tableCopies.empty())
+		{
+			vkCmdCopyBuffer(commandBuffer, staging, *pageTableBuffer->GetBuffer(), static_cast<uint32_t>(upload.tableCopies.size()), upload.tableCopies.data());
+		}
+		if (!upload.heightCopies.empty())
+		{
+			vkCmdCopyBufferToImage(commandBuffer, staging, heightImage, VK_IMAGE_LAYOUT_GENERAL,
+				static_cast<uint32_t>(upload.heightCopies.size()), upload.heightCopies.data());
+			vkCmdCopyBufferToImage(commandBuffer, staging, albedoImage, VK_IMAGE_LAYOUT_GENERAL,
+				static_cast<uint32_t>(upload.albedoCopies.size()), upload.albedoCopies.data());
+		}
+
+		// the feedback clear is only recorded on the first frame, the fragment shader writes after it
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		initialized = true;
+	}
+
+	void PVVirtualTexture::BindSet(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t setIndex, uint32_t frameIndex,
+		PVDescriptorAllocator* descriptorAllocator)
+	{
+		VkDescriptorSet& set = sets[frameIndex];
+		if (set == VK_NULL_HANDLE)
+		{
+			set = descriptorAllocator->Allocate(setLayout);
+			PVDescriptorAllocator::WriteSet(device, set, {
+				PVDescriptorWrite::Buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, *uniformBuffers[frameIndex]->GetBuffer(), 0, sizeof(Uniforms)),
+				PVDescriptorWrite::Buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, *pageTableBuffer->GetBuffer(), 0, VK_WHOLE_SIZE),
+				PVDescriptorWrite::Buffer(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, *feedbackBuffer->GetBuffer(), 0, VK_WHOLE_SIZE),
+				PVDescriptorWrite::Image(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, heightView, sampler, VK_IMAGE_LAYOUT_GENERAL),
+				PVDescriptorWrite::Image(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, albedoView, sampler, VK_IMAGE_LAYOUT_GENERAL) });
+		}
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, setIndex, 1, &set, 0, nullptr);
+	}
+
+	void PVVirtualTexture::RecordFeedback(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+	{
+		VkMemoryBarrier written = {};
+		written.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		written.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		written.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &written, 0, nullptr, 0, nullptr);
+
+		VkBufferCopy copyRegion = { 0, 0, feedbackBuffer->GetSize() };
+		vkCmdCopyBuffer(commandBuffer, *feedbackBuffer->GetBuffer(), *readbackBuffers[frameIndex]->GetBuffer(), 1, &copyRegion);
+
+		// the clear waits for the copy to have read the buffer
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+		vkCmdFillBuffer(commandBuffer, *feedbackBuffer->GetBuffer(), 0, VK_WHOLE_SIZE, 0);
+
+		VkMemoryBarrier readback = {};
+		readback.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		readback.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		readback.dstAccessMask = VK_ACCESS_HOST_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+			1, &readback, 0, nullptr, 0, nullptr);
+
+		recorded[frameIndex] = true;
+	}
+
+	void PVVirtualTexture::createImage(VkFormat format, VkImage& image, VkDeviceMemory& memory, VkImageView& view)
+	{
+		uint32_t texels = cachePagesPerSide * PageSize;
+
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = format;
+		imageInfo.extent = { texels, texels, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		if (vkCreateImage(*device, &imageInfo, PVHostAllocator::Callbacks(PVAllocationType::Image), &image) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create virtual texture cache");
+		}
+
+		VkMemoryRequirements requirements;
+		vkGetImageMemoryRequirements(*device, image, &requirements);
+		VkMemoryAllocateInfo allocateInfo = {};
+		allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocateInfo.allocationSize = requirements.size;
+		allocateInfo.memoryTypeIndex = deviceContext->FindMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		if (vkAllocateMemory(*device, &allocateInfo, PVHostAllocator::Callbacks(PVAllocationType::Memory), &memory) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate virtual texture cache memory");
+		}
+		vkBindImageMemory(*device, image, memory, 0);
+
+		VkImageViewCreateInfo viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = format;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		if (vkCreateImageView(*device, &viewInfo, PVHostAllocator::Callbacks(PVAllocationType::ImageView), &view) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create virtual texture cache view");
+		}
+	}
+
+	void PVVirtualTexture::requestPage(uint32_t index)
+	{
+		Page& page = pages[index];
+		if (page.loading || page.slot != NoSlot)
+		{
+			return;
+		}
+		page.loading = true;
+		pagesInFlight++;
+
+		// texel centers of the page's mip, the border reaches into the neighbouring pages
+		const uint32_t payload = PageSize - 2 * PageBorder;
+		float spacing = size / static_cast<float>((pagesPerSide >> page.mip) * payload);
+		int64_t firstX = static_cast<int64_t>(page.x) * payload - PageBorder;
+		int64_t firstY = static_cast<int64_t>(page.y) * payload - PageBorder;
+		HeightFunction function = heightFunction;
+		pageCache->Request({ seed, 0, page.mip, page.x, page.y }, PageSize, PageSize, [=](std::vector<float>& heights)
+		{
+			for (uint32_t y = 0; y < PageSize; y++)
+			{
+				for (uint32_t x = 0; x < PageSize; x++)
+				{
+					heights[y * PageSize + x] = function((firstX + x + 0.5f) * spacing, (firstY + y + 0.5f) * spacing);
+				}
+			}
+		});
+	}
+
+	bool PVVirtualTexture::placePage(const PVTileCache::Result& result, uint32_t frameIndex, VkDeviceSize& stagingOffset)
+	{
+		Page& page = pages[pageIndex(result.key.lod, result.key.x, result.key.y)];
+		page.loading = false;
+
+		// a free slot, or the one sampled least recently as long as no pixel of the last full
+		// feedback cycle used it
+		uint32_t slot = NoSlot;
+		uint64_t oldestFrame = UINT64_MAX;
+		for (uint32_t i = 0; i < slotPages.size(); i++)
+		{
+			if (slotPages[i] == NoSlot)
+			{
+				slot = i;
+				break;
+			}
+			const Page& resident = pages[slotPages[i]];
+			if (resident.mip + 1 < mipCount && resident.lastUsedFrame < oldestFrame)
+			{
+				slot = i;
+				oldestFrame = resident.lastUsedFrame;
+			}
+		}
+		if (slot == NoSlot || (slotPages[slot] != NoSlot && oldestFrame + 16 > frameNumber))
+		{
+			return false;
+		}
+		if (slotPages[slot] != NoSlot)
+		{
+			evictSlot(slot);
+		}
+
+		slotPages[slot] = pageIndex(page.mip, page.x, page.y);
+		page.slot = slot;
+		page.lastUsedFrame = frameNumber;
+		uint32_t slotX = slot % cachePagesPerSide;
+		uint32_t slotY = slot / cachePagesPerSide;
+		fillSubtree(page, slotX | (slotY << 8) | (page.mip << 16), false);
+
+		FrameUpload& upload = uploads[frameIndex];
+		uint8_t* staging = static_cast<uint8_t*>(stagingBuffers[frameIndex]->GetMappedData());
+		VkBufferImageCopy region = {};
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		region.imageOffset = { static_cast<int32_t>(slotX * PageSize), static_cast<int32_t>(slotY * PageSize), 0 };
+		region.imageExtent = { PageSize, PageSize, 1 };
+
+		VkDeviceSize heightBytes = static_cast<VkDeviceSize>(PageSize) * PageSize * sizeof(float);
+		memcpy(staging + stagingOffset, result.heights.data(), heightBytes);
+		region.bufferOffset = stagingOffset;
+		upload.heightCopies.push_back(region);
+		stagingOffset += heightBytes;
+
+		// grass low down, earth higher up and rock wherever it is steep
+		const uint32_t payload = PageSize - 2 * PageBorder;
+		float spacing = size / static_cast<float>((pagesPerSide >> page.mip) * payload);
+		uint32_t* albedo = reinterpret_cast<uint32_t*>(staging + stagingOffset);
+		auto height = [&result](uint32_t sampleX, uint32_t sampleY) { return result.heights[sampleY * PageSize + sampleX]; };
+		const float earthColor[] = { 0.45f, 0.35f, 0.25f };
+		const float grassColor[] = { 0.35f, 0.55f, 0.3f };
+		const float rockColor[] = { 0.5f, 0.48f, 0.45f };
+		for (uint32_t y = 0; y < PageSize; y++)
+		{
+			for (uint32_t x = 0; x < PageSize; x++)
+			{
+				uint32_t left = (x > 0) ? x - 1 : x;
+				uint32_t right = (x + 1 < PageSize) ? x + 1 : x;
+				uint32_t down = (y > 0) ? y - 1 : y;
+				uint32_t up = (y + 1 < PageSize) ? y + 1 : y;
+				float slopeX = (height(right, y) - height(left, y)) / ((right - left) * spacing);
+				float slopeY = (height(x, up) - height(x, down)) / ((up - down) * spacing);
+				float steepness = std::sqrt(slopeX * slopeX + slopeY * slopeY);
+
+				float grass = std::min(std::max(height(x, y) * 4.0f + 0.5f, 0.0f), 1.0f);
+				float rock = std::min(std::max((steepness - 0.6f) / 0.6f, 0.0f), 1.0f);
+				float color[3];
+				for (int c = 0; c < 3; c++)
+				{
+					float ground = earthColor[c] + (grassColor[c] - earthColor[c]) * grass;
+					color[c] = ground + (rockColor[c] - ground) * rock;
+				}
+				albedo[y * PageSize + x] = static_cast<uint32_t>(color[0] * 255.0f + 0.5f) | (static_cast<uint32_t>(color[1] * 255.0f + 0.5f) << 8)
+					| (static_cast<uint32_t>(color[2] * 255.0f + 0.5f) << 16) | (0xFFu << 24);
+			}
+		}
+		region.bufferOffset = stagingOffset;
+		upload.albedoCopies.push_back(region);
+		stagingOffset += static_cast<VkDeviceSize>(PageSize) * PageSize * sizeof(uint32_t);
+
+		uploadedTotal++;
+		uploadBytesTotal += heightBytes + static_cast<VkDeviceSize>(PageSize) * PageSize * sizeof(uint32_t);
+		return true;
+	}
+
+	void PVVirtualTexture::evictSlot(uint32_t slot)
+	{
+		Page& page = pages[slotPages[slot]];
+
+		// what the page's parent position resolves to takes over, the coarsest page is never evicted
+		uint32_t replacement = pageTable[pageIndex(page.mip + 1, page.x >> 1, page.y >> 1)];
+		fillSubtree(page, replacement, true);
+
+		page.slot = NoSlot;
+		slotPages[slot] = NoSlot;
+		evictedTotal++;
+	}
+
+	void PVVirtualTexture::fillSubtree(const Page& page, uint32_t entry, bool evicting)
+	{
+		for (uint32_t level = 0; level <= page.mip; level++)
+		{
+			uint32_t shift = page.mip - level;
+			uint32_t x0 = page.x << shift;
+			uint32_t y0 = page.y << shift;
+			uint32_t x1 = ((page.x + 1) << shift) - 1;
+			uint32_t y1 = ((page.y + 1) << shift) - 1;
+			uint32_t levelPages = pagesPerSide >> level;
+
+			// finer pages that are resident themselves keep their entries
+			for (uint32_t y = y0; y <= y1; y++)
+			{
+				for (uint32_t x = x0; x <= x1; x++)
+				{
+					uint32_t& current = pageTable[levelOffsets[level] + y * levelPages + x];
+					uint32_t currentMip = residentMip(current);
+					if (evicting ? currentMip == page.mip : currentMip >= page.mip)
+					{
+						current = entry;
+					}
+				}
+			}
+
+			Rect& rect = dirtyRects[level];
+			if (rect.empty)
+			{
+				rect.x0 = x0;
+				rect.y0 = y0;
+				rect.x1 = x1;
+				rect.y1 = y1;
+				rect.empty = false;
+			}
+			else
+			{
+				rect.x0 = std::min(rect.x0, x0);
+				rect.y0 = std::min(rect.y0, y0);
+				rect.x1 = std::max(rect.x1, x1);
+				rect.y1 = std::max(rect.y1, y1);
+			}
+		}
+	}
+
+	void PVVirtualTexture::stageTable(uint32_t frameIndex)
+	{
+		FrameUpload& upload = uploads[frameIndex];
+		uint8_t* staging = static_cast<uint8_t*>(stagingBuffers[frameIndex]->GetMappedData());
+
+		// one region per row of every changed rectangle, rows that are whole mips run together
+		for (uint32_t level = 0; level < mipCount; level++)
+		{
+			Rect& rect = dirtyRects[level];
+			if (rect.empty)
+			{
+				continue;
+			}
+
+			uint32_t levelPages = pagesPerSide >> level;
+			VkDeviceSize rowBytes = static_cast<VkDeviceSize>(rect.x1 - rect.x0 + 1) * sizeof(uint32_t);
+			for (uint32_t y = rect.y0; y <= rect.y1; y++)
+			{
+				VkDeviceSize offset = static_cast<VkDeviceSize>(levelOffsets[level] + y * levelPages + rect.x0) * sizeof(uint32_t);
+				memcpy(staging + offset, &pageTable[levelOffsets[level] + y * levelPages + rect.x0], rowBytes);
+				if (!upload.tableCopies.empty() && upload.tableCopies.back().srcOffset + upload.tableCopies.back().size == offset)
+				{
+					upload.tableCopies.back().size += rowBytes;
+				}
+				else
+				{
+					upload.tableCopies.push_back({ offset, offset, rowBytes });
+				}
+			}
+			tableEntriesTotal += static_cast<uint64_t>(rect.x1 - rect.x0 + 1) * (rect.y1 - rect.y0 + 1);
+			rect.empty = true;
+		}
+	}
+}
@@ -0,0 +1,190 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "PVDeviceContext.h"
+#include "PVDescriptorLayoutCache.h"
+#include "PVDescriptorAllocator.h"
+#include "PVStorageBuffer.h"
+#include "PVTileCache.h"
+
+namespace PVEngine
+{
+	// Height and albedo for a surface far larger than fits in memory. The virtual texture is a
+	// mip chain of square pages; only the pages something was drawn with recently live on the
+	// GPU, in a physical cache of fixed size, and a page table says where each one sits. A page
+	// that isn't resident points at its closest coarser one that is, so nothing is ever drawn
+	// without a texture, only blurrier.
+	//
+	// Drawing reports which pages were wanted into a feedback buffer (terrain.frag). Once the
+	// frame has finished, the pages missing the most detail are asked for first from a
+	// PVTileCache, which loads them from disk or generates them on its worker thread. Pages that
+	// arrive are uploaded a few per frame within a fixed budget, evicting the ones sampled least
+	// recently, and only the page table entries that changed are copied.
+	//
+	// Bound as one descriptor set, see GetSetLayout and Shaders/terrain.frag.
+	class PVVirtualTexture
+	{
+	public:
+		// terrain height at a point in terrain space, called on the cache's worker thread
+		typedef std::function<float(float x, float y)> HeightFunction;
+
+		// texels per page side, including a border of the neighbouring pages' texels so bilinear
+		// filtering never reads another page
+		static const uint32_t PageSize = 128;
+		static const uint32_t PageBorder = 1;
+
+		// size is the extent the texture covers in terrain space, pagesPerSide the pages of the
+		// finest mip along one side, a power of two. Pages are cached in cacheDirectory/pages.
+		PVVirtualTexture(const PVDeviceContext* deviceContext, PVDescriptorLayoutCache* layoutCache, float size, uint32_t pagesPerSide,
+			uint32_t cachePagesPerSide, VkDeviceSize uploadBudget, uint64_t seed, const std::string& cacheDirectory, HeightFunction heightFunction,
+			uint32_t frameCount);
+		~PVVirtualTexture();
+
+		void Cleanup();
+
+		static VkDescriptorSetLayout GetSetLayout(PVDescriptorLayoutCache* layoutCache);
+
+		// reads the pages the frame that last used this slot asked for, once the CPU has waited for it
+		void FrameCompleted(uint32_t frameIndex);
+
+		// places the pages that arrived, up to the upload budget, and stages them together with
+		// the page table entries they change into this frame slot's staging buffer
+		void Update(uint32_t frameIndex);
+
+		// outside a render pass, before anything samples the texture
+		void RecordUpload(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+		// the frame slot's set is allocated from descriptorAllocator and written the first time,
+		// nothing it points at changes afterwards, so the allocator must never be reset
+		void BindSet(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t setIndex, uint32_t frameIndex,
+			PVDescriptorAllocator* descriptorAllocator);
+
+		// outside a render pass, after everything that samples the texture, copies the feedback
+		// out and clears it for the next frame
+		void RecordFeedback(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+	private:
+		// std140, matches terrain.frag
+		struct Uniforms
+		{
+			float size;
+			uint32_t pagesPerSide;
+			uint32_t mipCount;
+			uint32_t pageSize;
+			uint32_t pageBorder;
+			uint32_t cachePagesPerSide;
+			uint32_t feedbackPhase;
+			uint32_t unused;
+		};
+
+		struct Page
+		{
+			// cache slot, or NoSlot
+			uint32_t slot;
+			uint32_t mip;
+			uint32_t x;
+			uint32_t y;
+			// the last frame a pixel was drawn with this page or a finer one
+			uint64_t lastUsedFrame = 0;
+			uint64_t wantedFrame = 0;
+			bool loading = false;
+		};
+
+		// inclusive page table entries of one mip
+		struct Rect
+		{
+			uint32_t x0, y0, x1, y1;
+			bool empty = true;
+		};
+
+		struct FrameUpload
+		{
+			std::vector<VkBufferCopy> tableCopies;
+			std::vector<VkBufferImageCopy> heightCopies;
+			std::vector<VkBufferImageCopy> albedoCopies;
+		};
+
+		static const uint32_t NoSlot = 0xFFFFFFFF;
+		static const uint32_t InvalidEntry = 0xFFFFFFFF;
+		// requests handed to the tile cache at once, the rest wait so newer feedback can reorder them
+		static const uint32_t MaxPagesInFlight = 8;
+
+		void createImage(VkFormat format, VkImage& image, VkDeviceMemory& memory, VkImageView& view);
+		void requestPage(uint32_t index);
+		// returns false when every slot holds a page that is still in use
+		bool placePage(const PVTileCache::Result& result, uint32_t frameIndex, VkDeviceSize& stagingOffset);
+		void evictSlot(uint32_t slot);
+		// points the entries under a page that resolve to it, or to something coarser, at entry
+		void fillSubtree(const Page& page, uint32_t entry, bool evicting);
+		void stageTable(uint32_t frameIndex);
+		uint32_t pageIndex(uint32_t mip, uint32_t x, uint32_t y) const { return levelOffsets[mip] + y * (pagesPerSide >> mip) + x; }
+		static uint32_t residentMip(uint32_t entry) { return (entry >> 16) & 0xFF; }
+
+		const PVDeviceContext* deviceContext;
+		const VkDevice* device;
+
+		float size;
+		uint32_t pagesPerSide;
+		uint32_t mipCount;
+		uint32_t cachePagesPerSide;
+		uint32_t maxPagesPerFrame;
+		uint64_t seed;
+		HeightFunction heightFunction;
+
+		VkDescriptorSetLayout setLayout;
+		// one per frame slot, null until its first BindSet
+		std::vector<VkDescriptorSet> sets;
+
+		// the physical cache, kept in GENERAL
+		VkImage heightImage = VK_NULL_HANDLE;
+		VkDeviceMemory heightMemory = VK_NULL_HANDLE;
+		VkImageView heightView = VK_NULL_HANDLE;
+		VkImage albedoImage = VK_NULL_HANDLE;
+		VkDeviceMemory albedoMemory = VK_NULL_HANDLE;
+		VkImageView albedoView = VK_NULL_HANDLE;
+		VkSampler sampler = VK_NULL_HANDLE;
+		bool initialized = false;
+
+		// every mip's pages, finest first, with the page table mirrored the same way
+		std::vector<uint32_t> levelOffsets;
+		std::vector<Page> pages;
+		std::vector<uint32_t> pageTable;
+		std::vector<Rect> dirtyRects;
+		std::vector<uint32_t> slotPages;
+
+		PVStorageBuffer* pageTableBuffer = nullptr;
+		PVStorageBuffer* feedbackBuffer = nullptr;
+
+		// per frame slot
+		std::vector<PVStorageBuffer*> uniformBuffers;
+		std::vector<PVStorageBuffer*> stagingBuffers;
+		std::vector<PVStorageBuffer*> readbackBuffers;
+		std::vector<FrameUpload> uploads;
+		std::vector<bool> recorded;
+
+		PVTileCache* pageCache = nullptr;
+		uint32_t pagesInFlight = 0;
+		// loaded, waiting for upload budget
+		std::deque<PVTileCache::Result> arrivedPages;
+		// wanted pages the feedback found, sorted by how much detail they are missing
+		std::vector<std::pair<uint32_t, uint32_t>> candidates;
+
+		uint64_t frameNumber = 0;
+
+		// report totals
+		uint32_t reportFrames = 0;
+		uint64_t wantedTotal = 0;
+		uint64_t uploadedTotal = 0;
+		uint64_t uploadBytesTotal = 0;
+		uint64_t tableEntriesTotal = 0;
+		uint64_t evictedTotal = 0;
+		uint64_t droppedTotal = 0;
+		uint64_t waitingTotal = 0;
+	};
+}
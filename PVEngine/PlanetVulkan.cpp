@@ -2,10 +2,14 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <cstring>
+#include <cstddef>
 #include <vector>
 #include <map>
 #include <algorithm>
 #include <set>
+#include <chrono>
+#include <cmath>
+#include <random>
 #include "PVVertex.h"
 
 namespace PVEngine
@@ -13,104 +17,559 @@ namespace PVEngine
 
 	PlanetVulkan::PlanetVulkan()
 	{
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			frameArenas.push_back(new PVFrameArena());
+		}
 	}
 
 
 	PlanetVulkan::~PlanetVulkan()
 	{
+		delete renderGraph;
 		delete swapchain;
+		delete deletionQueue;
+		delete transferDeletionQueue;
+		delete framePacer;
+		delete resolutionScaler;
+		delete occlusionCuller;
+		delete terrain;
+		delete virtualTexture;
+		delete graphicsTimeline;
+		delete transferTimeline;
+		delete shaderCache;
+		delete descriptorLayoutCache;
+		delete bindlessTable;
+		delete materialBuffer;
+		delete textureStreamer;
+		delete descriptorAllocator;
+		for (auto frameAllocator : frameDescriptorAllocators)
+		{
+			delete frameAllocator;
+		}
+		for (auto frameArena : frameArenas)
+		{
+			delete frameArena;
+		}
+		delete deviceContext;
 		delete graphicsCommandPool;
 		delete transferCommandPool;
-		delete uniformBuffer;
+		for (size_t i = 0; i < cameraBuffers.size(); i++)
+		{
+			delete cameraBuffers[i];
+			delete drawBuffers[i];
+		}
+		delete gpuTimer;
+		for (auto instanceBuffer : instanceBuffers)
+		{
+			delete instanceBuffer;
+		}
 		delete indexBuffer;
 		delete vertexBuffer;
+		delete sharingBuffers[0];
+		delete sharingBuffers[1];
 	}
 
 	void PlanetVulkan::InitVulkan()
 	{
-		InitWindow();
-		CreateInstance();
-		SetupDebugCallback();
-		CreateSurface();
-		GetPhysicalDevices();
-		CreateLogicalDevice();
-		swapchain = new PVSwapchain();
-		swapchain->Create(&logicalDevice, &physicalDevice, &surface, &windowObj, QuerySwapChainSupport(physicalDevice));
-		CreateRenderPass();
-		CreateDescriptorSetlayout();
-		CreateGraphicsPipeline();
-		swapchain->CreateFramebuffers(&renderPass);
-		
-		QueueFamilyIndices indices = FindQueueFamilies(&physicalDevice, &surface);
-		graphicsCommandPool = new PVCommandPool(&logicalDevice, indices.graphicsFamily);
-		transferCommandPool = new PVCommandPool(&logicalDevice, indices.transferFamily , VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		initStart = std::chrono::steady_clock::now();
+
+		// Startup as a dependency graph: reading the mesh pack overlaps instance and device
+		// creation, shader modules, the swapchain, descriptor layout and command pools are
+		// created in parallel once the device exists, and the mesh upload overlaps pipeline
+		// creation. Every use of a command pool is ordered by the edges so the pools stay
+		// externally synchronized.
+		PVTaskGraph startup;
+
+		auto windowTask = startup.AddTask("window", [this] { InitWindow(); }, {}, true);
+
+		auto meshFileTask = startup.AddTask("mesh pack read", [this]
+		{
+			meshPack.Open(meshPackFilename);
+			meshPack.Prefetch();
+			std::cout << "Mesh pack " << meshPackFilename << " opened with " << meshPack.GetEntries().size() << " blobs" << std::endl;
+		});
+
+		auto instanceTask = startup.AddTask("instance", [this]
+		{
+			CreateInstance();
+			SetupDebugCallback();
+		}, { windowTask });
+
+		auto surfaceTask = startup.AddTask("surface", [this] { CreateSurface(); }, { instanceTask });
+
+		auto deviceTask = startup.AddTask("device", [this]
+		{
+			GetPhysicalDevices();
+			if (bindlessRequested)
+			{
+				bindlessSupported = PVBindlessTable::QuerySupport(instance, physicalDevice, bindlessCapacity);
+				std::cout << (bindlessSupported ? "Using bindless resource tables" : "Descriptor indexing unavailable, using per-draw descriptor sets") << std::endl;
+			}
+			deviceContext = new PVDeviceContext(physicalDevice, surface);
+			CreateLogicalDevice();
+			deletionQueue = new PVDeletionQueue(&logicalDevice);
+			transferDeletionQueue = new PVDeletionQueue(&logicalDevice);
+			graphicsTimeline = new PVTimeline(&logicalDevice, graphicsQueue);
+			transferTimeline = new PVTimeline(&logicalDevice, transferQueue);
+			framePacer = new PVFramePacer(graphicsTimeline, pacingPolicy, pacingTargetFps);
+			shaderCache = new PVShaderCache(&logicalDevice);
+			shaderCache->SetHotReloadDirectory(shaderHotReloadDirectory);
+			descriptorLayoutCache = new PVDescriptorLayoutCache(&logicalDevice);
+		}, { surfaceTask });
+
+		auto vertexShaderTask = startup.AddTask("vertex shader", [this] { shaderCache->GetModule(PVShaders::Vertex); }, { deviceTask });
+
+		auto fragmentShaderTask = startup.AddTask("fragment shader", [this] { shaderCache->GetModule(PVShaders::Fragment); }, { deviceTask });
+
+		auto swapchainTask = startup.AddTask("swapchain", [this]
+		{
+			swapchain = new PVSwapchain();
+			swapchain->SetPresentModePreference(framePacer->GetPresentModePreference());
+			swapchain->SetImageCount(swapchainImageCount);
+			swapchain->Create(deviceContext, &windowObj, QuerySwapChainSupport(physicalDevice));
+			framePacer->SetSwapchainInfo(swapchain->GetPresentMode(), static_cast<uint32_t>(swapchain->GetImageCount()));
+			CreateRenderGraph();
+		}, { deviceTask });
+
+		auto descriptorLayoutTask = startup.AddTask("descriptor set layout", [this]
+		{
+			CreateDescriptorSetlayout();
+			if (bindlessSupported)
+			{
+				bindlessTable = new PVBindlessTable(&logicalDevice, bindlessCapacity);
+			}
+		}, { deviceTask });
+
+		auto pipelineTask = startup.AddTask("graphics pipeline", [this] { CreateGraphicsPipeline(); },
+			{ swapchainTask, descriptorLayoutTask, vertexShaderTask, fragmentShaderTask });
+
+		auto commandPoolTask = startup.AddTask("command pools", [this]
+		{
+			const QueueFamilyIndices& indices = deviceContext->GetQueueFamilyIndices();
+			graphicsCommandPool = new PVCommandPool(&logicalDevice, indices.graphicsFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+			transferCommandPool = new PVCommandPool(&logicalDevice, indices.transferFamily , VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+
+			uploadContext.commandPool = transferCommandPool->GetCommandPool();
+			uploadContext.timeline = transferTimeline;
+			uploadContext.deletionQueue = transferDeletionQueue;
+		}, { deviceTask });
+
+		// the only user of the transfer command pool during startup
+		auto meshUploadTask = startup.AddTask("mesh upload", [this] { CreateMeshBuffers(); }, { commandPoolTask, meshFileTask });
+
+		auto uniformBufferTask = startup.AddTask("uniform buffers", [this]
+		{
+			CreateFrameBuffers();
+			CreateProps();
+			CreateTerrain();
+			CreateTextures();
+		}, { commandPoolTask });
+
+		auto acquireTask = startup.AddTask("ownership acquire", [this]
+		{
+			transferWaitValue = std::max(vertexBuffer->GetUploadValue(), indexBuffer->GetUploadValue());
+			AcquireUploadedBuffers({ vertexBuffer, indexBuffer });
+		}, { meshUploadTask });
+
+		startup.AddTask("culling instances", [this] { SetCullingInstances(); }, { swapchainTask, uniformBufferTask, meshUploadTask });
+
+		startup.AddTask("descriptor sets", [this]
+		{
+			CreateDescriptorAllocators();
+			CreateDescriptorSets();
+			CreateMaterials();
+		}, { descriptorLayoutTask, uniformBufferTask });
+
+		// allocates from the graphics command pool, so it has to come after the acquire
+		startup.AddTask("command buffers", [this]
+		{
+			CreateCommandBuffers();
+			gpuTimer = new PVGpuTimer(deviceContext, MAX_FRAMES_IN_FLIGHT);
+		}, { acquireTask });
 
-		vertexBuffer = new PVVertexBuffer(&logicalDevice, &physicalDevice, &surface, transferCommandPool->GetCommandPool(), &transferQueue);
-		indexBuffer = new PVIndexBuffer(&logicalDevice, &physicalDevice, &surface, transferCommandPool->GetCommandPool(), &transferQueue);
-		uniformBuffer = new PVUniformBuffer(&logicalDevice, &physicalDevice, &surface, transferCommandPool->GetCommandPool(), &transferQueue);
+		startup.AddTask("sync objects", [this] { CreateSyncObjects(); }, { deviceTask });
 
-		CreateDescriptorPool();
-		CreateDescriptorSet();
+		startup.Execute(initThreadCount);
+		startup.PrintReport(std::cout);
 
-		CreateCommandBuffers();
-		CreateSemaphores();
+		RunBufferBenchmark();
+		RunSharingBenchmark();
 	}
 
 	void PlanetVulkan::CleanupVulkan()
 	{
+		renderGraph->Cleanup();
+		if (occlusionCuller != nullptr)
+		{
+			occlusionCuller->Cleanup();
+		}
+		deletionQueue->FlushAll();
+		transferDeletionQueue->FlushAll();
+
 		CleanupSwapChain();
 
-		vkDestroyDescriptorPool(logicalDevice, descriptorPool, nullptr);
+		std::cout << "Descriptor sets: " << descriptorAllocator->GetAllocatedSetCount() << " allocated in "
+			<< descriptorAllocator->GetPoolCount() << " pool(s), " << descriptorLayoutCache->GetLayoutCount() << " layout(s)" << std::endl;
+		descriptorAllocator->Cleanup();
+		for (auto frameAllocator : frameDescriptorAllocators)
+		{
+			frameAllocator->Cleanup();
+		}
+
+		descriptorLayoutCache->Cleanup();
+
+		if (bindlessTable != nullptr)
+		{
+			bindlessTable->Cleanup();
+		}
 
-		vkDestroyDescriptorSetLayout(logicalDevice, descriptorSetlayout, nullptr);
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			cameraBuffers[i]->CleanupUniformBuffer(&logicalDevice);
+			drawBuffers[i]->CleanupUniformBuffer(&logicalDevice);
+		}
+		for (auto instanceBuffer : instanceBuffers)
+		{
+			instanceBuffer->Cleanup(&logicalDevice);
+		}
+		if (terrain != nullptr)
+		{
+			terrain->Cleanup();
+		}
+		if (virtualTexture != nullptr)
+		{
+			virtualTexture->Cleanup();
+		}
+		textureStreamer->Cleanup();
 
-		uniformBuffer->CleanupUniformBuffer(&logicalDevice);
+		gpuTimer->Cleanup();
 
 		indexBuffer->CleanupIndexBuffer(&logicalDevice);
 
 		vertexBuffer->Cleanup(&logicalDevice);
+		if (materialBuffer != nullptr)
+		{
+			materialBuffer->Cleanup(&logicalDevice);
+			vkDestroySampler(logicalDevice, materialSampler, PVHostAllocator::Callbacks(PVAllocationType::Other));
+		}
+		for (auto sharingBuffer : sharingBuffers)
+		{
+			if (sharingBuffer != nullptr)
+			{
+				sharingBuffer->Cleanup(&logicalDevice);
+			}
+		}
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			vkDestroySemaphore(logicalDevice, renderFinishedSemaphores[i], PVHostAllocator::Callbacks(PVAllocationType::Sync));
+			vkDestroySemaphore(logicalDevice, imageAvailableSemaphores[i], PVHostAllocator::Callbacks(PVAllocationType::Sync));
+		}
+		graphicsTimeline->Cleanup();
+		transferTimeline->Cleanup();
 
-		vkDestroySemaphore(logicalDevice, renderFinishedSemaphore, VK_NULL_HANDLE);
-		vkDestroySemaphore(logicalDevice, imageAvailableSemaphore, VK_NULL_HANDLE);
+		shaderCache->Cleanup();
 
 		graphicsCommandPool->Cleanup(&logicalDevice);
 		transferCommandPool->Cleanup(&logicalDevice);
 
-		vkDestroyDevice(logicalDevice, VK_NULL_HANDLE);
-		DestroyDebugReportCallbackEXT(instance, callback, VK_NULL_HANDLE);
-		vkDestroySurfaceKHR(instance, surface, VK_NULL_HANDLE);
-		vkDestroyInstance(instance, VK_NULL_HANDLE);
+		vkDestroyDevice(logicalDevice, PVHostAllocator::Callbacks(PVAllocationType::Device));
+		DestroyDebugReportCallbackEXT(instance, callback, PVHostAllocator::Callbacks(PVAllocationType::Other));
+		vkDestroySurfaceKHR(instance, surface, PVHostAllocator::Callbacks(PVAllocationType::Surface));
+		vkDestroyInstance(instance, PVHostAllocator::Callbacks(PVAllocationType::Instance));
+
+		PVHostAllocator::Get().PrintReport(std::cout);
+		if (PVHostAllocator::Get().CheckForLeaks(std::cout))
+		{
+			std::cout << "All driver host allocations were freed" << std::endl;
+		}
 		glfwDestroyWindow(windowObj.window);
 		glfwTerminate();
 	}
 
 	void PlanetVulkan::CleanupSwapChain()
 	{
-		swapchain->CleanupFramebuffers();
-
 		vkFreeCommandBuffers(logicalDevice, *graphicsCommandPool->GetCommandPool(), static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
 
-		vkDestroyPipeline(logicalDevice, graphicsPipeline, VK_NULL_HANDLE);
-		vkDestroyPipelineLayout(logicalDevice, pipelineLayout, VK_NULL_HANDLE);
-		vkDestroyRenderPass(logicalDevice, renderPass, VK_NULL_HANDLE);
+		vkDestroyPipeline(logicalDevice, graphicsPipeline, PVHostAllocator::Callbacks(PVAllocationType::Pipeline));
+		if (rebindPipeline != VK_NULL_HANDLE)
+		{
+			vkDestroyPipeline(logicalDevice, rebindPipeline, PVHostAllocator::Callbacks(PVAllocationType::Pipeline));
+		}
+		if (instancedPipeline != VK_NULL_HANDLE)
+		{
+			vkDestroyPipeline(logicalDevice, instancedPipeline, PVHostAllocator::Callbacks(PVAllocationType::Pipeline));
+		}
+		if (terrainPipeline != VK_NULL_HANDLE)
+		{
+			vkDestroyPipeline(logicalDevice, terrainPipeline, PVHostAllocator::Callbacks(PVAllocationType::Pipeline));
+		}
+		if (terrainPipelineLayout != VK_NULL_HANDLE)
+		{
+			vkDestroyPipelineLayout(logicalDevice, terrainPipelineLayout, PVHostAllocator::Callbacks(PVAllocationType::PipelineLayout));
+		}
+		vkDestroyPipelineLayout(logicalDevice, pipelineLayout, PVHostAllocator::Callbacks(PVAllocationType::PipelineLayout));
 
 		swapchain->Cleanup();
 	}
 
 	void PlanetVulkan::GameLoop()
 	{
-		while (!glfwWindowShouldClose(windowObj.window))
+		// The simulation runs on this thread at a fixed rate and publishes a snapshot after every
+		// step. Frames are drawn from the latest snapshot on the render thread, which never waits
+		// for the simulation and is never waited on by it; input is handled as it arrives even
+		// while the render thread is blocked on present.
+		PublishSnapshot();
+
+		loopReportStart = std::chrono::steady_clock::now();
+		processCpuAtReport = PVCpuTime::GetProcessSeconds();
+
+		std::thread renderThread;
+		if (renderThreadEnabled)
 		{
-			glfwPollEvents();
+			renderRunning = true;
+			renderThread = std::thread(&PlanetVulkan::RenderLoop, this);
+		}
+
+		const double stepSeconds = 1.0 / simulationRate;
+		double accumulator = 0.0;
+		auto previousTime = std::chrono::steady_clock::now();
+
+		while (!glfwWindowShouldClose(windowObj.window) && !renderFailed)
+		{
+			if (renderThreadEnabled)
+			{
+				// sleeps until the next step is due, input wakes it early
+				glfwWaitEventsTimeout(std::max(stepSeconds - accumulator, 0.0));
+			}
+			else
+			{
+				glfwPollEvents();
+			}
 
-			//Update transformation matrices
-			uniformBuffer->Update(&logicalDevice, *swapchain->GetExtent());
+			auto now = std::chrono::steady_clock::now();
+			accumulator = std::min(accumulator + std::chrono::duration<double>(now - previousTime).count(), stepSeconds * MAX_SIMULATION_STEPS);
+			previousTime = now;
+
+			bool stepped = false;
+			while (accumulator >= stepSeconds)
+			{
+				StepSimulation(stepSeconds);
+				accumulator -= stepSeconds;
+				stepped = true;
+			}
+			if (stepped)
+			{
+				PublishSnapshot();
+			}
+
+			if (renderThreadEnabled)
+			{
+				simulationCpuSeconds.store(PVCpuTime::GetThreadSeconds(), std::memory_order_relaxed);
+			}
+			else
+			{
+				RenderFrame();
+			}
+		}
 
-			DrawFrame();
+		if (renderThreadEnabled)
+		{
+			renderRunning = false;
+			renderThread.join();
 		}
 
+		// full teardown, the presentation engine may still hold semaphores the timelines cannot see
 		vkDeviceWaitIdle(logicalDevice);
 		CleanupVulkan();
+
+		if (renderError)
+		{
+			std::rethrow_exception(renderError);
+		}
+	}
+
+	void PlanetVulkan::RecordInput(int key, int action)
+	{
+		inputTimes[inputCount % INPUT_HISTORY] = std::chrono::steady_clock::now();
+		inputCount++;
+
+		if (key == GLFW_KEY_SPACE && action == GLFW_PRESS)
+		{
+			rotationDirection = -rotationDirection;
+		}
+	}
+
+	void PlanetVulkan::StepSimulation(double stepSeconds)
+	{
+		float step = static_cast<float>(stepSeconds);
+
+		// held arrow keys orbit the camera around the quad
+		const float orbitSpeed = glm::radians(90.0f);
+		if (glfwGetKey(windowObj.window, GLFW_KEY_LEFT) == GLFW_PRESS)
+		{
+			cameraYaw -= orbitSpeed * step;
+		}
+		if (glfwGetKey(windowObj.window, GLFW_KEY_RIGHT) == GLFW_PRESS)
+		{
+			cameraYaw += orbitSpeed * step;
+		}
+
+		// craters land at random on the terrain, the renderer picks the edits up in its next frame
+		if (terrain != nullptr && terrainImpactsPerSecond > 0.0)
+		{
+			terrainImpactDebt += terrainImpactsPerSecond * stepSeconds;
+			std::uniform_real_distribution<float> position(0.0f, terrain->GetSize());
+			std::uniform_real_distribution<float> radius(0.15f, 0.6f);
+			while (terrainImpactDebt >= 1.0)
+			{
+				float impactRadius = radius(impactRandom);
+				terrain->ApplyBrush({ glm::vec2(position(impactRandom), position(impactRandom)), impactRadius, -0.25f * impactRadius });
+				terrainImpactDebt -= 1.0;
+			}
+		}
+
+		simulationRotation += rotationDirection * glm::radians(90.0f) * step;
+		simulationTime += stepSeconds;
+		simulationTick++;
+	}
+
+	void PlanetVulkan::PublishSnapshot()
+	{
+		PVSceneSnapshot& snapshot = snapshots.BeginWrite();
+		snapshot.tick = simulationTick;
+		snapshot.simulationTime = simulationTime;
+		snapshot.rotation = simulationRotation;
+
+		const float orbitRadius = 2.0f * std::sqrt(2.0f);
+		glm::dvec3 eye = sceneOrigin + glm::dvec3(orbitRadius * std::cos(cameraYaw), orbitRadius * std::sin(cameraYaw), 2.0);
+		snapshot.cameraPosition = eye;
+		snapshot.view = PVCameraRelative::View(eye, sceneOrigin, glm::vec3(0.0f, 0.0f, 1.0f));
+
+		// the oldest key event no frame has shown yet, older ones than the history holds are dropped
+		uint64_t firstUnrendered = std::max(renderedInputCount.load(std::memory_order_acquire),
+			inputCount > INPUT_HISTORY ? inputCount - INPUT_HISTORY : 0);
+		snapshot.inputCount = inputCount;
+		if (firstUnrendered < inputCount)
+		{
+			snapshot.inputTime = inputTimes[firstUnrendered % INPUT_HISTORY];
+		}
+
+		snapshots.Publish();
+	}
+
+	void PlanetVulkan::RenderLoop()
+	{
+		try
+		{
+			while (renderRunning)
+			{
+				RenderFrame();
+			}
+		}
+		catch (...)
+		{
+			renderError = std::current_exception();
+			renderFailed = true;
+			// wake the simulation thread so it notices
+			glfwPostEmptyEvent();
+		}
+	}
+
+	void PlanetVulkan::RenderFrame()
+	{
+		framePacer->WaitForFrameStart();
+
+		snapshots.Acquire();
+		const PVSceneSnapshot& snapshot = snapshots.Read();
+
+		size_t frame = currentFrame;
+		uint64_t allocationsBefore = allocationCounter ? CountHeapAllocations() : 0;
+		bool drawn = DrawFrame(snapshot);
+		if (allocationCounter)
+		{
+			ReportFrameAllocations(CountHeapAllocations() - allocationsBefore);
+		}
+
+		// the first frame to show new input starts its latency measurement
+		if (drawn && snapshot.inputCount > renderedInputCount.load(std::memory_order_relaxed))
+		{
+			frameInputs[frame].pending = true;
+			frameInputs[frame].inputTime = snapshot.inputTime;
+			renderedInputCount.store(snapshot.inputCount, std::memory_order_release);
+		}
+
+		if (!firstFrameReported)
+		{
+			firstFrameReported = true;
+			double initMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - initStart).count();
+			std::cout << "Time to first frame: " << initMs << " ms" << std::endl;
+			renderCpuAtReport = PVCpuTime::GetThreadSeconds();
+		}
+
+		if (++loopReportFrames == 300)
+		{
+			ReportFrameLoop();
+		}
+	}
+
+	void PlanetVulkan::MeasureInputLatency()
+	{
+		// taken when the CPU notices the GPU finished, which may be up to a frame late, and
+		// scanout adds up to one more refresh on top
+		auto now = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			if (frameInputs[i].pending && graphicsTimeline->IsComplete(frameTimelineValues[i]))
+			{
+				double latencyMs = std::chrono::duration<double, std::milli>(now - frameInputs[i].inputTime).count();
+				latencySumMs += latencyMs;
+				latencyMaxMs = std::max(latencyMaxMs, latencyMs);
+				latencySamples++;
+				frameInputs[i].pending = false;
+			}
+		}
+	}
+
+	void PlanetVulkan::ReportFrameLoop()
+	{
+		auto now = std::chrono::steady_clock::now();
+		double wallSeconds = std::chrono::duration<double>(now - loopReportStart).count();
+		double processCpu = PVCpuTime::GetProcessSeconds();
+		double renderCpu = PVCpuTime::GetThreadSeconds();
+
+		std::cout << "Frame loop (" << (renderThreadEnabled ? "render thread" : "single thread") << "): " << loopReportFrames << " frames in "
+			<< wallSeconds << " s, ";
+		if (latencySamples > 0)
+		{
+			std::cout << "input to photon " << latencySumMs / latencySamples << " ms average, " << latencyMaxMs << " ms worst over "
+				<< latencySamples << " inputs, ";
+		}
+		else
+		{
+			std::cout << "no input, ";
+		}
+		std::cout << "CPU " << 100.0 * (processCpu - processCpuAtReport) / wallSeconds << "% of a core for the process";
+		if (renderThreadEnabled)
+		{
+			double simulationCpu = simulationCpuSeconds.load(std::memory_order_relaxed);
+			std::cout << ", " << 100.0 * (simulationCpu - simulationCpuAtReport) / wallSeconds << "% simulation thread, "
+				<< 100.0 * (renderCpu - renderCpuAtReport) / wallSeconds << "% render thread" << std::endl;
+			simulationCpuAtReport = simulationCpu;
+		}
+		else
+		{
+			std::cout << ", " << 100.0 * (renderCpu - renderCpuAtReport) / wallSeconds << "% main thread" << std::endl;
+		}
+
+		loopReportFrames = 0;
+		loopReportStart = now;
+		processCpuAtReport = processCpu;
+		renderCpuAtReport = renderCpu;
+		latencySumMs = 0.0;
+		latencyMaxMs = 0.0;
+		latencySamples = 0;
 	}
 
 	void PlanetVulkan::InitWindow()
@@ -118,18 +577,34 @@ namespace PVEngine
 		windowObj.Create();
 		glfwSetWindowUserPointer(windowObj.window, this);
 		glfwSetWindowSizeCallback(windowObj.window,PlanetVulkan::OnWindowResized);
+		glfwSetKeyCallback(windowObj.window, PlanetVulkan::OnKey);
 	}
 
 	void PlanetVulkan::RecreateSwapChain()
 	{
-		vkDeviceWaitIdle(logicalDevice);
-		CleanupSwapChain();
+		// the old objects may still be in use by frames in flight, so rather than draining the
+		// device they are destroyed once the last submitted frame has completed
+		// the command buffers are recorded every frame and need no rebuilding
+		uint64_t heapAllocationsBefore = PVHostAllocator::Get().GetHeapAllocationCount();
+		uint64_t pooledAllocationsBefore = PVHostAllocator::Get().GetPooledAllocationCount();
+
+		// the pipelines are kept, viewport and scissor are dynamic and the render passes the graph
+		// rebuilds have the same attachment formats, so they stay compatible
+		uint64_t lastUsedFrame = graphicsTimeline->GetLastSubmittedValue();
+		swapchain->Retire(deletionQueue, lastUsedFrame);
+
+		swapchain->Create(deviceContext, &windowObj, QuerySwapChainSupport(physicalDevice, frameArenas[currentFrame]));
+		framePacer->SetSwapchainInfo(swapchain->GetPresentMode(), static_cast<uint32_t>(swapchain->GetImageCount()));
+		renderGraph->Compile(*swapchain->GetExtent(), lastUsedFrame);
+		if (occlusionCuller != nullptr)
+		{
+			occlusionCuller->Resize(*swapchain->GetExtent(), lastUsedFrame);
+		}
 
-		swapchain->Create(&logicalDevice, &physicalDevice, &surface, &windowObj, QuerySwapChainSupport(physicalDevice));
-		CreateRenderPass();
-		CreateGraphicsPipeline();
-		swapchain->CreateFramebuffers(&renderPass);
-		CreateCommandBuffers();
+		// once the pool is warm the driver's allocations for the new objects should be reusing
+		// the blocks the retired ones gave back
+		std::cout << "Swapchain recreated, driver made " << PVHostAllocator::Get().GetPooledAllocationCount() - pooledAllocationsBefore
+			<< " pooled and " << PVHostAllocator::Get().GetHeapAllocationCount() - heapAllocationsBefore << " heap allocations" << std::endl;
 	}
 
 	void PlanetVulkan::CreateInstance()
@@ -176,7 +651,7 @@ namespace PVEngine
 		createInfo.enabledExtensionCount = extensions.size();
 		createInfo.ppEnabledExtensionNames = extensions.data();
 
-		if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS)
+		if (vkCreateInstance(&createInfo, PVHostAllocator::Callbacks(PVAllocationType::Instance), &instance) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create instance!");
 		}
@@ -227,6 +702,9 @@ namespace PVEngine
 			extensions.push_back(glfwExtensions[i]);
 		}
 
+		// required by VK_KHR_timeline_semaphore on a 1.0 instance
+		extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+
 		if (enableValidationLayers)
 		{
 			extensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
@@ -247,7 +725,7 @@ namespace PVEngine
 		createInfo.flags = VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT;
 		createInfo.pfnCallback = debugCallback;
 
-		if (CreateDebugReportCallbackEXT(instance, &createInfo, nullptr, &callback) != VK_SUCCESS)
+		if (CreateDebugReportCallbackEXT(instance, &createInfo, PVHostAllocator::Callbacks(PVAllocationType::Other), &callback) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to set up debug callback");
 		}
@@ -259,7 +737,7 @@ namespace PVEngine
 
 	void PlanetVulkan::CreateSurface()
 	{
-		if (glfwCreateWindowSurface(instance, windowObj.window, nullptr, &surface) != VK_SUCCESS)
+		if (glfwCreateWindowSurface(instance, windowObj.window, PVHostAllocator::Callbacks(PVAllocationType::Surface), &surface) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create window surface");
 		}
@@ -300,9 +778,9 @@ namespace PVEngine
 		}
 	}
 
-	SwapChainSupportDetails PlanetVulkan::QuerySwapChainSupport(VkPhysicalDevice device)
+	SwapChainSupportDetails PlanetVulkan::QuerySwapChainSupport(VkPhysicalDevice device, std::pmr::memory_resource* memory)
 	{
-		SwapChainSupportDetails details;
+		SwapChainSupportDetails details(memory);
 
 		// capabilities
 		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
@@ -373,7 +851,7 @@ namespace PVEngine
 
 	void PlanetVulkan::CreateLogicalDevice()
 	{
-		QueueFamilyIndices indices = FindQueueFamilies(&physicalDevice, &surface);
+		const QueueFamilyIndices& indices = deviceContext->GetQueueFamilyIndices();
 
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 		std::set<int> uniqueQueueFamilies = { indices.graphicsFamily, indices.transferFamily };
@@ -391,13 +869,34 @@ namespace PVEngine
 		}
 		
 
+		// statistics only for the occlusion culling overdraw report, fragment stores for the
+		// virtual texture's feedback
 		VkPhysicalDeviceFeatures deviceFeatures = {};
+		deviceFeatures.pipelineStatisticsQuery = deviceContext->GetFeatures().pipelineStatisticsQuery;
+		deviceFeatures.fragmentStoresAndAtomics = deviceContext->GetFeatures().fragmentStoresAndAtomics;
+		// KTX2 textures may hold BCn data
+		deviceFeatures.textureCompressionBC = deviceContext->GetFeatures().textureCompressionBC;
+		virtualTexturingSupported = terrainRequested && deviceFeatures.fragmentStoresAndAtomics;
+
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+		timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+		timelineFeatures.timelineSemaphore = VK_TRUE;
+
+		std::vector<const char*> extensions = deviceExtensions;
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = PVBindlessTable::GetRequiredFeatures();
+		if (bindlessSupported)
+		{
+			const auto& bindlessExtensions = PVBindlessTable::GetRequiredDeviceExtensions();
+			extensions.insert(extensions.end(), bindlessExtensions.begin(), bindlessExtensions.end());
+			timelineFeatures.pNext = &indexingFeatures;
+		}
 
 		VkDeviceCreateInfo createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-		createInfo.pNext = nullptr;
+		createInfo.pNext = &timelineFeatures;
 		createInfo.flags = 0;
-		createInfo.queueCreateInfoCount = 1;
+		// the transfer family gets its own queue when it differs from the graphics one
+		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 		if (enableValidationLayers)
 		{
@@ -409,11 +908,11 @@ namespace PVEngine
 			createInfo.enabledLayerCount = 0;
 			createInfo.ppEnabledLayerNames = nullptr;
 		}
-		createInfo.enabledExtensionCount = deviceExtensions.size();
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+		createInfo.enabledExtensionCount = extensions.size();
+		createInfo.ppEnabledExtensionNames = extensions.data();
 		createInfo.pEnabledFeatures = &deviceFeatures;
 
-		if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &logicalDevice) != VK_SUCCESS)
+		if (vkCreateDevice(physicalDevice, &createInfo, PVHostAllocator::Callbacks(PVAllocationType::Device), &logicalDevice) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create logical device");
 		}
@@ -421,6 +920,7 @@ namespace PVEngine
 		{
 			std::cout << "Logical device created successfully" << std::endl;
 		}
+		deviceContext->SetLogicalDevice(logicalDevice);
 
 		vkGetDeviceQueue(logicalDevice, indices.graphicsFamily, 0, &graphicsQueue);
 		vkGetDeviceQueue(logicalDevice, indices.transferFamily, 0, &transferQueue);
@@ -429,154 +929,394 @@ namespace PVEngine
 
 
 
-	void PlanetVulkan::CreateRenderPass()
+	void PlanetVulkan::CreateRenderGraph()
 	{
-		VkAttachmentDescription colorAttachment = {};
-		colorAttachment.format = *swapchain->GetImageFormat();
-		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-		VkAttachmentReference colorAttachmentRef = {};
-		colorAttachmentRef.attachment = 0;
-		colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-		VkSubpassDescription subpass = {};
-		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpass.colorAttachmentCount = 1;
-		subpass.pColorAttachments = &colorAttachmentRef;
-
-		VkSubpassDependency dependency = {};
-		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency.dstSubpass = 0;
-		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.srcAccessMask = 0;
-		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		renderGraph = new PVRenderGraph(deviceContext, deletionQueue);
 
-		VkRenderPassCreateInfo renderPassInfo = {};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		renderPassInfo.attachmentCount = 1;
-		renderPassInfo.pAttachments = &colorAttachment;
-		renderPassInfo.subpassCount = 1;
-		renderPassInfo.pSubpasses = &subpass;
-		renderPassInfo.dependencyCount = 1;
-		renderPassInfo.pDependencies = &dependency;
-
-		if (vkCreateRenderPass(logicalDevice, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to create render pass");
-		}
-		else
+		// the draw benchmark compares GPU times, which a changing resolution would skew
+		if (dynamicResolutionRequested && benchmarkDrawCount == 0)
 		{
-			std::cout << "Render Pass created successfully" << std::endl;
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(physicalDevice, *swapchain->GetImageFormat(), &formatProperties);
+			VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+			if ((formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures && (swapchain->GetImageUsage() & VK_IMAGE_USAGE_TRANSFER_DST_BIT) != 0)
+			{
+				float maxScale = std::min(resolutionMaxScale, 1.0f);
+				resolutionScaler = new PVResolutionScaler(resolutionTargetGpuMs, std::min(resolutionMinScale, maxScale), maxScale);
+				std::cout << "Using dynamic resolution" << std::endl;
+			}
+			else
+			{
+				std::cout << "Swapchain images can't be blitted to, rendering at full resolution" << std::endl;
+			}
 		}
-	}
-
-	void PlanetVulkan::CreateDescriptorSetlayout()
-	{
-		VkDescriptorSetLayoutBinding uboLayoutBinding = {};
-		uboLayoutBinding.binding = 0;
-		uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		uboLayoutBinding.descriptorCount = 1;
-		uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		layoutInfo.bindingCount = 1;
-		layoutInfo.pBindings = &uboLayoutBinding;
 
-		if (vkCreateDescriptorSetLayout(logicalDevice, &layoutInfo, nullptr, &descriptorSetlayout) != VK_SUCCESS)
+		PVRenderGraph::ImageDesc colorDesc;
+		colorDesc.format = *swapchain->GetImageFormat();
+		colorDesc.clear = true;
+		colorDesc.clearValue = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+		PVRenderGraph::ImageDesc swapchainDesc = colorDesc;
+		swapchainDesc.clear = (resolutionScaler == nullptr);
+		// the acquire semaphore is waited on at color attachment output, previous contents are discarded
+		swapchainColor = renderGraph->ImportImage("swapchain", swapchainDesc, VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+		// with dynamic resolution the scene goes to a window sized image first, the scaled
+		// render area moves around inside it so it is never reallocated
+		PVRenderGraph::ResourceHandle forwardTarget = swapchainColor;
+		if (resolutionScaler != nullptr)
 		{
-			throw std::runtime_error("Failed to create descriptor set layout");
+			sceneColor = renderGraph->CreateImage("scene color", colorDesc);
+			forwardTarget = sceneColor;
 		}
-		else
+
+		// Reversed-Z, cleared to 0 as the far value. Without occlusion culling nothing reads it
+		// after the forward pass, so the graph discards it at the end of the render pass and backs
+		// it with lazily allocated memory where the device has it. It is recreated on every
+		// compile at the new extent.
+		PVRenderGraph::ImageDesc depthDesc;
+		depthDesc.format = deviceContext->FindDepthFormat();
+		depthDesc.clear = true;
+		depthDesc.clearValue.depthStencil = { 0.0f, 0 };
+		depthBuffer = renderGraph->CreateImage("depth", depthDesc);
+
+		// the Hi-Z pyramid is built by sampling the depth buffer
+		if (occlusionCullingRequested && propCount > 0)
 		{
-			std::cout << "Descriptor Set Layout created successfully" << std::endl;
+			VkFormatProperties depthProperties;
+			vkGetPhysicalDeviceFormatProperties(physicalDevice, depthDesc.format, &depthProperties);
+			if (depthProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)
+			{
+				occlusionCuller = new PVOcclusionCuller(deviceContext, deletionQueue, shaderCache, descriptorLayoutCache, MAX_FRAMES_IN_FLIGHT);
+				occlusionCuller->Resize(*swapchain->GetExtent(), 0);
+				std::cout << "Using Hi-Z occlusion culling" << std::endl;
+			}
+			else
+			{
+				std::cout << "Depth format can't be sampled, props are only frustum culled" << std::endl;
+			}
 		}
-	}
-
-	void PlanetVulkan::CreateDescriptorPool()
-	{
-		VkDescriptorPoolSize poolSize = {};
-		poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		poolSize.descriptorCount = 1;
 
-		VkDescriptorPoolCreateInfo poolInfo = {};
-		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		poolInfo.poolSizeCount = 1;
-		poolInfo.pPoolSizes = &poolSize;
-		poolInfo.maxSets = 1;
+		textureAcquirePass = renderGraph->AddPass("texture acquire", PVRenderGraph::PassType::Transfer, [this](VkCommandBuffer commandBuffer)
+		{
+			textureStreamer->RecordAcquire(commandBuffer, graphicsTimeline->GetLastSubmittedValue());
+			UpdateMaterialTexture(graphicsTimeline->GetLastSubmittedValue());
+		});
 
-		if (vkCreateDescriptorPool(logicalDevice, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+		if (terrainRequested)
 		{
-			throw std::runtime_error("Failed to create descriptor pool");
+			terrainUploadPass = renderGraph->AddPass("terrain upload", PVRenderGraph::PassType::Transfer, [this](VkCommandBuffer commandBuffer)
+			{
+				terrain->RecordUpload(commandBuffer, static_cast<uint32_t>(currentFrame));
+			});
 		}
-		else
+
+		if (virtualTexturingSupported)
 		{
-			std::cout << "Descriptor Pool created successfully" << std::endl;
+			virtualTextureUploadPass = renderGraph->AddPass("virtual texture upload", PVRenderGraph::PassType::Transfer, [this](VkCommandBuffer commandBuffer)
+			{
+				virtualTexture->RecordUpload(commandBuffer, static_cast<uint32_t>(currentFrame));
+			});
 		}
-	}
 
-	void PlanetVulkan::CreateDescriptorSet()
-	{
-		VkDescriptorSetLayout layouts[] = { descriptorSetlayout };
-		VkDescriptorSetAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocInfo.descriptorPool = descriptorPool;
-		allocInfo.descriptorSetCount = 1;
-		allocInfo.pSetLayouts = layouts;
-		if(vkAllocateDescriptorSets(logicalDevice, &allocInfo, &descriptorSet) != VK_SUCCESS)
+		if (occlusionCuller != nullptr)
 		{
-			throw std::runtime_error("Failed to create descriptor set");
+			earlyCullPass = renderGraph->AddPass("early cull", PVRenderGraph::PassType::Compute, [this](VkCommandBuffer commandBuffer)
+			{
+				occlusionCuller->RecordCull(commandBuffer, PVOcclusionCuller::Phase::Early, static_cast<uint32_t>(currentFrame), descriptorAllocator);
+			});
 		}
-		else
+
+		forwardPass = renderGraph->AddPass("forward", PVRenderGraph::PassType::Graphics, [this](VkCommandBuffer commandBuffer)
 		{
-			std::cout << "Descriptor Set created successfully" << std::endl;
-		}
-		VkDescriptorBufferInfo bufferInfo = {};
-		bufferInfo.buffer = *uniformBuffer->GetBuffer();
-		bufferInfo.offset = 0;
-		bufferInfo.range = uniformBuffer->GetUniformBufferSize();
+			SetForwardViewport(commandBuffer);
+
+			// with bindless the resource table rides along in the same bind as set 1, the sets stay
+			// bound across every pipeline below since they share the layout
+			VkDescriptorSet sets[] = { descriptorSets[currentFrame], bindlessTable != nullptr ? bindlessTable->GetSet() : VK_NULL_HANDLE };
+			uint32_t setCount = bindlessTable != nullptr ? 2 : 1;
+			uint32_t dynamicOffset = 0;
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, setCount, sets, 1, &dynamicOffset);
+			PushMaterialConstants(commandBuffer);
+
+			// first, so the quads and props below find their own mesh bound
+			if (terrain != nullptr)
+			{
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, terrainPipeline);
+				if (virtualTexture != nullptr)
+				{
+					// set 2, the sets below it stay bound for the pipelines that follow
+					virtualTexture->BindSet(commandBuffer, terrainPipelineLayout, 2, static_cast<uint32_t>(currentFrame), descriptorAllocator);
+				}
+				terrain->RecordDraw(commandBuffer, virtualTexture != nullptr ? terrainPipelineLayout : pipelineLayout);
+			}
 
-		VkWriteDescriptorSet descriptorWrite = {};
-		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrite.dstSet = descriptorSet;
-		descriptorWrite.dstBinding = 0;
-		descriptorWrite.dstArrayElement = 0;
-		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrite.descriptorCount = 1;
-		descriptorWrite.pBufferInfo = &bufferInfo;
+			bool pushConstants = drawPath == DrawPath::PushConstants;
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pushConstants ? graphicsPipeline : rebindPipeline);
 
-		vkUpdateDescriptorSets(logicalDevice, 1, &descriptorWrite, 0, nullptr);
-	}
+			VkBuffer vertexBuffers[] = { *vertexBuffer->GetBuffer() };
+			VkDeviceSize offsets[] = { 0 };
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
 
-	void PlanetVulkan::CreateGraphicsPipeline()
-	{
-		auto vertShaderCode = ReadFile("Shaders/vert.spv");
-		auto fragShaderCode = ReadFile("Shaders/frag.spv");
+			VkBuffer indexBfr = *indexBuffer->GetBuffer();
+			vkCmdBindIndexBuffer(commandBuffer, indexBfr, 0, VK_INDEX_TYPE_UINT32);
 
-		VkShaderModule vertShaderModule;
-		VkShaderModule fragShaderModule;
+			uint32_t indexCount = static_cast<uint32_t>(indexBuffer->GetIndicesSize());
+			for (uint32_t i = 0; i < static_cast<uint32_t>(drawConstants.size()); i++)
+			{
+				if (pushConstants)
+				{
+					vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PVDrawConstants), &drawConstants[i]);
+				}
+				else
+				{
+					// rebinding set 0 leaves the bindless set 1 bound
+					dynamicOffset = static_cast<uint32_t>(i * drawBufferStride);
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 1, &dynamicOffset);
+				}
+				vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+			}
 
-		vertShaderModule = CreateShaderModule(vertShaderCode);
-		fragShaderModule = CreateShaderModule(fragShaderCode);
+			// the sharing benchmark's triangles, from the exclusive or the concurrent buffer by phase
+			if (sharingBuffers[sharingIndex] != nullptr)
+			{
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PVDrawConstants), &drawConstants[0]);
+				VkBuffer sharingVertexBuffers[] = { *sharingBuffers[sharingIndex]->GetBuffer() };
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, sharingVertexBuffers, offsets);
+				vkCmdDraw(commandBuffer, sharingBuffers[sharingIndex]->GetVerticesSize(), 1, 0, 0);
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+			}
 
-		VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
-		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-		vertShaderStageInfo.module = vertShaderModule;
-		vertShaderStageInfo.pName = "main";
+			// props that passed the early phase, the rest wait for the late pass
+			if (occlusionCuller != nullptr)
+			{
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, instancedPipeline);
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PVDrawConstants), &propTileConstants[0]);
+				occlusionCuller->RecordDraw(commandBuffer, PVOcclusionCuller::Phase::Early);
+				return;
+			}
 
-		VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
-		fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		fragShaderStageInfo.module = fragShaderModule;
-		fragShaderStageInfo.pName = "main";
+			// every visible prop in one draw, the transforms come from the instance binding
+			uint32_t instanceCount = instanceBuffers.empty() ? 0 : instanceBuffers[currentFrame]->GetInstanceCount();
+			if (instanceCount > 0)
+			{
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, instancedPipeline);
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PVDrawConstants), &propTileConstants[0]);
+				VkBuffer instanceVertexBuffers[] = { *vertexBuffer->GetBuffer(), *instanceBuffers[currentFrame]->GetBuffer() };
+				VkDeviceSize instanceOffsets[] = { 0, 0 };
+				vkCmdBindVertexBuffers(commandBuffer, 0, 2, instanceVertexBuffers, instanceOffsets);
+				vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, 0, 0, 0);
+			}
+		});
+		renderGraph->Use(forwardPass, forwardTarget, PVRenderGraph::Usage::ColorAttachment);
+		renderGraph->Use(forwardPass, depthBuffer, PVRenderGraph::Usage::DepthAttachment);
+
+		if (occlusionCuller != nullptr)
+		{
+			hiZPass = renderGraph->AddPass("hi-z", PVRenderGraph::PassType::Compute, [this](VkCommandBuffer commandBuffer)
+			{
+				occlusionCuller->RecordPyramid(commandBuffer, static_cast<uint32_t>(currentFrame), renderGraph->GetImageView(depthBuffer), renderExtent,
+					descriptorAllocator);
+			});
+			renderGraph->Use(hiZPass, depthBuffer, PVRenderGraph::Usage::Sampled);
+
+			lateCullPass = renderGraph->AddPass("late cull", PVRenderGraph::PassType::Compute, [this](VkCommandBuffer commandBuffer)
+			{
+				occlusionCuller->RecordCull(commandBuffer, PVOcclusionCuller::Phase::Late, static_cast<uint32_t>(currentFrame), descriptorAllocator);
+			});
+
+			// only the props the early phase got wrong, on top of the early pass's color and depth
+			forwardLatePass = renderGraph->AddPass("forward late", PVRenderGraph::PassType::Graphics, [this](VkCommandBuffer commandBuffer)
+			{
+				SetForwardViewport(commandBuffer);
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, instancedPipeline);
+
+				VkBuffer vertexBuffers[] = { *vertexBuffer->GetBuffer() };
+				VkDeviceSize offsets[] = { 0 };
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+				vkCmdBindIndexBuffer(commandBuffer, *indexBuffer->GetBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+				VkDescriptorSet sets[] = { descriptorSets[currentFrame], bindlessTable != nullptr ? bindlessTable->GetSet() : VK_NULL_HANDLE };
+				uint32_t setCount = bindlessTable != nullptr ? 2 : 1;
+				uint32_t dynamicOffset = 0;
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, setCount, sets, 1, &dynamicOffset);
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PVDrawConstants), &propTileConstants[0]);
+				PushMaterialConstants(commandBuffer);
+
+				occlusionCuller->RecordDraw(commandBuffer, PVOcclusionCuller::Phase::Late);
+			});
+			renderGraph->Use(forwardLatePass, forwardTarget, PVRenderGraph::Usage::ColorAttachment);
+			renderGraph->Use(forwardLatePass, depthBuffer, PVRenderGraph::Usage::DepthAttachment);
+		}
+
+		if (virtualTexturingSupported)
+		{
+			virtualTextureFeedbackPass = renderGraph->AddPass("virtual texture feedback", PVRenderGraph::PassType::Transfer, [this](VkCommandBuffer commandBuffer)
+			{
+				virtualTexture->RecordFeedback(commandBuffer, static_cast<uint32_t>(currentFrame));
+			});
+		}
+
+		if (resolutionScaler != nullptr)
+		{
+			upscalePass = renderGraph->AddPass("upscale", PVRenderGraph::PassType::Transfer, [this](VkCommandBuffer commandBuffer)
+			{
+				VkExtent2D fullExtent = *swapchain->GetExtent();
+				VkImageBlit blit = {};
+				blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+				blit.srcOffsets[1] = { static_cast<int32_t>(renderExtent.width), static_cast<int32_t>(renderExtent.height), 1 };
+				blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+				blit.dstOffsets[1] = { static_cast<int32_t>(fullExtent.width), static_cast<int32_t>(fullExtent.height), 1 };
+				vkCmdBlitImage(commandBuffer, renderGraph->GetImage(sceneColor), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					renderGraph->GetImage(swapchainColor), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+			});
+			renderGraph->Use(upscalePass, sceneColor, PVRenderGraph::Usage::TransferSrc);
+			renderGraph->Use(upscalePass, swapchainColor, PVRenderGraph::Usage::TransferDst);
+		}
+
+		renderGraph->Compile(*swapchain->GetExtent(), graphicsTimeline->GetLastSubmittedValue());
+	}
+
+	void PlanetVulkan::CreateDescriptorSetlayout()
+	{
+		VkDescriptorSetLayoutBinding uboLayoutBinding = {};
+		uboLayoutBinding.binding = 0;
+		uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		uboLayoutBinding.descriptorCount = 1;
+		uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+		VkDescriptorSetLayoutBinding drawLayoutBinding = {};
+		drawLayoutBinding.binding = 1;
+		drawLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		drawLayoutBinding.descriptorCount = 1;
+		drawLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+		descriptorSetlayout = descriptorLayoutCache->GetLayout({ uboLayoutBinding, drawLayoutBinding });
+	}
+
+	void PlanetVulkan::CreateDescriptorAllocators()
+	{
+		descriptorAllocator = new PVDescriptorAllocator(&logicalDevice);
+
+		// pools are only created on first use, slots that never allocate cost nothing
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			frameDescriptorAllocators.push_back(new PVDescriptorAllocator(&logicalDevice));
+		}
+	}
+
+	void PlanetVulkan::CreateDescriptorSets()
+	{
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			descriptorSets.push_back(descriptorAllocator->GetSet(descriptorSetlayout, {
+				PVDescriptorWrite::Buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, *cameraBuffers[i]->GetBuffer(), 0, cameraBuffers[i]->GetUniformBufferSize()),
+				PVDescriptorWrite::Buffer(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, *drawBuffers[i]->GetBuffer(), 0, sizeof(PVDrawConstants)) }));
+		}
+	}
+
+	void PlanetVulkan::CreateFrameBuffers()
+	{
+		// the per-draw buffer is only read by the descriptor rebind path of the draw benchmark
+		VkDeviceSize alignment = deviceContext->GetLimits().minUniformBufferOffsetAlignment;
+		drawBufferStride = (sizeof(PVDrawConstants) + alignment - 1) / alignment * alignment;
+		uint32_t drawCount = std::max(benchmarkDrawCount, 1u);
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			cameraBuffers.push_back(new PVUniformBuffer(deviceContext));
+			drawBuffers.push_back(new PVUniformBuffer(deviceContext, drawBufferStride * drawCount));
+		}
+	}
+
+	void PlanetVulkan::CreateMaterials()
+	{
+		if (bindlessTable == nullptr)
+		{
+			return;
+		}
+
+		// a tint per material
+		const glm::vec4 tints[] = { glm::vec4(1.0f, 1.0f, 1.0f, 1.0f), glm::vec4(0.6f, 0.9f, 0.5f, 1.0f),
+			glm::vec4(0.8f, 0.7f, 0.5f, 1.0f), glm::vec4(0.6f, 0.7f, 0.9f, 1.0f) };
+		materialBuffer = new PVStorageBuffer(deviceContext, sizeof(tints), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true);
+		materialBuffer->Write(tints, 0, sizeof(tints));
+
+		materialConstants.materialBuffer = bindlessTable->RegisterStorageBuffer(*materialBuffer->GetBuffer(), 0, sizeof(tints));
+		materialConstants.materialCount = 4;
+
+		// trilinear over however many levels the material texture's view has
+		VkSamplerCreateInfo samplerInfo = {};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_LINEAR;
+		samplerInfo.minFilter = VK_FILTER_LINEAR;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.minLod = 0.0f;
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+		if (vkCreateSampler(logicalDevice, &samplerInfo, PVHostAllocator::Callbacks(PVAllocationType::Other), &materialSampler) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create material sampler");
+		}
+		materialConstants.albedoSampler = bindlessTable->RegisterSampler(materialSampler);
+		// registered once its coarsest level has streamed in
+		materialConstants.albedoTexture = PVBindlessTable::InvalidHandle;
+		std::cout << "Materials registered at bindless buffer " << materialConstants.materialBuffer << std::endl;
+	}
+
+	void PlanetVulkan::UpdateMaterialTexture(uint64_t retireValue)
+	{
+		if (materialBuffer == nullptr || !materialTextureLoaded)
+		{
+			return;
+		}
+
+		VkImageView view = textureStreamer->GetImageView(materialTexture);
+		if (view == materialTextureView)
+		{
+			return;
+		}
+
+		// frames already submitted keep sampling the old view through the old handle
+		if (materialConstants.albedoTexture != PVBindlessTable::InvalidHandle)
+		{
+			bindlessTable->Release(PVBindlessTable::SampledImages, materialConstants.albedoTexture, retireValue);
+		}
+		materialConstants.albedoTexture = bindlessTable->RegisterSampledImage(view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		materialTextureView = view;
+	}
+
+	void PlanetVulkan::PushMaterialConstants(VkCommandBuffer commandBuffer)
+	{
+		if (materialBuffer != nullptr)
+		{
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PVDrawConstants), sizeof(PVMaterialConstants),
+				&materialConstants);
+		}
+	}
+
+	void PlanetVulkan::CreateGraphicsPipeline()
+	{
+		// modules are owned by the cache and reused when the pipeline is recreated
+		VkShaderModule vertShaderModule = shaderCache->GetModule(PVShaders::Vertex);
+		// with bindless the fragment shader looks the materials up in the table
+		VkShaderModule fragShaderModule = shaderCache->GetModule(bindlessTable != nullptr ? PVShaders::MaterialFragment : PVShaders::Fragment);
+
+		VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
+		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+		vertShaderStageInfo.module = vertShaderModule;
+		vertShaderStageInfo.pName = "main";
+
+		VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
+		fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		fragShaderStageInfo.module = fragShaderModule;
+		fragShaderStageInfo.pName = "main";
 
 		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
@@ -594,24 +1334,11 @@ namespace PVEngine
 		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 		inputAssembly.primitiveRestartEnable = false;
 
-		VkViewport viewport = {};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = (float)swapchain->GetExtent()->width;
-		viewport.height = (float)swapchain->GetExtent()->height;
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-
-		VkRect2D scissor = {};
-		scissor.offset = { 0,0 };
-		scissor.extent = *swapchain->GetExtent();
-
+		// viewport and scissor are dynamic so the pipeline doesn't depend on the swapchain extent
 		VkPipelineViewportStateCreateInfo viewportState = {};
 		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 		viewportState.viewportCount = 1;
-		viewportState.pViewports = &viewport;
 		viewportState.scissorCount = 1;
-		viewportState.pScissors = &scissor;
 
 		VkPipelineRasterizationStateCreateInfo rasterizer = {};
 		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -628,6 +1355,15 @@ namespace PVEngine
 		multisampling.sampleShadingEnable = VK_FALSE;
 		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
+		// reversed-Z, nearer fragments have the greater depth
+		VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depthStencil.depthTestEnable = VK_TRUE;
+		depthStencil.depthWriteEnable = VK_TRUE;
+		depthStencil.depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+		depthStencil.depthBoundsTestEnable = VK_FALSE;
+		depthStencil.stencilTestEnable = VK_FALSE;
+
 		VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
 		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
 		colorBlendAttachment.blendEnable = VK_FALSE;
@@ -638,7 +1374,8 @@ namespace PVEngine
 		colorBlending.attachmentCount = 1;
 		colorBlending.pAttachments = &colorBlendAttachment;
 
-		VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_LINE_WIDTH };
+		// set every frame, dynamic resolution renders to a changing part of the target
+		VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
 
 		VkPipelineDynamicStateCreateInfo dynamicState = {};
 		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
@@ -647,10 +1384,19 @@ namespace PVEngine
 
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 1;
-		pipelineLayoutInfo.pSetLayouts = &descriptorSetlayout;
+		std::vector<VkDescriptorSetLayout> setLayouts = { descriptorSetlayout };
+		if (bindlessTable != nullptr)
+		{
+			setLayouts.push_back(bindlessTable->GetLayout());
+		}
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+		pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+
+		VkPushConstantRange pushConstantRanges[] = { PVDrawConstants::getPushConstantRange(), PVMaterialConstants::getPushConstantRange() };
+		pipelineLayoutInfo.pushConstantRangeCount = bindlessTable != nullptr ? 2 : 1;
+		pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges;
 
-		if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+		if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutInfo, PVHostAllocator::Callbacks(PVAllocationType::PipelineLayout), &pipelineLayout) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create pipeline layout");
 		}
@@ -668,13 +1414,15 @@ namespace PVEngine
 		pipelineInfo.pViewportState = &viewportState;
 		pipelineInfo.pRasterizationState = &rasterizer;
 		pipelineInfo.pMultisampleState = &multisampling;
+		pipelineInfo.pDepthStencilState = &depthStencil;
 		pipelineInfo.pColorBlendState = &colorBlending;
+		pipelineInfo.pDynamicState = &dynamicState;
 		pipelineInfo.layout = pipelineLayout;
-		pipelineInfo.renderPass = renderPass;
-		pipelineInfo.subpass = 0;
+		pipelineInfo.renderPass = renderGraph->GetRenderPass(forwardPass);
+		pipelineInfo.subpass = renderGraph->GetSubpass(forwardPass);
 
 
-		if (vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+		if (vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, PVHostAllocator::Callbacks(PVAllocationType::Pipeline), &graphicsPipeline) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create graphics pipeline");
 		}
@@ -683,40 +1431,118 @@ namespace PVEngine
 			std::cout << "Graphics pipeline created successfully" << std::endl;
 		}
 
-		vkDestroyShaderModule(logicalDevice, vertShaderModule, VK_NULL_HANDLE);
-		vkDestroyShaderModule(logicalDevice, fragShaderModule, VK_NULL_HANDLE);
+		if (propCount > 0)
+		{
+			// per-vertex data on binding 0, per-instance transform, morph and material on binding 1
+			VkVertexInputBindingDescription instancedBindings[] = { bindingDescription, InstanceData::getBindingDescription() };
+			auto instanceAttributes = InstanceData::getAttributeDescriptions();
+			std::vector<VkVertexInputAttributeDescription> instancedAttributes(attributeDescriptions.begin(), attributeDescriptions.end());
+			instancedAttributes.insert(instancedAttributes.end(), instanceAttributes.begin(), instanceAttributes.end());
+
+			VkPipelineVertexInputStateCreateInfo instancedVertexInput = vertexInputInfo;
+			instancedVertexInput.vertexBindingDescriptionCount = 2;
+			instancedVertexInput.pVertexBindingDescriptions = instancedBindings;
+			instancedVertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(instancedAttributes.size());
+			instancedVertexInput.pVertexAttributeDescriptions = instancedAttributes.data();
+
+			VkPipelineShaderStageCreateInfo instancedStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+			instancedStages[0].module = shaderCache->GetModule(PVShaders::InstancedVertex);
+
+			// with bindless material.frag applies the tints, looked up in the table
+			VkBool32 bindlessMaterials = VK_TRUE;
+			VkSpecializationMapEntry materialEntry = { 0, 0, sizeof(VkBool32) };
+			VkSpecializationInfo materialSpecialization = {};
+			materialSpecialization.mapEntryCount = 1;
+			materialSpecialization.pMapEntries = &materialEntry;
+			materialSpecialization.dataSize = sizeof(VkBool32);
+			materialSpecialization.pData = &bindlessMaterials;
+			if (bindlessTable != nullptr)
+			{
+				instancedStages[0].pSpecializationInfo = &materialSpecialization;
+			}
 
+			VkGraphicsPipelineCreateInfo instancedInfo = pipelineInfo;
+			instancedInfo.pStages = instancedStages;
+			instancedInfo.pVertexInputState = &instancedVertexInput;
 
-	}
+			if (vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &instancedInfo, PVHostAllocator::Callbacks(PVAllocationType::Pipeline), &instancedPipeline) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create instanced graphics pipeline");
+			}
+		}
 
-	VkShaderModule PlanetVulkan::CreateShaderModule(const std::vector<char>& code)
-	{
+		if (terrainRequested)
+		{
+			// position and normal on binding 0, placed by the tile matrix in the push constants
+			auto terrainBinding = TerrainVertex::getBindingDescription();
+			auto terrainAttributes = TerrainVertex::getAttributeDescriptions();
+			VkPipelineVertexInputStateCreateInfo terrainVertexInput = vertexInputInfo;
+			terrainVertexInput.pVertexBindingDescriptions = &terrainBinding;
+			terrainVertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(terrainAttributes.size());
+			terrainVertexInput.pVertexAttributeDescriptions = terrainAttributes.data();
+
+			VkPipelineShaderStageCreateInfo terrainStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+			terrainStages[0].module = shaderCache->GetModule(PVShaders::TerrainVertex);
+			// lit in the vertex shader, there are no materials to look up
+			terrainStages[1].module = shaderCache->GetModule(PVShaders::Fragment);
+
+			VkGraphicsPipelineCreateInfo terrainInfo = pipelineInfo;
+			terrainInfo.pStages = terrainStages;
+			terrainInfo.pVertexInputState = &terrainVertexInput;
+
+			// the virtual texture is set 2, with an empty set 1 when there is no bindless table
+			if (virtualTexturingSupported)
+			{
+				std::vector<VkDescriptorSetLayout> terrainSetLayouts = setLayouts;
+				if (bindlessTable == nullptr)
+				{
+					terrainSetLayouts.push_back(descriptorLayoutCache->GetLayout({}));
+				}
+				terrainSetLayouts.push_back(PVVirtualTexture::GetSetLayout(descriptorLayoutCache));
 
-		VkShaderModuleCreateInfo createInfo = {};
-		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		createInfo.codeSize = code.size();
+				VkPipelineLayoutCreateInfo terrainLayoutInfo = pipelineLayoutInfo;
+				terrainLayoutInfo.setLayoutCount = static_cast<uint32_t>(terrainSetLayouts.size());
+				terrainLayoutInfo.pSetLayouts = terrainSetLayouts.data();
+				if (vkCreatePipelineLayout(logicalDevice, &terrainLayoutInfo, PVHostAllocator::Callbacks(PVAllocationType::PipelineLayout), &terrainPipelineLayout) != VK_SUCCESS)
+				{
+					throw std::runtime_error("Failed to create terrain pipeline layout");
+				}
 
-		std::vector<uint32_t> codeAligned(code.size() / sizeof(uint32_t) + 1);
-		memcpy(codeAligned.data(), code.data(), code.size());
-		createInfo.pCode = codeAligned.data();
+				terrainStages[1].module = shaderCache->GetModule(PVShaders::TerrainFragment);
+				terrainInfo.layout = terrainPipelineLayout;
+			}
 
-		VkShaderModule shaderModule;
-		if (vkCreateShaderModule(logicalDevice, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to create shader module");
+			if (vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &terrainInfo, PVHostAllocator::Callbacks(PVAllocationType::Pipeline), &terrainPipeline) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create terrain graphics pipeline");
+			}
 		}
-		else
+
+		if (benchmarkDrawCount == 0)
 		{
-			std::cout << "Shader module created successfully!" << std::endl;
+			return;
 		}
 
-		return shaderModule;
+		// same pipeline reading the model matrix from the dynamic uniform buffer
+		VkBool32 modelFromPushConstants = VK_FALSE;
+		VkSpecializationMapEntry specializationEntry = { 0, 0, sizeof(VkBool32) };
+		VkSpecializationInfo specializationInfo = {};
+		specializationInfo.mapEntryCount = 1;
+		specializationInfo.pMapEntries = &specializationEntry;
+		specializationInfo.dataSize = sizeof(VkBool32);
+		specializationInfo.pData = &modelFromPushConstants;
+		shaderStages[0].pSpecializationInfo = &specializationInfo;
+
+		if (vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, PVHostAllocator::Callbacks(PVAllocationType::Pipeline), &rebindPipeline) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create graphics pipeline");
+		}
 	}
 
-
 	void PlanetVulkan::CreateCommandBuffers()
 	{
-		commandBuffers.resize(swapchain->GetFramebufferSize());
+		// one per frame in flight, reset and recorded again every frame
+		commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
 
 		VkCommandBufferAllocateInfo allocInfo = {};
 		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -732,89 +1558,513 @@ namespace PVEngine
 		{
 			std::cout << "Command Buffers created successfully" << std::endl;
 		}
+	}
 
-		for (size_t i = 0; i < commandBuffers.size(); i++)
-		{
-			VkCommandBufferBeginInfo beginInfo = {};
-			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+	void PlanetVulkan::RecordCommandBuffer(uint32_t imageIndex)
+	{
+		VkCommandBuffer commandBuffer = commandBuffers[currentFrame];
+		vkResetCommandBuffer(commandBuffer, 0);
 
-			vkBeginCommandBuffer(commandBuffers[i], &beginInfo);
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-			VkRenderPassBeginInfo renderPassInfo = {};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassInfo.renderPass = renderPass;
-			renderPassInfo.framebuffer = *swapchain->GetFramebuffer(i);
-			renderPassInfo.renderArea.offset = { 0,0 };
-			renderPassInfo.renderArea.extent = *swapchain->GetExtent();
-			VkClearValue clearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
-			renderPassInfo.clearValueCount = 1;
-			renderPassInfo.pClearValues = &clearColor;
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
 
-			vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		gpuTimer->Begin(commandBuffer, static_cast<uint32_t>(currentFrame));
+		if (occlusionCuller != nullptr)
+		{
+			occlusionCuller->BeginFrame(commandBuffer, static_cast<uint32_t>(currentFrame), renderExtent);
+		}
+		renderGraph->SetImportedImage(swapchainColor, swapchain->GetImage(imageIndex), swapchain->GetImageView(imageIndex));
+		renderGraph->Execute(commandBuffer, frameArenas[currentFrame]);
+		if (occlusionCuller != nullptr)
+		{
+			occlusionCuller->EndFrame(commandBuffer, static_cast<uint32_t>(currentFrame));
+		}
+		gpuTimer->End(commandBuffer, static_cast<uint32_t>(currentFrame));
 
-			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to record command buffer");
+		}
+	}
 
-			VkBuffer vertexBuffers[] = { *vertexBuffer->GetBuffer() };
-			VkDeviceSize offsets[] = { 0 };
-			vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
+	void PlanetVulkan::UpdateDrawConstants(float angle, const glm::dvec3& cameraPosition)
+	{
+		// the benchmark lays its quads out on a grid covering the same area as the single quad
+		uint32_t drawCount = std::max(benchmarkDrawCount, 1u);
+		if (drawNodes.GetCount() != drawCount)
+		{
+			uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(drawCount))));
+			float cellSize = 2.0f / columns;
 
-			VkBuffer indexBfr = *indexBuffer->GetBuffer();
-			vkCmdBindIndexBuffer(commandBuffers[i], indexBfr, 0, VK_INDEX_TYPE_UINT32);
+			drawNodes.Clear();
+			drawConstants.resize(drawCount);
+			for (uint32_t i = 0; i < drawCount; i++)
+			{
+				glm::vec3 cellCenter(0.0f);
+				float scale = 1.0f;
+				if (benchmarkDrawCount > 0)
+				{
+					cellCenter = glm::vec3((i % columns + 0.5f) * cellSize - 1.0f, (i / columns + 0.5f) * cellSize - 1.0f, 0.0f);
+					scale = cellSize * 0.8f;
+				}
+				drawNodes.Add(PVTransformSystem::NO_PARENT, cellCenter, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(scale));
+				drawConstants[i].morph = glm::vec4(0.0f);
+			}
 
-			vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			drawAnchor.Clear();
+			drawAnchor.Add(sceneOrigin, glm::mat3(1.0f));
+		}
 
-			vkCmdDrawIndexed(commandBuffers[i], static_cast<uint32_t>(indexBuffer->GetIndicesSize()), 1, 0, 0, 0);
+		// every quad spins about its own center
+		glm::quat rotation = glm::angleAxis(angle, glm::vec3(0.0f, 0.0f, 1.0f));
+		for (uint32_t i = 0; i < drawCount; i++)
+		{
+			drawNodes.SetRotation(i, rotation);
+		}
+		drawNodes.Update();
 
-			vkCmdEndRenderPass(commandBuffers[i]);
+		glm::mat4 anchor;
+		drawAnchor.Compute(cameraPosition, &anchor, sizeof(anchor));
 
-			if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS)
+		if (drawPath == DrawPath::DescriptorRebind)
+		{
+			// straight into the mapped buffer the draws read, the morph data after each matrix stays zero
+			drawNodes.WriteMatrices(anchor, drawBuffers[currentFrame]->GetMappedData(), static_cast<size_t>(drawBufferStride));
+			for (uint32_t i = 0; i < drawCount; i++)
 			{
-				throw std::runtime_error("Failed to record command buffer");
+				drawBuffers[currentFrame]->Write(&drawConstants[i].morph, i * drawBufferStride + offsetof(PVDrawConstants, morph), sizeof(glm::vec4));
 			}
 		}
+		else
+		{
+			drawNodes.WriteMatrices(anchor, &drawConstants[0].model, sizeof(PVDrawConstants));
+		}
 	}
 
-	void PlanetVulkan::CreateSemaphores()
+	void PlanetVulkan::CreateProps()
 	{
+		if (propCount == 0)
+		{
+			return;
+		}
 
-		VkSemaphoreCreateInfo semaphoreInfo = {};
-		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		// scattered over an area larger than the view so culling has something to reject
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> position(-6.0f, 6.0f);
+		std::uniform_real_distribution<float> angle(0.0f, glm::radians(360.0f));
+		std::uniform_real_distribution<float> size(0.05f, 0.2f);
+
+		props.resize(propCount);
+		for (uint32_t i = 0; i < propCount; i++)
+		{
+			float scale = size(random);
+			glm::vec3 center(position(random), position(random), 0.0f);
+
+			InstanceData& instance = props[i].instance;
+			instance.transform = glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f), center), angle(random), glm::vec3(0.0f, 0.0f, 1.0f)),
+				glm::vec3(scale));
+			instance.morph = glm::vec4(0.0f);
+			instance.materialIndex = i % 4;
+
+			// the quad spans -0.5..0.5
+			props[i].boundsCenter = center;
+			props[i].boundsRadius = scale * 0.7072f;
+		}
+		propTiles.Add(sceneOrigin, glm::mat3(1.0f));
+		propTileConstants.resize(propTiles.GetCount());
+		propTileConstants[0].morph = glm::vec4(0.0f);
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			instanceBuffers.push_back(new PVInstanceBuffer(deviceContext));
+		}
+	}
+
+	void PlanetVulkan::CreateTerrain()
+	{
+		if (!terrainRequested)
+		{
+			return;
+		}
 
-		if (vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &imageAvailableSemaphore) != VK_SUCCESS
-			|| vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &renderFinishedSemaphore) != VK_SUCCESS)
+		// 4x4 tiles of 33x33 vertices centered a little below the quad, the seed picks the landscape
+		const uint32_t tilesPerSide = 4;
+		const float tileSize = 2.0f;
+		const uint64_t terrainSeed = 1;
+		glm::dvec3 origin = sceneOrigin + glm::dvec3(-0.5 * tilesPerSide * tileSize, -0.5 * tilesPerSide * tileSize, -0.6);
+		terrain = new PVTerrain(deviceContext, origin, tilesPerSide, 33, tileSize, terrainSeed, tileCacheDirectory, MAX_FRAMES_IN_FLIGHT);
+
+		// 32x32 pages at the finest mip, about 2 mm a texel, through a cache of 16x16 pages
+		if (virtualTexturingSupported)
 		{
-			throw std::runtime_error("Failed to create semaphores");
+			virtualTexture = new PVVirtualTexture(deviceContext, descriptorLayoutCache, terrain->GetSize(), 32, 16, virtualTextureUploadBudget,
+				terrainSeed, tileCacheDirectory, [terrainSeed](float x, float y) { return PVTerrain::GenerateHeight(x, y, terrainSeed); }, MAX_FRAMES_IN_FLIGHT);
+			std::cout << "Using virtual texturing for the terrain" << std::endl;
 		}
 		else
 		{
-			std::cout << "Semaphores created successfully" << std::endl;
+			std::cout << "Fragment shader stores are not supported, the terrain is not virtual textured" << std::endl;
 		}
 	}
 
-	void PlanetVulkan::DrawFrame()
+	void PlanetVulkan::CreateTextures()
 	{
+		textureStreamer = new PVTextureStreamer(deviceContext, &uploadContext, deletionQueue, textureUploadBudget);
+
+		// the materials' albedo, its mips are blitted on the GPU
+		if (bindlessSupported)
+		{
+			materialTexture = textureStreamer->Load("material albedo", PVTextureStreamer::CreateTestKtx2(512, 0));
+			materialTextureLoaded = true;
+		}
+
+		if (textureBenchmarkCount == 0)
+		{
+			return;
+		}
+
+		// generated ones alternate between every level stored and only the finest, whose mips
+		// the GPU blits
+		for (uint32_t i = 0; i < textureBenchmarkCount; i++)
+		{
+			if (textureBenchmarkFile.empty())
+			{
+				textureStreamer->Load("generated " + std::to_string(i), PVTextureStreamer::CreateTestKtx2(2048, (i % 2 == 0) ? 12 : 0));
+			}
+			else
+			{
+				textureStreamer->Load(textureBenchmarkFile);
+			}
+		}
+		texturesStreaming = true;
+		std::cout << "Streaming " << textureBenchmarkCount << " textures at up to " << textureUploadBudget / 1024 << " KB a frame" << std::endl;
+	}
+
+	void PlanetVulkan::CullProps(const glm::mat4& viewProjection)
+	{
+		if (props.empty())
+		{
+			return;
+		}
+
+		// the GPU culls and reports on its own
+		if (occlusionCuller != nullptr)
+		{
+			occlusionCuller->Update(static_cast<uint32_t>(currentFrame), viewProjection);
+			return;
+		}
+
+		PVFrustum frustum = PVFrustum::fromViewProjection(viewProjection);
+
+		std::pmr::vector<InstanceData> visibleInstances(frameArenas[currentFrame]);
+		visibleInstances.reserve(props.size());
+		for (const auto& prop : props)
+		{
+			if (frustum.intersectsSphere(prop.boundsCenter, prop.boundsRadius))
+			{
+				visibleInstances.push_back(prop.instance);
+			}
+		}
+
+		// this slot's buffer is no longer read, a replacement only has to outlive the frames already submitted
+		instanceBuffers[currentFrame]->Upload(visibleInstances.data(), static_cast<uint32_t>(visibleInstances.size()),
+			deletionQueue, graphicsTimeline->GetLastSubmittedValue());
+
+		if (++cullReportFrames == 300)
+		{
+			std::cout << "Instancing: " << visibleInstances.size() << " of " << props.size() << " props visible, one draw" << std::endl;
+			cullReportFrames = 0;
+		}
+	}
+
+	void PlanetVulkan::SetCullingInstances()
+	{
+		if (occlusionCuller == nullptr)
+		{
+			return;
+		}
+
+		std::vector<InstanceData> instances;
+		std::vector<glm::vec4> bounds;
+		instances.reserve(props.size());
+		bounds.reserve(props.size());
+		for (const auto& prop : props)
+		{
+			instances.push_back(prop.instance);
+			bounds.push_back(glm::vec4(prop.boundsCenter, prop.boundsRadius));
+		}
+		occlusionCuller->SetInstances(instances, bounds, static_cast<uint32_t>(indexBuffer->GetIndicesSize()));
+	}
+
+	void PlanetVulkan::SetForwardViewport(VkCommandBuffer commandBuffer)
+	{
+		VkViewport viewport = { 0.0f, 0.0f, static_cast<float>(renderExtent.width), static_cast<float>(renderExtent.height), 0.0f, 1.0f };
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = { { 0, 0 }, renderExtent };
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	}
+
+	void PlanetVulkan::UpdateDrawBenchmark(double recordMs, bool gpuValid, double gpuMs)
+	{
+		if (benchmarkDrawCount == 0)
+		{
+			return;
+		}
+
+		benchmarkRecordMs += recordMs;
+		benchmarkFrames++;
+		if (gpuValid)
+		{
+			benchmarkGpuMs += gpuMs;
+			benchmarkGpuFrames++;
+		}
+
+		// alternate between the two paths so one run measures both
+		const uint32_t framesPerPhase = 300;
+		if (benchmarkFrames == framesPerPhase)
+		{
+			std::cout << "Draw benchmark, " << (drawPath == DrawPath::PushConstants ? "push constants" : "descriptor rebind")
+				<< ", " << benchmarkDrawCount << " draws: record " << benchmarkRecordMs / benchmarkFrames << " ms, GPU "
+				<< (benchmarkGpuFrames > 0 ? benchmarkGpuMs / benchmarkGpuFrames : 0.0) << " ms per frame" << std::endl;
+
+			drawPath = drawPath == DrawPath::PushConstants ? DrawPath::DescriptorRebind : DrawPath::PushConstants;
+			benchmarkRecordMs = 0.0;
+			benchmarkGpuMs = 0.0;
+			benchmarkFrames = 0;
+			benchmarkGpuFrames = 0;
+		}
+	}
+
+	uint64_t PlanetVulkan::CountHeapAllocations()
+	{
+		return allocationCounter() + PVHostAllocator::GetThreadHeapAllocationCount();
+	}
+
+	void PlanetVulkan::ReportFrameAllocations(uint64_t allocations)
+	{
+		frameHeapAllocations += allocations;
+		if (++allocationReportFrames < 300)
+		{
+			return;
+		}
+
+		// the first frames fill caches and size the arenas, only report from then on
+		if (allocationWarmupDone)
+		{
+			size_t arenaPeak = 0;
+			size_t arenaCapacity = 0;
+			for (auto frameArena : frameArenas)
+			{
+				arenaPeak = std::max(arenaPeak, frameArena->GetPeakBytes());
+				arenaCapacity = std::max(arenaCapacity, frameArena->GetCapacity());
+			}
+			std::cout << "Heap allocations: " << frameHeapAllocations << " over the last " << allocationReportFrames << " frames, frame arena peak "
+				<< arenaPeak << " of " << arenaCapacity << " bytes" << std::endl;
+		}
+		allocationWarmupDone = true;
+		frameHeapAllocations = 0;
+		allocationReportFrames = 0;
+	}
+
+	void PlanetVulkan::CreateMeshBuffers()
+	{
+		// the blobs are copied from the mapping straight into staging memory, the pack can be
+		// closed as soon as the buffers are created
+		const PVPackFormat::TocEntry& vertices = meshPack.Require("quad.vertices", PVPackFormat::BlobType::Vertices, sizeof(Vertex));
+		const PVPackFormat::TocEntry& indices = meshPack.Require("quad.indices", PVPackFormat::BlobType::Indices32, sizeof(uint32_t));
+
+		vertexBuffer = new PVVertexBuffer(deviceContext, &uploadContext, static_cast<const Vertex*>(meshPack.GetData(vertices)),
+			static_cast<uint32_t>(meshPack.GetElementCount(vertices)));
+		indexBuffer = new PVIndexBuffer(deviceContext, &uploadContext, static_cast<const uint32_t*>(meshPack.GetData(indices)),
+			static_cast<uint32_t>(meshPack.GetElementCount(indices)));
+
+		meshPack.Close();
+	}
+
+	void PlanetVulkan::AcquireUploadedBuffers(const std::vector<PVBuffer*>& buffers)
+	{
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = *graphicsCommandPool->GetCommandPool();
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer acquireCommandBuffer;
+		if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, &acquireCommandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create ownership acquire command buffer");
+		}
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(acquireCommandBuffer, &beginInfo);
+
+		bool acquireRecorded = false;
+		uint64_t uploadValue = 0;
+		for (PVBuffer* buffer : buffers)
+		{
+			if (buffer->RecordOwnershipAcquire(acquireCommandBuffer))
+			{
+				acquireRecorded = true;
+			}
+			uploadValue = std::max(uploadValue, buffer->GetUploadValue());
+		}
+
+		vkEndCommandBuffer(acquireCommandBuffer);
+
+		// same queue family for transfer and graphics, ownership never moved
+		if (!acquireRecorded)
+		{
+			vkFreeCommandBuffers(logicalDevice, *graphicsCommandPool->GetCommandPool(), 1, &acquireCommandBuffer);
+			return;
+		}
+
+		// the acquire barriers only take effect after the matching releases on the transfer queue
+		uint64_t acquireValue = graphicsTimeline->Submit(&acquireCommandBuffer, 1,
+			{ { transferTimeline, uploadValue, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT } });
+		deletionQueue->RetireCommandBuffers(*graphicsCommandPool->GetCommandPool(), { acquireCommandBuffer }, acquireValue);
+	}
+
+	void PlanetVulkan::CreateSyncObjects()
+	{
+		imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+		renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+		// timeline value 0 is already reached, so the first wait on each frame slot returns immediately
+		frameTimelineValues.assign(MAX_FRAMES_IN_FLIGHT, 0);
+
+		VkSemaphoreCreateInfo semaphoreInfo = {};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			if (vkCreateSemaphore(logicalDevice, &semaphoreInfo, PVHostAllocator::Callbacks(PVAllocationType::Sync), &imageAvailableSemaphores[i]) != VK_SUCCESS
+				|| vkCreateSemaphore(logicalDevice, &semaphoreInfo, PVHostAllocator::Callbacks(PVAllocationType::Sync), &renderFinishedSemaphores[i]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create synchronization objects");
+			}
+		}
+
+		std::cout << "Synchronization objects created successfully" << std::endl;
+	}
+
+	bool PlanetVulkan::DrawFrame(const PVSceneSnapshot& snapshot)
+	{
+		// wait until the frame that last used this slot has finished on the GPU
+		graphicsTimeline->Wait(frameTimelineValues[currentFrame]);
+		MeasureInputLatency();
+
+		// every set handed out for this slot last time round is free again
+		frameDescriptorAllocators[currentFrame]->Reset();
+		frameArenas[currentFrame]->Reset();
+
+		if (swapchainResized.exchange(false))
+		{
+			RecreateSwapChain();
+		}
+
+		deletionQueue->Flush(graphicsTimeline->GetCompletedValue());
+		if (bindlessTable != nullptr)
+		{
+			bindlessTable->Flush(graphicsTimeline->GetCompletedValue());
+		}
+		transferDeletionQueue->Flush(transferTimeline->GetCompletedValue());
+
+		// the timestamps of the frame that last used this slot, only counted if it drew the same way
+		double gpuMs = 0.0;
+		bool gpuResult = gpuTimer->GetResult(static_cast<uint32_t>(currentFrame), gpuMs);
+		bool gpuValid = gpuResult && frameDrawPaths[currentFrame] == drawPath;
+		if (gpuResult)
+		{
+			framePacer->GpuFrameMeasured(gpuMs);
+			if (resolutionScaler != nullptr)
+			{
+				resolutionScaler->Update(gpuMs);
+			}
+		}
+		if (occlusionCuller != nullptr)
+		{
+			occlusionCuller->FrameCompleted(static_cast<uint32_t>(currentFrame));
+		}
+		if (virtualTexture != nullptr)
+		{
+			virtualTexture->FrameCompleted(static_cast<uint32_t>(currentFrame));
+		}
+
+		// bounded so a surface that stops handing out images cannot hang the render loop, the
+		// frame is skipped and tried again on the next one
 		uint32_t imageIndex;
-		vkAcquireNextImageKHR(logicalDevice, *swapchain->GetSwapchain(), std::numeric_limits<uint64_t>::max(), imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+		VkResult acquireResult = vkAcquireNextImageKHR(logicalDevice, *swapchain->GetSwapchain(), ACQUIRE_TIMEOUT_NS,
+			imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+		if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			swapchainResized = true;
+			return false;
+		}
+		if (acquireResult == VK_TIMEOUT || acquireResult == VK_NOT_READY)
+		{
+			return false;
+		}
+		if (acquireResult != VK_SUCCESS && acquireResult != VK_SUBOPTIMAL_KHR)
+		{
+			throw std::runtime_error("Failed to acquire swapchain image");
+		}
 
-		VkSubmitInfo submitInfo = {};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		VkSemaphore waitSemaphores[] = { imageAvailableSemaphore };
-		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = waitSemaphores;
-		submitInfo.pWaitDstStageMask = waitStages;
-		VkSemaphore signalSemaphores[] = { renderFinishedSemaphore };
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = signalSemaphores;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+		// the slot's buffers are free again, nothing the GPU still reads is overwritten
+		PVUniformBuffer::UniformBufferObject camera = cameraBuffers[currentFrame]->Update(snapshot.view, *swapchain->GetExtent());
+		UpdateDrawConstants(snapshot.rotation, snapshot.cameraPosition);
+		if (terrain != nullptr)
+		{
+			terrain->Update(static_cast<uint32_t>(currentFrame), snapshot.cameraPosition);
+		}
+		if (virtualTexture != nullptr)
+		{
+			virtualTexture->Update(static_cast<uint32_t>(currentFrame));
+		}
+		textureStreamer->Update();
+		if (texturesStreaming && textureStreamer->IsIdle())
+		{
+			textureStreamer->PrintReport(std::cout);
+			texturesStreaming = false;
+		}
+		if (!props.empty())
+		{
+			propTiles.Compute(snapshot.cameraPosition, &propTileConstants[0].model, sizeof(PVDrawConstants));
+			CullProps(camera.proj * camera.view * propTileConstants[0].model);
+		}
 
-		if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		renderExtent = (resolutionScaler != nullptr) ? resolutionScaler->GetRenderExtent(*swapchain->GetExtent()) : *swapchain->GetExtent();
+		renderGraph->SetRenderArea(forwardPass, renderExtent);
+		if (occlusionCuller != nullptr)
 		{
-			throw std::runtime_error("Failed to submit draw command buffer");
+			renderGraph->SetRenderArea(forwardLatePass, renderExtent);
 		}
 
+		auto recordStart = std::chrono::steady_clock::now();
+		RecordCommandBuffer(imageIndex);
+		double recordMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
+
+		frameDrawPaths[currentFrame] = drawPath;
+		UpdateDrawBenchmark(recordMs, gpuValid, gpuMs);
+		UpdateSharingBenchmark(gpuResult, gpuMs);
+
+		// geometry uploads on the transfer queue have to land before vertex input reads them
+		std::pmr::vector<PVTimeline::WaitPoint> waitPoints(frameArenas[currentFrame]);
+		waitPoints.push_back({ transferTimeline, transferWaitValue, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT });
+		// texture levels acquired this frame, their copies had already finished
+		if (textureStreamer->GetAcquireValue() > 0)
+		{
+			waitPoints.push_back({ transferTimeline, textureStreamer->GetAcquireValue(), VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT });
+		}
+		VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
+
+		frameTimelineValues[currentFrame] = graphicsTimeline->Submit(&commandBuffers[currentFrame], 1, waitPoints,
+			imageAvailableSemaphores[currentFrame], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, renderFinishedSemaphores[currentFrame]);
+		framePacer->FrameSubmitted();
+
 		VkPresentInfoKHR presentInfo = {};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 		presentInfo.waitSemaphoreCount = 1;
@@ -825,7 +2075,160 @@ namespace PVEngine
 		presentInfo.pSwapchains = swapchains;
 		presentInfo.pImageIndices = &imageIndex;
 
-		vkQueuePresentKHR(graphicsQueue, &presentInfo);
+		VkResult presentResult = vkQueuePresentKHR(graphicsQueue, &presentInfo);
+		if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR)
+		{
+			swapchainResized = true;
+		}
+
+		currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+
+		return true;
+	}
+
+	void PlanetVulkan::RunBufferBenchmark()
+	{
+		if (bufferBenchmarkCount == 0)
+		{
+			return;
+		}
+
+		std::vector<Vertex> vertices(256, { glm::vec2(0.0f), glm::vec3(1.0f) });
+		std::vector<uint32_t> indices(1024, 0);
+		std::vector<PVBuffer*> buffers(bufferBenchmarkCount);
+
+		std::cout << "Buffer benchmark, " << bufferBenchmarkCount << " of each:" << std::endl;
+
+		// uploaded buffers wait for their copies before they are destroyed, outside the timing
+		auto measure = [&](const char* name, auto create, auto destroy)
+		{
+			auto start = std::chrono::steady_clock::now();
+			for (uint32_t i = 0; i < bufferBenchmarkCount; i++)
+			{
+				buffers[i] = create();
+			}
+			double createMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			transferTimeline->WaitIdle();
+			transferDeletionQueue->Flush(transferTimeline->GetCompletedValue());
+
+			start = std::chrono::steady_clock::now();
+			for (uint32_t i = 0; i < bufferBenchmarkCount; i++)
+			{
+				destroy(buffers[i]);
+			}
+			double destroyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			std::cout << "  " << name << ": create " << createMs * 1000.0 / bufferBenchmarkCount << " us, destroy "
+				<< destroyMs * 1000.0 / bufferBenchmarkCount << " us" << std::endl;
+		};
+
+		measure("vertex", [&]() { return new PVVertexBuffer(deviceContext, &uploadContext, vertices.data(), static_cast<uint32_t>(vertices.size())); },
+			[&](PVBuffer* buffer) { static_cast<PVVertexBuffer*>(buffer)->Cleanup(&logicalDevice); delete static_cast<PVVertexBuffer*>(buffer); });
+		measure("index", [&]() { return new PVIndexBuffer(deviceContext, &uploadContext, indices.data(), static_cast<uint32_t>(indices.size())); },
+			[&](PVBuffer* buffer) { static_cast<PVIndexBuffer*>(buffer)->CleanupIndexBuffer(&logicalDevice); delete static_cast<PVIndexBuffer*>(buffer); });
+		measure("uniform", [&]() { return new PVUniformBuffer(deviceContext); },
+			[&](PVBuffer* buffer) { static_cast<PVUniformBuffer*>(buffer)->CleanupUniformBuffer(&logicalDevice); delete static_cast<PVUniformBuffer*>(buffer); });
+		measure("instance", [&]() { return new PVInstanceBuffer(deviceContext); },
+			[&](PVBuffer* buffer) { static_cast<PVInstanceBuffer*>(buffer)->Cleanup(&logicalDevice); delete static_cast<PVInstanceBuffer*>(buffer); });
+		measure("storage", [&]() { return new PVStorageBuffer(deviceContext, 64 * 1024, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false); },
+			[&](PVBuffer* buffer) { static_cast<PVStorageBuffer*>(buffer)->Cleanup(&logicalDevice); delete static_cast<PVStorageBuffer*>(buffer); });
+
+		// what createBuffer and findMemoryType asked the driver for every buffer before
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < bufferBenchmarkCount; i++)
+		{
+			QueueFamilyIndices queueFamilies = FindQueueFamilies(&physicalDevice, &surface);
+			VkPhysicalDeviceMemoryProperties memoryProperties;
+			vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+		}
+		double queryMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "  queries saved by the device context: " << queryMs * 1000.0 / bufferBenchmarkCount << " us a buffer" << std::endl;
+	}
+
+	void PlanetVulkan::RunSharingBenchmark()
+	{
+		if (sharingBenchmarkUploads == 0)
+		{
+			return;
+		}
+
+		const QueueFamilyIndices& indices = deviceContext->GetQueueFamilyIndices();
+		if (indices.graphicsFamily == indices.transferFamily)
+		{
+			std::cout << "Sharing benchmark: uploads run on the graphics family, there are no concurrent buffers to compare" << std::endl;
+			return;
+		}
+
+		// tiny triangles over the quad, so fetching the vertices is most of the draw
+		const uint32_t triangleCount = 200000;
+		const float triangleSize = 0.004f;
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> position(-0.5f, 0.5f);
+		std::vector<Vertex> vertices;
+		vertices.reserve(triangleCount * 3);
+		for (uint32_t i = 0; i < triangleCount; i++)
+		{
+			glm::vec2 corner(position(random), position(random));
+			glm::vec3 color(0.9f, 0.4f, 0.2f);
+			vertices.push_back({ corner, color });
+			vertices.push_back({ corner + glm::vec2(triangleSize, 0.0f), color });
+			vertices.push_back({ corner + glm::vec2(0.0f, triangleSize), color });
+		}
+
+		const char* modeNames[] = { "exclusive", "concurrent" };
+		const VkSharingMode modes[] = { VK_SHARING_MODE_EXCLUSIVE, VK_SHARING_MODE_CONCURRENT };
+		for (uint32_t mode = 0; mode < 2; mode++)
+		{
+			// each upload is waited for, including the graphics queue's acquire for exclusive buffers
+			auto start = std::chrono::steady_clock::now();
+			for (uint32_t i = 0; i < sharingBenchmarkUploads; i++)
+			{
+				if (sharingBuffers[mode] != nullptr)
+				{
+					sharingBuffers[mode]->Cleanup(&logicalDevice);
+					delete sharingBuffers[mode];
+				}
+				sharingBuffers[mode] = new PVVertexBuffer(deviceContext, &uploadContext, vertices.data(), static_cast<uint32_t>(vertices.size()), modes[mode]);
+				AcquireUploadedBuffers({ sharingBuffers[mode] });
+				transferTimeline->Wait(sharingBuffers[mode]->GetUploadValue());
+				graphicsTimeline->WaitIdle();
+			}
+			double uploadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			transferDeletionQueue->Flush(transferTimeline->GetCompletedValue());
+
+			std::cout << "Sharing benchmark, " << modeNames[mode] << ": " << uploadMs / sharingBenchmarkUploads << " ms per upload of "
+				<< vertices.size() * sizeof(Vertex) / 1024 << " KB" << std::endl;
+		}
+	}
+
+	void PlanetVulkan::UpdateSharingBenchmark(bool gpuResult, double gpuMs)
+	{
+		if (sharingBuffers[0] == nullptr)
+		{
+			return;
+		}
+
+		// only frames that drew from the buffer being measured count
+		if (gpuResult && frameSharingIndices[currentFrame] == sharingIndex)
+		{
+			sharingGpuMs += gpuMs;
+			sharingGpuFrames++;
+		}
+		frameSharingIndices[currentFrame] = sharingIndex;
+
+		// alternate between the two buffers so one run measures both
+		const uint32_t framesPerPhase = 300;
+		if (++sharingFrames == framesPerPhase)
+		{
+			std::cout << "Sharing benchmark, " << (sharingIndex == 0 ? "exclusive" : "concurrent") << " vertex buffer: GPU "
+				<< (sharingGpuFrames > 0 ? sharingGpuMs / sharingGpuFrames : 0.0) << " ms per frame" << std::endl;
+
+			sharingIndex ^= 1;
+			sharingGpuMs = 0.0;
+			sharingFrames = 0;
+			sharingGpuFrames = 0;
+		}
 	}
 
 	bool PlanetVulkan::CheckDeviceExtensionSupport(VkPhysicalDevice device)
@@ -3,7 +3,15 @@
 #include <iostream>
 #include <stdexcept>
 #include <vector>
-#include <fstream>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <functional>
+#include <memory_resource>
+#include <atomic>
+#include <exception>
 
 #include "Window.h"
 #include "VDeleter.h"
@@ -13,28 +21,38 @@
 #include "PVUniformBuffer.h"
 #include "PVQueueFamily.h"
 #include "PVCommandPool.h"
+#include "PVDeviceContext.h"
+#include "PVDeletionQueue.h"
+#include "PVTimeline.h"
+#include "PVRenderGraph.h"
+#include "PVShaderCache.h"
+#include "PVAssetPack.h"
+#include "PVTaskGraph.h"
+#include "PVDescriptorLayoutCache.h"
+#include "PVDescriptorAllocator.h"
+#include "PVBindlessTable.h"
+#include "PVStorageBuffer.h"
+#include "PVMaterialConstants.h"
+#include "PVDrawConstants.h"
+#include "PVGpuTimer.h"
+#include "PVInstanceBuffer.h"
+#include "PVFrustum.h"
+#include "PVHostAllocator.h"
+#include "PVFrameArena.h"
+#include "PVSceneSnapshot.h"
+#include "PVSnapshotMailbox.h"
+#include "PVCpuTime.h"
+#include "PVFramePacer.h"
+#include "PVResolutionScaler.h"
+#include "PVOcclusionCuller.h"
+#include "PVCameraRelative.h"
+#include "PVTransformSystem.h"
+#include "PVTerrain.h"
+#include "PVVirtualTexture.h"
+#include "PVTextureStreamer.h"
 
 namespace PVEngine
 {
-	static std::vector<char> ReadFile(const std::string& filename)
-	{
-		std::ifstream file(filename, std::ios::ate | std::ios::binary);
-
-		if (!file.is_open())
-		{
-			throw std::runtime_error("Failed to open file");
-		}
-
-		size_t fileSize = (size_t)file.tellg();
-		std::vector<char> buffer(fileSize);
-
-		file.seekg(0);
-		file.read(buffer.data(), fileSize);
-		file.close();
-
-		return buffer;
-	}
-
 	class PlanetVulkan
 	{
 	public:
@@ -47,6 +65,113 @@ namespace PVEngine
 
 		void GameLoop();
 
+		// load shaders from loose .spv files in this directory instead of the embedded SPIR-V,
+		// must be set before InitVulkan
+		void SetShaderHotReloadDirectory(const std::string& directory) { shaderHotReloadDirectory = directory; }
+
+		// asset pack the meshes are loaded from, must be set before InitVulkan
+		void SetMeshPack(const std::string& filename) { meshPackFilename = filename; }
+
+		// worker threads used for startup in addition to the calling thread, 0 initializes
+		// everything serially, must be set before InitVulkan
+		void SetInitThreadCount(uint32_t threadCount) { initThreadCount = threadCount; }
+
+		// bind resources through one bindless table per frame when the device supports
+		// descriptor indexing, falls back to per-draw descriptor sets otherwise, must be set
+		// before InitVulkan
+		void SetBindlessEnabled(bool enabled) { bindlessRequested = enabled; }
+
+		// Draws drawCount quads every frame and alternates between pushing each model matrix
+		// with push constants and rebinding a dynamic uniform buffer per draw, printing CPU
+		// recording and GPU time for both. 0 draws the single quad, must be set before InitVulkan
+		void SetDrawBenchmark(uint32_t drawCount) { benchmarkDrawCount = drawCount; }
+
+		// Creates and destroys count buffers of each kind once startup is done and prints the time
+		// per buffer, next to the queue family and memory queries every buffer made before the
+		// device context cached them, must be set before InitVulkan
+		void SetBufferBenchmark(uint32_t count) { bufferBenchmarkCount = count; }
+
+		// Uploads a vertex buffer of small triangles uploadCount times, as an exclusive buffer the
+		// graphics queue acquires and as a concurrent one, and prints the time per upload. Then
+		// draws it every frame alternating between the two and prints the GPU time of each. Only
+		// runs with a dedicated transfer family, must be set before InitVulkan
+		void SetSharingBenchmark(uint32_t uploadCount) { sharingBenchmarkUploads = uploadCount; }
+
+		// scatters this many instanced props around the scene, frustum culled every frame and
+		// drawn with one instanced draw, must be set before InitVulkan
+		void SetPropCount(uint32_t count) { propCount = count; }
+
+		// culls the props on the GPU against a Hi-Z pyramid of the depth buffer instead of only
+		// against the frustum on the CPU, on by default, must be set before InitVulkan
+		void SetOcclusionCulling(bool enabled) { occlusionCullingRequested = enabled; }
+
+		// counters for the host memory the driver allocated through our callbacks, by scope and
+		// by object type, a report is printed at shutdown
+		PVHostAllocator& GetHostAllocator() { return PVHostAllocator::Get(); }
+
+		// counter returns the number of heap allocations the calling thread has made so far, with
+		// one set the heap allocations made while drawing, plus the host allocator's mallocs, are
+		// reported every 300 frames once the first 300 have warmed the caches up, must be set
+		// before GameLoop
+		void SetAllocationCounter(std::function<uint64_t()> counter) { allocationCounter = counter; }
+
+		// draw on a render thread of its own, leaving the thread that calls GameLoop to events and
+		// simulation. Disabled, that thread draws a frame after every round of events. Latency
+		// and CPU use are reported either way, must be set before GameLoop
+		void SetRenderThreadEnabled(bool enabled) { renderThreadEnabled = enabled; }
+
+		// fixed simulation steps per second, must be set before GameLoop
+		void SetSimulationRate(double stepsPerSecond) { simulationRate = stepsPerSecond; }
+
+		// how frames are paced and presented, see PVFramePacer. targetFps applies to the power
+		// saving and fixed rate policies, 0 picks their default, must be set before InitVulkan
+		void SetFramePacing(PVFramePacer::Policy policy, double targetFps = 0.0) { pacingPolicy = policy; pacingTargetFps = targetFps; }
+
+		// swapchain images to ask for, 0 for one more than the surface minimum, must be set
+		// before InitVulkan
+		void SetSwapchainImageCount(uint32_t count) { swapchainImageCount = count; }
+
+		// Renders the scene at a scale of the window size picked every frame to keep GPU time
+		// within targetGpuMs, then upscales into the swapchain image. The scale stays between
+		// minScale and maxScale, at most 1. Falls back to full resolution if the swapchain
+		// format can't be blitted, must be set before InitVulkan
+		void SetDynamicResolution(bool enabled, double targetGpuMs = 15.0, float minScale = 0.5f, float maxScale = 1.0f)
+		{
+			dynamicResolutionRequested = enabled;
+			resolutionTargetGpuMs = targetGpuMs;
+			resolutionMinScale = minScale;
+			resolutionMaxScale = maxScale;
+		}
+
+		// lays a deformable terrain under the scene and drops impactsPerSecond craters on it at
+		// random, must be set before InitVulkan
+		void SetTerrain(bool enabled, double impactsPerSecond = 2.0)
+		{
+			terrainRequested = enabled;
+			terrainImpactsPerSecond = impactsPerSecond;
+		}
+
+		// keeps the terrain's generated tiles in directory so later runs load them instead, an
+		// empty directory generates them every run, must be set before InitVulkan
+		void SetTileCacheDirectory(const std::string& directory)
+		{
+			tileCacheDirectory = directory;
+		}
+
+		// bytes of virtual texture pages the terrain may upload per frame, must be set before InitVulkan
+		void SetVirtualTextureUploadBudget(VkDeviceSize bytesPerFrame) { virtualTextureUploadBudget = bytesPerFrame; }
+
+		// bytes of texture levels copied per frame on the transfer queue, must be set before InitVulkan
+		void SetTextureUploadBudget(VkDeviceSize bytesPerFrame) { textureUploadBudget = bytesPerFrame; }
+
+		// streams count copies of a KTX2 file, or generated 2048x2048 textures when filename is
+		// empty, and reports the upload throughput once all are complete, must be set before InitVulkan
+		void SetTextureBenchmark(uint32_t count, const std::string& filename = "")
+		{
+			textureBenchmarkCount = count;
+			textureBenchmarkFile = filename;
+		}
+
 		Window windowObj;
 
 	private:
@@ -55,9 +180,34 @@ namespace PVEngine
 			if (width == 0 || height == 0)
 				return;
 
+			// the swapchain belongs to whichever thread draws, it picks this up on its next frame
 			PlanetVulkan* engine = reinterpret_cast<PlanetVulkan*>(glfwGetWindowUserPointer(window));
-			engine->RecreateSwapChain();
+			engine->swapchainResized = true;
 		}
+
+		static void OnKey(GLFWwindow* window, int key, int scancode, int action, int mods)
+		{
+			PlanetVulkan* engine = reinterpret_cast<PlanetVulkan*>(glfwGetWindowUserPointer(window));
+			engine->RecordInput(key, action);
+		}
+
+		// called for every key event on the simulation thread
+		void RecordInput(int key, int action);
+
+		// advances the simulation by one fixed step
+		void StepSimulation(double stepSeconds);
+
+		void PublishSnapshot();
+
+		void RenderLoop();
+
+		// draws the latest snapshot and keeps the frame loop statistics
+		void RenderFrame();
+
+		// samples input latency for every frame slot the GPU has finished
+		void MeasureInputLatency();
+
+		void ReportFrameLoop();
 		void InitWindow();
 
 		void CreateInstance();
@@ -72,7 +222,7 @@ namespace PVEngine
 
 		void CreateSurface();
 
-		SwapChainSupportDetails QuerySwapChainSupport(VkPhysicalDevice device);
+		SwapChainSupportDetails QuerySwapChainSupport(VkPhysicalDevice device, std::pmr::memory_resource* memory = std::pmr::get_default_resource());
 
 		void GetPhysicalDevices();
 
@@ -84,23 +234,73 @@ namespace PVEngine
 		//void CreateSwapChain();
 
 
-		void CreateRenderPass();
+		void CreateRenderGraph();
 
 		void CreateDescriptorSetlayout();
 
-		void CreateDescriptorPool();
+		void CreateDescriptorAllocators();
 
-		void CreateDescriptorSet();
+		void CreateDescriptorSets();
+
+		void CreateFrameBuffers();
+
+		// the material table, registered in the bindless table when there is one
+		void CreateMaterials();
+
+		// the bindless handles material.frag reads
+		void PushMaterialConstants(VkCommandBuffer commandBuffer);
+
+		// registers the material texture's view again once RecordAcquire has widened it, the old
+		// handle is released against retireValue
+		void UpdateMaterialTexture(uint64_t retireValue);
 
 		void CreateGraphicsPipeline();
 
-		VkShaderModule CreateShaderModule(const std::vector<char>& code);
-		
 		void CreateCommandBuffers();
 
-		void CreateSemaphores();
+		void RecordCommandBuffer(uint32_t imageIndex);
+
+		// model matrices relative to the camera, the view in the camera buffer has no translation
+		void UpdateDrawConstants(float angle, const glm::dvec3& cameraPosition);
+
+		void UpdateDrawBenchmark(double recordMs, bool gpuValid, double gpuMs);
+
+		// allocationCounter plus the host allocator's mallocs, both for the calling thread
+		uint64_t CountHeapAllocations();
+
+		void ReportFrameAllocations(uint64_t allocations);
+
+		void CreateProps();
+
+		// fills this frame's instance buffer with the props inside the view, viewProjection takes
+		// the props' tile space to clip space
+		void CullProps(const glm::mat4& viewProjection);
 
-		void DrawFrame();
+		void CreateTerrain();
+
+		// the streamer, and the benchmark's textures when one was asked for
+		void CreateTextures();
+
+		// hands the props to the occlusion culler once both exist
+		void SetCullingInstances();
+
+		// viewport and scissor covering this frame's render extent
+		void SetForwardViewport(VkCommandBuffer commandBuffer);
+
+		void CreateMeshBuffers();
+
+		void AcquireUploadedBuffers(const std::vector<PVBuffer*>& buffers);
+
+		void CreateSyncObjects();
+
+		// returns false if no swapchain image was available and the frame was skipped
+		bool DrawFrame(const PVSceneSnapshot& snapshot);
+
+		void RunBufferBenchmark();
+
+		void RunSharingBenchmark();
+
+		void UpdateSharingBenchmark(bool gpuResult, double gpuMs);
 
 		bool CheckDeviceExtensionSupport(VkPhysicalDevice device);
 
@@ -154,7 +354,7 @@ namespace PVEngine
 		};
 		const std::vector<const char*> validationLayers = { "VK_LAYER_LUNARG_standard_validation" };
 
-		const std::vector<const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+		const std::vector<const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME};
 
 		///Vulkan Handles
 		VkInstance instance;
@@ -167,15 +367,40 @@ namespace PVEngine
 
 		VkDevice logicalDevice;
 
+		PVDeviceContext* deviceContext;
+
 		VkQueue graphicsQueue;
 
 		VkQueue transferQueue;
 
 		PVSwapchain* swapchain;
 
-		
 
-		VkRenderPass renderPass;
+		// owns the render passes and framebuffers, the swapchain image is imported every frame
+		PVRenderGraph* renderGraph;
+
+		PVRenderGraph::ResourceHandle swapchainColor;
+
+		// scene color at the full swapchain size, only the scaled corner is rendered to
+		PVRenderGraph::ResourceHandle sceneColor;
+
+		// reversed-Z depth, graph owned so it is recreated along with the swapchain
+		PVRenderGraph::ResourceHandle depthBuffer;
+
+		PVRenderGraph::PassHandle upscalePass;
+
+		bool dynamicResolutionRequested = true;
+		double resolutionTargetGpuMs = 15.0;
+		float resolutionMinScale = 0.5f;
+		float resolutionMaxScale = 1.0f;
+
+		// null when rendering straight into the swapchain image
+		PVResolutionScaler* resolutionScaler = nullptr;
+
+		// the size the scene is rendered at this frame
+		VkExtent2D renderExtent = { 0, 0 };
+
+		PVRenderGraph::PassHandle forwardPass;
 
 		VkDescriptorSetLayout descriptorSetlayout;
 
@@ -183,25 +408,317 @@ namespace PVEngine
 
 		VkPipeline graphicsPipeline;
 
+		PVShaderCache* shaderCache;
+
+		std::string shaderHotReloadDirectory;
+
 		PVCommandPool* graphicsCommandPool;
 
 		PVCommandPool* transferCommandPool;
 
-		VkDescriptorPool descriptorPool;
+		PVDescriptorLayoutCache* descriptorLayoutCache;
+
+		// sets that live as long as the resources they point at
+		PVDescriptorAllocator* descriptorAllocator;
+
+		// transient sets, reset wholesale when their frame slot is reused
+		std::vector<PVDescriptorAllocator*> frameDescriptorAllocators;
+
+		// transient CPU memory, reset with the descriptor allocators when the slot is reused
+		std::vector<PVFrameArena*> frameArenas;
+
+		std::function<uint64_t()> allocationCounter;
+
+		uint64_t frameHeapAllocations = 0;
+
+		uint32_t allocationReportFrames = 0;
+
+		bool allocationWarmupDone = false;
+
+		bool bindlessRequested = true;
+
+		bool bindlessSupported = false;
+
+		PVBindlessTable::Capacity bindlessCapacity;
+
+		// set 1 of every pipeline layout when bindless is in use, null on the fallback path
+		PVBindlessTable* bindlessTable = nullptr;
+
+		// null without a bindless table, shader.frag draws untinted then
+		PVStorageBuffer* materialBuffer = nullptr;
+
+		PVMaterialConstants materialConstants = {};
+
+		// the albedo material.frag samples, streamed in and only loaded with a bindless table
+		PVTextureStreamer::TextureHandle materialTexture = 0;
+
+		bool materialTextureLoaded = false;
+
+		// the view registered as materialConstants.albedoTexture
+		VkImageView materialTextureView = VK_NULL_HANDLE;
+
+		VkSampler materialSampler = VK_NULL_HANDLE;
 
 		PVVertexBuffer* vertexBuffer;
 
 		PVIndexBuffer* indexBuffer;
 
-		PVUniformBuffer* uniformBuffer;
+		std::string meshPackFilename = "Assets/meshes.pvpack";
+
+		// only open during startup, read on a worker while the device is created
+		PVAssetPack meshPack;
+
+		uint32_t initThreadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+		std::chrono::steady_clock::time_point initStart;
+
+		bool firstFrameReported = false;
+
+		bool renderThreadEnabled = true;
 
+		PVFramePacer::Policy pacingPolicy = PVFramePacer::Policy::LowLatency;
+
+		double pacingTargetFps = 0.0;
+
+		uint32_t swapchainImageCount = 0;
+
+		PVFramePacer* framePacer = nullptr;
+
+		static const uint64_t ACQUIRE_TIMEOUT_NS = 100000000;
+
+		double simulationRate = 60.0;
+
+		// after a stall the simulation drops time beyond this many steps instead of catching up
+		static const uint32_t MAX_SIMULATION_STEPS = 8;
+
+		PVSnapshotMailbox<PVSceneSnapshot> snapshots;
+
+		// simulation state, only touched by the thread running GameLoop
+		uint64_t simulationTick = 0;
+		double simulationTime = 0.0;
+		float simulationRotation = 0.0f;
+		float rotationDirection = 1.0f;
+		float cameraYaw = glm::radians(45.0f);
+
+		// where the scene sits in world space, a planet radius from the origin where float
+		// positions would be off by up to a quarter metre
+		const glm::dvec3 sceneOrigin = glm::dvec3(6371000.0, 0.0, 0.0);
+
+		// times of the most recent key events, indexed by event number
+		static const uint32_t INPUT_HISTORY = 64;
+		std::chrono::steady_clock::time_point inputTimes[INPUT_HISTORY];
+		uint64_t inputCount = 0;
+
+		// key events the drawing thread has put in a frame, it tells the simulation which input
+		// times are still waiting for one
+		std::atomic<uint64_t> renderedInputCount{ 0 };
+
+		std::atomic<bool> renderRunning{ false };
+
+		// set by the render thread if a frame throws, GameLoop rethrows it
+		std::atomic<bool> renderFailed{ false };
+		std::exception_ptr renderError;
+
+		std::atomic<bool> swapchainResized{ false };
+
+		// CPU time of the simulation thread, sampled on that thread for the render thread's report
+		std::atomic<double> simulationCpuSeconds{ 0.0 };
+
+		// the oldest input a frame in flight was the first to show, measured when the GPU finishes it
+		struct FrameInput
+		{
+			bool pending = false;
+			std::chrono::steady_clock::time_point inputTime;
+		};
+
+		std::vector<FrameInput> frameInputs = std::vector<FrameInput>(MAX_FRAMES_IN_FLIGHT);
+
+		double latencySumMs = 0.0;
+		double latencyMaxMs = 0.0;
+		uint32_t latencySamples = 0;
+
+		uint32_t loopReportFrames = 0;
+		std::chrono::steady_clock::time_point loopReportStart;
+		double processCpuAtReport = 0.0;
+		double renderCpuAtReport = 0.0;
+		double simulationCpuAtReport = 0.0;
+
+		// view and projection, one buffer per frame in flight
+		std::vector<PVUniformBuffer*> cameraBuffers;
+
+		// per-draw constants for the descriptor rebind path, one buffer per frame in flight
+		std::vector<PVUniformBuffer*> drawBuffers;
+
+		VkDeviceSize drawBufferStride = 0;
+
+		std::vector<PVDrawConstants> drawConstants;
+
+		// the draws above hang from one double precision anchor, placed camera relative every frame
+		PVCameraRelative drawAnchor;
+		PVTransformSystem drawNodes;
+
+		enum class DrawPath
+		{
+			PushConstants,
+			DescriptorRebind,
+		};
+
+		DrawPath drawPath = DrawPath::PushConstants;
+
+		// rebindPipeline is only created when the benchmark runs
+		VkPipeline rebindPipeline = VK_NULL_HANDLE;
+
+		uint32_t benchmarkDrawCount = 0;
+
+		uint32_t bufferBenchmarkCount = 0;
+
+		uint32_t sharingBenchmarkUploads = 0;
+
+		// the sharing benchmark's last upload, exclusive then concurrent, null when it doesn't run
+		PVVertexBuffer* sharingBuffers[2] = { nullptr, nullptr };
+
+		// which of the two the forward pass draws from
+		uint32_t sharingIndex = 0;
+
+		// what each frame slot last drew from, so its timestamps are attributed correctly
+		std::vector<uint32_t> frameSharingIndices = std::vector<uint32_t>(MAX_FRAMES_IN_FLIGHT, 0);
+
+		double sharingGpuMs = 0.0;
+
+		uint32_t sharingFrames = 0;
+
+		uint32_t sharingGpuFrames = 0;
+
+		double benchmarkRecordMs = 0.0;
+
+		double benchmarkGpuMs = 0.0;
+
+		uint32_t benchmarkFrames = 0;
+
+		uint32_t benchmarkGpuFrames = 0;
+
+		PVGpuTimer* gpuTimer;
+
+		struct Prop
+		{
+			InstanceData instance;
+			glm::vec3 boundsCenter;
+			float boundsRadius;
+		};
+
+		uint32_t propCount = 0;
+
+		std::vector<Prop> props;
+
+		// the props are placed relative to the origin of the tile they belong to, only the tile
+		// origins are doubles. One tile holds them all for now
+		PVCameraRelative propTiles;
+
+		// camera relative tile matrices, pushed before the instanced draws
+		std::vector<PVDrawConstants> propTileConstants;
+
+		// one per frame in flight, empty without props
+		std::vector<PVInstanceBuffer*> instanceBuffers;
+
+		VkPipeline instancedPipeline = VK_NULL_HANDLE;
+
+		uint32_t cullReportFrames = 0;
+
+		bool occlusionCullingRequested = true;
+
+		// null when the props are frustum culled on the CPU
+		PVOcclusionCuller* occlusionCuller = nullptr;
+
+		// with occlusion culling the forward pass is split in two around the Hi-Z pyramid build
+		PVRenderGraph::PassHandle earlyCullPass;
+		PVRenderGraph::PassHandle hiZPass;
+		PVRenderGraph::PassHandle lateCullPass;
+		PVRenderGraph::PassHandle forwardLatePass;
+
+		bool terrainRequested = false;
+
+		double terrainImpactsPerSecond = 2.0;
+
+		std::string tileCacheDirectory;
+
+		// null without terrain
+		PVTerrain* terrain = nullptr;
+
+		VkPipeline terrainPipeline = VK_NULL_HANDLE;
+
+		// the terrain is textured virtually when the device lets fragment shaders write the
+		// feedback, its layout adds the texture's set after the ones the forward pass binds
+		bool virtualTexturingSupported = false;
+
+		VkDeviceSize virtualTextureUploadBudget = 512 * 1024;
+
+		// null without terrain or virtual texturing
+		PVVirtualTexture* virtualTexture = nullptr;
+
+		VkPipelineLayout terrainPipelineLayout = VK_NULL_HANDLE;
+
+		PVRenderGraph::PassHandle virtualTextureUploadPass;
+
+		// copies out which pages the frame asked for
+		PVRenderGraph::PassHandle virtualTextureFeedbackPass;
+
+		// copies the terrain's edited vertices before anything is drawn
+		PVRenderGraph::PassHandle terrainUploadPass;
+
+		PVTextureStreamer* textureStreamer = nullptr;
+
+		VkDeviceSize textureUploadBudget = 4 * 1024 * 1024;
+
+		uint32_t textureBenchmarkCount = 0;
+
+		std::string textureBenchmarkFile;
+
+		// set while the benchmark's textures stream in, reported once they are done
+		bool texturesStreaming = false;
+
+		// takes over the texture levels the transfer queue has finished before anything samples them
+		PVRenderGraph::PassHandle textureAcquirePass;
+
+		// simulation state for the impacts, only touched by the thread running GameLoop
+		double terrainImpactDebt = 0.0;
+		std::mt19937 impactRandom = std::mt19937(4321);
+
+		// one per frame in flight, recorded every frame
 		std::vector<VkCommandBuffer> commandBuffers;
 
-		VkSemaphore imageAvailableSemaphore;
+		// number of frames the CPU may record ahead of the GPU
+		static const size_t MAX_FRAMES_IN_FLIGHT = 2;
+
+		// binary semaphores, only used for swapchain acquire and present
+		std::vector<VkSemaphore> imageAvailableSemaphores;
+
+		std::vector<VkSemaphore> renderFinishedSemaphores;
+
+		size_t currentFrame = 0;
+
+		// how each frame slot was last drawn, so its timestamps are attributed correctly
+		std::vector<DrawPath> frameDrawPaths = std::vector<DrawPath>(MAX_FRAMES_IN_FLIGHT, DrawPath::PushConstants);
+
+		PVTimeline* graphicsTimeline;
+
+		PVTimeline* transferTimeline;
+
+		// graphics timeline value signaled by the last submission of each frame slot
+		std::vector<uint64_t> frameTimelineValues;
+
+		// transfer timeline value every graphics submission waits for before vertex input
+		uint64_t transferWaitValue = 0;
+
+		// resources retired here are tagged with graphics timeline values
+		PVDeletionQueue* deletionQueue;
+
+		// staging resources retired here are tagged with transfer timeline values
+		PVDeletionQueue* transferDeletionQueue;
 
-		VkSemaphore renderFinishedSemaphore;
+		PVUploadContext uploadContext;
 
-		VkDescriptorSet descriptorSet;
+		// camera and per-draw buffer of each frame in flight
+		std::vector<VkDescriptorSet> descriptorSets;
 
 
 
@@ -0,0 +1,19 @@
+// Declarations for PVBindlessTable, bound as set 1. Index with the handles returned by the
+// Register* calls, passed in through push constants or per-instance data. Wrap indices that
+// can differ within a draw in nonuniformEXT().
+// Pull in with #extension GL_GOOGLE_include_directive and #include "bindless.glsl".
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(set = 1, binding = 0) readonly buffer BindlessBuffer
+{
+	uint words[];
+} bindlessBuffers[];
+
+layout(set = 1, binding = 1) uniform texture2D bindlessTextures[];
+
+layout(set = 1, binding = 2) uniform sampler bindlessSamplers[];
+
+vec4 SampleBindless(uint textureHandle, uint samplerHandle, vec2 uv)
+{
+	return texture(sampler2D(bindlessTextures[nonuniformEXT(textureHandle)], bindlessSamplers[nonuniformEXT(samplerHandle)]), uv);
+}
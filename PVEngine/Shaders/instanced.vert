@@ -0,0 +1,49 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// true: material.frag looks the material up in the bindless table, false: tinted here
+layout(constant_id = 0) const bool BINDLESS_MATERIALS = false;
+
+layout(set = 0, binding = 0) uniform CameraBuffer
+{
+	mat4 view;
+	mat4 proj;
+} camera;
+
+// the camera relative origin of the tile the instances are placed in, instance transforms are
+// relative to it
+layout(push_constant) uniform DrawConstants
+{
+	mat4 model;
+	vec4 morph;
+} tile;
+
+layout (location = 0) in vec2 inPosition;
+layout (location = 1) in vec3 inColor;
+
+// per instance, binding 1
+layout (location = 2) in mat4 inTransform;
+layout (location = 6) in vec4 inMorph;
+layout (location = 7) in uint inMaterialIndex;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) flat out uint fragMaterialIndex;
+layout(location = 2) out vec2 fragUv;
+
+// the materials without a bindless table, the same tints PlanetVulkan puts in the material buffer
+const vec3 materialTints[4] = vec3[](vec3(1.0, 1.0, 1.0), vec3(0.6, 0.9, 0.5), vec3(0.8, 0.7, 0.5), vec3(0.6, 0.7, 0.9));
+
+void main()
+{
+	gl_Position = camera.proj * camera.view * tile.model * inTransform * vec4(inPosition, 0.0, 1.0);
+	fragColor = BINDLESS_MATERIALS ? inColor : inColor * materialTints[inMaterialIndex % 4];
+	fragMaterialIndex = inMaterialIndex;
+	// the quad spans -0.5..0.5
+	fragUv = inPosition + vec2(0.5);
+}
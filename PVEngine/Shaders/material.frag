@@ -0,0 +1,32 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "bindless.glsl"
+
+// bindless handles, mirrors PVMaterialConstants after the vertex stage's DrawConstants
+layout(push_constant) uniform MaterialConstants
+{
+	layout(offset = 80) uint materialBuffer;
+	uint materialCount;
+	// 0xFFFFFFFF until the texture's coarsest level has streamed in
+	uint albedoTexture;
+	uint albedoSampler;
+} material;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) flat in uint fragMaterialIndex;
+layout(location = 2) in vec2 fragUv;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+	// a vec4 tint per material, the table only holds words
+	uint base = (fragMaterialIndex % material.materialCount) * 4;
+	vec3 tint = uintBitsToFloat(uvec3(bindlessBuffers[material.materialBuffer].words[base],
+		bindlessBuffers[material.materialBuffer].words[base + 1], bindlessBuffers[material.materialBuffer].words[base + 2]));
+	// the view only spans the levels already streamed in, the finer ones are clamped away
+	vec3 albedo = material.albedoTexture != 0xFFFFFFFFu ? SampleBindless(material.albedoTexture, material.albedoSampler, fragUv).rgb : vec3(1.0);
+	outColor = vec4(fragColor * tint * albedo, 1.0);
+}
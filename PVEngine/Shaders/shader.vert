@@ -0,0 +1,49 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// true: the model matrix comes from push constants, false: from the dynamic uniform buffer,
+// only the draw benchmark builds the second variant
+layout(constant_id = 0) const bool MODEL_FROM_PUSH_CONSTANTS = true;
+
+layout(set = 0, binding = 0) uniform CameraBuffer
+{
+	mat4 view;
+	mat4 proj;
+} camera;
+
+layout(set = 0, binding = 1) uniform DrawBuffer
+{
+	mat4 model;
+	vec4 morph;
+} drawBuffer;
+
+layout(push_constant) uniform DrawConstants
+{
+	mat4 model;
+	vec4 morph;
+} draw;
+
+layout (location = 0) in vec2 inPosition;
+layout (location = 1) in vec3 inColor;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+
+layout(location = 0) out vec3 fragColor;
+// material.frag's table index, the quad uses the first material
+layout(location = 1) flat out uint fragMaterialIndex;
+layout(location = 2) out vec2 fragUv;
+
+
+void main()
+{
+	mat4 model = MODEL_FROM_PUSH_CONSTANTS ? draw.model : drawBuffer.model;
+	gl_Position = camera.proj * camera.view * model * vec4(inPosition, 0.0, 1.0);
+	fragColor = inColor;
+	fragMaterialIndex = 0;
+	// the quad spans -0.5..0.5
+	fragUv = inPosition + vec2(0.5);
+}
@@ -0,0 +1,109 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Terrain surface from the virtual texture. The mip the pixel needs picks a page, the page
+// table says which page of the physical cache holds it, or the closest coarser page that is
+// resident. One pixel in 16, a different one every frame, reports the page it wanted.
+
+// feedback only from pixels that end up visible
+layout(early_fragment_tests) in;
+
+// matches PVVirtualTexture::Uniforms
+layout(set = 2, binding = 0) uniform VirtualTexture
+{
+	float size;
+	uint pagesPerSide;
+	uint mipCount;
+	uint pageSize;
+	uint pageBorder;
+	uint cachePagesPerSide;
+	uint feedbackPhase;
+	uint unused;
+} vt;
+
+// slot x in bits 0-7, slot y in 8-15, the resident page's mip in 16-23, all ones until the
+// coarsest page is in
+layout(set = 2, binding = 1) readonly buffer PageTable
+{
+	uint entries[];
+} pageTable;
+
+layout(set = 2, binding = 2) writeonly buffer Feedback
+{
+	uint requested[];
+} feedback;
+
+layout(set = 2, binding = 3) uniform sampler2D heightCache;
+layout(set = 2, binding = 4) uniform sampler2D albedoCache;
+
+layout(location = 1) in vec3 terrainPosition;
+layout(location = 2) in vec3 terrainNormal;
+
+layout(location = 0) out vec4 outColor;
+
+const vec3 lightDirection = vec3(0.36, 0.27, 0.89);
+
+// the page table holds every mip's pages one after the other, finest first
+uint levelOffset(uint mip)
+{
+	uint offset = 0;
+	for (uint level = 0; level < mip; level++)
+	{
+		uint pages = vt.pagesPerSide >> level;
+		offset += pages * pages;
+	}
+	return offset;
+}
+
+// terrain space gradient of a value from its screen space derivatives
+vec2 terrainGradient(float value)
+{
+	mat2 screenToTerrain = mat2(dFdx(terrainPosition.xy), dFdy(terrainPosition.xy));
+	if (abs(determinant(screenToTerrain)) < 1e-12)
+	{
+		return vec2(0.0);
+	}
+	return inverse(transpose(screenToTerrain)) * vec2(dFdx(value), dFdy(value));
+}
+
+void main()
+{
+	uint payload = vt.pageSize - 2 * vt.pageBorder;
+	vec2 uv = clamp(terrainPosition.xy / vt.size, vec2(0.0), vec2(0.99999));
+
+	vec2 texel = uv * float(vt.pagesPerSide * payload);
+	vec2 texelX = dFdx(texel);
+	vec2 texelY = dFdy(texel);
+	float lod = 0.5 * log2(max(max(dot(texelX, texelX), dot(texelY, texelY)), 1e-8));
+	uint mip = uint(clamp(lod, 0.0, float(vt.mipCount - 1)));
+
+	uint pages = vt.pagesPerSide >> mip;
+	uvec2 page = uvec2(uv * float(pages));
+	uint index = levelOffset(mip) + page.y * pages + page.x;
+
+	uvec2 cell = uvec2(gl_FragCoord.xy) & 3u;
+	if (cell.y * 4 + cell.x == vt.feedbackPhase)
+	{
+		feedback.requested[index] = 1u;
+	}
+
+	vec3 albedo = vec3(0.4, 0.4, 0.35);
+	float height = terrainPosition.z;
+	uint entry = pageTable.entries[index];
+	if (entry != 0xFFFFFFFFu)
+	{
+		uvec2 slot = uvec2(entry & 0xFFu, (entry >> 8) & 0xFFu);
+		uint residentPages = vt.pagesPerSide >> ((entry >> 16) & 0xFFu);
+		vec2 local = fract(uv * float(residentPages));
+		vec2 physical = (vec2(slot * vt.pageSize + vt.pageBorder) + local * float(payload)) / float(vt.cachePagesPerSide * vt.pageSize);
+		albedo = textureLod(albedoCache, physical, 0.0).rgb;
+		height = textureLod(heightCache, physical, 0.0).r;
+	}
+
+	// the mesh's normal already has the slopes it can show, the texture adds the finer ones
+	vec2 detail = terrainGradient(height) - terrainGradient(terrainPosition.z);
+	vec3 normal = normalize(normalize(terrainNormal) + vec3(-detail, 0.0));
+
+	float light = 0.25 + 0.75 * max(dot(normal, lightDirection), 0.0);
+	outColor = vec4(albedo * light, 1.0);
+}
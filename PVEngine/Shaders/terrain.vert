@@ -0,0 +1,46 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(set = 0, binding = 0) uniform CameraBuffer
+{
+	mat4 view;
+	mat4 proj;
+} camera;
+
+// the camera relative origin of the tile, vertex positions are relative to it, morph.zw is
+// the tile's corner in terrain space
+layout(push_constant) uniform DrawConstants
+{
+	mat4 model;
+	vec4 morph;
+} tile;
+
+layout (location = 0) in vec3 inPosition;
+layout (location = 1) in vec3 inNormal;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+
+layout(location = 0) out vec3 fragColor;
+
+// for terrain.frag, which looks the surface up in the virtual texture
+layout(location = 1) out vec3 terrainPosition;
+layout(location = 2) out vec3 terrainNormal;
+
+const vec3 lightDirection = vec3(0.36, 0.27, 0.89);
+
+void main()
+{
+	gl_Position = camera.proj * camera.view * tile.model * vec4(inPosition, 1.0);
+
+	// tiles are only translated, so the normal needs no transform for lighting
+	float light = 0.25 + 0.75 * max(dot(normalize(inNormal), lightDirection), 0.0);
+	vec3 ground = mix(vec3(0.45, 0.35, 0.25), vec3(0.35, 0.55, 0.3), clamp(inPosition.z * 4.0 + 0.5, 0.0, 1.0));
+	fragColor = ground * light;
+
+	terrainPosition = vec3(tile.morph.zw + inPosition.xy, inPosition.z);
+	terrainNormal = inNormal;
+}
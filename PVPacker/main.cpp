@@ -0,0 +1,315 @@
+#include <PVEngine/PVAssetPack.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace PVEngine;
+
+namespace
+{
+	// matches PVEngine::Vertex, a vec2 position and a vec3 color
+	const uint32_t VertexStride = 5 * sizeof(float);
+
+	// size of the staging chunk both benchmark paths copy into, like a staging ring buffer
+	const size_t StagingChunkSize = 64 * 1024 * 1024;
+
+	void PrintWritten(const std::string& filename, const PVAssetPackWriter& writer)
+	{
+		std::cout << "Asset pack " << filename << " written with " << writer.GetBlobCount() << " blobs, " << writer.GetFileSize() << " bytes" << std::endl;
+	}
+
+	void PrintUsage()
+	{
+		std::cout << "Usage:" << std::endl;
+		std::cout << "  PVPacker pack <output.pvpack> <name>:<vertices|indices|raw>:<file> ..." << std::endl;
+		std::cout << "      .txt files hold whitespace separated numbers (floats for vertices, integers for indices)," << std::endl;
+		std::cout << "      anything else is copied as raw bytes already in GPU layout" << std::endl;
+		std::cout << "  PVPacker list <pack.pvpack>" << std::endl;
+		std::cout << "  PVPacker synth <output.pvpack> <gigabytes>" << std::endl;
+		std::cout << "      writes a pack of generated meshes to benchmark with" << std::endl;
+		std::cout << "  PVPacker bench <pack.pvpack> [iterations]" << std::endl;
+		std::cout << "      compares mapping the pack against reading it with ifstream" << std::endl;
+	}
+
+	std::vector<char> ReadInput(const std::string& filename, PVPackFormat::BlobType type)
+	{
+		bool text = filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".txt") == 0;
+		std::ifstream file(filename, text ? std::ios::in : std::ios::binary);
+		if (!file.is_open())
+		{
+			throw std::runtime_error("Failed to open " + filename);
+		}
+
+		std::vector<char> data;
+		if (!text)
+		{
+			data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			return data;
+		}
+
+		std::string token;
+		while (file >> token)
+		{
+			if (type == PVPackFormat::BlobType::Indices32)
+			{
+				uint32_t value = static_cast<uint32_t>(std::stoul(token));
+				data.insert(data.end(), reinterpret_cast<char*>(&value), reinterpret_cast<char*>(&value) + sizeof(value));
+			}
+			else
+			{
+				float value = std::stof(token);
+				data.insert(data.end(), reinterpret_cast<char*>(&value), reinterpret_cast<char*>(&value) + sizeof(value));
+			}
+		}
+		return data;
+	}
+
+	void Pack(int argc, char** argv)
+	{
+		PVAssetPackWriter writer;
+		writer.Open(argv[2]);
+
+		for (int i = 3; i < argc; i++)
+		{
+			std::string argument = argv[i];
+			size_t first = argument.find(':');
+			size_t second = argument.find(':', first + 1);
+			if (first == std::string::npos || second == std::string::npos)
+			{
+				throw std::runtime_error("Expected <name>:<type>:<file>, got " + argument);
+			}
+
+			std::string name = argument.substr(0, first);
+			std::string typeName = argument.substr(first + 1, second - first - 1);
+			std::string filename = argument.substr(second + 1);
+
+			PVPackFormat::BlobType type;
+			uint32_t stride;
+			if (typeName == "vertices")
+			{
+				type = PVPackFormat::BlobType::Vertices;
+				stride = VertexStride;
+			}
+			else if (typeName == "indices")
+			{
+				type = PVPackFormat::BlobType::Indices32;
+				stride = sizeof(uint32_t);
+			}
+			else if (typeName == "raw")
+			{
+				type = PVPackFormat::BlobType::Raw;
+				stride = 1;
+			}
+			else
+			{
+				throw std::runtime_error("Unknown blob type " + typeName);
+			}
+
+			std::vector<char> data = ReadInput(filename, type);
+			writer.AddBlob(name, type, stride, data.data(), data.size());
+		}
+
+		writer.Finish();
+		PrintWritten(argv[2], writer);
+	}
+
+	void List(const std::string& filename)
+	{
+		PVAssetPack pack;
+		pack.Open(filename);
+		std::cout << "Asset pack " << filename << " opened with " << pack.GetEntries().size() << " blobs" << std::endl;
+		for (const auto& entry : pack.GetEntries())
+		{
+			std::cout << "  " << entry.name << " type " << static_cast<uint32_t>(entry.type) << " stride " << entry.stride
+				<< " offset " << entry.offset << " size " << entry.size << std::endl;
+		}
+	}
+
+	void Synth(const std::string& filename, double gigabytes)
+	{
+		// grids of 1024x1024 vertices, written a row at a time so memory use stays flat
+		const uint32_t gridSize = 1024;
+		const uint64_t gridBytes = uint64_t(gridSize) * gridSize * VertexStride + uint64_t(gridSize - 1) * (gridSize - 1) * 6 * sizeof(uint32_t);
+		const uint64_t gridCount = std::max<uint64_t>(1, static_cast<uint64_t>(gigabytes * 1024.0 * 1024.0 * 1024.0) / gridBytes);
+
+		PVAssetPackWriter writer;
+		writer.Open(filename);
+
+		std::vector<float> vertexRow(gridSize * 5);
+		std::vector<uint32_t> indexRow((gridSize - 1) * 6);
+		for (uint64_t grid = 0; grid < gridCount; grid++)
+		{
+			writer.BeginBlob("grid" + std::to_string(grid) + ".vertices", PVPackFormat::BlobType::Vertices, VertexStride);
+			for (uint32_t y = 0; y < gridSize; y++)
+			{
+				for (uint32_t x = 0; x < gridSize; x++)
+				{
+					float* vertex = &vertexRow[x * 5];
+					vertex[0] = static_cast<float>(x) / (gridSize - 1) - 0.5f;
+					vertex[1] = static_cast<float>(y) / (gridSize - 1) - 0.5f;
+					vertex[2] = static_cast<float>(x) / gridSize;
+					vertex[3] = static_cast<float>(y) / gridSize;
+					vertex[4] = static_cast<float>(grid % 8) / 8.0f;
+				}
+				writer.WriteBlobData(vertexRow.data(), vertexRow.size() * sizeof(float));
+			}
+			writer.EndBlob();
+
+			writer.BeginBlob("grid" + std::to_string(grid) + ".indices", PVPackFormat::BlobType::Indices32, sizeof(uint32_t));
+			for (uint32_t y = 0; y < gridSize - 1; y++)
+			{
+				for (uint32_t x = 0; x < gridSize - 1; x++)
+				{
+					uint32_t corner = y * gridSize + x;
+					uint32_t* quad = &indexRow[x * 6];
+					quad[0] = corner;
+					quad[1] = corner + 1;
+					quad[2] = corner + gridSize + 1;
+					quad[3] = corner + gridSize + 1;
+					quad[4] = corner + gridSize;
+					quad[5] = corner;
+				}
+				writer.WriteBlobData(indexRow.data(), indexRow.size() * sizeof(uint32_t));
+			}
+			writer.EndBlob();
+		}
+
+		writer.Finish();
+		PrintWritten(filename, writer);
+	}
+
+	// copies a blob through the staging chunk the way an upload would, returns a checksum so the
+	// copies cannot be optimized away
+	uint64_t StageBlob(const uint8_t* data, uint64_t size, std::vector<uint8_t>& staging)
+	{
+		uint64_t checksum = 0;
+		for (uint64_t offset = 0; offset < size; offset += staging.size())
+		{
+			size_t chunk = static_cast<size_t>(std::min<uint64_t>(staging.size(), size - offset));
+			memcpy(staging.data(), data + offset, chunk);
+			checksum += staging[0] + staging[chunk - 1];
+		}
+		return checksum;
+	}
+
+	// the previous path: read the whole file into memory, parse the table, then stage each blob
+	uint64_t LoadWithStream(const std::string& filename, std::vector<uint8_t>& staging)
+	{
+		std::ifstream file(filename, std::ios::ate | std::ios::binary);
+		if (!file.is_open())
+		{
+			throw std::runtime_error("Failed to open " + filename);
+		}
+
+		size_t fileSize = static_cast<size_t>(file.tellg());
+		std::vector<char> buffer(fileSize);
+		file.seekg(0);
+		file.read(buffer.data(), fileSize);
+		file.close();
+
+		PVPackFormat::Header header;
+		memcpy(&header, buffer.data(), sizeof(header));
+		std::vector<PVPackFormat::TocEntry> entries(header.entryCount);
+		memcpy(entries.data(), buffer.data() + header.tocOffset, entries.size() * sizeof(PVPackFormat::TocEntry));
+
+		uint64_t checksum = 0;
+		for (const auto& entry : entries)
+		{
+			checksum += StageBlob(reinterpret_cast<const uint8_t*>(buffer.data()) + entry.offset, entry.size, staging);
+		}
+		return checksum;
+	}
+
+	uint64_t LoadWithMapping(const std::string& filename, std::vector<uint8_t>& staging)
+	{
+		PVAssetPack pack;
+		pack.Open(filename);
+
+		uint64_t checksum = 0;
+		for (const auto& entry : pack.GetEntries())
+		{
+			checksum += StageBlob(static_cast<const uint8_t*>(pack.GetData(entry)), entry.size, staging);
+		}
+		return checksum;
+	}
+
+	void Bench(const std::string& filename, int iterations)
+	{
+		std::vector<uint8_t> staging(StagingChunkSize);
+		uint64_t fileSize;
+		{
+			PVAssetPack pack;
+			pack.Open(filename);
+			fileSize = pack.GetFileSize();
+		}
+
+		std::cout << "Benchmarking " << filename << " (" << fileSize / (1024 * 1024) << " MB), " << iterations << " iterations" << std::endl;
+		std::cout << "The first iteration of the first method may include cold page cache reads" << std::endl;
+
+		const char* names[] = { "ifstream + copy", "mapped" };
+		for (int method = 0; method < 2; method++)
+		{
+			double totalMs = 0.0;
+			double bestMs = 0.0;
+			for (int i = 0; i < iterations; i++)
+			{
+				auto start = std::chrono::high_resolution_clock::now();
+				uint64_t checksum = (method == 0) ? LoadWithStream(filename, staging) : LoadWithMapping(filename, staging);
+				auto end = std::chrono::high_resolution_clock::now();
+
+				double ms = std::chrono::duration<double, std::milli>(end - start).count();
+				totalMs += ms;
+				bestMs = (i == 0) ? ms : std::min(bestMs, ms);
+				std::cout << "  " << names[method] << " iteration " << i << ": " << ms << " ms (checksum " << checksum << ")" << std::endl;
+			}
+
+			double averageMs = totalMs / iterations;
+			std::cout << names[method] << ": average " << averageMs << " ms, best " << bestMs << " ms, "
+				<< (fileSize / (1024.0 * 1024.0 * 1024.0)) / (bestMs / 1000.0) << " GB/s" << std::endl;
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		std::string command = (argc > 1) ? argv[1] : "";
+		if (command == "pack" && argc > 3)
+		{
+			Pack(argc, argv);
+		}
+		else if (command == "list" && argc == 3)
+		{
+			List(argv[2]);
+		}
+		else if (command == "synth" && argc == 4)
+		{
+			Synth(argv[2], std::stod(argv[3]));
+		}
+		else if (command == "bench" && (argc == 3 || argc == 4))
+		{
+			Bench(argv[2], (argc == 4) ? std::stoi(argv[3]) : 3);
+		}
+		else
+		{
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
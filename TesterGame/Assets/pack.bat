@@ -0,0 +1,2 @@
+..\..\x64\Release\PVPacker.exe pack meshes.pvpack quad.vertices:vertices:Source\quad_vertices.txt quad.indices:indices:Source\quad_indices.txt
+pause
\ No newline at end of file
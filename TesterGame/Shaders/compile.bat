@@ -1,3 +1,9 @@
-C:\VulkanSDK\1.0.68.0\Bin32\glslangValidator.exe -V shader.vert
-C:\VulkanSDK\1.0.68.0\Bin32\glslangValidator.exe -V shader.frag
-pause
+%VULKAN_SDK%\Bin\glslangValidator.exe -V ..\..\PVEngine\Shaders\shader.vert -o vert.spv
+%VULKAN_SDK%\Bin\glslangValidator.exe -V ..\..\PVEngine\Shaders\shader.frag -o frag.spv
+%VULKAN_SDK%\Bin\glslangValidator.exe -V ..\..\PVEngine\Shaders\material.frag -o material_frag.spv
+%VULKAN_SDK%\Bin\glslangValidator.exe -V ..\..\PVEngine\Shaders\instanced.vert -o instanced_vert.spv
+%VULKAN_SDK%\Bin\glslangValidator.exe -V ..\..\PVEngine\Shaders\hiz_pyramid.comp -o hiz_pyramid_comp.spv
+%VULKAN_SDK%\Bin\glslangValidator.exe -V ..\..\PVEngine\Shaders\hiz_cull.comp -o hiz_cull_comp.spv
+%VULKAN_SDK%\Bin\glslangValidator.exe -V ..\..\PVEngine\Shaders\terrain.vert -o terrain_vert.spv
+%VULKAN_SDK%\Bin\glslangValidator.exe -V ..\..\PVEngine\Shaders\terrain.frag -o terrain_frag.spv
+pause
\ No newline at end of file
@@ -1,27 +0,0 @@
-#version 450
-#extension GL_ARB_separate_shader_objects : enable
-
-layout(binding = 0) uniform UniformBufferObject
-{
-	mat4 model;
-	mat4 view;
-	mat4 proj;
-} ubo;
-
-layout (location = 0) in vec2 inPosition;
-layout (location = 1) in vec3 inColor;
-
-out gl_PerVertex
-{
-	vec4 gl_Position;
-};
-
-
-layout(location = 0) out vec3 fragColor;
-
-
-void main()
-{
-	gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 0.0, 1.0);
-	fragColor = inColor;
-}
\ No newline at end of file
@@ -11,6 +11,9 @@ public:
 
 	void Run();
 
+	// for configuring the engine before Run
+	PVEngine::PlanetVulkan& GetEngine() { return m_engine; }
+
 private:
 
 	void InitSystems();
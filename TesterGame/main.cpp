@@ -3,11 +3,155 @@
 #include "TesterGame.h"
 #include <stdexcept>
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// every operator new in the process goes through here so --count-allocations can report how
+// many heap allocations a frame makes, counted per thread so other threads' allocations don't
+// land in the frame the engine is sampling
+static thread_local uint64_t heapAllocationCount = 0;
+
+void* operator new(size_t size)
+{
+	heapAllocationCount++;
+	if (void* memory = malloc(size != 0 ? size : 1))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
 
 int main(int argc, char** argv)
 {
 	TesterGame testGame;
 
+	PVEngine::PVFramePacer::Policy pacingPolicy = PVEngine::PVFramePacer::Policy::LowLatency;
+	double targetFps = 0.0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		// --draw-benchmark <draws> compares push constants against per-draw descriptor rebinding
+		if (strcmp(argv[i], "--draw-benchmark") == 0 && i + 1 < argc)
+		{
+			testGame.GetEngine().SetDrawBenchmark(static_cast<uint32_t>(atoi(argv[++i])));
+		}
+		// --buffer-benchmark <count> times creating and destroying count buffers of each kind after startup
+		else if (strcmp(argv[i], "--buffer-benchmark") == 0 && i + 1 < argc)
+		{
+			testGame.GetEngine().SetBufferBenchmark(static_cast<uint32_t>(atoi(argv[++i])));
+		}
+		// --sharing-benchmark <uploads> compares exclusive and concurrent vertex buffers, uploading and drawing
+		else if (strcmp(argv[i], "--sharing-benchmark") == 0 && i + 1 < argc)
+		{
+			testGame.GetEngine().SetSharingBenchmark(static_cast<uint32_t>(atoi(argv[++i])));
+		}
+		// --props <count> scatters instanced props that are culled and drawn in one call
+		else if (strcmp(argv[i], "--props") == 0 && i + 1 < argc)
+		{
+			testGame.GetEngine().SetPropCount(static_cast<uint32_t>(atoi(argv[++i])));
+		}
+		// --single-thread draws on the simulation thread instead of a render thread of its own
+		else if (strcmp(argv[i], "--single-thread") == 0)
+		{
+			testGame.GetEngine().SetRenderThreadEnabled(false);
+		}
+		// --pacing low-latency|power-saving|fixed picks the frame pacing policy
+		else if (strcmp(argv[i], "--pacing") == 0 && i + 1 < argc)
+		{
+			const char* policy = argv[++i];
+			if (strcmp(policy, "power-saving") == 0)
+			{
+				pacingPolicy = PVEngine::PVFramePacer::Policy::PowerSaving;
+			}
+			else if (strcmp(policy, "fixed") == 0)
+			{
+				pacingPolicy = PVEngine::PVFramePacer::Policy::FixedRate;
+			}
+			else
+			{
+				pacingPolicy = PVEngine::PVFramePacer::Policy::LowLatency;
+			}
+		}
+		// --target-fps <fps> frame rate for the power saving and fixed rate policies
+		else if (strcmp(argv[i], "--target-fps") == 0 && i + 1 < argc)
+		{
+			targetFps = atof(argv[++i]);
+		}
+		// --swapchain-images <count> overrides the number of swapchain images
+		else if (strcmp(argv[i], "--swapchain-images") == 0 && i + 1 < argc)
+		{
+			testGame.GetEngine().SetSwapchainImageCount(static_cast<uint32_t>(atoi(argv[++i])));
+		}
+		// --no-occlusion-culling only frustum culls the props, on the CPU
+		else if (strcmp(argv[i], "--no-occlusion-culling") == 0)
+		{
+			testGame.GetEngine().SetOcclusionCulling(false);
+		}
+		// --target-gpu-ms <ms> sets the GPU frame time dynamic resolution aims for, 0 renders at full resolution
+		else if (strcmp(argv[i], "--target-gpu-ms") == 0 && i + 1 < argc)
+		{
+			double targetGpuMs = atof(argv[++i]);
+			testGame.GetEngine().SetDynamicResolution(targetGpuMs > 0.0, targetGpuMs > 0.0 ? targetGpuMs : 15.0);
+		}
+		// --terrain <impacts per second> lays a deformable terrain under the scene and craters it at random
+		else if (strcmp(argv[i], "--terrain") == 0 && i + 1 < argc)
+		{
+			testGame.GetEngine().SetTerrain(true, atof(argv[++i]));
+		}
+		// --tile-cache <directory> stores the generated terrain tiles there and loads them on later runs
+		else if (strcmp(argv[i], "--tile-cache") == 0 && i + 1 < argc)
+		{
+			testGame.GetEngine().SetTileCacheDirectory(argv[++i]);
+		}
+		// --vt-upload-kb <KB> caps the virtual texture pages the terrain uploads per frame
+		else if (strcmp(argv[i], "--vt-upload-kb") == 0 && i + 1 < argc)
+		{
+			testGame.GetEngine().SetVirtualTextureUploadBudget(static_cast<VkDeviceSize>(atoi(argv[++i])) * 1024);
+		}
+		// --texture-upload-kb <KB> caps the texture levels copied per frame
+		else if (strcmp(argv[i], "--texture-upload-kb") == 0 && i + 1 < argc)
+		{
+			testGame.GetEngine().SetTextureUploadBudget(static_cast<VkDeviceSize>(atoi(argv[++i])) * 1024);
+		}
+		// --texture-benchmark <count> streams count generated 2048x2048 textures and reports the throughput,
+		// run with VK_ICD_FILENAMES pointing at lavapipe or SwiftShader to measure under a software ICD
+		else if (strcmp(argv[i], "--texture-benchmark") == 0 && i + 1 < argc)
+		{
+			testGame.GetEngine().SetTextureBenchmark(static_cast<uint32_t>(atoi(argv[++i])));
+		}
+		// --texture-benchmark-file <file.ktx2> <count> the same with count copies of a KTX2 file
+		else if (strcmp(argv[i], "--texture-benchmark-file") == 0 && i + 2 < argc)
+		{
+			const char* filename = argv[++i];
+			testGame.GetEngine().SetTextureBenchmark(static_cast<uint32_t>(atoi(argv[++i])), filename);
+		}
+		// --camera-relative-benchmark times the per-frame camera relative matrices for 100k objects and exits
+		else if (strcmp(argv[i], "--camera-relative-benchmark") == 0)
+		{
+			PVEngine::PVCameraRelative::Benchmark(100000);
+			return EXIT_SUCCESS;
+		}
+		// --transform-benchmark times the batched transform kernels on 1000 planets with moons and props and exits
+		else if (strcmp(argv[i], "--transform-benchmark") == 0)
+		{
+			PVEngine::PVTransformSystem::Benchmark(1000);
+			return EXIT_SUCCESS;
+		}
+		// --count-allocations prints how many heap allocations steady state frames make
+		else if (strcmp(argv[i], "--count-allocations") == 0)
+		{
+			testGame.GetEngine().SetAllocationCounter([]() { return heapAllocationCount; });
+		}
+	}
+
+	testGame.GetEngine().SetFramePacing(pacingPolicy, targetFps);
+
 	try
 	{
 		testGame.Run();